@@ -0,0 +1,204 @@
+#include <obs-module.h>
+#include "audio-kernels.h"
+#include <math.h>
+#include <stdio.h>
+
+// Checks every kernel table the CPU can run against the scalar table. The
+// mixes must match bit for bit for every channel count, every length up to
+// two of the widest vector blocks and every misalignment of the inputs and
+// the output; the reductions must agree to rounding. The scalar table is
+// itself checked against the original audio-buffer.c loops. Every mismatch
+// is reported and the exit status is non-zero if there was any.
+
+#define TEST_MAX_FRAMES 32 // two 16-float AVX2 reduction blocks
+#define TEST_MAX_OFFSET 8  // one AVX2 register of misalignment
+#define TEST_BUFFER (TEST_MAX_FRAMES + TEST_MAX_OFFSET)
+#define TEST_MAX_TABLES 8
+#define TEST_TOLERANCE 1e-5f
+
+enum test_format {
+    TEST_FORMAT_FLOAT,
+    TEST_FORMAT_S16,
+    TEST_FORMAT_S32,
+    TEST_FORMAT_COUNT
+};
+
+static const char *const format_names[TEST_FORMAT_COUNT] = {"float", "s16", "s32"};
+
+struct test_input {
+    float f[MAX_AV_PLANES][TEST_BUFFER];
+    int16_t s16[MAX_AV_PLANES][TEST_BUFFER];
+    int32_t s32[MAX_AV_PLANES][TEST_BUFFER];
+};
+
+static struct test_input input;
+static int failures = 0;
+
+// Deterministic pseudo-random samples including the extremes and signed zero
+static void fill_input(void)
+{
+    uint32_t seed = 0x12345678u;
+    for (uint32_t c = 0; c < MAX_AV_PLANES; c++) {
+        for (uint32_t i = 0; i < TEST_BUFFER; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            input.s32[c][i] = (int32_t)seed;
+            input.s16[c][i] = (int16_t)(seed >> 16);
+            input.f[c][i] = (float)input.s32[c][i] * (1.0f / 2147483648.0f);
+        }
+        for (uint32_t i = 0; i < TEST_BUFFER; i += 11) {
+            input.s16[c][i] = INT16_MIN;
+            input.s32[c][i] = INT32_MIN;
+            input.s16[c][i + 1] = INT16_MAX;
+            input.s32[c][i + 1] = INT32_MAX;
+            input.f[c][i + 2] = -0.0f;
+        }
+    }
+}
+
+// The original audio-buffer.c loops, verbatim
+static void reference_mix(enum test_format format, const void *const *src, uint32_t channels,
+                          float *dst, size_t frames)
+{
+    if (format == TEST_FORMAT_FLOAT && channels == 1) {
+        memcpy(dst, src[0], frames * sizeof(float));
+        return;
+    }
+    
+    for (size_t i = 0; i < frames; i++) {
+        float sample_sum = 0.0f;
+        for (uint32_t c = 0; c < channels; c++) {
+            if (format == TEST_FORMAT_FLOAT) {
+                sample_sum += ((const float *)src[c])[i];
+            } else if (format == TEST_FORMAT_S16) {
+                sample_sum += (float)((const int16_t *)src[c])[i] / 32768.0f;
+            } else {
+                sample_sum += (float)((const int32_t *)src[c])[i] / 2147483648.0f;
+            }
+        }
+        dst[i] = sample_sum / (float)channels;
+    }
+}
+
+static void run_mix(const struct audio_kernels *kernels, enum test_format format,
+                    const void *const *src, uint32_t channels, float *dst, size_t frames)
+{
+    if (format == TEST_FORMAT_FLOAT) {
+        kernels->mix_float((const float *const *)src, channels, dst, frames);
+    } else if (format == TEST_FORMAT_S16) {
+        kernels->mix_s16((const int16_t *const *)src, channels, dst, frames);
+    } else {
+        kernels->mix_s32((const int32_t *const *)src, channels, dst, frames);
+    }
+}
+
+static const void *plane(enum test_format format, uint32_t channel, size_t offset)
+{
+    if (format == TEST_FORMAT_FLOAT) {
+        return input.f[channel] + offset;
+    }
+    if (format == TEST_FORMAT_S16) {
+        return input.s16[channel] + offset;
+    }
+    return input.s32[channel] + offset;
+}
+
+static void fail(const char *name, const char *what, const char *format, uint32_t channels,
+                 size_t frames, size_t offset)
+{
+    fprintf(stderr, "FAIL %s %s: %s, %u channels, %zu frames, offset %zu\n", name, what,
+            format, channels, frames, offset);
+    failures++;
+}
+
+// Against the scalar table, or the verbatim loops when `kernels` is scalar.
+// Each channel starts at a different offset, so no two inputs share an
+// alignment, and the output is misaligned by the same offset. The guard
+// after the output catches writes past the last frame.
+static void check_mixes(const struct audio_kernels *kernels, const struct audio_kernels *scalar)
+{
+    float expected[TEST_BUFFER + 1];
+    float actual[TEST_BUFFER + 1];
+    const float guard = 12345.0f;
+    
+    for (int f = 0; f < TEST_FORMAT_COUNT; f++) {
+        enum test_format format = (enum test_format)f;
+        
+        for (uint32_t channels = 1; channels <= MAX_AV_PLANES; channels++) {
+            for (size_t offset = 0; offset < TEST_MAX_OFFSET; offset++) {
+                const void *src[MAX_AV_PLANES];
+                for (uint32_t c = 0; c < channels; c++) {
+                    src[c] = plane(format, c, (offset + c) % TEST_MAX_OFFSET);
+                }
+                
+                for (size_t frames = 0; frames <= TEST_MAX_FRAMES; frames++) {
+                    memset(expected, 0, sizeof(expected));
+                    memset(actual, 0, sizeof(actual));
+                    actual[offset + frames] = guard;
+                    
+                    if (kernels == scalar) {
+                        reference_mix(format, src, channels, expected + offset, frames);
+                    } else {
+                        run_mix(scalar, format, src, channels, expected + offset, frames);
+                    }
+                    run_mix(kernels, format, src, channels, actual + offset, frames);
+                    
+                    if (memcmp(expected + offset, actual + offset, frames * sizeof(float)) != 0) {
+                        fail(kernels->name, "mix differs", format_names[f], channels, frames,
+                             offset);
+                    } else if (actual[offset + frames] != guard) {
+                        fail(kernels->name, "mix overruns", format_names[f], channels, frames,
+                             offset);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static bool close_enough(float actual, float expected, float scale)
+{
+    return fabsf(actual - expected) <= TEST_TOLERANCE * fmaxf(scale, 1e-30f);
+}
+
+static void check_reductions(const struct audio_kernels *kernels,
+                             const struct audio_kernels *scalar)
+{
+    for (size_t offset = 0; offset < TEST_MAX_OFFSET; offset++) {
+        const float *a = input.f[0] + offset;
+        const float *b = input.f[1] + (offset + 1) % TEST_MAX_OFFSET;
+        
+        for (size_t count = 0; count <= TEST_MAX_FRAMES; count++) {
+            float energy = scalar->sum_squares(a, count);
+            float energy_b = scalar->sum_squares(b, count);
+            if (!close_enough(kernels->sum_squares(a, count), energy, energy)) {
+                fail(kernels->name, "sum_squares out of tolerance", "float", 1, count, offset);
+            }
+            
+            // Cauchy-Schwarz bounds the dot product's rounding error
+            float bound = sqrtf(energy * energy_b);
+            if (!close_enough(kernels->dot(a, b, count), scalar->dot(a, b, count), bound)) {
+                fail(kernels->name, "dot out of tolerance", "float", 2, count, offset);
+            }
+        }
+    }
+}
+
+int main(void)
+{
+    const struct audio_kernels *tables[TEST_MAX_TABLES];
+    size_t count = audio_kernels_supported(tables, TEST_MAX_TABLES);
+    const struct audio_kernels *scalar = audio_kernels_scalar();
+    
+    fill_input();
+    
+    for (size_t i = 0; i < count; i++) {
+        int before = failures;
+        check_mixes(tables[i], scalar);
+        if (tables[i] != scalar) {
+            check_reductions(tables[i], scalar);
+        }
+        printf("%-8s %s\n", tables[i]->name, failures == before ? "ok" : "FAILED");
+    }
+    
+    return failures == 0 ? 0 : 1;
+}
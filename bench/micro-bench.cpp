@@ -0,0 +1,580 @@
+#include <obs-module.h>
+#include <util/platform.h>
+#include "obs-shim.h"
+#include "audio-buffer.h"
+#include "audio-kernels.h"
+#include "audio-ring.h"
+#include "llm-corrector.h"
+#include <json/json.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Microbenchmarks for the code on the audio thread and the worker's hot
+// path: the downmix kernels behind audio_buffer_convert_to_mono_float, the
+// silence detector, the ingest ring, the resampler and the JSON work of an
+// LLM correction. Results can be written as JSON and compared against an
+// earlier run; the comparison exits non-zero past --max-regression.
+
+#define MICRO_PACKET_FRAMES AUDIO_OUTPUT_FRAMES // what OBS hands a filter
+#define MICRO_RING_CAPACITY (16000 * 8)          // the filter's ingest ring
+#define MICRO_LLM_SEGMENTS 8                      // the corrector's batch limit
+
+struct micro_options {
+    const char* filter = nullptr;
+    const char* json_path = nullptr;
+    const char* baseline_path = nullptr;
+    double min_time_ms = 20.0;
+    int repetitions = 5;
+    double max_regression = -1.0; // percent, off when negative
+};
+
+struct micro_result {
+    std::string name;
+    const char* unit;
+    uint64_t items; // per operation
+    uint64_t iterations;
+    double ns_per_op;     // median over the repetitions
+    double ns_per_op_min;
+};
+
+// One benchmark: `run` performs `iterations` operations on `items` units
+// of work each. Setup happens before it is timed.
+struct micro_case {
+    std::string name;
+    const char* unit;
+    uint64_t items;
+    std::function<void(uint64_t iterations)> run;
+};
+
+static volatile float micro_sink; // keeps results alive
+
+static void micro_usage(void) {
+    fprintf(stderr,
+            "usage: micro-bench [options]\n"
+            "\n"
+            "  --filter TEXT         run only benchmarks whose name contains TEXT\n"
+            "  --min-time MS         time per repetition (default 20)\n"
+            "  --repetitions N       repetitions, the median is reported (default 5)\n"
+            "  --json FILE           write the results as JSON, - for stdout\n"
+            "  --baseline FILE       compare against the JSON of an earlier run\n"
+            "  --max-regression PCT  fail if a benchmark is more than PCT percent slower\n"
+            "                        than in the baseline\n");
+}
+
+// Deterministic noise, so every run converts the same samples
+static uint32_t micro_random(uint32_t* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state;
+}
+
+static float micro_random_sample(uint32_t* state) {
+    return (float)(micro_random(state) >> 8) / (float)(1u << 23) - 1.0f;
+}
+
+// Planar audio in any of OBS' formats, one packet long
+class MicroAudio {
+public:
+    MicroAudio(enum audio_format format, uint32_t channels, uint32_t frames) {
+        memset(&audio, 0, sizeof(audio));
+        audio.frames = frames;
+        
+        uint32_t seed = 0x5eed0000u + channels;
+        for (uint32_t c = 0; c < channels; c++) {
+            planes[c].resize((size_t)frames * sizeof(float));
+            for (uint32_t i = 0; i < frames; i++) {
+                float sample = micro_random_sample(&seed) * 0.5f;
+                uint8_t* dst = planes[c].data();
+                switch (format) {
+                case AUDIO_FORMAT_U8BIT:
+                case AUDIO_FORMAT_U8BIT_PLANAR:
+                    dst[i] = (uint8_t)(128.0f + sample * 127.0f);
+                    break;
+                case AUDIO_FORMAT_16BIT:
+                case AUDIO_FORMAT_16BIT_PLANAR:
+                    ((int16_t*)dst)[i] = (int16_t)(sample * 32767.0f);
+                    break;
+                case AUDIO_FORMAT_32BIT:
+                case AUDIO_FORMAT_32BIT_PLANAR:
+                    ((int32_t*)dst)[i] = (int32_t)(sample * 2147483647.0f);
+                    break;
+                default:
+                    ((float*)dst)[i] = sample;
+                    break;
+                }
+            }
+            audio.data[c] = planes[c].data();
+        }
+    }
+    
+    struct obs_audio_data audio;
+
+private:
+    std::vector<uint8_t> planes[MAX_AV_PLANES];
+};
+
+struct micro_format {
+    enum audio_format format;
+    const char* name;
+};
+
+static const micro_format micro_formats[] = {
+    {AUDIO_FORMAT_U8BIT, "u8"},
+    {AUDIO_FORMAT_16BIT, "s16"},
+    {AUDIO_FORMAT_32BIT, "s32"},
+    {AUDIO_FORMAT_FLOAT, "f32"},
+    {AUDIO_FORMAT_U8BIT_PLANAR, "u8p"},
+    {AUDIO_FORMAT_16BIT_PLANAR, "s16p"},
+    {AUDIO_FORMAT_32BIT_PLANAR, "s32p"},
+    {AUDIO_FORMAT_FLOAT_PLANAR, "f32p"},
+};
+
+// The speaker layouts OBS can mix: mono, stereo, 2.1, 4.0, 4.1, 5.1 and 7.1
+static const uint32_t micro_layouts[] = {1, 2, 3, 4, 5, 6, 8};
+
+// Cases
+
+static void micro_add_audio_buffer(std::vector<micro_case>& cases) {
+    for (const micro_format& format : micro_formats) {
+        for (uint32_t channels : micro_layouts) {
+            auto input = std::make_shared<MicroAudio>(format.format, channels, MICRO_PACKET_FRAMES);
+            std::string suffix = std::string(format.name) + "/" + std::to_string(channels) + "ch";
+            
+            // Takes the channel count from the OBS mix, which the shim
+            // only knows while the case runs. U8 is not supported and
+            // measures the rejection.
+            cases.push_back({"convert_to_mono_float/" + suffix, "frames", MICRO_PACKET_FRAMES,
+                             [input, format, channels](uint64_t iterations) {
+                obs_shim_set_audio(48000, channels);
+                struct audio_buffer_info info = {48000, channels, format.format};
+                for (uint64_t i = 0; i < iterations; i++) {
+                    float* mono = audio_buffer_convert_to_mono_float(&input->audio, &info);
+                    if (mono) {
+                        micro_sink = mono[0];
+                        bfree(mono);
+                    }
+                }
+            }});
+            
+            // The allocation-free form the audio callback uses
+            if (format.format == AUDIO_FORMAT_FLOAT_PLANAR ||
+                format.format == AUDIO_FORMAT_16BIT_PLANAR ||
+                format.format == AUDIO_FORMAT_32BIT_PLANAR) {
+                auto output = std::make_shared<std::vector<float>>(MICRO_PACKET_FRAMES);
+                cases.push_back({"mix_to_mono/" + suffix, "frames", MICRO_PACKET_FRAMES,
+                                 [input, output, format, channels](uint64_t iterations) {
+                    struct audio_buffer_info info = {48000, channels, format.format};
+                    for (uint64_t i = 0; i < iterations; i++) {
+                        audio_buffer_mix_to_mono(&input->audio, &info, 0, MICRO_PACKET_FRAMES,
+                                                 output->data());
+                        micro_sink = (*output)[0];
+                    }
+                }});
+            }
+        }
+    }
+    
+    // One ingest chunk and one second at 16kHz
+    for (size_t count : {(size_t)1600, (size_t)16000}) {
+        auto samples = std::make_shared<std::vector<float>>(count);
+        uint32_t seed = 7;
+        for (float& sample : *samples) sample = micro_random_sample(&seed) * 0.1f;
+        
+        cases.push_back({"silence_detection/" + std::to_string(count), "samples", count,
+                         [samples](uint64_t iterations) {
+            bool silent = false;
+            for (uint64_t i = 0; i < iterations; i++) {
+                audio_buffer_apply_silence_detection(samples->data(), samples->size(), -40.0f,
+                                                     &silent);
+                micro_sink = silent ? 1.0f : 0.0f;
+            }
+        }});
+    }
+}
+
+struct MicroRing {
+    MicroRing() { audio_ring_init(&ring, MICRO_RING_CAPACITY); }
+    ~MicroRing() { audio_ring_free(&ring); }
+    struct audio_ring ring;
+};
+
+static void micro_add_ring(std::vector<micro_case>& cases) {
+    // A 48kHz packet after resampling, a full packet and an ingest chunk
+    for (size_t count : {(size_t)341, (size_t)1024, (size_t)1600}) {
+        auto ring = std::make_shared<MicroRing>();
+        auto samples = std::make_shared<std::vector<float>>(count, 0.25f);
+        std::string suffix = "/" + std::to_string(count);
+        
+        // The producer's write followed by the worker's read
+        cases.push_back({"audio_ring/write_read" + suffix, "samples", count,
+                         [ring, samples](uint64_t iterations) {
+            size_t count = samples->size();
+            for (uint64_t i = 0; i < iterations; i++) {
+                audio_ring_write(&ring->ring, samples->data(), count);
+                audio_ring_read(&ring->ring, samples->data(), count);
+            }
+            micro_sink = (*samples)[0];
+        }});
+        
+        cases.push_back({"audio_ring/peek" + suffix, "samples", count,
+                         [ring, samples](uint64_t iterations) {
+            size_t count = samples->size();
+            audio_ring_clear(&ring->ring);
+            audio_ring_write(&ring->ring, samples->data(), count);
+            for (uint64_t i = 0; i < iterations; i++) {
+                audio_ring_peek(&ring->ring, samples->data(), count);
+            }
+            audio_ring_clear(&ring->ring);
+            micro_sink = (*samples)[0];
+        }});
+    }
+}
+
+static void micro_add_resampler(std::vector<micro_case>& cases) {
+    for (uint32_t rate : {48000u, 44100u}) {
+        auto input = std::make_shared<std::vector<float>>(MICRO_PACKET_FRAMES);
+        uint32_t seed = rate;
+        for (float& sample : *input) sample = micro_random_sample(&seed) * 0.5f;
+        
+        cases.push_back({"resampler/" + std::to_string(rate) + "-16000", "frames",
+                         MICRO_PACKET_FRAMES, [input, rate](uint64_t iterations) {
+            struct audio_resampler* resampler = audio_resampler_create(rate, 16000);
+            if (!resampler) return;
+            std::vector<float> output(audio_resampler_max_output(resampler, input->size()));
+            for (uint64_t i = 0; i < iterations; i++) {
+                audio_resampler_process(resampler, input->data(), input->size(), output.data(),
+                                        output.size());
+            }
+            micro_sink = output[0];
+            audio_resampler_destroy(resampler);
+        }});
+    }
+}
+
+// A short caption, and a long one at the segment limit
+static const char* const micro_short_text = "the quick brown fox jumps over the lazy dog";
+static const char* const micro_long_text =
+    "so what we are going to do today is walk through the whole build from the start, "
+    "setting up the encoder, picking the bitrate and the key frame interval, and then "
+    "we will look at why the audio drifts after an hour of streaming and how the "
+    "resampler and the sync offset interact when the capture card reports a slightly "
+    "different clock than the one the mixer expects, which is more common than you "
+    "would think with cheap usb devices and long cables";
+
+static std::string micro_chat_response(const std::string& content) {
+    Json::Value message;
+    message["role"] = "assistant";
+    message["content"] = content;
+    Json::Value choice;
+    choice["index"] = 0;
+    choice["message"] = message;
+    choice["finish_reason"] = "stop";
+    Json::Value response;
+    response["id"] = "chatcmpl-micro";
+    response["object"] = "chat.completion";
+    response["model"] = "gpt-3.5-turbo";
+    response["choices"].append(choice);
+    response["usage"]["prompt_tokens"] = 120;
+    response["usage"]["completion_tokens"] = 80;
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "";
+    return Json::writeString(writer, response);
+}
+
+// The same answer as server-sent events, a word per event
+static std::string micro_chat_stream(const std::string& content) {
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "";
+    std::string events;
+    size_t begin = 0;
+    while (begin < content.size()) {
+        size_t end = content.find(' ', begin + 1);
+        if (end == std::string::npos) end = content.size();
+        Json::Value chunk;
+        chunk["id"] = "chatcmpl-micro";
+        chunk["object"] = "chat.completion.chunk";
+        chunk["choices"][0]["index"] = 0;
+        chunk["choices"][0]["delta"]["content"] = content.substr(begin, end - begin);
+        events += "data: " + Json::writeString(writer, chunk) + "\n\n";
+        begin = end;
+    }
+    return events + "data: [DONE]\n\n";
+}
+
+static std::string micro_batch_answer(const char* text) {
+    Json::Value answer;
+    for (int i = 0; i < MICRO_LLM_SEGMENTS; i++) {
+        Json::Value item;
+        item["index"] = i;
+        item["text"] = text;
+        answer["segments"].append(item);
+    }
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "";
+    return Json::writeString(writer, answer);
+}
+
+static void micro_add_llm(std::vector<micro_case>& cases, void* corrector) {
+    if (!corrector) {
+        fprintf(stderr, "micro-bench: no LLM corrector, skipping the llm benchmarks\n");
+        return;
+    }
+    
+    struct llm_text {
+        const char* name;
+        const char* text;
+    };
+    static const llm_text texts[] = {{"short", micro_short_text}, {"long", micro_long_text}};
+    
+    for (const llm_text& text : texts) {
+        const char* value = text.text;
+        uint64_t chars = strlen(value);
+        std::string suffix = std::string("/") + text.name;
+        
+        cases.push_back({"llm_build/single" + suffix, "chars", chars,
+                         [corrector, value](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                char* body = llm_corrector_build_request(corrector, value, nullptr, 1, false);
+                micro_sink = body ? (float)body[0] : 0.0f;
+                bfree(body);
+            }
+        }});
+        cases.push_back({"llm_build/batch" + suffix, "chars", chars * MICRO_LLM_SEGMENTS,
+                         [corrector, value](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                char* body = llm_corrector_build_request(corrector, value, nullptr,
+                                                         MICRO_LLM_SEGMENTS, false);
+                micro_sink = body ? (float)body[0] : 0.0f;
+                bfree(body);
+            }
+        }});
+        
+        auto response = std::make_shared<std::string>(micro_chat_response(value));
+        auto batch = std::make_shared<std::string>(micro_chat_response(micro_batch_answer(value)));
+        auto stream = std::make_shared<std::string>(micro_chat_stream(value));
+        struct llm_response {
+            const char* name;
+            std::shared_ptr<std::string> body;
+            bool streamed;
+        };
+        for (const llm_response& parse : {llm_response{"single", response, false},
+                                          llm_response{"batch", batch, false},
+                                          llm_response{"stream", stream, true}}) {
+            auto body = parse.body;
+            bool streamed = parse.streamed;
+            cases.push_back({std::string("llm_parse/") + parse.name + suffix, "bytes",
+                             body->size(), [body, streamed](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; i++) {
+                    char* content = llm_corrector_parse_response(body->c_str(), streamed);
+                    micro_sink = content ? (float)content[0] : 0.0f;
+                    bfree(content);
+                }
+            }});
+        }
+    }
+}
+
+// Timing
+
+static double micro_time_ns(const micro_case& test, uint64_t iterations) {
+    uint64_t start = os_gettime_ns();
+    test.run(iterations);
+    return (double)(os_gettime_ns() - start);
+}
+
+static micro_result micro_measure(const micro_case& test, const micro_options& options) {
+    // Grow the batch until it fills one repetition
+    double target_ns = options.min_time_ms * 1e6;
+    uint64_t iterations = 1;
+    double elapsed = micro_time_ns(test, iterations);
+    while (elapsed < target_ns && iterations < (1ULL << 40)) {
+        double scale = elapsed > 0.0 ? target_ns / elapsed * 1.2 : 100.0;
+        iterations = (uint64_t)((double)iterations * std::min(std::max(scale, 2.0), 100.0));
+        elapsed = micro_time_ns(test, iterations);
+    }
+    
+    std::vector<double> per_op;
+    for (int r = 0; r < options.repetitions; r++) {
+        per_op.push_back(micro_time_ns(test, iterations) / (double)iterations);
+    }
+    std::sort(per_op.begin(), per_op.end());
+    
+    micro_result result;
+    result.name = test.name;
+    result.unit = test.unit;
+    result.items = test.items;
+    result.iterations = iterations;
+    result.ns_per_op = per_op[per_op.size() / 2];
+    result.ns_per_op_min = per_op.front();
+    return result;
+}
+
+// Output
+
+static Json::Value micro_to_json(const std::vector<micro_result>& results,
+                                 const micro_options& options) {
+    Json::Value root;
+    root["suite"] = "micro-bench";
+    root["version"] = 1;
+    root["kernels"] = audio_kernels_get()->name;
+    root["cores"] = os_get_logical_cores();
+    root["min_time_ms"] = options.min_time_ms;
+    root["repetitions"] = options.repetitions;
+    
+    Json::Value items(Json::arrayValue);
+    for (const micro_result& result : results) {
+        Json::Value item;
+        item["name"] = result.name;
+        item["unit"] = result.unit;
+        item["items_per_op"] = (Json::UInt64)result.items;
+        item["iterations"] = (Json::UInt64)result.iterations;
+        item["ns_per_op"] = result.ns_per_op;
+        item["ns_per_op_min"] = result.ns_per_op_min;
+        item["ns_per_item"] = result.ns_per_op / (double)result.items;
+        items.append(item);
+    }
+    root["results"] = items;
+    return root;
+}
+
+static bool micro_write_json(const Json::Value& root, const char* path) {
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "  ";
+    std::string text = Json::writeString(writer, root) + "\n";
+    
+    if (strcmp(path, "-") == 0) {
+        fputs(text.c_str(), stdout);
+        return true;
+    }
+    std::ofstream file(path);
+    file << text;
+    if (!file) {
+        fprintf(stderr, "%s: cannot write\n", path);
+        return false;
+    }
+    return true;
+}
+
+static bool micro_load_baseline(const char* path, std::map<std::string, double>& baseline) {
+    std::ifstream file(path);
+    Json::Value root;
+    Json::CharReaderBuilder reader;
+    std::string errors;
+    if (!file || !Json::parseFromStream(reader, file, &root, &errors) ||
+        !root["results"].isArray()) {
+        fprintf(stderr, "%s: not a micro-bench result file %s\n", path, errors.c_str());
+        return false;
+    }
+    for (const Json::Value& item : root["results"]) {
+        if (item["name"].isString() && item["ns_per_op"].isNumeric()) {
+            baseline[item["name"].asString()] = item["ns_per_op"].asDouble();
+        }
+    }
+    return true;
+}
+
+static void micro_print_header(FILE* out, bool compare) {
+    fprintf(out, "%-36s %12s %10s %12s  %-8s%s\n", "benchmark", "ns/op", "ns/item", "Mitems/s",
+            "item", compare ? "  baseline" : "");
+}
+
+// Returns false when the result regressed past the limit
+static bool micro_print_result(FILE* out, const micro_result& result,
+                               const micro_options& options,
+                               const std::map<std::string, double>* baseline) {
+    double per_item = result.ns_per_op / (double)result.items;
+    fprintf(out, "%-36s %12.1f %10.3f %12.1f  %-8s", result.name.c_str(), result.ns_per_op,
+            per_item, per_item > 0.0 ? 1e3 / per_item : 0.0, result.unit);
+    
+    bool passed = true;
+    if (baseline) {
+        auto found = baseline->find(result.name);
+        if (found == baseline->end() || found->second <= 0.0) {
+            fprintf(out, "  (new)");
+        } else {
+            double change = (result.ns_per_op / found->second - 1.0) * 100.0;
+            fprintf(out, "  %+7.1f%%", change);
+            if (options.max_regression >= 0.0 && change > options.max_regression) {
+                fprintf(out, "  FAIL");
+                passed = false;
+            }
+        }
+    }
+    fprintf(out, "\n");
+    return passed;
+}
+
+int main(int argc, char** argv) {
+    micro_options options;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        
+        if (strcmp(arg, "--filter") == 0 && value) {
+            options.filter = value;
+        } else if (strcmp(arg, "--min-time") == 0 && value) {
+            options.min_time_ms = std::max(atof(value), 1.0);
+        } else if (strcmp(arg, "--repetitions") == 0 && value) {
+            options.repetitions = std::max(atoi(value), 1);
+        } else if (strcmp(arg, "--json") == 0 && value) {
+            options.json_path = value;
+        } else if (strcmp(arg, "--baseline") == 0 && value) {
+            options.baseline_path = value;
+        } else if (strcmp(arg, "--max-regression") == 0 && value) {
+            options.max_regression = atof(value);
+        } else {
+            micro_usage();
+            return 2;
+        }
+        i++;
+    }
+    
+    std::map<std::string, double> baseline;
+    if (options.baseline_path && !micro_load_baseline(options.baseline_path, baseline)) {
+        return 2;
+    }
+    
+    obs_shim_set_log_level(LOG_WARNING);
+    audio_kernels_init();
+    llm_corrector_global_init();
+    void* corrector = llm_corrector_create("http://127.0.0.1:9/v1/chat/completions", "bench");
+    
+    std::vector<micro_case> cases;
+    micro_add_audio_buffer(cases);
+    micro_add_ring(cases);
+    micro_add_resampler(cases);
+    micro_add_llm(cases, corrector);
+    
+    // With JSON on stdout the table goes to stderr
+    bool json_stdout = options.json_path && strcmp(options.json_path, "-") == 0;
+    FILE* table = json_stdout ? stderr : stdout;
+    
+    fprintf(table, "micro-bench: %s kernels, %.0f ms x %d repetitions per benchmark\n",
+           audio_kernels_get()->name, options.min_time_ms, options.repetitions);
+    micro_print_header(table, options.baseline_path != nullptr);
+    
+    std::vector<micro_result> results;
+    bool passed = true;
+    for (const micro_case& test : cases) {
+        if (options.filter && test.name.find(options.filter) == std::string::npos) continue;
+        results.push_back(micro_measure(test, options));
+        passed = micro_print_result(table, results.back(), options,
+                                    options.baseline_path ? &baseline : nullptr) && passed;
+        fflush(table);
+    }
+    
+    llm_corrector_destroy(corrector);
+    llm_corrector_global_shutdown();
+    
+    if (options.json_path && !micro_write_json(micro_to_json(results, options), options.json_path)) {
+        return 2;
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "../util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Signal parameters. Only what the shim emits fits: a few pointers and
+// strings by name, owned by the emitter.
+
+#define CALLDATA_MAX_ENTRIES 4
+
+struct calldata_entry {
+    const char *name;
+    void *ptr;
+    const char *string;
+};
+
+struct calldata {
+    struct calldata_entry entries[CALLDATA_MAX_ENTRIES];
+    size_t count;
+};
+
+typedef struct calldata calldata_t;
+
+void *calldata_ptr(const calldata_t *data, const char *name);
+const char *calldata_string(const calldata_t *data, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "calldata.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct signal_handler;
+typedef struct signal_handler signal_handler_t;
+typedef void (*signal_callback_t)(void *data, calldata_t *cd);
+
+// Callbacks run on the emitting thread; disconnecting waits for a callback
+// that is running
+void signal_handler_connect(signal_handler_t *handler, const char *signal,
+                            signal_callback_t callback, void *data);
+void signal_handler_disconnect(signal_handler_t *handler, const char *signal,
+                               signal_callback_t callback, void *data);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "../util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MAX_AV_PLANES 8
+#define AUDIO_OUTPUT_FRAMES 1024
+
+enum audio_format {
+    AUDIO_FORMAT_UNKNOWN,
+    AUDIO_FORMAT_U8BIT,
+    AUDIO_FORMAT_16BIT,
+    AUDIO_FORMAT_32BIT,
+    AUDIO_FORMAT_FLOAT,
+    AUDIO_FORMAT_U8BIT_PLANAR,
+    AUDIO_FORMAT_16BIT_PLANAR,
+    AUDIO_FORMAT_32BIT_PLANAR,
+    AUDIO_FORMAT_FLOAT_PLANAR,
+};
+
+struct audio_output;
+typedef struct audio_output audio_t;
+
+size_t audio_output_get_channels(const audio_t *audio);
+uint32_t audio_output_get_sample_rate(const audio_t *audio);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <math.h>
+
+static inline float mul_to_db(const float mul)
+{
+    return (mul == 0.0f) ? -INFINITY : (20.0f * log10f(mul));
+}
+
+static inline float db_to_mul(const float db)
+{
+    return isfinite((double)db) ? powf(10.0f, db / 20.0f) : 0.0f;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "obs.h"
+
+#ifdef __cplusplus
+#define MODULE_EXPORT extern "C" EXPORT
+#define MODULE_EXTERN extern "C"
+#else
+#define MODULE_EXPORT EXPORT
+#define MODULE_EXTERN extern
+#endif
+
+// The harness links the plugin sources directly, so there is no module to
+// load and lookups return the key itself
+MODULE_EXTERN const char *obs_module_text(const char *lookup_string);
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "util/c99defs.h"
+#include "util/base.h"
+#include "util/bmem.h"
+#include "media-io/audio-io.h"
+#include "callback/signal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct obs_source;
+struct obs_weak_source;
+struct obs_data;
+struct obs_properties;
+struct obs_property;
+typedef struct obs_source obs_source_t;
+typedef struct obs_weak_source obs_weak_source_t;
+typedef struct obs_data obs_data_t;
+typedef struct obs_properties obs_properties_t;
+typedef struct obs_property obs_property_t;
+
+struct obs_audio_data {
+    uint8_t *data[MAX_AV_PLANES];
+    uint32_t frames;
+    uint64_t timestamp;
+};
+
+enum obs_source_type {
+    OBS_SOURCE_TYPE_INPUT,
+    OBS_SOURCE_TYPE_FILTER,
+    OBS_SOURCE_TYPE_TRANSITION,
+    OBS_SOURCE_TYPE_SCENE,
+};
+
+#define OBS_SOURCE_VIDEO (1 << 0)
+#define OBS_SOURCE_AUDIO (1 << 1)
+
+// Only the callbacks an audio filter can use; hosts must not rely on the
+// layout matching libobs
+struct obs_source_info {
+    const char *id;
+    enum obs_source_type type;
+    uint32_t output_flags;
+    const char *(*get_name)(void *type_data);
+    void *(*create)(obs_data_t *settings, obs_source_t *source);
+    void (*destroy)(void *data);
+    void (*get_defaults)(obs_data_t *settings);
+    obs_properties_t *(*get_properties)(void *data);
+    void (*update)(void *data, obs_data_t *settings);
+    struct obs_audio_data *(*filter_audio)(void *data, struct obs_audio_data *audio);
+};
+
+audio_t *obs_get_audio(void);
+
+obs_source_t *obs_get_source_by_name(const char *name);
+void obs_source_release(obs_source_t *source);
+void obs_source_update(obs_source_t *source, obs_data_t *settings);
+const char *obs_source_get_name(const obs_source_t *source);
+
+obs_weak_source_t *obs_source_get_weak_source(obs_source_t *source);
+obs_source_t *obs_weak_source_get_source(obs_weak_source_t *weak);
+void obs_weak_source_release(obs_weak_source_t *weak);
+
+// Emits "source_create" and "source_remove" for the host's sources, each
+// with "source"
+signal_handler_t *obs_get_signal_handler(void);
+
+obs_data_t *obs_data_create(void);
+void obs_data_addref(obs_data_t *data);
+void obs_data_release(obs_data_t *data);
+void obs_data_set_string(obs_data_t *data, const char *name, const char *val);
+void obs_data_set_int(obs_data_t *data, const char *name, long long val);
+void obs_data_set_double(obs_data_t *data, const char *name, double val);
+void obs_data_set_bool(obs_data_t *data, const char *name, bool val);
+void obs_data_set_default_string(obs_data_t *data, const char *name, const char *val);
+void obs_data_set_default_int(obs_data_t *data, const char *name, long long val);
+void obs_data_set_default_double(obs_data_t *data, const char *name, double val);
+void obs_data_set_default_bool(obs_data_t *data, const char *name, bool val);
+const char *obs_data_get_string(obs_data_t *data, const char *name);
+long long obs_data_get_int(obs_data_t *data, const char *name);
+double obs_data_get_double(obs_data_t *data, const char *name);
+bool obs_data_get_bool(obs_data_t *data, const char *name);
+
+enum obs_text_type {
+    OBS_TEXT_DEFAULT,
+    OBS_TEXT_PASSWORD,
+    OBS_TEXT_MULTILINE,
+    OBS_TEXT_INFO,
+};
+
+enum obs_path_type {
+    OBS_PATH_FILE,
+    OBS_PATH_FILE_SAVE,
+    OBS_PATH_DIRECTORY,
+};
+
+enum obs_combo_type {
+    OBS_COMBO_TYPE_INVALID,
+    OBS_COMBO_TYPE_EDITABLE,
+    OBS_COMBO_TYPE_LIST,
+};
+
+enum obs_combo_format {
+    OBS_COMBO_FORMAT_INVALID,
+    OBS_COMBO_FORMAT_INT,
+    OBS_COMBO_FORMAT_FLOAT,
+    OBS_COMBO_FORMAT_STRING,
+};
+
+enum obs_group_type {
+    OBS_COMBO_INVALID,
+    OBS_GROUP_NORMAL,
+    OBS_GROUP_CHECKABLE,
+};
+
+// Properties are accepted and discarded; nothing renders them here
+obs_properties_t *obs_properties_create(void);
+void obs_properties_destroy(obs_properties_t *props);
+obs_property_t *obs_properties_add_bool(obs_properties_t *props, const char *name,
+                                        const char *description);
+obs_property_t *obs_properties_add_int(obs_properties_t *props, const char *name,
+                                       const char *description, int min, int max, int step);
+obs_property_t *obs_properties_add_int_slider(obs_properties_t *props, const char *name,
+                                              const char *description, int min, int max,
+                                              int step);
+obs_property_t *obs_properties_add_float_slider(obs_properties_t *props, const char *name,
+                                                const char *description, double min,
+                                                double max, double step);
+obs_property_t *obs_properties_add_text(obs_properties_t *props, const char *name,
+                                        const char *description, enum obs_text_type type);
+obs_property_t *obs_properties_add_path(obs_properties_t *props, const char *name,
+                                        const char *description, enum obs_path_type type,
+                                        const char *filter, const char *default_path);
+obs_property_t *obs_properties_add_list(obs_properties_t *props, const char *name,
+                                        const char *description, enum obs_combo_type type,
+                                        enum obs_combo_format format);
+obs_property_t *obs_properties_add_group(obs_properties_t *props, const char *name,
+                                         const char *description, enum obs_group_type type,
+                                         obs_properties_t *group);
+typedef bool (*obs_property_clicked_t)(obs_properties_t *props, obs_property_t *property,
+                                      void *data);
+obs_property_t *obs_properties_add_button(obs_properties_t *props, const char *name,
+                                          const char *text, obs_property_clicked_t callback);
+size_t obs_property_list_add_string(obs_property_t *p, const char *name, const char *val);
+size_t obs_property_list_add_int(obs_property_t *p, const char *name, long long val);
+void obs_property_int_set_suffix(obs_property_t *p, const char *suffix);
+void obs_property_float_set_suffix(obs_property_t *p, const char *suffix);
+
+#ifdef __cplusplus
+}
+#endif
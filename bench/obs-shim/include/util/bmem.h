@@ -0,0 +1,47 @@
+#pragma once
+
+#include "c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void *bmalloc(size_t size);
+void *brealloc(void *ptr, size_t size);
+void bfree(void *ptr);
+
+static inline void *bzalloc(size_t size)
+{
+    void *mem = bmalloc(size);
+    memset(mem, 0, size);
+    return mem;
+}
+
+static inline char *bstrdup_n(const char *str, size_t n)
+{
+    if (!str) {
+        return NULL;
+    }
+    char *dup = (char *)bmalloc(n + 1);
+    memcpy(dup, str, n);
+    dup[n] = 0;
+    return dup;
+}
+
+static inline char *bstrdup(const char *str)
+{
+    return str ? bstrdup_n(str, strlen(str)) : NULL;
+}
+
+static inline void *bmemdup(const void *ptr, size_t size)
+{
+    void *out = bmalloc(size);
+    if (size) {
+        memcpy(out, ptr, size);
+    }
+    return out;
+}
+
+#ifdef __cplusplus
+}
+#endif
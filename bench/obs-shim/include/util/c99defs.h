@@ -0,0 +1,21 @@
+#pragma once
+
+// Minimal stand-in for libobs, enough to build the plugin sources outside
+// OBS. Only what the plugin uses is declared, with libobs' signatures.
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define UNUSED_PARAMETER(param) (void)param
+
+#ifdef __cplusplus
+#define EXPORT extern "C" __attribute__((visibility("default")))
+#else
+#define EXPORT __attribute__((visibility("default")))
+#endif
+
+#define PRINTFATTR(f, a) __attribute__((__format__(__printf__, f, a)))
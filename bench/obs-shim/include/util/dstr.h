@@ -0,0 +1,99 @@
+#pragma once
+
+#include "bmem.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct dstr {
+    char *array;
+    size_t len;
+    size_t capacity;
+};
+
+static inline void dstr_init(struct dstr *dst)
+{
+    dst->array = NULL;
+    dst->len = 0;
+    dst->capacity = 0;
+}
+
+static inline void dstr_free(struct dstr *dst)
+{
+    bfree(dst->array);
+    dstr_init(dst);
+}
+
+static inline void dstr_ensure_capacity(struct dstr *dst, size_t new_size)
+{
+    if (new_size <= dst->capacity) {
+        return;
+    }
+    size_t new_cap = dst->capacity ? dst->capacity * 2 : new_size;
+    if (new_size > new_cap) {
+        new_cap = new_size;
+    }
+    dst->array = (char *)brealloc(dst->array, new_cap);
+    dst->capacity = new_cap;
+}
+
+static inline void dstr_ncat(struct dstr *dst, const char *array, size_t len)
+{
+    if (!array || !*array || !len) {
+        return;
+    }
+    dstr_ensure_capacity(dst, dst->len + len + 1);
+    memcpy(dst->array + dst->len, array, len);
+    dst->len += len;
+    dst->array[dst->len] = 0;
+}
+
+static inline void dstr_cat(struct dstr *dst, const char *array)
+{
+    if (array) {
+        dstr_ncat(dst, array, strlen(array));
+    }
+}
+
+static inline void dstr_copy(struct dstr *dst, const char *array)
+{
+    dst->len = 0;
+    if (dst->array) {
+        dst->array[0] = 0;
+    }
+    dstr_cat(dst, array);
+}
+
+static inline void dstr_cat_ch(struct dstr *dst, char ch)
+{
+    dstr_ensure_capacity(dst, dst->len + 2);
+    dst->array[dst->len++] = ch;
+    dst->array[dst->len] = 0;
+}
+
+static inline void dstr_vcatf(struct dstr *dst, const char *format, va_list args)
+{
+    va_list copy;
+    va_copy(copy, args);
+    int len = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+    if (len <= 0) {
+        return;
+    }
+    dstr_ensure_capacity(dst, dst->len + (size_t)len + 1);
+    vsnprintf(dst->array + dst->len, (size_t)len + 1, format, args);
+    dst->len += (size_t)len;
+}
+
+static inline void dstr_catf(struct dstr *dst, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    dstr_vcatf(dst, format, args);
+    va_end(args);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "c99defs.h"
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint64_t os_gettime_ns(void);
+bool os_sleepto_ns(uint64_t time_target);
+void os_sleep_ms(uint32_t duration);
+int os_get_physical_cores(void);
+int os_get_logical_cores(void);
+
+FILE *os_fopen(const char *path, const char *mode);
+
+// Writes to `path` plus `temp_ext` and renames over `path`; no backup and no
+// byte order mark are supported
+bool os_quick_write_utf8_file_safe(const char *path, const char *str, size_t len, bool marker,
+                                   const char *temp_ext, const char *backup_ext);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct os_task_queue;
+typedef struct os_task_queue os_task_queue_t;
+typedef void (*os_task_t)(void *param);
+
+os_task_queue_t *os_task_queue_create(void);
+bool os_task_queue_queue_task(os_task_queue_t *tq, os_task_t task, void *param);
+void os_task_queue_destroy(os_task_queue_t *tq);
+bool os_task_queue_wait(os_task_queue_t *tq);
+
+#ifdef __cplusplus
+}
+#endif
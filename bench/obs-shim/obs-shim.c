@@ -0,0 +1,1056 @@
+#define _GNU_SOURCE
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/task.h>
+#include <util/threading.h>
+#include "obs-shim.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_SHIM_THREADS 256
+
+// Memory
+
+void *bmalloc(size_t size)
+{
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        fprintf(stderr, "obs-shim: out of memory allocating %zu bytes\n", size);
+        abort();
+    }
+    return ptr;
+}
+
+void *brealloc(void *ptr, size_t size)
+{
+    ptr = realloc(ptr, size ? size : 1);
+    if (!ptr) {
+        fprintf(stderr, "obs-shim: out of memory allocating %zu bytes\n", size);
+        abort();
+    }
+    return ptr;
+}
+
+void bfree(void *ptr)
+{
+    free(ptr);
+}
+
+// Logging
+
+static volatile long log_level = LOG_INFO;
+
+void obs_shim_set_log_level(int level)
+{
+    os_atomic_set_long(&log_level, level);
+}
+
+void blogva(int level, const char *format, va_list args)
+{
+    if (level > os_atomic_load_long(&log_level)) {
+        return;
+    }
+    
+    const char *prefix = level <= LOG_ERROR ? "error: " : level <= LOG_WARNING ? "warning: " : "";
+    char line[4096];
+    vsnprintf(line, sizeof(line), format, args);
+    fprintf(stderr, "%s%s\n", prefix, line);
+}
+
+void blog(int level, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    blogva(level, format, args);
+    va_end(args);
+}
+
+const char *obs_module_text(const char *lookup_string)
+{
+    return lookup_string;
+}
+
+// Time
+
+uint64_t os_gettime_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+bool os_sleepto_ns(uint64_t time_target)
+{
+    uint64_t now = os_gettime_ns();
+    if (time_target <= now) {
+        return false;
+    }
+    
+    struct timespec ts;
+    ts.tv_sec = (time_t)((time_target - now) / 1000000000ULL);
+    ts.tv_nsec = (long)((time_target - now) % 1000000000ULL);
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+    return true;
+}
+
+void os_sleep_ms(uint32_t duration)
+{
+    os_sleepto_ns(os_gettime_ns() + (uint64_t)duration * 1000000ULL);
+}
+
+int os_get_logical_cores(void)
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+int os_get_physical_cores(void)
+{
+    return os_get_logical_cores();
+}
+
+FILE *os_fopen(const char *path, const char *mode)
+{
+    return path ? fopen(path, mode) : NULL;
+}
+
+bool os_quick_write_utf8_file_safe(const char *path, const char *str, size_t len, bool marker,
+                                   const char *temp_ext, const char *backup_ext)
+{
+    if (!path || !str || marker || (backup_ext && *backup_ext)) {
+        return false;
+    }
+    
+    char temp_path[4096];
+    snprintf(temp_path, sizeof(temp_path), "%s%s%s", path,
+             temp_ext && *temp_ext != '.' ? "." : "", temp_ext ? temp_ext : ".tmp");
+    FILE *file = fopen(temp_path, "wb");
+    if (!file) {
+        return false;
+    }
+    bool written = fwrite(str, 1, len, file) == len;
+    written = fclose(file) == 0 && written;
+    if (!written || rename(temp_path, path) != 0) {
+        remove(temp_path);
+        return false;
+    }
+    return true;
+}
+
+// Threads. Named threads are remembered with their CPU clock so the host
+// can attribute CPU time to the plugin's stages.
+
+struct shim_thread {
+    char name[64];
+    clockid_t clock;
+    bool alive;
+    uint64_t cpu_ns; // last reading
+};
+
+static pthread_mutex_t thread_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct shim_thread threads[MAX_SHIM_THREADS];
+static size_t thread_count;
+
+void os_set_thread_name(const char *name)
+{
+#ifdef __APPLE__
+    pthread_setname_np(name);
+#else
+    // Linux limits names to 15 characters; keep the distinctive tail
+    size_t len = strlen(name);
+    pthread_setname_np(pthread_self(), len > 15 ? name + len - 15 : name);
+#endif
+
+    clockid_t clock;
+    if (pthread_getcpuclockid(pthread_self(), &clock) != 0) {
+        return;
+    }
+    
+    pthread_mutex_lock(&thread_mutex);
+    if (thread_count < MAX_SHIM_THREADS) {
+        struct shim_thread *thread = &threads[thread_count++];
+        snprintf(thread->name, sizeof(thread->name), "%s", name);
+        thread->clock = clock;
+        thread->alive = true;
+        thread->cpu_ns = 0;
+    }
+    pthread_mutex_unlock(&thread_mutex);
+}
+
+size_t obs_shim_get_thread_times(struct obs_shim_thread_time *times, size_t max_times)
+{
+    size_t count = 0;
+    
+    pthread_mutex_lock(&thread_mutex);
+    for (size_t i = 0; i < thread_count; i++) {
+        struct shim_thread *thread = &threads[i];
+        struct timespec ts;
+        if (thread->alive && clock_gettime(thread->clock, &ts) == 0) {
+            thread->cpu_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+        } else {
+            thread->alive = false;
+        }
+        
+        size_t slot = 0;
+        while (slot < count && strcmp(times[slot].name, thread->name) != 0) {
+            slot++;
+        }
+        if (slot == count) {
+            if (count == max_times) {
+                continue;
+            }
+            memset(&times[count], 0, sizeof(times[count]));
+            snprintf(times[count].name, sizeof(times[count].name), "%s", thread->name);
+            count++;
+        }
+        times[slot].threads++;
+        times[slot].cpu_ns += thread->cpu_ns;
+    }
+    pthread_mutex_unlock(&thread_mutex);
+    
+    return count;
+}
+
+uint64_t obs_shim_thread_cpu_ns(void)
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0;
+    }
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+struct os_sem_data {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int value;
+};
+
+int os_sem_init(os_sem_t **sem, int value)
+{
+    os_sem_t *s = bzalloc(sizeof(os_sem_t));
+    pthread_mutex_init(&s->mutex, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    s->value = value;
+    *sem = s;
+    return 0;
+}
+
+void os_sem_destroy(os_sem_t *sem)
+{
+    if (!sem) {
+        return;
+    }
+    pthread_mutex_destroy(&sem->mutex);
+    pthread_cond_destroy(&sem->cond);
+    bfree(sem);
+}
+
+int os_sem_post(os_sem_t *sem)
+{
+    pthread_mutex_lock(&sem->mutex);
+    sem->value++;
+    pthread_cond_signal(&sem->cond);
+    pthread_mutex_unlock(&sem->mutex);
+    return 0;
+}
+
+int os_sem_wait(os_sem_t *sem)
+{
+    pthread_mutex_lock(&sem->mutex);
+    while (sem->value <= 0) {
+        pthread_cond_wait(&sem->cond, &sem->mutex);
+    }
+    sem->value--;
+    pthread_mutex_unlock(&sem->mutex);
+    return 0;
+}
+
+struct os_event_data {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool signalled;
+    bool manual;
+};
+
+int os_event_init(os_event_t **event, enum os_event_type type)
+{
+    os_event_t *e = bzalloc(sizeof(os_event_t));
+    pthread_mutex_init(&e->mutex, NULL);
+    pthread_cond_init(&e->cond, NULL);
+    e->manual = type == OS_EVENT_TYPE_MANUAL;
+    *event = e;
+    return 0;
+}
+
+void os_event_destroy(os_event_t *event)
+{
+    if (!event) {
+        return;
+    }
+    pthread_mutex_destroy(&event->mutex);
+    pthread_cond_destroy(&event->cond);
+    bfree(event);
+}
+
+int os_event_wait(os_event_t *event)
+{
+    pthread_mutex_lock(&event->mutex);
+    while (!event->signalled) {
+        pthread_cond_wait(&event->cond, &event->mutex);
+    }
+    if (!event->manual) {
+        event->signalled = false;
+    }
+    pthread_mutex_unlock(&event->mutex);
+    return 0;
+}
+
+int os_event_timedwait(os_event_t *event, unsigned long milliseconds)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += milliseconds / 1000;
+    ts.tv_nsec += (long)(milliseconds % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    
+    int result = 0;
+    pthread_mutex_lock(&event->mutex);
+    while (!event->signalled && result == 0) {
+        result = pthread_cond_timedwait(&event->cond, &event->mutex, &ts);
+    }
+    if (event->signalled) {
+        if (!event->manual) {
+            event->signalled = false;
+        }
+        result = 0;
+    }
+    pthread_mutex_unlock(&event->mutex);
+    return result;
+}
+
+int os_event_signal(os_event_t *event)
+{
+    pthread_mutex_lock(&event->mutex);
+    event->signalled = true;
+    pthread_cond_broadcast(&event->cond);
+    pthread_mutex_unlock(&event->mutex);
+    return 0;
+}
+
+void os_event_reset(os_event_t *event)
+{
+    pthread_mutex_lock(&event->mutex);
+    event->signalled = false;
+    pthread_mutex_unlock(&event->mutex);
+}
+
+// Task queues: one thread each, running tasks in order
+
+struct shim_task {
+    os_task_t task;
+    void *param;
+    struct shim_task *next;
+};
+
+struct os_task_queue {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    pthread_cond_t idle;
+    struct shim_task *head;
+    struct shim_task *tail;
+    bool running_task;
+    bool stop;
+    struct os_task_queue *next;
+};
+
+static pthread_mutex_t task_queues_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct os_task_queue *task_queues;
+
+static void *task_queue_thread(void *param)
+{
+    os_task_queue_t *tq = param;
+    os_set_thread_name("task queue");
+    
+    pthread_mutex_lock(&tq->mutex);
+    for (;;) {
+        while (!tq->head && !tq->stop) {
+            pthread_cond_wait(&tq->wake, &tq->mutex);
+        }
+        if (!tq->head) {
+            break;
+        }
+        
+        struct shim_task *task = tq->head;
+        tq->head = task->next;
+        if (!tq->head) {
+            tq->tail = NULL;
+        }
+        tq->running_task = true;
+        pthread_mutex_unlock(&tq->mutex);
+        
+        task->task(task->param);
+        bfree(task);
+        
+        pthread_mutex_lock(&tq->mutex);
+        tq->running_task = false;
+        pthread_cond_broadcast(&tq->idle);
+    }
+    pthread_mutex_unlock(&tq->mutex);
+    return NULL;
+}
+
+os_task_queue_t *os_task_queue_create(void)
+{
+    os_task_queue_t *tq = bzalloc(sizeof(os_task_queue_t));
+    pthread_mutex_init(&tq->mutex, NULL);
+    pthread_cond_init(&tq->wake, NULL);
+    pthread_cond_init(&tq->idle, NULL);
+    if (pthread_create(&tq->thread, NULL, task_queue_thread, tq) != 0) {
+        pthread_mutex_destroy(&tq->mutex);
+        pthread_cond_destroy(&tq->wake);
+        pthread_cond_destroy(&tq->idle);
+        bfree(tq);
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&task_queues_mutex);
+    tq->next = task_queues;
+    task_queues = tq;
+    pthread_mutex_unlock(&task_queues_mutex);
+    return tq;
+}
+
+bool os_task_queue_queue_task(os_task_queue_t *tq, os_task_t task, void *param)
+{
+    if (!tq) {
+        return false;
+    }
+    
+    struct shim_task *item = bzalloc(sizeof(struct shim_task));
+    item->task = task;
+    item->param = param;
+    
+    pthread_mutex_lock(&tq->mutex);
+    if (tq->tail) {
+        tq->tail->next = item;
+    } else {
+        tq->head = item;
+    }
+    tq->tail = item;
+    pthread_cond_signal(&tq->wake);
+    pthread_mutex_unlock(&tq->mutex);
+    return true;
+}
+
+bool os_task_queue_wait(os_task_queue_t *tq)
+{
+    if (!tq) {
+        return false;
+    }
+    
+    pthread_mutex_lock(&tq->mutex);
+    while (tq->head || tq->running_task) {
+        pthread_cond_wait(&tq->idle, &tq->mutex);
+    }
+    pthread_mutex_unlock(&tq->mutex);
+    return true;
+}
+
+// Runs whatever is queued, then stops the thread
+void os_task_queue_destroy(os_task_queue_t *tq)
+{
+    if (!tq) {
+        return;
+    }
+    
+    pthread_mutex_lock(&task_queues_mutex);
+    for (os_task_queue_t **link = &task_queues; *link; link = &(*link)->next) {
+        if (*link == tq) {
+            *link = tq->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&task_queues_mutex);
+    
+    pthread_mutex_lock(&tq->mutex);
+    tq->stop = true;
+    pthread_cond_signal(&tq->wake);
+    pthread_mutex_unlock(&tq->mutex);
+    pthread_join(tq->thread, NULL);
+    
+    pthread_mutex_destroy(&tq->mutex);
+    pthread_cond_destroy(&tq->wake);
+    pthread_cond_destroy(&tq->idle);
+    bfree(tq);
+}
+
+void obs_shim_wait_task_queues(void)
+{
+    pthread_mutex_lock(&task_queues_mutex);
+    for (os_task_queue_t *tq = task_queues; tq; tq = tq->next) {
+        os_task_queue_wait(tq);
+    }
+    pthread_mutex_unlock(&task_queues_mutex);
+}
+
+// Audio output
+
+struct audio_output {
+    uint32_t sample_rate;
+    size_t channels;
+};
+
+static struct audio_output audio_output = {48000, 2};
+
+void obs_shim_set_audio(uint32_t sample_rate, size_t channels)
+{
+    audio_output.sample_rate = sample_rate;
+    audio_output.channels = channels;
+}
+
+audio_t *obs_get_audio(void)
+{
+    return &audio_output;
+}
+
+size_t audio_output_get_channels(const audio_t *audio)
+{
+    return audio ? audio->channels : 0;
+}
+
+uint32_t audio_output_get_sample_rate(const audio_t *audio)
+{
+    return audio ? audio->sample_rate : 0;
+}
+
+// Settings. Items keep a user value and a default side by side, like
+// obs_data; lookups are linear, which is plenty for a filter's settings.
+
+enum shim_item_type {
+    ITEM_STRING,
+    ITEM_INT,
+    ITEM_DOUBLE,
+    ITEM_BOOL,
+};
+
+struct shim_value {
+    bool set;
+    char *string;
+    long long integer;
+    double number;
+    bool boolean;
+};
+
+struct shim_item {
+    char *name;
+    enum shim_item_type type;
+    struct shim_value user;
+    struct shim_value def;
+    struct shim_item *next;
+};
+
+struct obs_data {
+    volatile long refs;
+    struct shim_item *items;
+};
+
+obs_data_t *obs_data_create(void)
+{
+    obs_data_t *data = bzalloc(sizeof(obs_data_t));
+    data->refs = 1;
+    return data;
+}
+
+void obs_data_addref(obs_data_t *data)
+{
+    if (data) {
+        os_atomic_inc_long(&data->refs);
+    }
+}
+
+void obs_data_release(obs_data_t *data)
+{
+    if (!data || os_atomic_dec_long(&data->refs) > 0) {
+        return;
+    }
+    
+    struct shim_item *item = data->items;
+    while (item) {
+        struct shim_item *next = item->next;
+        bfree(item->name);
+        bfree(item->user.string);
+        bfree(item->def.string);
+        bfree(item);
+        item = next;
+    }
+    bfree(data);
+}
+
+static struct shim_item *data_item(obs_data_t *data, const char *name, bool create)
+{
+    for (struct shim_item *item = data->items; item; item = item->next) {
+        if (strcmp(item->name, name) == 0) {
+            return item;
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+    
+    struct shim_item *item = bzalloc(sizeof(struct shim_item));
+    item->name = bstrdup(name);
+    item->next = data->items;
+    data->items = item;
+    return item;
+}
+
+static struct shim_value *data_value(obs_data_t *data, const char *name,
+                                     enum shim_item_type type, bool user)
+{
+    struct shim_item *item = data_item(data, name, true);
+    item->type = type;
+    struct shim_value *value = user ? &item->user : &item->def;
+    value->set = true;
+    return value;
+}
+
+// The user value if there is one, else the default, else NULL
+static const struct shim_value *data_lookup(obs_data_t *data, const char *name)
+{
+    struct shim_item *item = data ? data_item(data, name, false) : NULL;
+    if (!item) {
+        return NULL;
+    }
+    return item->user.set ? &item->user : item->def.set ? &item->def : NULL;
+}
+
+static void data_set_string(obs_data_t *data, const char *name, const char *val, bool user)
+{
+    struct shim_value *value = data_value(data, name, ITEM_STRING, user);
+    bfree(value->string);
+    value->string = bstrdup(val ? val : "");
+}
+
+void obs_data_set_string(obs_data_t *data, const char *name, const char *val)
+{
+    data_set_string(data, name, val, true);
+}
+
+void obs_data_set_default_string(obs_data_t *data, const char *name, const char *val)
+{
+    data_set_string(data, name, val, false);
+}
+
+void obs_data_set_int(obs_data_t *data, const char *name, long long val)
+{
+    data_value(data, name, ITEM_INT, true)->integer = val;
+}
+
+void obs_data_set_default_int(obs_data_t *data, const char *name, long long val)
+{
+    data_value(data, name, ITEM_INT, false)->integer = val;
+}
+
+void obs_data_set_double(obs_data_t *data, const char *name, double val)
+{
+    data_value(data, name, ITEM_DOUBLE, true)->number = val;
+}
+
+void obs_data_set_default_double(obs_data_t *data, const char *name, double val)
+{
+    data_value(data, name, ITEM_DOUBLE, false)->number = val;
+}
+
+void obs_data_set_bool(obs_data_t *data, const char *name, bool val)
+{
+    data_value(data, name, ITEM_BOOL, true)->boolean = val;
+}
+
+void obs_data_set_default_bool(obs_data_t *data, const char *name, bool val)
+{
+    data_value(data, name, ITEM_BOOL, false)->boolean = val;
+}
+
+const char *obs_data_get_string(obs_data_t *data, const char *name)
+{
+    const struct shim_value *value = data_lookup(data, name);
+    return value && value->string ? value->string : "";
+}
+
+long long obs_data_get_int(obs_data_t *data, const char *name)
+{
+    const struct shim_value *value = data_lookup(data, name);
+    return value ? value->integer : 0;
+}
+
+double obs_data_get_double(obs_data_t *data, const char *name)
+{
+    const struct shim_value *value = data_lookup(data, name);
+    return value ? value->number : 0.0;
+}
+
+bool obs_data_get_bool(obs_data_t *data, const char *name)
+{
+    const struct shim_value *value = data_lookup(data, name);
+    return value ? value->boolean : false;
+}
+
+// Properties
+
+struct obs_property {
+    int unused;
+};
+
+struct obs_properties {
+    struct obs_property property; // handed out for every add
+};
+
+obs_properties_t *obs_properties_create(void)
+{
+    return bzalloc(sizeof(obs_properties_t));
+}
+
+void obs_properties_destroy(obs_properties_t *props)
+{
+    bfree(props);
+}
+
+obs_property_t *obs_properties_add_bool(obs_properties_t *props, const char *name,
+                                        const char *description)
+{
+    UNUSED_PARAMETER(name);
+    UNUSED_PARAMETER(description);
+    return &props->property;
+}
+
+obs_property_t *obs_properties_add_int(obs_properties_t *props, const char *name,
+                                       const char *description, int min, int max, int step)
+{
+    UNUSED_PARAMETER(name);
+    UNUSED_PARAMETER(description);
+    UNUSED_PARAMETER(min);
+    UNUSED_PARAMETER(max);
+    UNUSED_PARAMETER(step);
+    return &props->property;
+}
+
+obs_property_t *obs_properties_add_int_slider(obs_properties_t *props, const char *name,
+                                              const char *description, int min, int max,
+                                              int step)
+{
+    return obs_properties_add_int(props, name, description, min, max, step);
+}
+
+obs_property_t *obs_properties_add_float_slider(obs_properties_t *props, const char *name,
+                                                const char *description, double min,
+                                                double max, double step)
+{
+    UNUSED_PARAMETER(name);
+    UNUSED_PARAMETER(description);
+    UNUSED_PARAMETER(min);
+    UNUSED_PARAMETER(max);
+    UNUSED_PARAMETER(step);
+    return &props->property;
+}
+
+obs_property_t *obs_properties_add_text(obs_properties_t *props, const char *name,
+                                        const char *description, enum obs_text_type type)
+{
+    UNUSED_PARAMETER(name);
+    UNUSED_PARAMETER(description);
+    UNUSED_PARAMETER(type);
+    return &props->property;
+}
+
+obs_property_t *obs_properties_add_path(obs_properties_t *props, const char *name,
+                                        const char *description, enum obs_path_type type,
+                                        const char *filter, const char *default_path)
+{
+    UNUSED_PARAMETER(name);
+    UNUSED_PARAMETER(description);
+    UNUSED_PARAMETER(type);
+    UNUSED_PARAMETER(filter);
+    UNUSED_PARAMETER(default_path);
+    return &props->property;
+}
+
+obs_property_t *obs_properties_add_list(obs_properties_t *props, const char *name,
+                                        const char *description, enum obs_combo_type type,
+                                        enum obs_combo_format format)
+{
+    UNUSED_PARAMETER(name);
+    UNUSED_PARAMETER(description);
+    UNUSED_PARAMETER(type);
+    UNUSED_PARAMETER(format);
+    return &props->property;
+}
+
+obs_property_t *obs_properties_add_group(obs_properties_t *props, const char *name,
+                                         const char *description, enum obs_group_type type,
+                                         obs_properties_t *group)
+{
+    UNUSED_PARAMETER(name);
+    UNUSED_PARAMETER(description);
+    UNUSED_PARAMETER(type);
+    obs_properties_destroy(group);
+    return &props->property;
+}
+
+obs_property_t *obs_properties_add_button(obs_properties_t *props, const char *name,
+                                          const char *text, obs_property_clicked_t callback)
+{
+    UNUSED_PARAMETER(name);
+    UNUSED_PARAMETER(text);
+    UNUSED_PARAMETER(callback);
+    return &props->property;
+}
+
+size_t obs_property_list_add_string(obs_property_t *p, const char *name, const char *val)
+{
+    UNUSED_PARAMETER(p);
+    UNUSED_PARAMETER(name);
+    UNUSED_PARAMETER(val);
+    return 0;
+}
+
+size_t obs_property_list_add_int(obs_property_t *p, const char *name, long long val)
+{
+    UNUSED_PARAMETER(p);
+    UNUSED_PARAMETER(name);
+    UNUSED_PARAMETER(val);
+    return 0;
+}
+
+void obs_property_int_set_suffix(obs_property_t *p, const char *suffix)
+{
+    UNUSED_PARAMETER(p);
+    UNUSED_PARAMETER(suffix);
+}
+
+void obs_property_float_set_suffix(obs_property_t *p, const char *suffix)
+{
+    UNUSED_PARAMETER(p);
+    UNUSED_PARAMETER(suffix);
+}
+
+// Signals: one global handler, with callbacks run under its mutex
+
+void *calldata_ptr(const calldata_t *data, const char *name)
+{
+    for (size_t i = 0; data && i < data->count; i++) {
+        if (strcmp(data->entries[i].name, name) == 0) {
+            return data->entries[i].ptr;
+        }
+    }
+    return NULL;
+}
+
+const char *calldata_string(const calldata_t *data, const char *name)
+{
+    for (size_t i = 0; data && i < data->count; i++) {
+        if (strcmp(data->entries[i].name, name) == 0) {
+            return data->entries[i].string;
+        }
+    }
+    return NULL;
+}
+
+struct shim_connection {
+    char *signal;
+    signal_callback_t callback;
+    void *data;
+    struct shim_connection *next;
+};
+
+struct signal_handler {
+    pthread_mutex_t mutex;
+    struct shim_connection *connections;
+};
+
+static signal_handler_t global_signals = {PTHREAD_MUTEX_INITIALIZER, NULL};
+
+signal_handler_t *obs_get_signal_handler(void)
+{
+    return &global_signals;
+}
+
+void signal_handler_connect(signal_handler_t *handler, const char *signal,
+                            signal_callback_t callback, void *data)
+{
+    struct shim_connection *connection = bzalloc(sizeof(struct shim_connection));
+    connection->signal = bstrdup(signal);
+    connection->callback = callback;
+    connection->data = data;
+    
+    pthread_mutex_lock(&handler->mutex);
+    connection->next = handler->connections;
+    handler->connections = connection;
+    pthread_mutex_unlock(&handler->mutex);
+}
+
+void signal_handler_disconnect(signal_handler_t *handler, const char *signal,
+                               signal_callback_t callback, void *data)
+{
+    pthread_mutex_lock(&handler->mutex);
+    for (struct shim_connection **link = &handler->connections; *link; link = &(*link)->next) {
+        struct shim_connection *connection = *link;
+        if (connection->callback == callback && connection->data == data &&
+            strcmp(connection->signal, signal) == 0) {
+            *link = connection->next;
+            bfree(connection->signal);
+            bfree(connection);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&handler->mutex);
+}
+
+static void shim_signal(signal_handler_t *handler, const char *signal, calldata_t *data)
+{
+    pthread_mutex_lock(&handler->mutex);
+    for (struct shim_connection *connection = handler->connections; connection;
+         connection = connection->next) {
+        if (strcmp(connection->signal, signal) == 0) {
+            connection->callback(connection->data, data);
+        }
+    }
+    pthread_mutex_unlock(&handler->mutex);
+}
+
+// Sources. The host owns them; lookups hand out the same pointer without
+// counting references. Weak references outlive their source and then
+// resolve to NULL.
+
+struct obs_weak_source {
+    volatile long refs;
+    obs_source_t *source; // guarded by sources_mutex
+};
+
+struct obs_source {
+    char *name;
+    volatile long updates;
+    obs_weak_source_t *weak;
+    struct obs_source *next;
+};
+
+static pthread_mutex_t sources_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct obs_source *sources;
+
+static void shim_source_signal(const char *signal, obs_source_t *source)
+{
+    calldata_t data = {{{"source", source, NULL}}, 1};
+    shim_signal(&global_signals, signal, &data);
+}
+
+obs_source_t *obs_shim_source_create(const char *name)
+{
+    obs_source_t *source = bzalloc(sizeof(obs_source_t));
+    source->name = bstrdup(name);
+    source->weak = bzalloc(sizeof(obs_weak_source_t));
+    source->weak->refs = 1;
+    source->weak->source = source;
+    
+    pthread_mutex_lock(&sources_mutex);
+    source->next = sources;
+    sources = source;
+    pthread_mutex_unlock(&sources_mutex);
+    
+    shim_source_signal("source_create", source);
+    return source;
+}
+
+void obs_shim_source_destroy(obs_source_t *source)
+{
+    if (!source) {
+        return;
+    }
+    
+    shim_source_signal("source_remove", source);
+    
+    pthread_mutex_lock(&sources_mutex);
+    for (obs_source_t **link = &sources; *link; link = &(*link)->next) {
+        if (*link == source) {
+            *link = source->next;
+            break;
+        }
+    }
+    source->weak->source = NULL;
+    pthread_mutex_unlock(&sources_mutex);
+    
+    obs_weak_source_release(source->weak);
+    bfree(source->name);
+    bfree(source);
+}
+
+obs_weak_source_t *obs_source_get_weak_source(obs_source_t *source)
+{
+    if (!source) {
+        return NULL;
+    }
+    os_atomic_inc_long(&source->weak->refs);
+    return source->weak;
+}
+
+obs_source_t *obs_weak_source_get_source(obs_weak_source_t *weak)
+{
+    if (!weak) {
+        return NULL;
+    }
+    pthread_mutex_lock(&sources_mutex);
+    obs_source_t *source = weak->source;
+    pthread_mutex_unlock(&sources_mutex);
+    return source;
+}
+
+void obs_weak_source_release(obs_weak_source_t *weak)
+{
+    if (weak && os_atomic_dec_long(&weak->refs) == 0) {
+        bfree(weak);
+    }
+}
+
+uint64_t obs_shim_source_updates(const obs_source_t *source)
+{
+    return source ? (uint64_t)os_atomic_load_long(&source->updates) : 0;
+}
+
+obs_source_t *obs_get_source_by_name(const char *name)
+{
+    obs_source_t *found = NULL;
+    
+    pthread_mutex_lock(&sources_mutex);
+    for (obs_source_t *source = sources; source && name; source = source->next) {
+        if (strcmp(source->name, name) == 0) {
+            found = source;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sources_mutex);
+    return found;
+}
+
+void obs_source_release(obs_source_t *source)
+{
+    UNUSED_PARAMETER(source);
+}
+
+void obs_source_update(obs_source_t *source, obs_data_t *settings)
+{
+    UNUSED_PARAMETER(settings);
+    if (source) {
+        os_atomic_inc_long(&source->updates);
+    }
+}
+
+const char *obs_source_get_name(const obs_source_t *source)
+{
+    return source ? source->name : NULL;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <obs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Host-side controls of the libobs shim. The plugin never sees these; the
+// benchmark harness uses them to stand in for OBS around the filter.
+
+// Format of the audio OBS would mix; set it before creating a filter
+void obs_shim_set_audio(uint32_t sample_rate, size_t channels);
+
+// Messages above `level` (LOG_ERROR < LOG_WARNING < LOG_INFO < LOG_DEBUG)
+// are dropped
+void obs_shim_set_log_level(int level);
+
+// Named sources that obs_get_source_by_name can find. Updates are accepted
+// and counted, nothing is rendered.
+obs_source_t *obs_shim_source_create(const char *name);
+void obs_shim_source_destroy(obs_source_t *source);
+uint64_t obs_shim_source_updates(const obs_source_t *source);
+
+// Blocks until every task queue has run what it was given, e.g. until a
+// filter has finished loading its engines
+void obs_shim_wait_task_queues(void);
+
+// CPU time of the threads that named themselves with os_set_thread_name,
+// summed per name. Threads that have exited keep their last reading.
+struct obs_shim_thread_time {
+    char name[64];
+    uint32_t threads;
+    uint64_t cpu_ns;
+};
+
+size_t obs_shim_get_thread_times(struct obs_shim_thread_time *times, size_t max_times);
+
+// CPU time of the calling thread, or 0 where the platform cannot tell
+uint64_t obs_shim_thread_cpu_ns(void);
+
+#ifdef __cplusplus
+}
+#endif
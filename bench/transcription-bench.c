@@ -0,0 +1,840 @@
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include "obs-shim.h"
+#include "ai-transcription-filter.h"
+#include "audio-kernels.h"
+#include "inference-scheduler.h"
+#include "load-shedder.h"
+#include "llm-corrector.h"
+#include "transcript-writer.h"
+#include <math.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Headless end-to-end benchmark. Plays WAV files (or deterministic
+// synthetic speech) into the filter through the libobs shim, the way OBS
+// would deliver them, and reports real-time factor, speech-to-caption
+// latency, dropped audio and CPU time per pipeline stage. Exits non-zero
+// when a --max-* limit is exceeded, so it can gate regressions.
+
+#define BENCH_SAMPLE_RATE 16000        // the filter's internal rate
+#define BENCH_INGEST_CHUNK 1600        // samples the worker takes per VAD pass
+#define BENCH_TAIL_SILENCE_MS 1500     // lets the VAD close the last utterance
+#define BENCH_MAX_PENDING_SAMPLES BENCH_SAMPLE_RATE
+#define BENCH_MAX_PENDING_SEGMENTS 4   // half the filter's inference queue
+#define BENCH_DRAIN_TIMEOUT_NS 120000000000ULL
+#define BENCH_MAX_STAGES 16
+#define BENCH_SYNTH_HARMONICS 36 // covers 4kHz at the lowest pitch
+#define BENCH_TEXT_SOURCE "Bench Captions"
+
+struct bench_options {
+    bool max_speed;
+    const char *model_path;
+    bool streaming;
+    bool load_shedding;
+    int interval_ms;
+    int workers;
+    int threads;
+    int beam_size;
+    int latency_budget_ms; // auto-tuning when > 0
+    int runs;
+    const char *llm_endpoint;
+    const char *llm_key;
+    const char *stats_path;
+    const char *transcript_path;
+    bool verbose;
+    double max_rtf;
+    double max_p95_ms;
+    double max_p99_ms;
+    double max_dropped_ms;
+    long max_dropped_segments;
+};
+
+struct bench_audio {
+    uint32_t sample_rate;
+    uint32_t channels;
+    size_t frames;
+    float **planes;
+};
+
+// When each packet was handed to the filter. Entries are written before
+// count is published, so the caption callback can search them while the
+// feed goes on.
+struct bench_feed_entry {
+    uint64_t frames_end;
+    uint64_t time_ns;
+};
+
+struct bench_run {
+    uint32_t sample_rate;
+    struct bench_feed_entry *feed;
+    volatile long feed_count;
+    
+    pthread_mutex_t mutex;
+    double *latencies_ms;
+    size_t latency_count;
+    size_t latency_capacity;
+    uint64_t captions;
+};
+
+struct bench_totals {
+    double audio_s;
+    double fed_s; // audio plus the trailing silence
+    double wall_s;
+    double *latencies_ms;
+    size_t latency_count;
+    uint64_t captions;
+    uint64_t samples_dropped;
+    uint64_t segments_queued;
+    uint64_t segments_dropped;
+    uint64_t load_escalations;
+    uint32_t load_level_max;
+    uint64_t callbacks;
+    uint64_t callback_cpu_ns;
+    uint64_t callback_max_ns;
+    uint64_t process_cpu_ns;
+    struct obs_shim_thread_time stages[BENCH_MAX_STAGES];
+    size_t stage_count;
+};
+
+static void bench_usage(void)
+{
+    fprintf(stderr,
+            "usage: transcription-bench [options] <file.wav | synth:SECONDS>...\n"
+            "\n"
+            "  --speed realtime|max  feed at the input's own pace (default) or as fast as\n"
+            "                        the pipeline accepts it\n"
+            "  --model PATH          Whisper model; defaults to a stand-in file, which is all\n"
+            "                        the placeholder engine needs\n"
+            "  --streaming on|off    streaming transcription (default on)\n"
+            "  --load-shedding on|off\n"
+            "                        degrade quality when inference falls behind (default on)\n"
+            "  --interval MS         transcription interval (default 1000)\n"
+            "  --workers N           inference workers, 0 = auto (default 0)\n"
+            "  --threads N           decoder threads per worker, 0 = auto (default 0)\n"
+            "  --beam N              beam size, 1 decodes greedily (default 1)\n"
+            "  --auto-tune MS        let the model tuner pick the variant, threads and\n"
+            "                        window for this latency budget\n"
+            "  --runs N              play every input N times (default 1)\n"
+            "  --llm URL             enable LLM correction against this endpoint\n"
+            "  --llm-key KEY         API key for --llm (default \"bench\")\n"
+            "  --stats-file PATH     have the filter write its pipeline stats file here\n"
+            "  --transcript PATH     save the transcript here; .srt, .vtt and .jsonl pick\n"
+            "                        that format, anything else is plain text\n"
+            "  --verbose             show the plugin's log\n"
+            "\n"
+            "  --max-rtf X           fail if the real-time factor exceeds X\n"
+            "  --max-p95 MS          fail if p95 speech-to-caption latency exceeds MS\n"
+            "  --max-p99 MS          fail if p99 speech-to-caption latency exceeds MS\n"
+            "  --max-dropped-ms MS   fail if more than MS of audio was dropped\n"
+            "  --max-dropped-segments N\n"
+            "                        fail if the inference pool gave up on more than N\n");
+}
+
+// Input
+
+static uint32_t read_le(const uint8_t *p, int bytes)
+{
+    uint32_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static void bench_audio_free(struct bench_audio *audio)
+{
+    for (uint32_t c = 0; c < audio->channels && audio->planes; c++) {
+        bfree(audio->planes[c]);
+    }
+    bfree(audio->planes);
+    memset(audio, 0, sizeof(*audio));
+}
+
+static void bench_audio_alloc(struct bench_audio *audio, uint32_t sample_rate,
+                              uint32_t channels, size_t frames)
+{
+    audio->sample_rate = sample_rate;
+    audio->channels = channels;
+    audio->frames = frames;
+    audio->planes = bzalloc(channels * sizeof(float *));
+    for (uint32_t c = 0; c < channels; c++) {
+        audio->planes[c] = bzalloc((frames ? frames : 1) * sizeof(float));
+    }
+}
+
+// PCM (8/16/24/32-bit) and 32-bit float WAV, including WAVE_FORMAT_EXTENSIBLE
+static bool bench_load_wav(const char *path, struct bench_audio *audio)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+    
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *bytes = size > 0 ? bmalloc((size_t)size) : NULL;
+    bool read_ok = bytes && fread(bytes, 1, (size_t)size, file) == (size_t)size;
+    fclose(file);
+    
+    if (!read_ok || size < 12 || memcmp(bytes, "RIFF", 4) != 0 ||
+        memcmp(bytes + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "%s: not a WAV file\n", path);
+        bfree(bytes);
+        return false;
+    }
+    
+    uint32_t format = 0, channels = 0, sample_rate = 0, bits = 0;
+    const uint8_t *data = NULL;
+    size_t data_size = 0;
+    
+    for (size_t pos = 12; pos + 8 <= (size_t)size;) {
+        uint32_t chunk_size = read_le(bytes + pos + 4, 4);
+        const uint8_t *chunk = bytes + pos + 8;
+        size_t available = (size_t)size - pos - 8;
+        if (chunk_size > available) {
+            chunk_size = (uint32_t)available;
+        }
+        
+        if (memcmp(bytes + pos, "fmt ", 4) == 0 && chunk_size >= 16) {
+            format = read_le(chunk, 2);
+            channels = read_le(chunk + 2, 2);
+            sample_rate = read_le(chunk + 4, 4);
+            bits = read_le(chunk + 14, 2);
+            if (format == 0xFFFE && chunk_size >= 26) {
+                format = read_le(chunk + 24, 2); // sub-format GUID starts with the tag
+            }
+        } else if (memcmp(bytes + pos, "data", 4) == 0) {
+            data = chunk;
+            data_size = chunk_size;
+        }
+        pos += 8 + (size_t)chunk_size + (chunk_size & 1);
+    }
+    
+    bool supported = (format == 1 && (bits == 8 || bits == 16 || bits == 24 || bits == 32)) ||
+                     (format == 3 && bits == 32);
+    if (!data || !supported || channels == 0 || channels > MAX_AV_PLANES || sample_rate == 0) {
+        fprintf(stderr, "%s: unsupported WAV format (tag %u, %u bits, %u channels)\n", path,
+                format, bits, channels);
+        bfree(bytes);
+        return false;
+    }
+    
+    uint32_t sample_bytes = bits / 8;
+    size_t frames = data_size / (sample_bytes * channels);
+    bench_audio_alloc(audio, sample_rate, channels, frames);
+    
+    for (size_t i = 0; i < frames; i++) {
+        for (uint32_t c = 0; c < channels; c++) {
+            const uint8_t *p = data + (i * channels + c) * sample_bytes;
+            float value;
+            if (format == 3) {
+                memcpy(&value, p, sizeof(float));
+            } else if (bits == 8) {
+                value = ((float)p[0] - 128.0f) / 128.0f;
+            } else {
+                // Sign-extend from the top byte
+                int32_t sample = (int32_t)(read_le(p, (int)sample_bytes) << (32 - bits));
+                value = (float)sample / 2147483648.0f;
+            }
+            audio->planes[c][i] = value;
+        }
+    }
+    
+    bfree(bytes);
+    return true;
+}
+
+// Deterministic speech-like audio: voiced phrases of 1.2-3 s with a
+// wandering pitch, formant-shaped harmonics and syllable-rate amplitude
+// modulation, separated by 0.5-1.2 s of faint noise. 48kHz stereo, the
+// usual OBS mix format.
+static void bench_synthesize(double seconds, struct bench_audio *audio)
+{
+    const uint32_t rate = 48000;
+    const double formants[3] = {600.0, 1400.0, 2600.0};
+    size_t frames = (size_t)(seconds * rate);
+    bench_audio_alloc(audio, rate, 2, frames);
+    
+    uint32_t seed = 12345;
+    size_t pos = 0;
+    double phase = 0.0;
+    bool voiced = false;
+    
+    while (pos < frames) {
+        seed = seed * 1664525u + 1013904223u;
+        double span = voiced ? 0.5 + (seed >> 8) / 16777216.0 * 0.7
+                             : 1.2 + (seed >> 8) / 16777216.0 * 1.8;
+        voiced = !voiced;
+        size_t end = pos + (size_t)(span * rate);
+        if (end > frames) {
+            end = frames;
+        }
+        
+        double base_pitch = 110.0 + (seed % 90);
+        double pitch = base_pitch;
+        double gains[BENCH_SYNTH_HARMONICS] = {0};
+        for (size_t i = pos; i < end; i++) {
+            double t = (double)(i - pos) / rate;
+            seed = seed * 1664525u + 1013904223u;
+            double noise = ((seed >> 8) / 16777216.0 - 0.5) * 0.002;
+            double value = noise;
+            
+            if (voiced) {
+                // Pitch and harmonic weights move slowly; refresh every 10 ms
+                if ((i - pos) % (rate / 100) == 0) {
+                    pitch = base_pitch * (1.0 + 0.08 * sin(2.0 * M_PI * 0.7 * t));
+                    for (int h = 1; h <= BENCH_SYNTH_HARMONICS; h++) {
+                        double gain = 0.0;
+                        for (int f = 0; f < 3 && h * pitch < 4000.0; f++) {
+                            double d = (h * pitch - formants[f]) / 300.0;
+                            gain += exp(-d * d) / (f + 1);
+                        }
+                        gains[h - 1] = gain;
+                    }
+                }
+                phase += 2.0 * M_PI * pitch / rate;
+                double envelope = 0.5 - 0.5 * cos(2.0 * M_PI * 4.0 * t);
+                // sin(h * phase) by the Chebyshev recurrence
+                double two_cos = 2.0 * cos(phase);
+                double previous = 0.0, current = sin(phase);
+                double voice = 0.0;
+                for (int h = 1; h <= BENCH_SYNTH_HARMONICS; h++) {
+                    voice += gains[h - 1] * current;
+                    double next = two_cos * current - previous;
+                    previous = current;
+                    current = next;
+                }
+                value += 0.15 * envelope * voice;
+            }
+            
+            audio->planes[0][i] = (float)value;
+            audio->planes[1][i] = (float)value;
+        }
+        pos = end;
+    }
+}
+
+static bool bench_load_input(const char *input, struct bench_audio *audio)
+{
+    if (strncmp(input, "synth:", 6) == 0) {
+        double seconds = atof(input + 6);
+        if (seconds <= 0.0) {
+            fprintf(stderr, "%s: expected synth:SECONDS\n", input);
+            return false;
+        }
+        bench_synthesize(seconds, audio);
+        return true;
+    }
+    return bench_load_wav(input, audio);
+}
+
+// Latency
+
+// Caption callback, on an inference thread: finds when the packet holding
+// the end of the utterance was delivered
+static void bench_caption(void *param, const char *text, uint64_t end_sample)
+{
+    struct bench_run *run = param;
+    uint64_t now = os_gettime_ns();
+    UNUSED_PARAMETER(text);
+    
+    uint64_t end_frame = (end_sample * run->sample_rate + BENCH_SAMPLE_RATE - 1) /
+                         BENCH_SAMPLE_RATE;
+    size_t count = (size_t)os_atomic_load_long(&run->feed_count);
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (run->feed[mid].frames_end < end_frame) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    
+    pthread_mutex_lock(&run->mutex);
+    run->captions++;
+    if (lo < count) {
+        if (run->latency_count == run->latency_capacity) {
+            run->latency_capacity = run->latency_capacity ? run->latency_capacity * 2 : 64;
+            run->latencies_ms = brealloc(run->latencies_ms,
+                                         run->latency_capacity * sizeof(double));
+        }
+        run->latencies_ms[run->latency_count++] = (double)(now - run->feed[lo].time_ns) / 1e6;
+    }
+    pthread_mutex_unlock(&run->mutex);
+}
+
+static int bench_compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Nearest-rank percentile of sorted values
+static double bench_percentile(const double *sorted, size_t count, double p)
+{
+    if (count == 0) {
+        return 0.0;
+    }
+    size_t rank = (size_t)ceil(p / 100.0 * count);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// Running the filter
+
+static uint64_t bench_process_cpu_ns(void)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return ((uint64_t)usage.ru_utime.tv_sec + (uint64_t)usage.ru_stime.tv_sec) * 1000000000ULL +
+           ((uint64_t)usage.ru_utime.tv_usec + (uint64_t)usage.ru_stime.tv_usec) * 1000ULL;
+}
+
+static enum transcript_format transcript_format_for(const char *path)
+{
+    const char *extension = strrchr(path, '.');
+    if (extension && strcmp(extension, ".srt") == 0) {
+        return TRANSCRIPT_FORMAT_SRT;
+    }
+    if (extension && strcmp(extension, ".vtt") == 0) {
+        return TRANSCRIPT_FORMAT_WEBVTT;
+    }
+    if (extension && strcmp(extension, ".jsonl") == 0) {
+        return TRANSCRIPT_FORMAT_JSONL;
+    }
+    return TRANSCRIPT_FORMAT_TEXT;
+}
+
+static obs_data_t *bench_settings(const struct bench_options *options)
+{
+    obs_data_t *settings = obs_data_create();
+    ai_transcription_filter_info.get_defaults(settings);
+    
+    obs_data_set_bool(settings, "enabled", true);
+    obs_data_set_string(settings, "whisper_model_path", options->model_path);
+    obs_data_set_bool(settings, "streaming_mode", options->streaming);
+    obs_data_set_bool(settings, "load_shedding", options->load_shedding);
+    obs_data_set_int(settings, "transcription_interval_ms", options->interval_ms);
+    obs_data_set_int(settings, "inference_workers", options->workers);
+    obs_data_set_int(settings, "whisper_threads", options->threads);
+    obs_data_set_int(settings, "whisper_beam_size", options->beam_size);
+    if (options->latency_budget_ms > 0) {
+        obs_data_set_bool(settings, "auto_tune", true);
+        obs_data_set_int(settings, "latency_budget_ms", options->latency_budget_ms);
+    }
+    obs_data_set_bool(settings, "output_to_text_source", true);
+    obs_data_set_string(settings, "text_source_name", BENCH_TEXT_SOURCE);
+    
+    // Faster than real time every job would look stale to the live deadline
+    obs_data_set_bool(settings, "real_time_mode", !options->max_speed);
+    
+    if (options->llm_endpoint) {
+        obs_data_set_bool(settings, "use_llm_correction", true);
+        obs_data_set_string(settings, "llm_api_endpoint", options->llm_endpoint);
+        obs_data_set_string(settings, "llm_api_key", options->llm_key);
+    }
+    if (options->stats_path) {
+        obs_data_set_string(settings, "stats_file_path", options->stats_path);
+    }
+    if (options->transcript_path) {
+        obs_data_set_bool(settings, "save_to_file", true);
+        obs_data_set_string(settings, "output_file_path", options->transcript_path);
+        obs_data_set_int(settings, "output_format", transcript_format_for(options->transcript_path));
+    }
+    return settings;
+}
+
+static void bench_add_stage_times(struct bench_totals *totals,
+                                  const struct obs_shim_thread_time *before, size_t before_count,
+                                  const struct obs_shim_thread_time *after, size_t after_count)
+{
+    for (size_t i = 0; i < after_count; i++) {
+        uint64_t cpu_ns = after[i].cpu_ns;
+        for (size_t j = 0; j < before_count; j++) {
+            if (strcmp(before[j].name, after[i].name) == 0) {
+                cpu_ns -= cpu_ns > before[j].cpu_ns ? before[j].cpu_ns : cpu_ns;
+                break;
+            }
+        }
+        
+        size_t slot = 0;
+        while (slot < totals->stage_count && strcmp(totals->stages[slot].name, after[i].name)) {
+            slot++;
+        }
+        if (slot == totals->stage_count) {
+            if (slot == BENCH_MAX_STAGES) {
+                continue;
+            }
+            totals->stages[slot] = after[i];
+            totals->stages[slot].cpu_ns = 0;
+            totals->stage_count++;
+        }
+        totals->stages[slot].cpu_ns += cpu_ns;
+    }
+}
+
+// Plays one input into a fresh filter and waits until everything it
+// produced has been transcribed
+static bool bench_run_input(const struct bench_options *options, const char *input,
+                            const struct bench_audio *audio, struct bench_totals *totals)
+{
+    size_t tail_frames = (size_t)audio->sample_rate * BENCH_TAIL_SILENCE_MS / 1000;
+    size_t total_frames = audio->frames + tail_frames;
+    size_t packets = (audio->frames + AUDIO_OUTPUT_FRAMES - 1) / AUDIO_OUTPUT_FRAMES +
+                     (tail_frames + AUDIO_OUTPUT_FRAMES - 1) / AUDIO_OUTPUT_FRAMES;
+    
+    struct bench_run run = {0};
+    run.sample_rate = audio->sample_rate;
+    run.feed = bzalloc(packets * sizeof(struct bench_feed_entry));
+    pthread_mutex_init(&run.mutex, NULL);
+    
+    float *silence = bzalloc(AUDIO_OUTPUT_FRAMES * sizeof(float));
+    
+    obs_shim_set_audio(audio->sample_rate, audio->channels);
+    obs_source_t *text_source = obs_shim_source_create(BENCH_TEXT_SOURCE);
+    obs_source_t *source = obs_shim_source_create("Bench Audio");
+    obs_data_t *settings = bench_settings(options);
+    
+    void *filter = ai_transcription_filter_info.create(settings, source);
+    ai_transcription_set_caption_callback(filter, bench_caption, &run);
+    obs_shim_wait_task_queues(); // engines loaded before the clock starts
+    
+    struct obs_shim_thread_time before[BENCH_MAX_STAGES];
+    size_t before_count = obs_shim_get_thread_times(before, BENCH_MAX_STAGES);
+    uint64_t process_cpu_start = bench_process_cpu_ns();
+    
+    uint64_t start = os_gettime_ns();
+    size_t fed = 0;
+    for (size_t packet = 0; fed < total_frames && packet < packets; packet++) {
+        uint32_t frames = (uint32_t)(total_frames - fed < AUDIO_OUTPUT_FRAMES
+                                         ? total_frames - fed : AUDIO_OUTPUT_FRAMES);
+        
+        // A packet is delivered once all of it has been captured
+        if (!options->max_speed) {
+            os_sleepto_ns(start + (uint64_t)(fed + frames) * 1000000000ULL / audio->sample_rate);
+        }
+        
+        struct obs_audio_data data = {0};
+        for (uint32_t c = 0; c < audio->channels; c++) {
+            data.data[c] = (uint8_t *)(fed < audio->frames ? audio->planes[c] + fed : silence);
+        }
+        if (fed < audio->frames && fed + frames > audio->frames) {
+            frames = (uint32_t)(audio->frames - fed); // the tail starts on a packet boundary
+        }
+        data.frames = frames;
+        data.timestamp = start + (uint64_t)fed * 1000000000ULL / audio->sample_rate;
+        
+        uint64_t cpu_before = obs_shim_thread_cpu_ns();
+        ai_transcription_filter_info.filter_audio(filter, &data);
+        uint64_t cpu_spent = obs_shim_thread_cpu_ns() - cpu_before;
+        totals->callbacks++;
+        totals->callback_cpu_ns += cpu_spent;
+        if (cpu_spent > totals->callback_max_ns) {
+            totals->callback_max_ns = cpu_spent;
+        }
+        
+        fed += frames;
+        run.feed[packet].frames_end = fed;
+        run.feed[packet].time_ns = os_gettime_ns();
+        os_atomic_set_long(&run.feed_count, (long)(packet + 1));
+        
+        // Flat out, only stay as far ahead as the filter can queue
+        struct ai_transcription_stats stats;
+        while (options->max_speed) {
+            ai_transcription_get_stats(filter, &stats);
+            if (stats.samples_pending < BENCH_MAX_PENDING_SAMPLES &&
+                stats.segments_pending < BENCH_MAX_PENDING_SEGMENTS) {
+                break;
+            }
+            os_sleep_ms(1);
+        }
+    }
+    
+    // Drain: the worker has seen everything and no segment is left
+    struct ai_transcription_stats stats;
+    uint64_t drain_start = os_gettime_ns();
+    bool drained = false;
+    while (os_gettime_ns() - drain_start < BENCH_DRAIN_TIMEOUT_NS) {
+        ai_transcription_get_stats(filter, &stats);
+        if (stats.samples_pending < BENCH_INGEST_CHUNK && stats.segments_pending == 0) {
+            drained = true;
+            break;
+        }
+        os_sleep_ms(2);
+    }
+    uint64_t end = os_gettime_ns();
+    
+    struct obs_shim_thread_time after[BENCH_MAX_STAGES];
+    size_t after_count = obs_shim_get_thread_times(after, BENCH_MAX_STAGES);
+    bench_add_stage_times(totals, before, before_count, after, after_count);
+    totals->process_cpu_ns += bench_process_cpu_ns() - process_cpu_start;
+    
+    ai_transcription_filter_info.destroy(filter);
+    obs_data_release(settings);
+    obs_shim_source_destroy(source);
+    obs_shim_source_destroy(text_source);
+    
+    if (!drained) {
+        fprintf(stderr, "%s: pipeline did not drain within %llu s\n", input,
+                (unsigned long long)(BENCH_DRAIN_TIMEOUT_NS / 1000000000ULL));
+    }
+    
+    totals->audio_s += (double)audio->frames / audio->sample_rate;
+    totals->fed_s += (double)total_frames / audio->sample_rate;
+    totals->wall_s += (double)(end - start) / 1e9;
+    totals->captions += run.captions;
+    totals->samples_dropped += stats.samples_dropped;
+    totals->segments_queued += stats.segments_queued;
+    totals->segments_dropped += stats.segments_dropped;
+    totals->load_escalations += stats.load_escalations;
+    if (stats.load_level_max > totals->load_level_max) {
+        totals->load_level_max = stats.load_level_max;
+    }
+    
+    if (run.latency_count > 0) {
+        totals->latencies_ms = brealloc(totals->latencies_ms, (totals->latency_count +
+                                        run.latency_count) * sizeof(double));
+        memcpy(totals->latencies_ms + totals->latency_count, run.latencies_ms,
+               run.latency_count * sizeof(double));
+        totals->latency_count += run.latency_count;
+    }
+    
+    printf("  %-40s %7.1f s audio, %7.1f s wall, %4llu captions\n", input,
+           (double)audio->frames / audio->sample_rate, (double)(end - start) / 1e9,
+           (unsigned long long)run.captions);
+    
+    bfree(silence);
+    bfree(run.latencies_ms);
+    bfree(run.feed);
+    pthread_mutex_destroy(&run.mutex);
+    return drained;
+}
+
+// Report
+
+// Pipeline order for the plugin's threads, anything else after them
+static int bench_stage_rank(const char *name)
+{
+    static const char *order[] = {
+        "ai-transcription: ingest",
+        "ai-transcription: inference",
+        "ai-transcription: correction",
+        "ai-transcription: llm",
+    };
+    for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+        if (strcmp(name, order[i]) == 0) {
+            return (int)i;
+        }
+    }
+    return (int)(sizeof(order) / sizeof(order[0]));
+}
+
+static int bench_compare_stage(const void *a, const void *b)
+{
+    const struct obs_shim_thread_time *x = a, *y = b;
+    int rank = bench_stage_rank(x->name) - bench_stage_rank(y->name);
+    return rank ? rank : strcmp(x->name, y->name);
+}
+
+static void bench_sort_stages(struct bench_totals *totals)
+{
+    qsort(totals->stages, totals->stage_count, sizeof(totals->stages[0]), bench_compare_stage);
+}
+
+static bool bench_report(const struct bench_options *options, struct bench_totals *totals)
+{
+    qsort(totals->latencies_ms, totals->latency_count, sizeof(double), bench_compare_double);
+    
+    double rtf = totals->wall_s / totals->fed_s;
+    double p50 = bench_percentile(totals->latencies_ms, totals->latency_count, 50.0);
+    double p95 = bench_percentile(totals->latencies_ms, totals->latency_count, 95.0);
+    double p99 = bench_percentile(totals->latencies_ms, totals->latency_count, 99.0);
+    double max = totals->latency_count ? totals->latencies_ms[totals->latency_count - 1] : 0.0;
+    double dropped_ms = (double)totals->samples_dropped * 1000.0 / BENCH_SAMPLE_RATE;
+    
+    printf("\n");
+    printf("audio          %.1f s in %.1f s, real-time factor %.3f%s\n", totals->audio_s,
+           totals->wall_s, rtf, options->max_speed ? "" : " (paced, see --speed max)");
+    printf("captions       %llu from %llu segments\n", (unsigned long long)totals->captions,
+           (unsigned long long)totals->segments_queued);
+    printf("latency        p50 %.1f ms, p95 %.1f ms, p99 %.1f ms, max %.1f ms (speech end to caption)\n",
+           p50, p95, p99, max);
+    printf("dropped        %.1f ms of audio, %llu segments\n", dropped_ms,
+           (unsigned long long)totals->segments_dropped);
+    if (totals->load_escalations > 0) {
+        printf("load shedding  stepped down %llu times, worst level %s\n",
+               (unsigned long long)totals->load_escalations,
+               load_level_name((enum load_level)totals->load_level_max));
+    }
+    
+    printf("\nCPU time per stage        total ms   %% of audio\n");
+    printf("  %-22s %10.1f %10.2f%%   (avg %.1f us, max %.1f us per packet)\n",
+           "audio callback", totals->callback_cpu_ns / 1e6,
+           totals->callback_cpu_ns / 1e7 / totals->audio_s,
+           totals->callbacks ? totals->callback_cpu_ns / 1e3 / totals->callbacks : 0.0,
+           totals->callback_max_ns / 1e3);
+    bench_sort_stages(totals);
+    for (size_t i = 0; i < totals->stage_count; i++) {
+        const struct obs_shim_thread_time *stage = &totals->stages[i];
+        const char *name = strncmp(stage->name, "ai-transcription: ", 18) == 0
+                               ? stage->name + 18 : stage->name;
+        printf("  %-22s %10.1f %10.2f%%\n", name, stage->cpu_ns / 1e6,
+               stage->cpu_ns / 1e7 / totals->audio_s);
+    }
+    printf("  %-22s %10.1f %10.2f%%\n", "process", totals->process_cpu_ns / 1e6,
+           totals->process_cpu_ns / 1e7 / totals->audio_s);
+    
+    bool passed = true;
+    if (options->max_rtf > 0.0 && rtf > options->max_rtf) {
+        printf("FAIL: real-time factor %.3f above %.3f\n", rtf, options->max_rtf);
+        passed = false;
+    }
+    if (options->max_p95_ms > 0.0 && p95 > options->max_p95_ms) {
+        printf("FAIL: p95 latency %.1f ms above %.1f ms\n", p95, options->max_p95_ms);
+        passed = false;
+    }
+    if (options->max_p99_ms > 0.0 && p99 > options->max_p99_ms) {
+        printf("FAIL: p99 latency %.1f ms above %.1f ms\n", p99, options->max_p99_ms);
+        passed = false;
+    }
+    if (options->max_dropped_ms >= 0.0 && dropped_ms > options->max_dropped_ms) {
+        printf("FAIL: %.1f ms of audio dropped, limit %.1f ms\n", dropped_ms,
+               options->max_dropped_ms);
+        passed = false;
+    }
+    if (options->max_dropped_segments >= 0 &&
+        totals->segments_dropped > (uint64_t)options->max_dropped_segments) {
+        printf("FAIL: %llu segments dropped, limit %ld\n",
+               (unsigned long long)totals->segments_dropped, options->max_dropped_segments);
+        passed = false;
+    }
+    return passed;
+}
+
+int main(int argc, char **argv)
+{
+    struct bench_options options = {
+        .streaming = true,
+        .load_shedding = true,
+        .interval_ms = 1000,
+        .beam_size = 1,
+        .runs = 1,
+        .llm_key = "bench",
+        .max_dropped_ms = -1.0,
+        .max_dropped_segments = -1,
+    };
+    
+    int first_input = argc;
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        bool takes_value = true;
+        
+        if (strcmp(arg, "--speed") == 0 && value) {
+            options.max_speed = strcmp(value, "max") == 0;
+        } else if (strcmp(arg, "--model") == 0 && value) {
+            options.model_path = value;
+        } else if (strcmp(arg, "--streaming") == 0 && value) {
+            options.streaming = strcmp(value, "off") != 0;
+        } else if (strcmp(arg, "--load-shedding") == 0 && value) {
+            options.load_shedding = strcmp(value, "off") != 0;
+        } else if (strcmp(arg, "--interval") == 0 && value) {
+            options.interval_ms = atoi(value);
+        } else if (strcmp(arg, "--workers") == 0 && value) {
+            options.workers = atoi(value);
+        } else if (strcmp(arg, "--threads") == 0 && value) {
+            options.threads = atoi(value);
+        } else if (strcmp(arg, "--beam") == 0 && value) {
+            options.beam_size = atoi(value) > 0 ? atoi(value) : 1;
+        } else if (strcmp(arg, "--auto-tune") == 0 && value) {
+            options.latency_budget_ms = atoi(value);
+        } else if (strcmp(arg, "--runs") == 0 && value) {
+            options.runs = atoi(value) > 0 ? atoi(value) : 1;
+        } else if (strcmp(arg, "--llm") == 0 && value) {
+            options.llm_endpoint = value;
+        } else if (strcmp(arg, "--llm-key") == 0 && value) {
+            options.llm_key = value;
+        } else if (strcmp(arg, "--stats-file") == 0 && value) {
+            options.stats_path = value;
+        } else if (strcmp(arg, "--transcript") == 0 && value) {
+            options.transcript_path = value;
+        } else if (strcmp(arg, "--max-rtf") == 0 && value) {
+            options.max_rtf = atof(value);
+        } else if (strcmp(arg, "--max-p95") == 0 && value) {
+            options.max_p95_ms = atof(value);
+        } else if (strcmp(arg, "--max-p99") == 0 && value) {
+            options.max_p99_ms = atof(value);
+        } else if (strcmp(arg, "--max-dropped-ms") == 0 && value) {
+            options.max_dropped_ms = atof(value);
+        } else if (strcmp(arg, "--max-dropped-segments") == 0 && value) {
+            options.max_dropped_segments = atol(value);
+        } else if (strcmp(arg, "--verbose") == 0) {
+            options.verbose = true;
+            takes_value = false;
+        } else if (arg[0] == '-') {
+            bench_usage();
+            return 2;
+        } else {
+            first_input = i;
+            break;
+        }
+        i += takes_value;
+    }
+    
+    if (first_input >= argc) {
+        bench_usage();
+        return 2;
+    }
+    
+    // The placeholder engine only maps the file, so any file will do
+    if (!options.model_path) {
+        options.model_path = argv[0];
+    }
+    
+    obs_shim_set_log_level(options.verbose ? LOG_INFO : LOG_WARNING);
+    audio_kernels_init();
+    inference_scheduler_init((uint32_t)options.workers);
+    llm_corrector_global_init();
+    
+    printf("transcription-bench: %s speed, streaming %s, interval %d ms, %u inference workers, "
+           "%d cores%s\n", options.max_speed ? "max" : "real-time",
+           options.streaming ? "on" : "off", options.interval_ms,
+           inference_scheduler_get_workers(), os_get_logical_cores(),
+           options.llm_endpoint ? ", LLM correction on" : "");
+    
+    struct bench_totals totals = {0};
+    bool ok = true;
+    for (int run = 0; run < options.runs; run++) {
+        for (int i = first_input; i < argc; i++) {
+            struct bench_audio audio = {0};
+            if (!bench_load_input(argv[i], &audio)) {
+                ok = false;
+                continue;
+            }
+            ok = bench_run_input(&options, argv[i], &audio, &totals) && ok;
+            bench_audio_free(&audio);
+        }
+    }
+    
+    inference_scheduler_shutdown();
+    llm_corrector_global_shutdown();
+    
+    if (totals.audio_s <= 0.0) {
+        bfree(totals.latencies_ms);
+        return 2;
+    }
+    
+    ok = bench_report(&options, &totals) && ok;
+    bfree(totals.latencies_ms);
+    return ok ? 0 : 1;
+}
@@ -1,59 +1,259 @@
 #include <obs-module.h>
 #include <media-io/audio-math.h>
 #include <util/threading.h>
-#include <util/circlebuf.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+#include <util/task.h>
 #include <pthread.h>
+#include "ai-transcription-filter.h"
 #include "whisper-engine.h"
 #include "llm-corrector.h"
 #include "audio-buffer.h"
+#include "audio-ring.h"
+#include "sample-clock.h"
+#include "vad.h"
+#include "transcript-stitcher.h"
+#include "inference-scheduler.h"
+#include "correction-stage.h"
+#include "local-corrector.h"
+#include "pipeline-stats.h"
+#include "transcript-writer.h"
+#include "caption-output.h"
+#include "model-tuner.h"
+#include "load-shedder.h"
 
-#define TRANSCRIPTION_BUFFER_SIZE (48000 * 4) // 4 seconds at 48kHz
-#define MIN_TRANSCRIPTION_LENGTH (48000 * 1)  // 1 second minimum
+#define TRANSCRIPTION_SAMPLE_RATE 16000 // Whisper's native input rate
+#define TRANSCRIPTION_BUFFER_SIZE (TRANSCRIPTION_SAMPLE_RATE * 4) // 4 seconds at 16kHz
+#define MIN_TRANSCRIPTION_LENGTH (TRANSCRIPTION_SAMPLE_RATE * 1)  // 1 second minimum
+#define MAX_SEGMENT_LENGTH (TRANSCRIPTION_SAMPLE_RATE * 30)       // Whisper's context limit
+#define AUDIO_RING_SIZE (TRANSCRIPTION_SAMPLE_RATE * 8)           // covers the longest interval
+#define AUDIO_SCRATCH_FRAMES AUDIO_OUTPUT_FRAMES
+#define INGEST_CHUNK_SAMPLES 1600 // 100 ms per ring read
+#define MAX_QUEUED_SEGMENTS 8
+#define REALTIME_DEADLINE_NS 3000000000ULL // captions older than this are useless live
+#define BATCH_DEADLINE_NS 15000000000ULL
+#define MAX_QUEUED_CORRECTIONS 4
+#define MAX_CORRECTION_SPANS 8
+#define CORRECTION_CONTEXT_WORDS 3
+#define WORKER_WAKE_SAMPLES INGEST_CHUNK_SAMPLES // audio that justifies a VAD pass
+#define QUEUE_WAIT_REPORT_NS 60000000000ULL      // 60 s between latency log lines
+#define MAX_STATS_COUNTERS 48
+#define MAX_STREAM_OVERLAP (TRANSCRIPTION_SAMPLE_RATE * 3)
+#define STREAM_WINDOW_SIZE (MAX_STREAM_OVERLAP + MAX_SEGMENT_LENGTH)
+#define TRANSCRIPT_FLUSH_MAX_MS 60000
+#define MAX_AUTO_DECODER_THREADS 8
+#define SHED_STREAM_OVERLAP (TRANSCRIPTION_SAMPLE_RATE / 4) // overlap kept while shedding load
+#define SHED_VAD_HANGOVER_FRAMES 15                         // 150 ms
+
+// Settings the inference jobs read while they run. update writes them under
+// settings_mutex and bumps their version; a job copies them before it starts
+// when the version has changed, so a decode never sees a string being
+// replaced.
+struct transcription_job_settings {
+    char *language_hint;
+    char *context_prompt;
+    bool use_llm_correction;
+    int llm_deadline_ms;
+    int correction_gate;
+    float correction_threshold;
+};
 
 struct ai_transcription_data {
     obs_source_t *context;
     
-    // Audio processing
-    struct circlebuf audio_buffer;
+    // Audio processing. The audio thread downmixes into mono_scratch,
+    // resamples to 16kHz into resample_scratch and pushes into audio_ring;
+    // only the worker thread reads the ring and runs the segmenter. `clock`
+    // follows the ring the same way with the capture time of the samples.
+    struct audio_ring audio_ring;
+    struct sample_clock clock;
     struct audio_buffer_info buffer_info;
-    pthread_mutex_t buffer_mutex;
+    struct audio_resampler *resampler;
+    float *mono_scratch;
+    float *resample_scratch;
+    size_t resample_scratch_size;
+    float *ingest_scratch;
+    
+    // Voice activity detection. Settings land in pending_vad_config and are
+    // picked up by the worker, which owns the segmenter.
+    struct vad_segmenter *segmenter;
+    struct vad_config pending_vad_config;
+    size_t pending_max_segment;
+    size_t pending_partial_samples;
+    int pending_interval_ms;
+    size_t pending_stream_overlap;
+    bool pending_streaming;
+    bool shed_speech_only; // load shedding forces the VAD on
+    bool vad_config_dirty;
+    pthread_mutex_t settings_mutex;
     
-    // Transcription settings
-    bool enabled;
+    // Streaming decode, owned by the running inference job. Each window is the tail of the
+    // previous one (stream_context samples, already decoded) followed by the
+    // new audio, so every sample is decoded about (step + overlap) / step
+    // times instead of once per pass over a whole buffer.
+    bool streaming;
+    size_t stream_overlap;
+    float *stream_window;
+    size_t stream_window_len;
+    size_t stream_context;
+    size_t stream_utterance_len;
+    uint64_t stream_start_ns; // when the current utterance began
+    float stream_confidence;
+    void *stitcher;
+    
+    // Speech segments run as jobs on the shared inference scheduler, one at
+    // a time per filter. A dropped job sets stream_resync so a streamed
+    // utterance missing a piece starts over instead of being stitched.
+    struct inference_client *inference;
+    volatile bool stream_resync;
+    
+    // Pipeline progress for ai_transcription_get_stats. samples_ingested
+    // follows the ring's read position but only moves once the samples have
+    // been through the VAD, so queued segments are counted by then.
+    volatile long samples_ingested;
+    volatile long segments_queued;
+    volatile long segments_done; // run or dropped
+    
+    // Transcription settings. `enabled` is read by the audio and worker
+    // threads and only accessed through os_atomic.
+    volatile bool enabled;
     bool real_time_mode;
     float silence_threshold;
     int transcription_interval_ms;
+    bool vad_enabled;
+    int vad_hangover_ms;
+    bool streaming_mode;
+    int stream_overlap_ms;
+    int inference_priority;
+    int inference_workers;
     
-    // AI settings  
+    // AI settings. The model path, LLM credentials, vocabulary and whether
+    // LLM correction is on are guarded by engine_mutex because the engine
+    // loader reads them. The inference jobs get theirs from job_settings.
+    bool use_local_correction;
+    char *vocabulary_path;
     bool use_llm_correction;
     char *whisper_model_path;
     char *llm_api_endpoint;
     char *llm_api_key;
-    char *language_hint;
-    char *context_prompt;
     
-    // Output settings
-    bool output_to_text_source;
-    char *text_source_name;
-    bool save_to_file;
-    char *output_file_path;
-    bool show_confidence;
+    // pending_job_settings and its version are guarded by settings_mutex;
+    // job_settings is the running job's copy
+    struct transcription_job_settings pending_job_settings;
+    long job_settings_version;
+    struct transcription_job_settings job_settings;
+    long job_settings_seen;
     
-    // Processing thread
+    // Output. Captions reach the text source through caption_output and
+    // transcript files are written by transcript_writer, each on its own
+    // thread and configured from update.
+    struct caption_output *caption_output;
+    struct transcript_writer *transcript_writer;
+    
+    // Processing thread. The worker blocks on worker_wake while it has
+    // nothing to do; anyone with work for it calls transcription_wake, which
+    // only posts when the worker has announced it is about to wait.
     pthread_t transcription_thread;
     bool thread_running;
-    bool stop_thread;
+    volatile bool stop_thread;
+    volatile bool worker_waiting;
+    os_sem_t *worker_wake;
+    
+    // Latency histograms per pipeline stage, recorded lock-free from every
+    // thread. The stats file is written by the ingest thread; its path and
+    // interval are guarded by settings_mutex.
+    struct pipeline_stats stats;
+    uint64_t queue_wait_reported_ns;
+    char *stats_file_path;
+    int stats_interval_s;
+    uint64_t stats_written_ns;
     
-    // Transcription engines
+    // Transcription engines. whisper_context and local_corrector belong to
+    // the inference jobs. Engines are built on engine_loader, never on the
+    // UI thread. They are handed over through pending_whisper and
+    // pending_local under engine_mutex; each job swaps them in before it
+    // starts and destroys the ones it retires, so an engine is never freed
+    // while it is in use. The LLM corrector goes straight to the correction
+    // stage, which swaps it the same way.
     void *whisper_context;
-    void *llm_context;
+    void *local_corrector;
+    os_task_queue_t *engine_loader;
+    pthread_mutex_t engine_mutex;
+    void *pending_whisper;
+    bool pending_whisper_set;
+    void *pending_local; // NULL turns the vocabulary pass off
+    bool pending_local_set;
+    char *loaded_llm_endpoint; // loader only: what the newest LLM engine was built with
+    char *loaded_llm_key;
+    volatile long whisper_load_ms;
+    volatile long llm_load_ms;
+    
+    // Smaller model for load shedding, handed over like the main one.
+    // fallback_context belongs to the inference jobs; the path is guarded by
+    // engine_mutex, and empty picks the most quantized variant of the model.
+    void *fallback_context;
+    void *pending_fallback;
+    bool pending_fallback_set;
+    char *fallback_model_path;
+    
+    // Auto-tuning, read by the loader under engine_mutex. When it is on the
+    // configured model only names the model; the tuner picks the variant,
+    // thread count and streaming window.
+    bool auto_tune;
+    int latency_budget_ms;
+    bool recalibrate;
+    volatile bool cancel_loading; // set by destroy to cut a calibration short
+    
+    // Decoder settings for the next job and the tuner's choices, guarded by
+    // settings_mutex. An automatic thread count is resolved by the job; a
+    // tuned window replaces the transcription interval.
+    struct whisper_engine_params decoder_params;
+    int tuned_threads;
+    int tuned_window_ms;
+    
+    // Load shedding. The inference jobs feed the controller after each
+    // segment and apply the level it returns; backlog_samples is the audio
+    // queued for them and not started yet. `load_shedding` is only accessed
+    // through os_atomic.
+    volatile bool load_shedding;
+    struct load_shedder shedder;
+    enum load_level load_level;
+    volatile long backlog_samples;
+    volatile long corrections_shed; // skipped the LLM to save time
     
-    // Statistics
-    uint64_t total_transcribed_frames;
-    uint64_t last_transcription_time;
-    float last_confidence;
+    // LLM correction runs behind the captions: the raw text is shown at
+    // once and replaced if the correction arrives while it is still the
+    // newest caption. caption_mutex orders caption updates from the
+    // inference job and the correction stage.
+    struct correction_stage *correction;
+    pthread_mutex_t caption_mutex;
+    uint64_t caption_id;
+    volatile long correction_skipped; // confident enough to skip the LLM
+    volatile long local_replacements; // terms rewritten from the vocabulary
+    ai_transcription_caption_cb caption_callback;
+    void *caption_param;
 };
 
+// Where a finished piece of transcript was spoken: capture times from the
+// sample clock (0 if unknown) and the end position in the 16kHz stream
+struct transcription_span {
+    uint64_t end_sample;
+    uint64_t start_ns;
+    uint64_t end_ns;
+};
+
+static void ai_transcription_update(void *data, obs_data_t *settings);
+static void transcription_write_stats(struct ai_transcription_data *filter, bool force,
+                                      const struct inference_client_stats *inference,
+                                      const struct correction_stats *correction);
+
+static void transcription_job_settings_free(struct transcription_job_settings *settings)
+{
+    bfree(settings->language_hint);
+    bfree(settings->context_prompt);
+    memset(settings, 0, sizeof(*settings));
+}
+
 static const char *ai_transcription_get_name(void *unused)
 {
     UNUSED_PARAMETER(unused);
@@ -65,144 +265,1110 @@ static void ai_transcription_destroy(void *data)
     struct ai_transcription_data *filter = data;
     
     if (filter->thread_running) {
-        filter->stop_thread = true;
+        os_atomic_set_bool(&filter->stop_thread, true);
+        os_sem_post(filter->worker_wake);
         pthread_join(filter->transcription_thread, NULL);
     }
     
-    pthread_mutex_destroy(&filter->buffer_mutex);
-    circlebuf_free(&filter->audio_buffer);
+    // Drops queued segments and waits for a running one
+    struct inference_client_stats inference_stats = {0};
+    inference_client_get_stats(filter->inference, &inference_stats);
+    inference_client_destroy(filter->inference);
+    filter->inference = NULL;
+    
+    // Waits for a load in progress, which stops calibrating first
+    os_atomic_set_bool(&filter->cancel_loading, true);
+    os_task_queue_destroy(filter->engine_loader);
+    
+    // Waits for the request in flight; queued ones are written out raw
+    struct correction_stats correction_stats = {0};
+    correction_stage_get_stats(filter->correction, &correction_stats);
+    correction_stage_destroy(filter->correction);
+    filter->correction = NULL;
+    
+    // Everything has stopped, so this is the final state; the inference and
+    // correction counters come from the snapshots taken before they went
+    // away. The transcript writer goes last: the correction stage writes out
+    // what it had queued.
+    transcription_write_stats(filter, true, &inference_stats, &correction_stats);
+    struct transcript_writer_stats writer_stats;
+    transcript_writer_get_stats(filter->transcript_writer, &writer_stats);
+    transcript_writer_destroy(filter->transcript_writer);
+    caption_output_destroy(filter->caption_output);
+    pthread_mutex_destroy(&filter->caption_mutex);
+    
+    blog(LOG_INFO, "AI Transcription: ring overruns: %ld samples in %ld events, "
+         "high-water mark: %ld of %zu samples",
+         os_atomic_load_long(&filter->audio_ring.overrun_samples),
+         os_atomic_load_long(&filter->audio_ring.overrun_events),
+         os_atomic_load_long(&filter->audio_ring.high_water_mark),
+         filter->audio_ring.capacity);
+    
+    struct load_shedder_stats shed_stats;
+    load_shedder_get_stats(&filter->shedder, &shed_stats);
+    if (shed_stats.escalations > 0) {
+        blog(LOG_INFO, "AI Transcription: load shedding stepped down %llu times and back up "
+             "%llu times, worst level %s, %.1f s degraded, %ld corrections skipped",
+             (unsigned long long)shed_stats.escalations,
+             (unsigned long long)shed_stats.recoveries,
+             load_level_name((enum load_level)shed_stats.max_level),
+             shed_stats.degraded_ms / 1000.0,
+             os_atomic_load_long(&filter->corrections_shed));
+    }
+    
+    struct vad_stats vad_stats;
+    vad_segmenter_get_stats(filter->segmenter, &vad_stats);
+    blog(LOG_INFO, "AI Transcription: VAD kept %llu of %llu frames as speech, "
+         "%llu segments queued, %llu discarded",
+         (unsigned long long)vad_stats.speech_frames,
+         (unsigned long long)vad_stats.frames,
+         (unsigned long long)vad_stats.segments,
+         (unsigned long long)vad_stats.discarded_segments);
+    blog(LOG_INFO, "AI Transcription: %llu inference jobs run, %llu dropped as stale, "
+         "%llu dropped on overflow, max queue depth %zu",
+         (unsigned long long)inference_stats.completed,
+         (unsigned long long)inference_stats.dropped_stale,
+         (unsigned long long)inference_stats.dropped_overflow,
+         inference_stats.max_queued);
+    blog(LOG_INFO, "AI Transcription: %ld transcripts skipped correction as confident, "
+         "%llu corrections requested in %llu spans, %llu changed, %llu unchanged, "
+         "%llu past deadline, %llu overflowed",
+         os_atomic_load_long(&filter->correction_skipped),
+         (unsigned long long)correction_stats.submitted,
+         (unsigned long long)correction_stats.spans,
+         (unsigned long long)correction_stats.corrected,
+         (unsigned long long)correction_stats.unchanged,
+         (unsigned long long)correction_stats.expired,
+         (unsigned long long)correction_stats.overflowed);
+    blog(LOG_INFO, "AI Transcription: vocabulary pass rewrote %ld terms",
+         os_atomic_load_long(&filter->local_replacements));
+    if (writer_stats.entries > 0) {
+        blog(LOG_INFO, "AI Transcription: %llu transcripts written in %llu flushes "
+             "(%llu bytes), %llu write errors",
+             (unsigned long long)writer_stats.entries,
+             (unsigned long long)writer_stats.flushes,
+             (unsigned long long)writer_stats.bytes,
+             (unsigned long long)writer_stats.write_errors);
+    }
+    if (correction_stats.answered > 0) {
+        blog(LOG_INFO, "AI Transcription: %llu LLM requests, latency avg %.1f ms, "
+             "max %.1f ms; %llu streamed, first token avg %.1f ms, max %.1f ms",
+             (unsigned long long)correction_stats.answered,
+             correction_stats.latency_total_us / 1000.0 / correction_stats.answered,
+             correction_stats.latency_max_us / 1000.0,
+             (unsigned long long)correction_stats.streamed,
+             correction_stats.streamed > 0 ?
+                 correction_stats.first_token_total_us / 1000.0 / correction_stats.streamed : 0.0,
+             correction_stats.first_token_max_us / 1000.0);
+    }
+    for (int stage = 0; stage < PIPELINE_STAGE_COUNT; stage++) {
+        struct latency_summary summary;
+        char text[160];
+        latency_histogram_summarize(&filter->stats.stages[stage], &summary);
+        if (summary.count > 0) {
+            pipeline_stats_format_summary(&summary, text, sizeof(text));
+            blog(LOG_INFO, "AI Transcription: %s %s",
+                 pipeline_stage_name((enum pipeline_stage)stage), text);
+        }
+    }
+    blog(LOG_INFO, "AI Transcription: last engine load took %ld ms (Whisper), %ld ms (LLM)",
+         os_atomic_load_long(&filter->whisper_load_ms),
+         os_atomic_load_long(&filter->llm_load_ms));
+    
+    vad_segmenter_destroy(filter->segmenter);
+    transcript_stitcher_destroy(filter->stitcher);
+    bfree(filter->stream_window);
+    pthread_mutex_destroy(&filter->settings_mutex);
+    os_sem_destroy(filter->worker_wake);
+    audio_ring_free(&filter->audio_ring);
+    audio_resampler_destroy(filter->resampler);
+    bfree(filter->mono_scratch);
+    bfree(filter->resample_scratch);
+    bfree(filter->ingest_scratch);
     
     // Cleanup AI contexts
     if (filter->whisper_context) {
         whisper_engine_destroy(filter->whisper_context);
     }
-    if (filter->llm_context) {
-        llm_corrector_destroy(filter->llm_context);
+    if (filter->pending_whisper) {
+        whisper_engine_destroy(filter->pending_whisper);
+    }
+    if (filter->fallback_context) {
+        whisper_engine_destroy(filter->fallback_context);
+    }
+    if (filter->pending_fallback) {
+        whisper_engine_destroy(filter->pending_fallback);
     }
+    local_corrector_destroy(filter->local_corrector);
+    local_corrector_destroy(filter->pending_local);
+    pthread_mutex_destroy(&filter->engine_mutex);
     
     // Free strings
     bfree(filter->whisper_model_path);
+    bfree(filter->fallback_model_path);
+    bfree(filter->vocabulary_path);
     bfree(filter->llm_api_endpoint);
     bfree(filter->llm_api_key);
-    bfree(filter->language_hint);
-    bfree(filter->context_prompt);
-    bfree(filter->text_source_name);
-    bfree(filter->output_file_path);
+    bfree(filter->loaded_llm_endpoint);
+    bfree(filter->loaded_llm_key);
+    transcription_job_settings_free(&filter->pending_job_settings);
+    transcription_job_settings_free(&filter->job_settings);
+    bfree(filter->stats_file_path);
     
     bfree(filter);
 }
 
-static void *transcription_thread_worker(void *data)
+// Queued audio changes from the ingest thread and from any inference
+// thread that runs or drops a job, so this needs a real atomic add
+static void transcription_add_backlog(struct ai_transcription_data *filter, long samples)
 {
-    struct ai_transcription_data *filter = data;
+    long backlog;
+    do {
+        backlog = os_atomic_load_long(&filter->backlog_samples);
+    } while (!os_atomic_compare_swap_long(&filter->backlog_samples, backlog, backlog + samples));
+}
+
+static void transcription_drop_segment(void *param, void *job, enum inference_drop_reason reason)
+{
+    struct ai_transcription_data *filter = param;
+    struct vad_segment *segment = job;
     
-    blog(LOG_INFO, "AI Transcription thread started");
+    if (reason != INFERENCE_DROP_CANCELED) {
+        os_atomic_set_bool(&filter->stream_resync, true);
+    }
+    transcription_add_backlog(filter, -(long)segment->count);
+    bfree(segment->samples);
+    bfree(segment);
+    os_atomic_inc_long(&filter->segments_done);
+}
+
+// Segment callback from the VAD: hands a finished utterance (or a streamed
+// piece of one) to the inference scheduler. Live captions get a short
+// deadline; a job that waited longer than that is dropped, not run.
+static void transcription_enqueue_segment(void *param, struct vad_segment *segment)
+{
+    struct ai_transcription_data *filter = param;
     
-    while (!filter->stop_thread) {
-        if (!filter->enabled) {
-            os_sleep_ms(100);
-            continue;
+    struct vad_segment *job = bmalloc(sizeof(struct vad_segment));
+    *job = *segment;
+    
+    // The audio thread publishes an anchor just after its samples, so pick
+    // up one that may have arrived since this chunk was read
+    sample_clock_consume(&filter->clock);
+    job->start_ns = sample_clock_timestamp(&filter->clock, segment->start_sample);
+    job->end_ns = sample_clock_timestamp(&filter->clock, segment->start_sample + segment->count);
+    os_atomic_inc_long(&filter->segments_queued);
+    transcription_add_backlog(filter, (long)segment->count);
+    
+    uint64_t deadline = os_gettime_ns() + (filter->real_time_mode ? REALTIME_DEADLINE_NS
+                                                                  : BATCH_DEADLINE_NS);
+    if (!inference_client_submit(filter->inference, job, deadline)) {
+        transcription_drop_segment(filter, job, INFERENCE_DROP_CANCELED);
+    }
+}
+
+static void transcription_record_queue_wait(struct ai_transcription_data *filter,
+                                            uint64_t enqueue_ns)
+{
+    uint64_t now = os_gettime_ns();
+    pipeline_stats_record(&filter->stats, PIPELINE_STAGE_QUEUE_WAIT, now - enqueue_ns);
+    
+    if (now - filter->queue_wait_reported_ns >= QUEUE_WAIT_REPORT_NS) {
+        filter->queue_wait_reported_ns = now;
+        struct latency_summary summary;
+        char text[160];
+        latency_histogram_summarize(&filter->stats.stages[PIPELINE_STAGE_QUEUE_WAIT], &summary);
+        pipeline_stats_format_summary(&summary, text, sizeof(text));
+        blog(LOG_INFO, "AI Transcription: queue wait %s", text);
+    }
+}
+
+// Wakes the worker if it is waiting. Safe from the audio thread: it is one
+// atomic exchange plus, at most once per wait, a semaphore post.
+static void transcription_wake(struct ai_transcription_data *filter)
+{
+    if (os_atomic_set_bool(&filter->worker_waiting, false)) {
+        os_sem_post(filter->worker_wake);
+    }
+}
+
+// Blocks until there is work. The flag is raised before the final check so
+// that a producer publishing in between is guaranteed to see it and post.
+static void transcription_wait(struct ai_transcription_data *filter)
+{
+    os_atomic_set_bool(&filter->worker_waiting, true);
+    
+    bool ready = os_atomic_load_bool(&filter->stop_thread) ||
+                 (os_atomic_load_bool(&filter->enabled) &&
+                  audio_ring_available(&filter->audio_ring) >= WORKER_WAKE_SAMPLES);
+    
+    // If a producer already took the flag its post is pending and must be
+    // consumed, otherwise the next wait would return immediately
+    if (!ready || !os_atomic_set_bool(&filter->worker_waiting, false)) {
+        os_sem_wait(filter->worker_wake);
+    }
+}
+
+// Drains everything the audio thread has published through the VAD
+// segmenter, queueing any utterances it completes
+static void transcription_ingest(struct ai_transcription_data *filter)
+{
+    pthread_mutex_lock(&filter->settings_mutex);
+    if (filter->vad_config_dirty) {
+        // Shedding load, silence and music must not reach the recognizer,
+        // and pauses end an utterance sooner
+        struct vad_config vad_config = filter->pending_vad_config;
+        if (filter->shed_speech_only) {
+            vad_config.enabled = true;
+            if (vad_config.hangover_frames > SHED_VAD_HANGOVER_FRAMES) {
+                vad_config.hangover_frames = SHED_VAD_HANGOVER_FRAMES;
+            }
         }
-        
-        pthread_mutex_lock(&filter->buffer_mutex);
-        
-        // Check if we have enough audio data to transcribe
-        size_t buffer_size = filter->audio_buffer.size;
-        if (buffer_size < MIN_TRANSCRIPTION_LENGTH * sizeof(float)) {
-            pthread_mutex_unlock(&filter->buffer_mutex);
-            os_sleep_ms(filter->transcription_interval_ms);
-            continue;
+        vad_segmenter_set_config(filter->segmenter, &vad_config);
+        vad_segmenter_set_max_samples(filter->segmenter, filter->pending_max_segment);
+        vad_segmenter_set_partial_samples(filter->segmenter, filter->pending_partial_samples);
+        filter->streaming = filter->pending_streaming;
+        filter->stream_overlap = filter->pending_stream_overlap;
+        filter->vad_config_dirty = false;
+    }
+    pthread_mutex_unlock(&filter->settings_mutex);
+    
+    size_t count;
+    while ((count = audio_ring_read(&filter->audio_ring, filter->ingest_scratch,
+                                    INGEST_CHUNK_SAMPLES)) > 0) {
+        uint64_t start = os_gettime_ns();
+        sample_clock_consume(&filter->clock);
+        vad_segmenter_push(filter->segmenter, filter->ingest_scratch, count,
+                           transcription_enqueue_segment, filter);
+        pipeline_stats_record(&filter->stats, PIPELINE_STAGE_VAD, os_gettime_ns() - start);
+        os_atomic_set_long(&filter->samples_ingested,
+                           os_atomic_load_long(&filter->samples_ingested) + (long)count);
+    }
+}
+
+// The engine for the next decode: the fallback model while load shedding
+// calls for it, if one is loaded
+static void *transcription_engine(struct ai_transcription_data *filter)
+{
+    if (filter->load_level >= LOAD_LEVEL_SMALL_MODEL && filter->fallback_context) {
+        return filter->fallback_context;
+    }
+    return filter->whisper_context;
+}
+
+// Runs Whisper on `count` samples, padding to the one second minimum.
+// The transcript is always initialized and must be freed.
+static bool transcription_decode(struct ai_transcription_data *filter, const float *samples,
+                                 size_t count, struct whisper_transcript *transcript)
+{
+    memset(transcript, 0, sizeof(*transcript));
+    void *engine = transcription_engine(filter);
+    if (!engine) {
+        return false;
+    }
+    
+    // Whisper needs at least a second of input; pad short audio with silence
+    float *padded = NULL;
+    if (count < MIN_TRANSCRIPTION_LENGTH) {
+        padded = bzalloc(MIN_TRANSCRIPTION_LENGTH * sizeof(float));
+        if (count > 0) {
+            memcpy(padded, samples, count * sizeof(float));
         }
-        
-        // Extract audio data for transcription
-        float *audio_data = bmalloc(buffer_size);
-        circlebuf_peek_front(&filter->audio_buffer, audio_data, buffer_size);
-        size_t sample_count = buffer_size / sizeof(float);
-        
-        pthread_mutex_unlock(&filter->buffer_mutex);
-        
-        // Perform transcription with Whisper
-        char *transcription = NULL;
-        float confidence = 0.0f;
-        
-        if (filter->whisper_context) {
-            transcription = whisper_engine_transcribe(
-                filter->whisper_context,
-                audio_data,
-                sample_count,
-                filter->language_hint,
-                &confidence
-            );
+        samples = padded;
+        count = MIN_TRANSCRIPTION_LENGTH;
+    }
+    
+    uint64_t start = os_gettime_ns();
+    bool decoded = whisper_engine_transcribe_detailed(
+        engine,
+        samples,
+        count,
+        filter->job_settings.language_hint,
+        transcript
+    );
+    pipeline_stats_record(&filter->stats, PIPELINE_STAGE_INFERENCE, os_gettime_ns() - start);
+    
+    bfree(padded);
+    return decoded;
+}
+
+// Shows a new caption and returns its id. `capture_ns` is when the audio it
+// ends with was captured, which a caption delay counts from.
+static uint64_t transcription_show_caption(struct ai_transcription_data *filter, const char *text,
+                                           float confidence, uint64_t capture_ns)
+{
+    pthread_mutex_lock(&filter->caption_mutex);
+    uint64_t id = ++filter->caption_id;
+    caption_output_set(filter->caption_output, text, confidence, capture_ns);
+    pthread_mutex_unlock(&filter->caption_mutex);
+    return id;
+}
+
+// Rewrites caption `id` unless something newer has been shown since
+static void transcription_replace_caption(struct ai_transcription_data *filter, uint64_t id,
+                                          const char *text, float confidence,
+                                          uint64_t capture_ns)
+{
+    pthread_mutex_lock(&filter->caption_mutex);
+    if (filter->caption_id == id) {
+        caption_output_set(filter->caption_output, text, confidence, capture_ns);
+    }
+    pthread_mutex_unlock(&filter->caption_mutex);
+}
+
+// Commits a finished piece of transcript to the file and the log. Cue times
+// count from the capture time of the first audio the filter stored, so gaps
+// in the audio stay gaps in the transcript; the writer only queues, so this
+// never waits on the disk.
+static void transcription_write(struct ai_transcription_data *filter, const char *transcription,
+                                float confidence, uint64_t start_ns, uint64_t end_ns)
+{
+    uint64_t origin = filter->clock.origin_ns;
+    transcript_writer_append(filter->transcript_writer, transcription, confidence,
+                             start_ns > origin ? start_ns - origin : 0,
+                             end_ns > origin ? end_ns - origin : 0);
+    blog(LOG_INFO, "Transcription (%.1f%%): %s", confidence * 100.0f, transcription);
+}
+
+// Final output for a finished piece of transcript. The vocabulary pass
+// fixes known names first and marks them certain, so the raw text that goes
+// on screen right away already has them. With LLM correction on, the
+// confidence gate then picks what the LLM gets to see, and the file and log
+// wait for the correction stage so they get the final wording.
+static void transcription_output(struct ai_transcription_data *filter, const char *transcription,
+                                 float confidence, const float *word_confidence,
+                                 size_t word_count, const struct transcription_span *span)
+{
+    if (!transcription || strlen(transcription) == 0) {
+        return;
+    }
+    
+    struct local_correction local;
+    if (filter->local_corrector &&
+        local_corrector_correct(filter->local_corrector, transcription, word_confidence,
+                                word_count, &local)) {
+        transcription = local.text;
+        word_confidence = local.word_confidence;
+        word_count = local.word_count;
+        os_atomic_set_long(&filter->local_replacements,
+                           os_atomic_load_long(&filter->local_replacements) + (long)local.replaced);
+    } else {
+        memset(&local, 0, sizeof(local));
+    }
+    
+    // The next utterance is decoded with this one as its prompt, whichever
+    // model decodes it
+    whisper_engine_set_prompt(filter->whisper_context, transcription);
+    if (filter->fallback_context) {
+        whisper_engine_set_prompt(filter->fallback_context, transcription);
+    }
+    
+    uint64_t caption_id = transcription_show_caption(filter, transcription, confidence,
+                                                     span->end_ns);
+    if (filter->caption_callback) {
+        filter->caption_callback(filter->caption_param, transcription, span->end_sample);
+    }
+    
+    size_t span_count = 0;
+    struct correction_span spans[MAX_CORRECTION_SPANS];
+    bool shed_llm = filter->load_level >= LOAD_LEVEL_NO_LLM;
+    const struct transcription_job_settings *settings = &filter->job_settings;
+    if (settings->use_llm_correction && shed_llm) {
+        os_atomic_inc_long(&filter->corrections_shed);
+    } else if (settings->use_llm_correction &&
+               correction_stage_has_corrector(filter->correction)) {
+        span_count = correction_gate_select(
+            (enum correction_gate)settings->correction_gate, transcription, confidence,
+            word_confidence, word_count, settings->correction_threshold,
+            CORRECTION_CONTEXT_WORDS, spans, MAX_CORRECTION_SPANS);
+        if (span_count == 0) {
+            os_atomic_inc_long(&filter->correction_skipped);
         }
-        
-        // Apply LLM correction if enabled and transcription exists
-        if (transcription && filter->use_llm_correction && filter->llm_context) {
-            char *corrected_text = llm_corrector_improve(
-                filter->llm_context,
-                transcription,
-                filter->context_prompt,
-                confidence
-            );
-            
-            if (corrected_text) {
-                bfree(transcription);
-                transcription = corrected_text;
-            }
+    }
+    
+    if (span_count > 0) {
+        uint64_t deadline = os_gettime_ns() + (uint64_t)settings->llm_deadline_ms * 1000000ULL;
+        correction_stage_submit(filter->correction, transcription, settings->context_prompt,
+                                confidence, spans, span_count, caption_id, span->start_ns,
+                                span->end_ns, deadline);
+    } else {
+        transcription_write(filter, transcription, confidence, span->start_ns, span->end_ns);
+    }
+    
+    local_correction_free(&local);
+}
+
+// Correction stage callback: swap in the corrected text if it is still on
+// screen, then commit whichever text won
+static void transcription_correction_done(void *param, const struct correction_request *request,
+                                          const char *corrected)
+{
+    struct ai_transcription_data *filter = param;
+    
+    pipeline_stats_record(&filter->stats, PIPELINE_STAGE_LLM, os_gettime_ns() - request->submit_ns);
+    if (corrected) {
+        transcription_replace_caption(filter, request->caption_id, corrected,
+                                      request->confidence, request->end_ns);
+    }
+    transcription_write(filter, corrected ? corrected : request->text, request->confidence,
+                        request->start_ns, request->end_ns);
+}
+
+// Correction stage callback for streamed answers: the caption follows the
+// words as they arrive; only the final text is committed
+static void transcription_correction_partial(void *param,
+                                             const struct correction_request *request,
+                                             const char *text)
+{
+    struct ai_transcription_data *filter = param;
+    transcription_replace_caption(filter, request->caption_id, text, request->confidence,
+                                  request->end_ns);
+}
+
+// Whole-utterance decode, used when streaming is off
+static void transcription_process_segment(struct ai_transcription_data *filter,
+                                          struct vad_segment *segment)
+{
+    struct whisper_transcript transcript;
+    transcription_decode(filter, segment->samples, segment->count, &transcript);
+    struct transcription_span span = {
+        .end_sample = segment->start_sample + segment->count,
+        .start_ns = segment->start_ns,
+        .end_ns = segment->end_ns,
+    };
+    transcription_output(filter, transcript.text, transcript.confidence,
+                         transcript.word_confidence, transcript.word_count, &span);
+    whisper_transcript_free(&transcript);
+}
+
+static void transcription_stream_reset(struct ai_transcription_data *filter)
+{
+    transcript_stitcher_reset(filter->stitcher);
+    filter->stream_window_len = 0;
+    filter->stream_context = 0;
+    filter->stream_utterance_len = 0;
+}
+
+// Streaming decode: the new audio is decoded together with a bounded overlap
+// of audio that was already decoded, and the stitcher aligns the two
+// hypotheses so only newly stable words come out. The caption follows the
+// utterance as it grows; the full utterance is corrected and logged once it
+// ends.
+static void transcription_process_stream(struct ai_transcription_data *filter,
+                                         struct vad_segment *segment)
+{
+    if (segment->first) {
+        transcription_stream_reset(filter);
+    }
+    
+    if (filter->stream_utterance_len == 0) {
+        filter->stream_start_ns = segment->start_ns;
+    }
+    
+    size_t count = segment->count;
+    if (filter->stream_window_len + count > STREAM_WINDOW_SIZE) {
+        count = STREAM_WINDOW_SIZE - filter->stream_window_len;
+    }
+    if (count > 0) {
+        memcpy(filter->stream_window + filter->stream_window_len, segment->samples,
+               count * sizeof(float));
+        filter->stream_window_len += count;
+        filter->stream_utterance_len += count;
+    }
+    
+    // Very long utterances (or VAD off) are committed in pieces so the
+    // stitcher and caption stay bounded
+    bool final = !segment->partial || filter->stream_utterance_len >= MAX_SEGMENT_LENGTH;
+    
+    char *pending = transcript_stitcher_pending(filter->stitcher);
+    bool has_new_audio = filter->stream_window_len > filter->stream_context;
+    if (has_new_audio || pending) {
+        struct whisper_transcript hypothesis;
+        char *stable = NULL;
+        if (transcription_decode(filter, filter->stream_window, filter->stream_window_len,
+                                 &hypothesis)) {
+            filter->stream_confidence = hypothesis.confidence;
+            float overlap_ratio = (float)filter->stream_context /
+                                  (float)filter->stream_window_len;
+            stable = transcript_stitcher_merge(filter->stitcher, hypothesis.text,
+                                               hypothesis.word_confidence,
+                                               hypothesis.word_count, overlap_ratio, final);
+        } else if (final) {
+            // An empty hypothesis would replace the held-back word; without a
+            // decode to confirm it, it is kept as it was
+            stable = transcript_stitcher_flush(filter->stitcher);
         }
-        
-        // Output transcription
-        if (transcription && strlen(transcription) > 0) {
-            filter->last_confidence = confidence;
-            filter->last_transcription_time = os_gettime_ns();
-            
-            // Update text source if specified
-            if (filter->output_to_text_source && filter->text_source_name) {
-                obs_source_t *text_source = obs_get_source_by_name(filter->text_source_name);
-                if (text_source) {
-                    obs_data_t *settings = obs_data_create();
-                    
-                    if (filter->show_confidence) {
-                        char *text_with_confidence = bmalloc(strlen(transcription) + 50);
-                        snprintf(text_with_confidence, strlen(transcription) + 50, 
-                                "%s (%.1f%%)", transcription, confidence * 100.0f);
-                        obs_data_set_string(settings, "text", text_with_confidence);
-                        bfree(text_with_confidence);
-                    } else {
-                        obs_data_set_string(settings, "text", transcription);
-                    }
-                    
-                    obs_source_update(text_source, settings);
-                    obs_data_release(settings);
-                    obs_source_release(text_source);
-                }
-            }
-            
-            // Save to file if enabled
-            if (filter->save_to_file && filter->output_file_path) {
-                FILE *file = fopen(filter->output_file_path, "a");
-                if (file) {
-                    fprintf(file, "[%llu] %s\n", 
-                           (unsigned long long)filter->last_transcription_time, 
-                           transcription);
-                    fclose(file);
-                }
-            }
-            
-            blog(LOG_INFO, "Transcription (%.1f%%): %s", confidence * 100.0f, transcription);
+        if (stable) {
+            blog(LOG_DEBUG, "Transcription (stable): %s", stable);
         }
+        bfree(stable);
+        whisper_transcript_free(&hypothesis);
+    }
+    bfree(pending);
+    
+    if (final) {
+        char *text = transcript_stitcher_text(filter->stitcher);
+        size_t word_count = 0;
+        float *word_confidence = transcript_stitcher_confidence(filter->stitcher, &word_count);
+        struct transcription_span span = {
+            .end_sample = segment->start_sample + segment->count,
+            .start_ns = filter->stream_start_ns,
+            .end_ns = segment->end_ns,
+        };
+        transcription_output(filter, text, filter->stream_confidence, word_confidence,
+                             word_count, &span);
+        bfree(word_confidence);
+        bfree(text);
+        transcription_stream_reset(filter);
+        return;
+    }
+    
+    // Live caption: committed words plus the tentative tail
+    char *text = transcript_stitcher_text(filter->stitcher);
+    pending = transcript_stitcher_pending(filter->stitcher);
+    if (text || pending) {
+        struct dstr caption = {0};
+        dstr_copy(&caption, text ? text : "");
+        if (text && pending) {
+            dstr_cat_ch(&caption, ' ');
+        }
+        dstr_cat(&caption, pending ? pending : "");
+        transcription_show_caption(filter, caption.array, filter->stream_confidence,
+                                   segment->end_ns);
+        dstr_free(&caption);
+    }
+    bfree(text);
+    bfree(pending);
+    
+    // Keep the newest audio as context for the next window, less of it when
+    // shedding load
+    size_t keep = filter->stream_overlap;
+    if (filter->load_level >= LOAD_LEVEL_SHORT_OVERLAP && keep > SHED_STREAM_OVERLAP) {
+        keep = SHED_STREAM_OVERLAP;
+    }
+    if (keep < filter->stream_window_len) {
+        memmove(filter->stream_window,
+                filter->stream_window + (filter->stream_window_len - keep),
+                keep * sizeof(float));
+        filter->stream_window_len = keep;
+    }
+    filter->stream_context = filter->stream_window_len;
+}
+
+static bool strings_equal(const char *a, const char *b)
+{
+    return a && b ? strcmp(a, b) == 0 : a == b;
+}
+
+// Decoder threads when none are configured: the physical cores split
+// between the inference workers, so jobs running side by side do not
+// oversubscribe the CPU
+static int transcription_auto_threads(void)
+{
+    uint32_t workers = inference_scheduler_get_workers();
+    int threads = os_get_physical_cores() / (int)(workers > 0 ? workers : 1);
+    if (threads > MAX_AUTO_DECODER_THREADS) {
+        threads = MAX_AUTO_DECODER_THREADS;
+    }
+    return threads > 0 ? threads : 1;
+}
+
+// Streaming step from the tuned window or the configured interval. Called
+// with settings_mutex held.
+static void transcription_update_partial_samples(struct ai_transcription_data *filter)
+{
+    int interval_ms = filter->tuned_window_ms > 0 ? filter->tuned_window_ms
+                                                  : filter->pending_interval_ms;
+    filter->pending_partial_samples = filter->pending_streaming
+        ? (size_t)interval_ms * TRANSCRIPTION_SAMPLE_RATE / 1000 : 0;
+}
+
+// Runs the model tuner when auto-tuning is on and applies the thread count
+// and window it picked. Returns the model variant to load, or NULL for the
+// configured model. Runs on engine_loader; the first calibration on a
+// machine can take minutes.
+static char *transcription_tune_model(struct ai_transcription_data *filter)
+{
+    pthread_mutex_lock(&filter->engine_mutex);
+    char *model_path = filter->auto_tune ? bstrdup(filter->whisper_model_path) : NULL;
+    struct model_tuner_request request = {
+        .latency_budget_ms = (uint32_t)filter->latency_budget_ms,
+        .recalibrate = filter->recalibrate,
+        .cancel = &filter->cancel_loading,
+    };
+    filter->recalibrate = false;
+    pthread_mutex_unlock(&filter->engine_mutex);
+    
+    struct model_tuning tuning = {0};
+    if (model_path && *model_path) {
+        pthread_mutex_lock(&filter->settings_mutex);
+        request.overlap_ms = (uint32_t)(filter->pending_stream_overlap * 1000 /
+                                        TRANSCRIPTION_SAMPLE_RATE);
+        request.beam_size = filter->decoder_params.beam_size;
+        pthread_mutex_unlock(&filter->settings_mutex);
         
-        bfree(audio_data);
-        bfree(transcription);
+        request.model_path = model_path;
+        request.max_threads = transcription_auto_threads();
+        model_tuner_select(&request, &tuning);
+    }
+    bfree(model_path);
+    
+    pthread_mutex_lock(&filter->settings_mutex);
+    filter->tuned_threads = tuning.n_threads;
+    filter->tuned_window_ms = (int)tuning.window_ms;
+    transcription_update_partial_samples(filter);
+    filter->vad_config_dirty = true;
+    pthread_mutex_unlock(&filter->settings_mutex);
+    
+    char *tuned_path = tuning.model_path;
+    tuning.model_path = NULL;
+    model_tuning_free(&tuning);
+    return tuned_path;
+}
+
+// The smaller model load shedding falls back to: the configured one, or the
+// most quantized variant of the model in use. NULL with load shedding off
+// or when there is nothing smaller.
+static char *transcription_fallback_model(struct ai_transcription_data *filter,
+                                          const char *tuned_path)
+{
+    if (!os_atomic_load_bool(&filter->load_shedding)) {
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&filter->engine_mutex);
+    bool configured = filter->fallback_model_path && *filter->fallback_model_path;
+    char *fallback = configured ? bstrdup(filter->fallback_model_path) : NULL;
+    char *model_path = configured ? NULL
+                                  : bstrdup(tuned_path ? tuned_path : filter->whisper_model_path);
+    pthread_mutex_unlock(&filter->engine_mutex);
+    
+    if (!configured) {
+        fallback = model_tuner_smallest_variant(model_path);
+        bfree(model_path);
+    }
+    return fallback;
+}
+
+// Engine loader task: builds whatever the current settings call for and
+// publishes it for the worker. Runs on engine_loader, so a slow model load
+// never blocks the UI or the audio path.
+static void transcription_load_engines(void *param)
+{
+    struct ai_transcription_data *filter = param;
+    char *tuned_path = transcription_tune_model(filter);
+    
+    // The filter is going away; nothing built now would be used
+    if (os_atomic_load_bool(&filter->cancel_loading)) {
+        bfree(tuned_path);
+        return;
+    }
+    char *fallback_path = transcription_fallback_model(filter, tuned_path);
+    
+    pthread_mutex_lock(&filter->engine_mutex);
+    char *model_path = tuned_path ? tuned_path : bstrdup(filter->whisper_model_path);
+    char *endpoint = bstrdup(filter->llm_api_endpoint);
+    char *api_key = bstrdup(filter->llm_api_key);
+    char *vocabulary = bstrdup(filter->vocabulary_path);
+    bool want_llm = filter->use_llm_correction && endpoint && *endpoint && api_key && *api_key;
+    bool want_local = filter->use_local_correction && vocabulary && *vocabulary;
+    
+    // Compare against the newest engine, published or already swapped in
+    void *newest_whisper = filter->pending_whisper_set ? filter->pending_whisper
+                                                       : filter->whisper_context;
+    bool need_whisper = model_path && *model_path &&
+                        (!newest_whisper || whisper_engine_model_changed(newest_whisper, model_path));
+    void *newest_fallback = filter->pending_fallback_set ? filter->pending_fallback
+                                                         : filter->fallback_context;
+    bool need_fallback = fallback_path ? !newest_fallback ||
+                                         whisper_engine_model_changed(newest_fallback, fallback_path)
+                                       : newest_fallback != NULL;
+    void *newest_local = filter->pending_local_set ? filter->pending_local
+                                                   : filter->local_corrector;
+    bool need_local = want_local ? !newest_local ||
+                                   local_corrector_vocabulary_changed(newest_local, vocabulary)
+                                 : newest_local != NULL;
+    pthread_mutex_unlock(&filter->engine_mutex);
+    
+    bool need_llm = want_llm && (!strings_equal(endpoint, filter->loaded_llm_endpoint) ||
+                                 !strings_equal(api_key, filter->loaded_llm_key));
+    
+    void *whisper = NULL;
+    if (need_whisper) {
+        uint64_t start = os_gettime_ns();
+        whisper = whisper_engine_create(model_path);
+        long elapsed_ms = (long)((os_gettime_ns() - start) / 1000000);
+        os_atomic_set_long(&filter->whisper_load_ms, elapsed_ms);
+        blog(LOG_INFO, "AI Transcription: Whisper engine %s in %ld ms",
+             whisper ? "ready" : "failed", elapsed_ms);
+    }
+    
+    void *fallback = NULL;
+    if (need_fallback && fallback_path) {
+        fallback = whisper_engine_create(fallback_path);
+        blog(LOG_INFO, "AI Transcription: fallback model %s %s", fallback_path,
+             fallback ? "ready" : "failed to load");
+    }
+    
+    void *local = NULL;
+    if (need_local && want_local) {
+        local = local_corrector_create(vocabulary);
+    }
+    
+    void *llm = NULL;
+    if (need_llm) {
+        uint64_t start = os_gettime_ns();
+        llm = llm_corrector_create(endpoint, api_key);
+        os_atomic_set_long(&filter->llm_load_ms, (long)((os_gettime_ns() - start) / 1000000));
         
-        // Clear processed audio from buffer in real-time mode
-        if (filter->real_time_mode) {
-            pthread_mutex_lock(&filter->buffer_mutex);
-            circlebuf_pop_front(&filter->audio_buffer, NULL, 
-                               MIN_TRANSCRIPTION_LENGTH * sizeof(float));
-            pthread_mutex_unlock(&filter->buffer_mutex);
+        bfree(filter->loaded_llm_endpoint);
+        bfree(filter->loaded_llm_key);
+        filter->loaded_llm_endpoint = bstrdup(endpoint);
+        filter->loaded_llm_key = bstrdup(api_key);
+    }
+    
+    // Replace anything the worker has not picked up yet. A vocabulary that
+    // fails to load keeps the previous one in service.
+    void *stale_whisper = NULL;
+    void *stale_fallback = NULL;
+    void *stale_local = NULL;
+    pthread_mutex_lock(&filter->engine_mutex);
+    if (need_whisper && whisper) {
+        stale_whisper = filter->pending_whisper;
+        filter->pending_whisper = whisper;
+        filter->pending_whisper_set = true;
+    }
+    if (need_fallback && (fallback || !fallback_path)) {
+        stale_fallback = filter->pending_fallback;
+        filter->pending_fallback = fallback;
+        filter->pending_fallback_set = true;
+    }
+    if (need_local && (local || !want_local)) {
+        stale_local = filter->pending_local;
+        filter->pending_local = local;
+        filter->pending_local_set = true;
+    }
+    pthread_mutex_unlock(&filter->engine_mutex);
+    
+    if (stale_whisper) {
+        whisper_engine_destroy(stale_whisper);
+    }
+    if (stale_fallback) {
+        whisper_engine_destroy(stale_fallback);
+    }
+    local_corrector_destroy(stale_local);
+    if (need_llm) {
+        correction_stage_set_corrector(filter->correction, llm);
+    }
+    
+    bfree(model_path);
+    bfree(fallback_path);
+    bfree(endpoint);
+    bfree(api_key);
+    bfree(vocabulary);
+}
+
+// Worker side of the hot-swap. Called between segments, so the engines
+// being retired are idle and can be destroyed right away.
+static void transcription_swap_engines(struct ai_transcription_data *filter)
+{
+    void *old_whisper = NULL;
+    void *old_fallback = NULL;
+    void *old_local = NULL;
+    
+    pthread_mutex_lock(&filter->engine_mutex);
+    if (filter->pending_whisper_set) {
+        old_whisper = filter->whisper_context;
+        filter->whisper_context = filter->pending_whisper;
+        filter->pending_whisper = NULL;
+        filter->pending_whisper_set = false;
+    }
+    if (filter->pending_fallback_set) {
+        old_fallback = filter->fallback_context;
+        filter->fallback_context = filter->pending_fallback;
+        filter->pending_fallback = NULL;
+        filter->pending_fallback_set = false;
+    }
+    if (filter->pending_local_set) {
+        old_local = filter->local_corrector;
+        filter->local_corrector = filter->pending_local;
+        filter->pending_local = NULL;
+        filter->pending_local_set = false;
+    }
+    pthread_mutex_unlock(&filter->engine_mutex);
+    
+    if (old_whisper) {
+        whisper_engine_destroy(old_whisper);
+    }
+    if (old_fallback) {
+        whisper_engine_destroy(old_fallback);
+    }
+    local_corrector_destroy(old_local);
+}
+
+// Hands the decoder settings to the engine before a job. Without a
+// configured thread count the tuned one is used, if any.
+static void transcription_apply_decoder_params(struct ai_transcription_data *filter)
+{
+    if (!filter->whisper_context) {
+        return;
+    }
+    
+    pthread_mutex_lock(&filter->settings_mutex);
+    struct whisper_engine_params params = filter->decoder_params;
+    if (params.n_threads <= 0) {
+        params.n_threads = filter->tuned_threads;
+    }
+    pthread_mutex_unlock(&filter->settings_mutex);
+    
+    if (params.n_threads <= 0) {
+        params.n_threads = transcription_auto_threads();
+    }
+    whisper_engine_set_params(filter->whisper_context, &params);
+    if (filter->fallback_context) {
+        whisper_engine_set_params(filter->fallback_context, &params);
+    }
+}
+
+// Copies the settings the job reads if update changed them since the last
+// job
+static void transcription_refresh_job_settings(struct ai_transcription_data *filter)
+{
+    pthread_mutex_lock(&filter->settings_mutex);
+    if (filter->job_settings_seen != filter->job_settings_version) {
+        const struct transcription_job_settings *pending = &filter->pending_job_settings;
+        transcription_job_settings_free(&filter->job_settings);
+        filter->job_settings = *pending;
+        filter->job_settings.language_hint = bstrdup(pending->language_hint);
+        filter->job_settings.context_prompt = bstrdup(pending->context_prompt);
+        filter->job_settings_seen = filter->job_settings_version;
+    }
+    pthread_mutex_unlock(&filter->settings_mutex);
+}
+
+// Feeds the load shedder what a job cost and applies the level it returns
+// from the next job on. Level changes are logged; forcing the VAD on is
+// left to the ingest thread, which owns the segmenter.
+static void transcription_shed_load(struct ai_transcription_data *filter, uint64_t busy_ns,
+                                    size_t samples)
+{
+    enum load_level previous = filter->load_level;
+    if (os_atomic_load_bool(&filter->load_shedding)) {
+        struct inference_client_stats inference_stats = {0};
+        inference_client_get_stats(filter->inference, &inference_stats);
+        size_t backlog = (size_t)os_atomic_load_long(&filter->backlog_samples) +
+                         audio_ring_available(&filter->audio_ring);
+        filter->load_level = load_shedder_update(
+            &filter->shedder, busy_ns, samples, backlog,
+            inference_stats.dropped_stale + inference_stats.dropped_overflow, os_gettime_ns());
+    } else if (previous != LOAD_LEVEL_NORMAL) {
+        load_shedder_reset(&filter->shedder);
+        filter->load_level = LOAD_LEVEL_NORMAL;
+    }
+    
+    if (filter->load_level == previous) {
+        return;
+    }
+    
+    struct load_shedder_stats stats;
+    load_shedder_get_stats(&filter->shedder, &stats);
+    if (filter->load_level > previous) {
+        blog(LOG_WARNING, "AI Transcription: '%s' is falling behind (RTF %.2f, %llu ms "
+             "backlog), shedding load: %s", obs_source_get_name(filter->context),
+             stats.rtf_milli / 1000.0, (unsigned long long)stats.backlog_ms,
+             load_level_name(filter->load_level));
+        if (filter->load_level == LOAD_LEVEL_SMALL_MODEL && !filter->fallback_context) {
+            blog(LOG_WARNING, "AI Transcription: no smaller model is loaded to fall back to");
+        }
+    } else {
+        blog(LOG_INFO, "AI Transcription: '%s' is keeping up again (RTF %.2f), load level "
+             "back to %s", obs_source_get_name(filter->context), stats.rtf_milli / 1000.0,
+             load_level_name(filter->load_level));
+    }
+    
+    bool speech_only = filter->load_level >= LOAD_LEVEL_SPEECH_ONLY;
+    if (speech_only != (previous >= LOAD_LEVEL_SPEECH_ONLY)) {
+        pthread_mutex_lock(&filter->settings_mutex);
+        filter->shed_speech_only = speech_only;
+        filter->vad_config_dirty = true;
+        pthread_mutex_unlock(&filter->settings_mutex);
+        transcription_wake(filter);
+    }
+}
+
+// Inference job, run on a scheduler thread. The scheduler never runs two
+// jobs of one filter at once, so the engines and stream state need no lock.
+static void transcription_run_segment(void *param, void *job, uint64_t enqueue_ns)
+{
+    struct ai_transcription_data *filter = param;
+    struct vad_segment *segment = job;
+    uint64_t start = os_gettime_ns();
+    
+    transcription_add_backlog(filter, -(long)segment->count);
+    transcription_record_queue_wait(filter, enqueue_ns);
+    transcription_swap_engines(filter);
+    transcription_apply_decoder_params(filter);
+    transcription_refresh_job_settings(filter);
+    
+    if (os_atomic_set_bool(&filter->stream_resync, false) && !segment->first) {
+        // Part of this utterance was dropped; whatever was stitched so far
+        // cannot be continued
+        transcription_stream_reset(filter);
+        segment->first = true;
+    }
+    
+    // A continuation belongs to an utterance already being streamed, even
+    // if streaming was switched off meanwhile
+    if (filter->streaming || !segment->first) {
+        transcription_process_stream(filter, segment);
+    } else {
+        transcription_process_segment(filter, segment);
+    }
+    transcription_shed_load(filter, os_gettime_ns() - start, segment->count);
+    
+    bfree(segment->samples);
+    bfree(segment);
+    os_atomic_inc_long(&filter->segments_done);
+}
+
+// Counters reported with the latency histograms. `vad` is only passed by
+// whoever owns the segmenter. `inference` and `correction` replace the live
+// stats once those stages are gone; NULL reads them from the stages.
+static size_t transcription_collect_counters(struct ai_transcription_data *filter,
+                                             const struct vad_stats *vad,
+                                             const struct inference_client_stats *inference,
+                                             const struct correction_stats *correction,
+                                             struct pipeline_counter *counters)
+{
+    struct inference_client_stats inference_stats = {0};
+    if (inference) {
+        inference_stats = *inference;
+    } else {
+        inference_client_get_stats(filter->inference, &inference_stats);
+    }
+    struct correction_stats correction_stats = {0};
+    if (correction) {
+        correction_stats = *correction;
+    } else {
+        correction_stage_get_stats(filter->correction, &correction_stats);
+    }
+    struct transcript_writer_stats writer_stats;
+    transcript_writer_get_stats(filter->transcript_writer, &writer_stats);
+    struct caption_output_stats caption_stats;
+    caption_output_get_stats(filter->caption_output, &caption_stats);
+    
+    pthread_mutex_lock(&filter->caption_mutex);
+    uint64_t captions = filter->caption_id;
+    pthread_mutex_unlock(&filter->caption_mutex);
+    
+    struct load_shedder_stats shed_stats;
+    load_shedder_get_stats(&filter->shedder, &shed_stats);
+    
+    pthread_mutex_lock(&filter->settings_mutex);
+    int tuned_threads = filter->tuned_threads;
+    int tuned_window_ms = filter->tuned_window_ms;
+    pthread_mutex_unlock(&filter->settings_mutex);
+    
+    size_t count = 0;
+#define ADD_COUNTER(counter_name, counter_value) \
+    counters[count++] = (struct pipeline_counter){counter_name, (uint64_t)(counter_value)}
+    
+    ADD_COUNTER("samples_stored", (unsigned long)os_atomic_load_long(&filter->audio_ring.write_pos));
+    ADD_COUNTER("samples_dropped", os_atomic_load_long(&filter->audio_ring.overrun_samples));
+    ADD_COUNTER("ring_high_water", os_atomic_load_long(&filter->audio_ring.high_water_mark));
+    if (vad) {
+        ADD_COUNTER("vad_frames", vad->frames);
+        ADD_COUNTER("vad_speech_frames", vad->speech_frames);
+        ADD_COUNTER("vad_segments", vad->segments);
+        ADD_COUNTER("vad_discarded_segments", vad->discarded_segments);
+    }
+    ADD_COUNTER("segments_queued", os_atomic_load_long(&filter->segments_queued));
+    ADD_COUNTER("inference_completed", inference_stats.completed);
+    ADD_COUNTER("inference_dropped_stale", inference_stats.dropped_stale);
+    ADD_COUNTER("inference_dropped_overflow", inference_stats.dropped_overflow);
+    ADD_COUNTER("load_level", shed_stats.level);
+    ADD_COUNTER("load_level_max", shed_stats.max_level);
+    ADD_COUNTER("load_escalations", shed_stats.escalations);
+    ADD_COUNTER("load_recoveries", shed_stats.recoveries);
+    ADD_COUNTER("load_rtf_milli", shed_stats.rtf_milli);
+    ADD_COUNTER("load_backlog_ms", shed_stats.backlog_ms);
+    ADD_COUNTER("load_degraded_ms", shed_stats.degraded_ms);
+    ADD_COUNTER("captions", captions);
+    ADD_COUNTER("tuned_threads", tuned_threads);
+    ADD_COUNTER("tuned_window_ms", tuned_window_ms);
+    ADD_COUNTER("caption_updates", caption_stats.shown);
+    ADD_COUNTER("captions_coalesced", caption_stats.coalesced);
+    ADD_COUNTER("captions_unchanged", caption_stats.unchanged);
+    ADD_COUNTER("vocabulary_replacements", os_atomic_load_long(&filter->local_replacements));
+    ADD_COUNTER("corrections_skipped", os_atomic_load_long(&filter->correction_skipped));
+    ADD_COUNTER("corrections_shed", os_atomic_load_long(&filter->corrections_shed));
+    ADD_COUNTER("corrections_submitted", correction_stats.submitted);
+    ADD_COUNTER("corrections_changed", correction_stats.corrected);
+    ADD_COUNTER("corrections_unchanged", correction_stats.unchanged);
+    ADD_COUNTER("corrections_expired", correction_stats.expired);
+    ADD_COUNTER("corrections_overflowed", correction_stats.overflowed);
+    ADD_COUNTER("llm_requests", correction_stats.answered);
+    ADD_COUNTER("transcript_entries", writer_stats.entries);
+    ADD_COUNTER("transcript_bytes", writer_stats.bytes);
+    ADD_COUNTER("transcript_write_errors", writer_stats.write_errors);
+#undef ADD_COUNTER
+
+    return count;
+}
+
+// Writes the stats file if one is set and it is due (or `force`). Called
+// by the ingest thread between VAD passes, which owns the segmenter, and
+// once more on destroy after it has stopped, with the final inference and
+// correction stats.
+static void transcription_write_stats(struct ai_transcription_data *filter, bool force,
+                                      const struct inference_client_stats *inference,
+                                      const struct correction_stats *correction)
+{
+    uint64_t now = os_gettime_ns();
+    char *path = NULL;
+    
+    pthread_mutex_lock(&filter->settings_mutex);
+    uint64_t interval = (uint64_t)filter->stats_interval_s * 1000000000ULL;
+    if (filter->stats_file_path && *filter->stats_file_path &&
+        (force || now - filter->stats_written_ns >= interval)) {
+        path = bstrdup(filter->stats_file_path);
+    }
+    pthread_mutex_unlock(&filter->settings_mutex);
+    
+    if (!path) {
+        return;
+    }
+    filter->stats_written_ns = now;
+    
+    struct vad_stats vad_stats;
+    vad_segmenter_get_stats(filter->segmenter, &vad_stats);
+    struct pipeline_counter counters[MAX_STATS_COUNTERS];
+    size_t count = transcription_collect_counters(filter, &vad_stats, inference, correction,
+                                                  counters);
+    pipeline_stats_write_json(&filter->stats, obs_source_get_name(filter->context), counters,
+                              count, path);
+    bfree(path);
+}
+
+// Ingest thread: moves audio from the ring through the VAD and submits the
+// speech it finds. It never decodes, so it stays cheap per source.
+static void *transcription_thread_worker(void *data)
+{
+    struct ai_transcription_data *filter = data;
+    
+    os_set_thread_name("ai-transcription: ingest");
+    blog(LOG_INFO, "AI Transcription thread started");
+    
+    while (!os_atomic_load_bool(&filter->stop_thread)) {
+        if (!os_atomic_load_bool(&filter->enabled)) {
+            transcription_wait(filter);
+            continue;
         }
         
-        os_sleep_ms(filter->transcription_interval_ms);
+        // Only speech reaches the recognizer; silence and music never queue
+        transcription_ingest(filter);
+        transcription_write_stats(filter, false, NULL, NULL);
+        transcription_wait(filter);
     }
     
     blog(LOG_INFO, "AI Transcription thread stopped");
@@ -213,17 +1379,46 @@ static void *ai_transcription_create(obs_data_t *settings, obs_source_t *source)
 {
     struct ai_transcription_data *filter = bzalloc(sizeof(struct ai_transcription_data));
     filter->context = source;
+    pipeline_stats_init(&filter->stats);
+    
+    // Initialize audio buffers. Everything the audio thread writes to is
+    // allocated here so that filter_audio never allocates.
+    audio_ring_init(&filter->audio_ring, AUDIO_RING_SIZE);
+    sample_clock_init(&filter->clock, TRANSCRIPTION_SAMPLE_RATE);
+    load_shedder_init(&filter->shedder);
+    filter->mono_scratch = bmalloc(AUDIO_SCRATCH_FRAMES * sizeof(float));
+    filter->ingest_scratch = bmalloc(INGEST_CHUNK_SAMPLES * sizeof(float));
     
-    // Initialize audio buffer
-    circlebuf_init(&filter->audio_buffer);
-    circlebuf_reserve(&filter->audio_buffer, TRANSCRIPTION_BUFFER_SIZE * sizeof(float));
-    pthread_mutex_init(&filter->buffer_mutex, NULL);
+    pthread_mutex_init(&filter->settings_mutex, NULL);
+    os_sem_init(&filter->worker_wake, 0);
+    pthread_mutex_init(&filter->engine_mutex, NULL);
+    filter->engine_loader = os_task_queue_create();
+    pthread_mutex_init(&filter->caption_mutex, NULL);
+    filter->caption_output = caption_output_create(&filter->stats.stages[PIPELINE_STAGE_OUTPUT]);
+    filter->transcript_writer = transcript_writer_create();
+    filter->correction = correction_stage_create(MAX_QUEUED_CORRECTIONS,
+                                                 transcription_correction_done,
+                                                 transcription_correction_partial, filter);
+    filter->inference = inference_client_create(obs_source_get_name(source), MAX_QUEUED_SEGMENTS,
+                                                transcription_run_segment,
+                                                transcription_drop_segment, filter);
+    filter->segmenter = vad_segmenter_create(NULL, MAX_SEGMENT_LENGTH);
+    filter->stitcher = transcript_stitcher_create();
+    filter->stream_window = bmalloc(STREAM_WINDOW_SIZE * sizeof(float));
     
-    // Initialize buffer info
-    filter->buffer_info.sample_rate = 48000;
-    filter->buffer_info.channels = 1; // Mono for transcription
+    // Initialize buffer info from the OBS audio output feeding the filter
+    filter->buffer_info.sample_rate = audio_output_get_sample_rate(obs_get_audio());
+    filter->buffer_info.channels = (uint32_t)audio_output_get_channels(obs_get_audio());
     filter->buffer_info.format = AUDIO_FORMAT_FLOAT;
     
+    // Resample to 16kHz on ingest so the ring, window and copies only carry
+    // what Whisper actually consumes
+    filter->resampler = audio_resampler_create(filter->buffer_info.sample_rate,
+                                               TRANSCRIPTION_SAMPLE_RATE);
+    filter->resample_scratch_size = audio_resampler_max_output(filter->resampler,
+                                                               AUDIO_SCRATCH_FRAMES);
+    filter->resample_scratch = bmalloc(filter->resample_scratch_size * sizeof(float));
+    
     // Apply initial settings
     ai_transcription_update(filter, settings);
     
@@ -241,25 +1436,107 @@ static void ai_transcription_update(void *data, obs_data_t *settings)
     struct ai_transcription_data *filter = data;
     
     // Update settings
-    filter->enabled = obs_data_get_bool(settings, "enabled");
+    os_atomic_set_bool(&filter->enabled, obs_data_get_bool(settings, "enabled"));
     filter->real_time_mode = obs_data_get_bool(settings, "real_time_mode");
     filter->silence_threshold = (float)obs_data_get_double(settings, "silence_threshold");
     filter->transcription_interval_ms = (int)obs_data_get_int(settings, "transcription_interval_ms");
+    filter->vad_enabled = obs_data_get_bool(settings, "vad_enabled");
+    filter->vad_hangover_ms = (int)obs_data_get_int(settings, "vad_hangover_ms");
+    filter->streaming_mode = obs_data_get_bool(settings, "streaming_mode");
+    filter->stream_overlap_ms = (int)obs_data_get_int(settings, "stream_overlap_ms");
+    filter->inference_priority = (int)obs_data_get_int(settings, "inference_priority");
+    filter->inference_workers = (int)obs_data_get_int(settings, "inference_workers");
+    os_atomic_set_bool(&filter->load_shedding, obs_data_get_bool(settings, "load_shedding"));
+    
+    inference_client_set_priority(filter->inference,
+                                  (enum inference_priority)filter->inference_priority);
+    
+    // The pool is shared, so this is process-wide: the last filter whose
+    // settings were applied decides
+    inference_scheduler_set_workers((uint32_t)filter->inference_workers);
+    
+    // Real-time mode keeps utterances short for latency; otherwise let them
+    // grow to Whisper's full context for accuracy. Streaming hands the
+    // utterance out every interval instead, so it never needs the cut.
+    struct vad_config vad_config;
+    vad_config_defaults(&vad_config);
+    vad_config.enabled = filter->vad_enabled;
+    vad_config.threshold_db = filter->silence_threshold;
+    vad_config.hangover_frames = (uint32_t)(filter->vad_hangover_ms / 10);
+    
+    pthread_mutex_lock(&filter->settings_mutex);
+    filter->pending_vad_config = vad_config;
+    filter->pending_max_segment = filter->real_time_mode && !filter->streaming_mode
+        ? TRANSCRIPTION_BUFFER_SIZE : MAX_SEGMENT_LENGTH;
+    filter->pending_streaming = filter->streaming_mode;
+    filter->pending_interval_ms = filter->transcription_interval_ms;
+    if (!obs_data_get_bool(settings, "auto_tune")) {
+        filter->tuned_threads = 0;
+        filter->tuned_window_ms = 0;
+    }
+    transcription_update_partial_samples(filter);
+    filter->pending_stream_overlap = (size_t)filter->stream_overlap_ms *
+                                     TRANSCRIPTION_SAMPLE_RATE / 1000;
+    if (filter->pending_stream_overlap > MAX_STREAM_OVERLAP) {
+        filter->pending_stream_overlap = MAX_STREAM_OVERLAP;
+    }
+    filter->vad_config_dirty = true;
+    filter->decoder_params = (struct whisper_engine_params){
+        .n_threads = (int)obs_data_get_int(settings, "whisper_threads"),
+        .beam_size = (int)obs_data_get_int(settings, "whisper_beam_size"),
+        .no_context = obs_data_get_bool(settings, "whisper_no_context"),
+        .single_segment = obs_data_get_bool(settings, "whisper_single_segment"),
+    };
+    pthread_mutex_unlock(&filter->settings_mutex);
     
     // AI settings
+    pthread_mutex_lock(&filter->settings_mutex);
+    struct transcription_job_settings *job_settings = &filter->pending_job_settings;
+    job_settings->use_llm_correction = obs_data_get_bool(settings, "use_llm_correction");
+    job_settings->llm_deadline_ms = (int)obs_data_get_int(settings, "llm_deadline_ms");
+    job_settings->correction_gate = (int)obs_data_get_int(settings, "correction_gate");
+    job_settings->correction_threshold =
+        (float)obs_data_get_double(settings, "correction_threshold");
+    
+    const char *language = obs_data_get_string(settings, "language_hint");
+    if (language) {
+        bfree(job_settings->language_hint);
+        job_settings->language_hint = bstrdup(language);
+    }
+    
+    const char *context = obs_data_get_string(settings, "context_prompt");
+    if (context) {
+        bfree(job_settings->context_prompt);
+        job_settings->context_prompt = bstrdup(context);
+    }
+    filter->job_settings_version++;
+    pthread_mutex_unlock(&filter->settings_mutex);
+    
+    correction_stage_set_batch_window(filter->correction,
+                                      (long)obs_data_get_int(settings, "llm_batch_window_ms"));
+    correction_stage_set_streaming(filter->correction, obs_data_get_bool(settings, "llm_streaming"));
+    
+    pthread_mutex_lock(&filter->engine_mutex);
     filter->use_llm_correction = obs_data_get_bool(settings, "use_llm_correction");
+    filter->use_local_correction = obs_data_get_bool(settings, "use_local_correction");
+    const char *vocabulary = obs_data_get_string(settings, "vocabulary_path");
+    if (vocabulary) {
+        bfree(filter->vocabulary_path);
+        filter->vocabulary_path = bstrdup(vocabulary);
+    }
     
     const char *whisper_model = obs_data_get_string(settings, "whisper_model_path");
     if (whisper_model && strlen(whisper_model) > 0) {
         bfree(filter->whisper_model_path);
         filter->whisper_model_path = bstrdup(whisper_model);
-        
-        // Reinitialize Whisper if model changed
-        if (filter->whisper_context) {
-            whisper_engine_destroy(filter->whisper_context);
-        }
-        filter->whisper_context = whisper_engine_create(filter->whisper_model_path);
     }
+    filter->auto_tune = obs_data_get_bool(settings, "auto_tune");
+    const char *fallback_model = obs_data_get_string(settings, "fallback_model_path");
+    if (fallback_model) {
+        bfree(filter->fallback_model_path);
+        filter->fallback_model_path = bstrdup(fallback_model);
+    }
+    filter->latency_budget_ms = (int)obs_data_get_int(settings, "latency_budget_ms");
     
     const char *llm_endpoint = obs_data_get_string(settings, "llm_api_endpoint");
     if (llm_endpoint) {
@@ -272,86 +1549,169 @@ static void ai_transcription_update(void *data, obs_data_t *settings)
         bfree(filter->llm_api_key);
         filter->llm_api_key = bstrdup(llm_key);
     }
+    pthread_mutex_unlock(&filter->engine_mutex);
     
-    const char *language = obs_data_get_string(settings, "language_hint");
-    if (language) {
-        bfree(filter->language_hint);
-        filter->language_hint = bstrdup(language);
-    }
-    
-    const char *context = obs_data_get_string(settings, "context_prompt");
-    if (context) {
-        bfree(filter->context_prompt);
-        filter->context_prompt = bstrdup(context);
-    }
-    
-    // Update LLM context if needed
-    if (filter->use_llm_correction && filter->llm_api_endpoint && filter->llm_api_key) {
-        if (filter->llm_context) {
-            llm_corrector_destroy(filter->llm_context);
-        }
-        filter->llm_context = llm_corrector_create(filter->llm_api_endpoint, filter->llm_api_key);
+    // Engines load in the background, and only for an enabled filter; a
+    // disabled one costs nothing until it is switched on. The loader skips
+    // engines whose model and credentials are unchanged.
+    if (os_atomic_load_bool(&filter->enabled)) {
+        os_task_queue_queue_task(filter->engine_loader, transcription_load_engines, filter);
     }
     
     // Output settings
-    filter->output_to_text_source = obs_data_get_bool(settings, "output_to_text_source");
+    caption_output_configure(filter->caption_output,
+                             obs_data_get_bool(settings, "output_to_text_source")
+                                 ? obs_data_get_string(settings, "text_source_name") : NULL,
+                             obs_data_get_bool(settings, "show_confidence"),
+                             (uint32_t)obs_data_get_int(settings, "caption_interval_ms"),
+                             (uint32_t)obs_data_get_int(settings, "caption_delay_ms"));
     
-    const char *text_source = obs_data_get_string(settings, "text_source_name");
-    if (text_source) {
-        bfree(filter->text_source_name);
-        filter->text_source_name = bstrdup(text_source);
+    // The writer keeps the file open when only the flush settings change
+    struct transcript_writer_config writer_config = {
+        .path = obs_data_get_string(settings, "output_file_path"),
+        .format = (enum transcript_format)obs_data_get_int(settings, "output_format"),
+        .flush_interval_ms = (uint32_t)obs_data_get_int(settings, "output_flush_ms"),
+        .flush_bytes = (size_t)obs_data_get_int(settings, "output_flush_kb") * 1024,
+        .sync = (enum transcript_sync)obs_data_get_int(settings, "output_sync"),
+    };
+    if (writer_config.flush_interval_ms > TRANSCRIPT_FLUSH_MAX_MS) {
+        writer_config.flush_interval_ms = TRANSCRIPT_FLUSH_MAX_MS;
     }
+    transcript_writer_configure(filter->transcript_writer,
+                                obs_data_get_bool(settings, "save_to_file") ? &writer_config : NULL);
     
-    filter->save_to_file = obs_data_get_bool(settings, "save_to_file");
-    
-    const char *output_file = obs_data_get_string(settings, "output_file_path");
-    if (output_file) {
-        bfree(filter->output_file_path);
-        filter->output_file_path = bstrdup(output_file);
+    pthread_mutex_lock(&filter->settings_mutex);
+    const char *stats_file = obs_data_get_string(settings, "stats_file_path");
+    if (stats_file) {
+        bfree(filter->stats_file_path);
+        filter->stats_file_path = bstrdup(stats_file);
+    }
+    filter->stats_interval_s = (int)obs_data_get_int(settings, "stats_interval_s");
+    if (filter->stats_interval_s < 1) {
+        filter->stats_interval_s = 1;
     }
+    pthread_mutex_unlock(&filter->settings_mutex);
     
-    filter->show_confidence = obs_data_get_bool(settings, "show_confidence");
+    // Let the worker pick up the new settings (or notice it was enabled)
+    transcription_wake(filter);
 }
 
 static struct obs_audio_data *ai_transcription_filter_audio(void *data, struct obs_audio_data *audio)
 {
     struct ai_transcription_data *filter = data;
     
-    if (!filter->enabled || !audio || !audio->data[0]) {
+    if (!os_atomic_load_bool(&filter->enabled) || !audio || !audio->data[0]) {
         return audio;
     }
     
-    // Convert audio to mono float format for transcription
-    float *mono_data = audio_buffer_convert_to_mono_float(audio, &filter->buffer_info);
-    if (!mono_data) {
+    if (!filter->resampler) {
         return audio;
     }
     
-    // Add to circular buffer for transcription processing
-    pthread_mutex_lock(&filter->buffer_mutex);
+    uint64_t start = os_gettime_ns();
     
-    size_t data_size = audio->frames * sizeof(float);
-    
-    // Ensure buffer doesn't overflow
-    while (filter->audio_buffer.size + data_size > TRANSCRIPTION_BUFFER_SIZE * sizeof(float)) {
-        // Remove oldest data to make room
-        circlebuf_pop_front(&filter->audio_buffer, NULL, data_size);
+    // Convert audio to mono float in scratch-sized chunks, resample to 16kHz
+    // and hand it to the worker through the lock-free ring. Nothing here
+    // allocates or blocks.
+    for (uint32_t offset = 0; offset < audio->frames; offset += AUDIO_SCRATCH_FRAMES) {
+        uint32_t frames = audio->frames - offset;
+        if (frames > AUDIO_SCRATCH_FRAMES) {
+            frames = AUDIO_SCRATCH_FRAMES;
+        }
+        
+        if (!audio_buffer_mix_to_mono(audio, &filter->buffer_info, offset, frames,
+                                      filter->mono_scratch)) {
+            return audio;
+        }
+        
+        size_t resampled = audio_resampler_process(filter->resampler,
+                                                   filter->mono_scratch, frames,
+                                                   filter->resample_scratch,
+                                                   filter->resample_scratch_size);
+        size_t stored = audio_ring_write(&filter->audio_ring, filter->resample_scratch,
+                                         resampled);
+        sample_clock_produce(&filter->clock,
+                             audio->timestamp + (uint64_t)offset * 1000000000ULL /
+                                                    filter->buffer_info.sample_rate,
+                             stored);
     }
     
-    circlebuf_push_back(&filter->audio_buffer, mono_data, data_size);
-    filter->total_transcribed_frames += audio->frames;
-    
-    pthread_mutex_unlock(&filter->buffer_mutex);
+    if (audio_ring_available(&filter->audio_ring) >= WORKER_WAKE_SAMPLES) {
+        transcription_wake(filter);
+    }
     
-    bfree(mono_data);
+    pipeline_stats_record(&filter->stats, PIPELINE_STAGE_AUDIO_CALLBACK, os_gettime_ns() - start);
     
     // Pass through original audio unchanged
     return audio;
 }
 
-static obs_properties_t *ai_transcription_properties(void *data)
+static bool ai_transcription_recalibrate(obs_properties_t *props, obs_property_t *property,
+                                         void *data)
+{
+    UNUSED_PARAMETER(props);
+    UNUSED_PARAMETER(property);
+    struct ai_transcription_data *filter = data;
+    
+    pthread_mutex_lock(&filter->engine_mutex);
+    filter->recalibrate = true;
+    pthread_mutex_unlock(&filter->engine_mutex);
+    
+    if (os_atomic_load_bool(&filter->enabled)) {
+        os_task_queue_queue_task(filter->engine_loader, transcription_load_engines, filter);
+    }
+    return false;
+}
+
+static bool ai_transcription_refresh_stats(obs_properties_t *props, obs_property_t *property,
+                                           void *data)
 {
+    UNUSED_PARAMETER(props);
+    UNUSED_PARAMETER(property);
     UNUSED_PARAMETER(data);
+    return true; // rebuilds the properties, and with them the figures
+}
+
+// Read-only lines with the latency of every stage and the drop counters,
+// as of when the properties were opened or refreshed
+static void ai_transcription_add_stats(struct ai_transcription_data *filter,
+                                       obs_properties_t *group)
+{
+    char text[256];
+    char line[192];
+    
+    for (int stage = 0; stage < PIPELINE_STAGE_COUNT; stage++) {
+        struct latency_summary summary;
+        latency_histogram_summarize(&filter->stats.stages[stage], &summary);
+        pipeline_stats_format_summary(&summary, line, sizeof(line));
+        snprintf(text, sizeof(text), "%s: %s",
+                 pipeline_stage_label((enum pipeline_stage)stage), line);
+        
+        char name[64];
+        snprintf(name, sizeof(name), "stats_%s", pipeline_stage_name((enum pipeline_stage)stage));
+        obs_properties_add_text(group, name, text, OBS_TEXT_INFO);
+    }
+    
+    struct ai_transcription_stats stats;
+    ai_transcription_get_stats(filter, &stats);
+    snprintf(text, sizeof(text), "Dropped: %.1f s of audio, %llu of %llu segments",
+             (double)stats.samples_dropped / TRANSCRIPTION_SAMPLE_RATE,
+             (unsigned long long)stats.segments_dropped,
+             (unsigned long long)stats.segments_queued);
+    obs_properties_add_text(group, "stats_dropped", text, OBS_TEXT_INFO);
+    
+    struct load_shedder_stats shed_stats;
+    load_shedder_get_stats(&filter->shedder, &shed_stats);
+    snprintf(text, sizeof(text), "Load: %s (RTF %.2f, %llu ms backlog), stepped down %llu "
+             "times, %.1f s degraded", load_level_name((enum load_level)shed_stats.level),
+             shed_stats.rtf_milli / 1000.0, (unsigned long long)shed_stats.backlog_ms,
+             (unsigned long long)shed_stats.escalations, shed_stats.degraded_ms / 1000.0);
+    obs_properties_add_text(group, "stats_load", text, OBS_TEXT_INFO);
+}
+
+static obs_properties_t *ai_transcription_properties(void *data)
+{
+    struct ai_transcription_data *filter = data;
     
     obs_properties_t *props = obs_properties_create();
     
@@ -366,16 +1726,66 @@ static obs_properties_t *ai_transcription_properties(void *data)
     obs_properties_add_int(props, "transcription_interval_ms", "Transcription Interval (ms)", 
                           500, 5000, 100);
     
+    obs_properties_add_bool(props, "vad_enabled", "Voice Activity Detection");
+    obs_property_t *hangover_prop = obs_properties_add_int_slider(props, "vad_hangover_ms",
+        "Pause Before Cut (ms)", 100, 2000, 10);
+    obs_property_int_set_suffix(hangover_prop, " ms");
+    
+    obs_properties_add_bool(props, "streaming_mode", "Streaming Transcription");
+    obs_property_t *overlap_prop = obs_properties_add_int_slider(props, "stream_overlap_ms",
+        "Overlap Context (ms)", 200, 3000, 100);
+    obs_property_int_set_suffix(overlap_prop, " ms");
+    
+    obs_property_t *priority_prop = obs_properties_add_list(props, "inference_priority",
+        "Inference Priority", OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+    obs_property_list_add_int(priority_prop, "High", INFERENCE_PRIORITY_HIGH);
+    obs_property_list_add_int(priority_prop, "Normal", INFERENCE_PRIORITY_NORMAL);
+    obs_property_list_add_int(priority_prop, "Low", INFERENCE_PRIORITY_LOW);
+    
+    obs_properties_add_int(props, "inference_workers", "Inference Workers (All Sources, 0 = Auto)",
+                          0, 16, 1);
+    obs_properties_add_bool(props, "load_shedding", "Adaptive Load Shedding");
+    
     // AI Engine settings
     obs_properties_t *ai_group = obs_properties_create();
     obs_properties_add_group(props, "ai_settings", "AI Settings", OBS_GROUP_NORMAL, ai_group);
     
     obs_properties_add_path(ai_group, "whisper_model_path", "Whisper Model Path", 
                            OBS_PATH_FILE, "Model files (*.bin)", NULL);
+    obs_properties_add_int(ai_group, "whisper_threads", "Decoder Threads (0 = Auto)", 0, 32, 1);
+    obs_properties_add_int(ai_group, "whisper_beam_size", "Beam Size (1 = Greedy)", 1, 8, 1);
+    obs_properties_add_bool(ai_group, "whisper_single_segment", "Single Segment Decoding");
+    obs_properties_add_bool(ai_group, "whisper_no_context", "Decode Without Previous Text");
+    obs_properties_add_bool(ai_group, "auto_tune", "Auto-Tune Model, Threads and Window");
+    obs_property_t *budget_prop = obs_properties_add_int(ai_group, "latency_budget_ms",
+        "Latency Budget (ms)", 500, 10000, 100);
+    obs_property_int_set_suffix(budget_prop, " ms");
+    obs_properties_add_button(ai_group, "recalibrate", "Recalibrate",
+                              ai_transcription_recalibrate);
+    obs_properties_add_path(ai_group, "fallback_model_path", "Fallback Model Path",
+                           OBS_PATH_FILE, "Model files (*.bin)", NULL);
+    
+    obs_properties_add_bool(ai_group, "use_local_correction", "Use Vocabulary Correction");
+    obs_properties_add_path(ai_group, "vocabulary_path", "Vocabulary File",
+                           OBS_PATH_FILE, "Text files (*.txt);;All files (*.*)", NULL);
     
     obs_properties_add_bool(ai_group, "use_llm_correction", "Use LLM Correction");
     obs_properties_add_text(ai_group, "llm_api_endpoint", "LLM API Endpoint", OBS_TEXT_DEFAULT);
     obs_properties_add_text(ai_group, "llm_api_key", "LLM API Key", OBS_TEXT_PASSWORD);
+    obs_property_t *deadline_prop = obs_properties_add_int(ai_group, "llm_deadline_ms",
+        "Correction Deadline (ms)", 500, 30000, 100);
+    obs_property_int_set_suffix(deadline_prop, " ms");
+    obs_property_t *batch_prop = obs_properties_add_int(ai_group, "llm_batch_window_ms",
+        "Correction Batch Window (ms)", 0, 1000, 25);
+    obs_property_int_set_suffix(batch_prop, " ms");
+    obs_properties_add_bool(ai_group, "llm_streaming", "Stream Corrections");
+    obs_property_t *gate_prop = obs_properties_add_list(ai_group, "correction_gate",
+        "Correct", OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+    obs_property_list_add_int(gate_prop, "Low-Confidence Words Only", CORRECTION_GATE_SPANS);
+    obs_property_list_add_int(gate_prop, "Low-Confidence Segments", CORRECTION_GATE_SEGMENT);
+    obs_property_list_add_int(gate_prop, "Every Segment", CORRECTION_GATE_ALWAYS);
+    obs_properties_add_float_slider(ai_group, "correction_threshold",
+        "Correction Confidence Threshold", 0.0, 1.0, 0.01);
     
     obs_property_t *lang_prop = obs_properties_add_list(ai_group, "language_hint", "Language",
         OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
@@ -395,10 +1805,49 @@ static obs_properties_t *ai_transcription_properties(void *data)
     obs_properties_add_bool(output_group, "output_to_text_source", "Output to Text Source");
     obs_properties_add_text(output_group, "text_source_name", "Text Source Name", OBS_TEXT_DEFAULT);
     obs_properties_add_bool(output_group, "show_confidence", "Show Confidence Score");
+    obs_property_t *caption_interval_prop = obs_properties_add_int_slider(output_group,
+        "caption_interval_ms", "Minimum Caption Interval (ms)", 0, 1000, 10);
+    obs_property_int_set_suffix(caption_interval_prop, " ms");
+    obs_property_t *caption_delay_prop = obs_properties_add_int(output_group,
+        "caption_delay_ms", "Caption Delay (ms)", 0, 10000, 100);
+    obs_property_int_set_suffix(caption_delay_prop, " ms");
     
     obs_properties_add_bool(output_group, "save_to_file", "Save to File");
     obs_properties_add_path(output_group, "output_file_path", "Output File Path", 
-                           OBS_PATH_FILE_SAVE, "Text files (*.txt)", NULL);
+                           OBS_PATH_FILE_SAVE, "Transcripts (*.txt *.srt *.vtt *.jsonl)", NULL);
+    obs_property_t *format_prop = obs_properties_add_list(output_group, "output_format",
+        "File Format", OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+    obs_property_list_add_int(format_prop, "Plain Text", TRANSCRIPT_FORMAT_TEXT);
+    obs_property_list_add_int(format_prop, "SubRip (SRT)", TRANSCRIPT_FORMAT_SRT);
+    obs_property_list_add_int(format_prop, "WebVTT", TRANSCRIPT_FORMAT_WEBVTT);
+    obs_property_list_add_int(format_prop, "JSON Lines", TRANSCRIPT_FORMAT_JSONL);
+    obs_property_t *flush_prop = obs_properties_add_int(output_group, "output_flush_ms",
+        "Flush Interval (ms)", 0, TRANSCRIPT_FLUSH_MAX_MS, 100);
+    obs_property_int_set_suffix(flush_prop, " ms");
+    obs_property_t *flush_size_prop = obs_properties_add_int(output_group, "output_flush_kb",
+        "Flush Size (KB)", 1, 4096, 1);
+    obs_property_int_set_suffix(flush_size_prop, " KB");
+    obs_property_t *sync_prop = obs_properties_add_list(output_group, "output_sync",
+        "Sync to Disk", OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+    obs_property_list_add_int(sync_prop, "Never", TRANSCRIPT_SYNC_NEVER);
+    obs_property_list_add_int(sync_prop, "On Close", TRANSCRIPT_SYNC_CLOSE);
+    obs_property_list_add_int(sync_prop, "After Every Flush", TRANSCRIPT_SYNC_FLUSH);
+    
+    // Pipeline statistics
+    obs_properties_t *stats_group = obs_properties_create();
+    obs_properties_add_group(props, "pipeline_stats", "Pipeline Statistics", OBS_GROUP_NORMAL,
+                             stats_group);
+    
+    if (filter) {
+        ai_transcription_add_stats(filter, stats_group);
+        obs_properties_add_button(stats_group, "stats_refresh", "Refresh Statistics",
+                                  ai_transcription_refresh_stats);
+    }
+    obs_properties_add_path(stats_group, "stats_file_path", "Stats File",
+                           OBS_PATH_FILE_SAVE, "JSON files (*.json)", NULL);
+    obs_property_t *stats_interval_prop = obs_properties_add_int(stats_group, "stats_interval_s",
+        "Stats File Interval (s)", 1, 3600, 1);
+    obs_property_int_set_suffix(stats_interval_prop, " s");
     
     return props;
 }
@@ -409,8 +1858,27 @@ static void ai_transcription_defaults(obs_data_t *settings)
     obs_data_set_default_bool(settings, "real_time_mode", true);
     obs_data_set_default_double(settings, "silence_threshold", -40.0);
     obs_data_set_default_int(settings, "transcription_interval_ms", 1000);
+    obs_data_set_default_bool(settings, "vad_enabled", true);
+    obs_data_set_default_int(settings, "vad_hangover_ms", 300);
+    obs_data_set_default_bool(settings, "streaming_mode", true);
+    obs_data_set_default_int(settings, "stream_overlap_ms", 1000);
+    obs_data_set_default_int(settings, "inference_priority", INFERENCE_PRIORITY_NORMAL);
+    obs_data_set_default_int(settings, "inference_workers", 0);
+    obs_data_set_default_bool(settings, "load_shedding", true);
     
+    obs_data_set_default_bool(settings, "use_local_correction", false);
+    obs_data_set_default_int(settings, "whisper_threads", 0);
+    obs_data_set_default_int(settings, "whisper_beam_size", 1);
+    obs_data_set_default_bool(settings, "whisper_single_segment", true);
+    obs_data_set_default_bool(settings, "whisper_no_context", false);
+    obs_data_set_default_bool(settings, "auto_tune", false);
+    obs_data_set_default_int(settings, "latency_budget_ms", 3000);
     obs_data_set_default_bool(settings, "use_llm_correction", false);
+    obs_data_set_default_int(settings, "llm_deadline_ms", 4000);
+    obs_data_set_default_int(settings, "llm_batch_window_ms", 0);
+    obs_data_set_default_bool(settings, "llm_streaming", true);
+    obs_data_set_default_int(settings, "correction_gate", CORRECTION_GATE_SPANS);
+    obs_data_set_default_double(settings, "correction_threshold", 0.8);
     obs_data_set_default_string(settings, "language_hint", "auto");
     obs_data_set_default_string(settings, "context_prompt", 
         "Please correct any transcription errors in the following text, "
@@ -418,7 +1886,50 @@ static void ai_transcription_defaults(obs_data_t *settings)
     
     obs_data_set_default_bool(settings, "output_to_text_source", false);
     obs_data_set_default_bool(settings, "show_confidence", true);
+    obs_data_set_default_int(settings, "caption_interval_ms", 100);
+    obs_data_set_default_int(settings, "caption_delay_ms", 0);
     obs_data_set_default_bool(settings, "save_to_file", false);
+    obs_data_set_default_int(settings, "output_format", TRANSCRIPT_FORMAT_TEXT);
+    obs_data_set_default_int(settings, "output_flush_ms", 1000);
+    obs_data_set_default_int(settings, "output_flush_kb", 64);
+    obs_data_set_default_int(settings, "output_sync", TRANSCRIPT_SYNC_CLOSE);
+    
+    obs_data_set_default_int(settings, "stats_interval_s", 10);
+}
+
+void ai_transcription_set_caption_callback(void *data, ai_transcription_caption_cb callback,
+                                           void *param)
+{
+    struct ai_transcription_data *filter = data;
+    filter->caption_callback = callback;
+    filter->caption_param = param;
+}
+
+void ai_transcription_get_stats(void *data, struct ai_transcription_stats *stats)
+{
+    struct ai_transcription_data *filter = data;
+    
+    // Ring positions are free-running longs; differences are taken unsigned
+    unsigned long stored = (unsigned long)os_atomic_load_long(&filter->audio_ring.write_pos);
+    unsigned long ingested = (unsigned long)os_atomic_load_long(&filter->samples_ingested);
+    unsigned long queued = (unsigned long)os_atomic_load_long(&filter->segments_queued);
+    unsigned long done = (unsigned long)os_atomic_load_long(&filter->segments_done);
+    
+    struct inference_client_stats inference_stats = {0};
+    inference_client_get_stats(filter->inference, &inference_stats);
+    
+    stats->samples_stored = stored;
+    stats->samples_dropped = (unsigned long)os_atomic_load_long(&filter->audio_ring.overrun_samples);
+    stats->samples_pending = stored - ingested;
+    stats->segments_queued = queued;
+    stats->segments_pending = queued - done;
+    stats->segments_dropped = inference_stats.dropped_stale + inference_stats.dropped_overflow;
+    
+    struct load_shedder_stats shed_stats;
+    load_shedder_get_stats(&filter->shedder, &shed_stats);
+    stats->load_level = (uint32_t)shed_stats.level;
+    stats->load_level_max = (uint32_t)shed_stats.max_level;
+    stats->load_escalations = shed_stats.escalations;
 }
 
 struct obs_source_info ai_transcription_filter_info = {
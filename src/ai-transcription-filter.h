@@ -0,0 +1,42 @@
+#pragma once
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The filter as seen by a host. OBS only needs the source info; the rest is
+// for hosts that drive the filter directly, such as the benchmark harness.
+
+extern struct obs_source_info ai_transcription_filter_info;
+
+// Called on the inference thread for every finished transcript right after
+// its raw text went on screen. `end_sample` is where the utterance ended in
+// the filter's 16kHz input, counting from the first sample it stored.
+typedef void (*ai_transcription_caption_cb)(void *param, const char *text, uint64_t end_sample);
+
+// Set before audio starts flowing
+void ai_transcription_set_caption_callback(void *data, ai_transcription_caption_cb callback,
+                                           void *param);
+
+// Progress through the pipeline, in 16kHz samples and speech segments.
+// The filter is idle once samples_pending is under one ingest chunk and
+// segments_pending is zero.
+struct ai_transcription_stats {
+    uint64_t samples_stored;  // taken from the audio thread into the ring
+    uint64_t samples_dropped; // the ring was full
+    uint64_t samples_pending; // stored but not yet through the VAD
+    uint64_t segments_queued;
+    uint64_t segments_pending; // queued or running
+    uint64_t segments_dropped; // stale or pushed out of a full queue
+    uint32_t load_level;       // current load shedding level (enum load_level)
+    uint32_t load_level_max;
+    uint64_t load_escalations; // times load shedding stepped down
+};
+
+void ai_transcription_get_stats(void *data, struct ai_transcription_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
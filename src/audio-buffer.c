@@ -1,15 +1,21 @@
 #include "audio-buffer.h"
+#include "audio-kernels.h"
 #include <media-io/audio-math.h>
 #include <util/bmem.h>
 #include <math.h>
 
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
 float* audio_buffer_convert_to_mono_float(struct obs_audio_data* audio, 
                                          struct audio_buffer_info* info) {
     if (!audio || !audio->data[0] || !info) {
         return NULL;
     }
     
-    uint32_t channels = audio_output_get_channels(obs_get_audio());
+    struct audio_buffer_info input_info = *info;
+    input_info.channels = (uint32_t)audio_output_get_channels(obs_get_audio());
     uint32_t frames = audio->frames;
     
     // Allocate buffer for mono float data
@@ -18,60 +24,7 @@ float* audio_buffer_convert_to_mono_float(struct obs_audio_data* audio,
         return NULL;
     }
     
-    // Convert based on input format
-    if (info->format == AUDIO_FORMAT_FLOAT) {
-        float** input_data = (float**)audio->data;
-        
-        if (channels == 1) {
-            // Already mono, just copy
-            memcpy(mono_buffer, input_data[0], frames * sizeof(float));
-        } else {
-            // Mix down to mono by averaging channels
-            for (uint32_t i = 0; i < frames; i++) {
-                float sample_sum = 0.0f;
-                for (uint32_t c = 0; c < channels; c++) {
-                    sample_sum += input_data[c][i];
-                }
-                mono_buffer[i] = sample_sum / (float)channels;
-            }
-        }
-    } else if (info->format == AUDIO_FORMAT_16BIT) {
-        int16_t** input_data = (int16_t**)audio->data;
-        
-        if (channels == 1) {
-            // Convert 16-bit to float
-            for (uint32_t i = 0; i < frames; i++) {
-                mono_buffer[i] = (float)input_data[0][i] / 32768.0f;
-            }
-        } else {
-            // Mix down and convert
-            for (uint32_t i = 0; i < frames; i++) {
-                float sample_sum = 0.0f;
-                for (uint32_t c = 0; c < channels; c++) {
-                    sample_sum += (float)input_data[c][i] / 32768.0f;
-                }
-                mono_buffer[i] = sample_sum / (float)channels;
-            }
-        }
-    } else if (info->format == AUDIO_FORMAT_32BIT) {
-        int32_t** input_data = (int32_t**)audio->data;
-        
-        if (channels == 1) {
-            // Convert 32-bit to float
-            for (uint32_t i = 0; i < frames; i++) {
-                mono_buffer[i] = (float)input_data[0][i] / 2147483648.0f;
-            }
-        } else {
-            // Mix down and convert
-            for (uint32_t i = 0; i < frames; i++) {
-                float sample_sum = 0.0f;
-                for (uint32_t c = 0; c < channels; c++) {
-                    sample_sum += (float)input_data[c][i] / 2147483648.0f;
-                }
-                mono_buffer[i] = sample_sum / (float)channels;
-            }
-        }
-    } else {
+    if (!audio_buffer_mix_to_mono(audio, &input_info, 0, frames, mono_buffer)) {
         // Unsupported format
         bfree(mono_buffer);
         return NULL;
@@ -80,6 +33,52 @@ float* audio_buffer_convert_to_mono_float(struct obs_audio_data* audio,
     return mono_buffer;
 }
 
+bool audio_buffer_mix_to_mono(const struct obs_audio_data* audio,
+                              const struct audio_buffer_info* info,
+                              uint32_t offset, uint32_t frames, float* dst) {
+    if (!audio || !audio->data[0] || !info || !dst ||
+        info->channels == 0 || info->channels > MAX_AV_PLANES) {
+        return false;
+    }
+    
+    const struct audio_kernels* kernels = audio_kernels_get();
+    uint32_t channels = info->channels;
+    
+    // OBS hands filters planar data, so the packed and planar enum values
+    // describe the same layout here
+    switch (info->format) {
+    case AUDIO_FORMAT_FLOAT:
+    case AUDIO_FORMAT_FLOAT_PLANAR: {
+        const float* input_data[MAX_AV_PLANES];
+        for (uint32_t c = 0; c < channels; c++) {
+            input_data[c] = (const float*)audio->data[c] + offset;
+        }
+        kernels->mix_float(input_data, channels, dst, frames);
+        return true;
+    }
+    case AUDIO_FORMAT_16BIT:
+    case AUDIO_FORMAT_16BIT_PLANAR: {
+        const int16_t* input_data[MAX_AV_PLANES];
+        for (uint32_t c = 0; c < channels; c++) {
+            input_data[c] = (const int16_t*)audio->data[c] + offset;
+        }
+        kernels->mix_s16(input_data, channels, dst, frames);
+        return true;
+    }
+    case AUDIO_FORMAT_32BIT:
+    case AUDIO_FORMAT_32BIT_PLANAR: {
+        const int32_t* input_data[MAX_AV_PLANES];
+        for (uint32_t c = 0; c < channels; c++) {
+            input_data[c] = (const int32_t*)audio->data[c] + offset;
+        }
+        kernels->mix_s32(input_data, channels, dst, frames);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
 void audio_buffer_apply_silence_detection(float* audio_data, size_t sample_count, 
                                          float threshold_db, bool* is_silence_out) {
     if (!audio_data || sample_count == 0 || !is_silence_out) {
@@ -88,11 +87,7 @@ void audio_buffer_apply_silence_detection(float* audio_data, size_t sample_count
     }
     
     // Calculate RMS (Root Mean Square) of the audio
-    float rms_sum = 0.0f;
-    for (size_t i = 0; i < sample_count; i++) {
-        float sample = audio_data[i];
-        rms_sum += sample * sample;
-    }
+    float rms_sum = audio_kernels_get()->sum_squares(audio_data, sample_count);
     
     float rms = sqrtf(rms_sum / (float)sample_count);
     
@@ -104,4 +99,187 @@ void audio_buffer_apply_silence_detection(float* audio_data, size_t sample_count
     
     // Check if below silence threshold
     *is_silence_out = (rms_db < threshold_db);
-}
\ No newline at end of file
+}
+
+#define RESAMPLER_TAPS 64           // taps per polyphase branch, at the input rate
+#define RESAMPLER_BLOCK 1024        // input frames staged per inner iteration
+#define RESAMPLER_MAX_PHASES 1024
+#define RESAMPLER_CUTOFF 0.45f      // passband edge as a fraction of the lower rate
+#define RESAMPLER_KAISER_BETA 7.0   // roughly 70 dB stopband attenuation
+
+struct audio_resampler {
+    uint32_t input_rate;
+    uint32_t output_rate;
+    uint32_t up;   // interpolation factor L
+    uint32_t down; // decimation factor M
+    
+    float* coeffs; // up branches of RESAMPLER_TAPS reversed taps
+    
+    // Input history. The window for the next output starts at `pos`, and
+    // `phase` selects the branch of the polyphase filter.
+    float* history;
+    size_t history_len;
+    size_t pos;
+    uint32_t phase;
+};
+
+static uint32_t gcd_u32(uint32_t a, uint32_t b) {
+    while (b != 0) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Zeroth-order modified Bessel function of the first kind, for the Kaiser window
+static double bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < 1e-12 * sum) break;
+    }
+    return sum;
+}
+
+static void resampler_design(struct audio_resampler* r) {
+    const uint32_t up = r->up;
+    const size_t length = (size_t)up * RESAMPLER_TAPS;
+    const double center = (double)(length - 1) / 2.0;
+    
+    // Cutoff in cycles per sample at the interpolated rate (input_rate * up)
+    uint32_t lower_rate = r->output_rate < r->input_rate ? r->output_rate : r->input_rate;
+    double cutoff = RESAMPLER_CUTOFF * (double)lower_rate / ((double)r->input_rate * up);
+    double window_norm = bessel_i0(RESAMPLER_KAISER_BETA);
+    
+    for (uint32_t p = 0; p < up; p++) {
+        float* branch = r->coeffs + (size_t)p * RESAMPLER_TAPS;
+        double branch_sum = 0.0;
+        
+        for (uint32_t j = 0; j < RESAMPLER_TAPS; j++) {
+            size_t n = (size_t)p + (size_t)j * up;
+            double t = (double)n - center;
+            double x = 2.0 * cutoff * t;
+            double sinc = fabs(x) < 1e-12 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            double ratio = t / (center + 0.5);
+            double window = bessel_i0(RESAMPLER_KAISER_BETA * sqrt(fmax(0.0, 1.0 - ratio * ratio))) /
+                            window_norm;
+            double h = 2.0 * cutoff * sinc * window;
+            
+            // Stored reversed so each output is a forward dot product over history
+            branch[RESAMPLER_TAPS - 1 - j] = (float)h;
+            branch_sum += h;
+        }
+        
+        // Unity DC gain on every branch avoids a ripple at the phase period
+        if (branch_sum != 0.0) {
+            for (uint32_t j = 0; j < RESAMPLER_TAPS; j++) {
+                branch[j] = (float)(branch[j] / branch_sum);
+            }
+        }
+    }
+}
+
+struct audio_resampler* audio_resampler_create(uint32_t input_rate, uint32_t output_rate) {
+    if (input_rate == 0 || output_rate == 0) {
+        return NULL;
+    }
+    
+    uint32_t g = gcd_u32(input_rate, output_rate);
+    uint32_t up = output_rate / g;
+    uint32_t down = input_rate / g;
+    if (up > RESAMPLER_MAX_PHASES) {
+        blog(LOG_ERROR, "Resampler: unsupported ratio %u -> %u Hz", input_rate, output_rate);
+        return NULL;
+    }
+    
+    struct audio_resampler* r = bzalloc(sizeof(struct audio_resampler));
+    r->input_rate = input_rate;
+    r->output_rate = output_rate;
+    r->up = up;
+    r->down = down;
+    r->coeffs = bmalloc((size_t)up * RESAMPLER_TAPS * sizeof(float));
+    r->history = bmalloc((RESAMPLER_TAPS + RESAMPLER_BLOCK) * sizeof(float));
+    
+    resampler_design(r);
+    audio_resampler_reset(r);
+    
+    blog(LOG_INFO, "Resampler: %u -> %u Hz (L=%u, M=%u, %d taps/phase)",
+         input_rate, output_rate, up, down, RESAMPLER_TAPS);
+    return r;
+}
+
+void audio_resampler_destroy(struct audio_resampler* resampler) {
+    if (!resampler) return;
+    
+    bfree(resampler->coeffs);
+    bfree(resampler->history);
+    bfree(resampler);
+}
+
+void audio_resampler_reset(struct audio_resampler* resampler) {
+    if (!resampler) return;
+    
+    // Start from silence so the first outputs ramp in instead of clicking
+    memset(resampler->history, 0, (RESAMPLER_TAPS - 1) * sizeof(float));
+    resampler->history_len = RESAMPLER_TAPS - 1;
+    resampler->pos = 0;
+    resampler->phase = 0;
+}
+
+size_t audio_resampler_max_output(const struct audio_resampler* resampler,
+                                  size_t input_frames) {
+    if (!resampler) return 0;
+    
+    return (size_t)(((uint64_t)input_frames * resampler->up) / resampler->down) + 2;
+}
+
+size_t audio_resampler_process(struct audio_resampler* resampler,
+                               const float* input, size_t input_frames,
+                               float* output, size_t output_capacity) {
+    if (!resampler || !input || !output) {
+        return 0;
+    }
+    
+    struct audio_resampler* r = resampler;
+    const struct audio_kernels* kernels = audio_kernels_get();
+    size_t produced = 0;
+    
+    while (input_frames > 0) {
+        size_t chunk = input_frames;
+        if (chunk > RESAMPLER_BLOCK) {
+            chunk = RESAMPLER_BLOCK;
+        }
+        
+        memcpy(r->history + r->history_len, input, chunk * sizeof(float));
+        r->history_len += chunk;
+        input += chunk;
+        input_frames -= chunk;
+        
+        // Emit every output whose full window is available
+        while (r->pos + RESAMPLER_TAPS <= r->history_len && produced < output_capacity) {
+            const float* branch = r->coeffs + (size_t)r->phase * RESAMPLER_TAPS;
+            output[produced++] = kernels->dot(r->history + r->pos, branch, RESAMPLER_TAPS);
+            
+            r->phase += r->down;
+            r->pos += r->phase / r->up;
+            r->phase %= r->up;
+        }
+        
+        // Keep only the samples later windows still need. If the caller's
+        // output buffer ran out, drop the backlog rather than overflow.
+        size_t keep_from = r->pos < r->history_len ? r->pos : r->history_len;
+        if (r->history_len - keep_from > RESAMPLER_TAPS - 1) {
+            keep_from = r->history_len - (RESAMPLER_TAPS - 1);
+            r->pos = keep_from;
+        }
+        size_t remaining = r->history_len - keep_from;
+        memmove(r->history, r->history + keep_from, remaining * sizeof(float));
+        r->history_len = remaining;
+        r->pos -= keep_from;
+    }
+    
+    return produced;
+}
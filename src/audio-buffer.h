@@ -2,6 +2,10 @@
 
 #include <obs-module.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct audio_buffer_info {
     uint32_t sample_rate;
     uint32_t channels;
@@ -10,5 +14,38 @@ struct audio_buffer_info {
 
 float* audio_buffer_convert_to_mono_float(struct obs_audio_data* audio, 
                                          struct audio_buffer_info* info);
+
+// Downmixes `frames` frames starting at `offset` into a caller-supplied buffer.
+// Unlike audio_buffer_convert_to_mono_float this never allocates and takes the
+// channel count from `info`, so it is safe to call from the audio thread.
+bool audio_buffer_mix_to_mono(const struct obs_audio_data* audio,
+                              const struct audio_buffer_info* info,
+                              uint32_t offset, uint32_t frames, float* dst);
 void audio_buffer_apply_silence_detection(float* audio_data, size_t sample_count, 
-                                         float threshold_db, bool* is_silence_out);
\ No newline at end of file
+                                         float threshold_db, bool* is_silence_out);
+
+// Streaming band-limited resampler (polyphase windowed-sinc FIR).
+//
+// Converts between any two integer rates with a rational ratio, e.g. the
+// OBS output rate (44.1 or 48 kHz) down to the 16 kHz Whisper consumes. All
+// state and tables are allocated in audio_resampler_create, so processing is
+// allocation-free and can run on the audio thread one packet at a time.
+struct audio_resampler;
+
+struct audio_resampler* audio_resampler_create(uint32_t input_rate, uint32_t output_rate);
+void audio_resampler_destroy(struct audio_resampler* resampler);
+void audio_resampler_reset(struct audio_resampler* resampler);
+
+// Upper bound on the samples produced by one call with `input_frames` frames
+size_t audio_resampler_max_output(const struct audio_resampler* resampler,
+                                  size_t input_frames);
+
+// Consumes all of `input` and returns the number of samples written to
+// `output`. `output_capacity` must be at least audio_resampler_max_output.
+size_t audio_resampler_process(struct audio_resampler* resampler,
+                               const float* input, size_t input_frames,
+                               float* output, size_t output_capacity);
+
+#ifdef __cplusplus
+}
+#endif
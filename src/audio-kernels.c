@@ -0,0 +1,430 @@
+#include "audio-kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define AUDIO_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AUDIO_KERNELS_TARGET_AVX2
+#else
+#define AUDIO_KERNELS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#define S16_SCALE (1.0f / 32768.0f)
+#define S32_SCALE (1.0f / 2147483648.0f)
+
+// Averaging by a power-of-two channel count can use the exact reciprocal;
+// anything else has to divide to stay bit-identical to the scalar code.
+static inline bool channels_pow2(uint32_t channels) {
+    return (channels & (channels - 1)) == 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Scalar                                                                    */
+
+static void scalar_mix_float(const float* const* src, uint32_t channels, float* dst, size_t frames) {
+    if (channels == 1) {
+        memcpy(dst, src[0], frames * sizeof(float));
+        return;
+    }
+    
+    const float divisor = (float)channels;
+    const float recip = 1.0f / divisor;
+    const bool pow2 = channels_pow2(channels);
+    
+    for (size_t i = 0; i < frames; i++) {
+        float sum = 0.0f;
+        for (uint32_t c = 0; c < channels; c++) {
+            sum += src[c][i];
+        }
+        dst[i] = pow2 ? sum * recip : sum / divisor;
+    }
+}
+
+static void scalar_mix_s16(const int16_t* const* src, uint32_t channels, float* dst, size_t frames) {
+    const float divisor = (float)channels;
+    const float recip = 1.0f / divisor;
+    const bool pow2 = channels_pow2(channels);
+    
+    for (size_t i = 0; i < frames; i++) {
+        float sum = 0.0f;
+        for (uint32_t c = 0; c < channels; c++) {
+            sum += (float)src[c][i] * S16_SCALE;
+        }
+        dst[i] = pow2 ? sum * recip : sum / divisor;
+    }
+}
+
+static void scalar_mix_s32(const int32_t* const* src, uint32_t channels, float* dst, size_t frames) {
+    const float divisor = (float)channels;
+    const float recip = 1.0f / divisor;
+    const bool pow2 = channels_pow2(channels);
+    
+    for (size_t i = 0; i < frames; i++) {
+        float sum = 0.0f;
+        for (uint32_t c = 0; c < channels; c++) {
+            sum += (float)src[c][i] * S32_SCALE;
+        }
+        dst[i] = pow2 ? sum * recip : sum / divisor;
+    }
+}
+
+static float scalar_sum_squares(const float* src, size_t count) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        sum += src[i] * src[i];
+    }
+    return sum;
+}
+
+static float scalar_dot(const float* a, const float* b, size_t count) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static const struct audio_kernels scalar_kernels = {
+    "scalar",
+    scalar_mix_float,
+    scalar_mix_s16,
+    scalar_mix_s32,
+    scalar_sum_squares,
+    scalar_dot,
+};
+
+#ifdef AUDIO_KERNELS_X86
+
+/* ------------------------------------------------------------------------- */
+/* SSE2 (baseline on x86-64)                                                 */
+
+static inline __m128 sse2_average(__m128 sum, uint32_t channels) {
+    if (channels_pow2(channels)) {
+        return _mm_mul_ps(sum, _mm_set1_ps(1.0f / (float)channels));
+    }
+    return _mm_div_ps(sum, _mm_set1_ps((float)channels));
+}
+
+static inline __m128 sse2_load_s16(const int16_t* src) {
+    __m128i raw = _mm_loadl_epi64((const __m128i*)src);
+    // Sign-extend the four 16-bit samples into 32-bit lanes
+    __m128i wide = _mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16);
+    return _mm_cvtepi32_ps(wide);
+}
+
+static void sse2_mix_float(const float* const* src, uint32_t channels, float* dst, size_t frames) {
+    if (channels == 1) {
+        memcpy(dst, src[0], frames * sizeof(float));
+        return;
+    }
+    
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128 sum = _mm_setzero_ps();
+        for (uint32_t c = 0; c < channels; c++) {
+            sum = _mm_add_ps(sum, _mm_loadu_ps(src[c] + i));
+        }
+        _mm_storeu_ps(dst + i, sse2_average(sum, channels));
+    }
+    
+    if (i < frames) {
+        const float* tail[MAX_AV_PLANES];
+        for (uint32_t c = 0; c < channels; c++) {
+            tail[c] = src[c] + i;
+        }
+        scalar_mix_float(tail, channels, dst + i, frames - i);
+    }
+}
+
+static void sse2_mix_s16(const int16_t* const* src, uint32_t channels, float* dst, size_t frames) {
+    const __m128 scale = _mm_set1_ps(S16_SCALE);
+    
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128 sum = _mm_setzero_ps();
+        for (uint32_t c = 0; c < channels; c++) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(sse2_load_s16(src[c] + i), scale));
+        }
+        _mm_storeu_ps(dst + i, sse2_average(sum, channels));
+    }
+    
+    if (i < frames) {
+        const int16_t* tail[MAX_AV_PLANES];
+        for (uint32_t c = 0; c < channels; c++) {
+            tail[c] = src[c] + i;
+        }
+        scalar_mix_s16(tail, channels, dst + i, frames - i);
+    }
+}
+
+static void sse2_mix_s32(const int32_t* const* src, uint32_t channels, float* dst, size_t frames) {
+    const __m128 scale = _mm_set1_ps(S32_SCALE);
+    
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128 sum = _mm_setzero_ps();
+        for (uint32_t c = 0; c < channels; c++) {
+            __m128 s = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(src[c] + i)));
+            sum = _mm_add_ps(sum, _mm_mul_ps(s, scale));
+        }
+        _mm_storeu_ps(dst + i, sse2_average(sum, channels));
+    }
+    
+    if (i < frames) {
+        const int32_t* tail[MAX_AV_PLANES];
+        for (uint32_t c = 0; c < channels; c++) {
+            tail[c] = src[c] + i;
+        }
+        scalar_mix_s32(tail, channels, dst + i, frames - i);
+    }
+}
+
+static float sse2_sum_squares(const float* src, size_t count) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128 a = _mm_loadu_ps(src + i);
+        __m128 b = _mm_loadu_ps(src + i + 4);
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(a, a));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(b, b));
+    }
+    
+    float lanes[4];
+    _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+    float sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    
+    for (; i < count; i++) {
+        sum += src[i] * src[i];
+    }
+    return sum;
+}
+
+static float sse2_dot(const float* a, const float* b, size_t count) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    
+    float lanes[4];
+    _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+    float sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    
+    for (; i < count; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static const struct audio_kernels sse2_kernels = {
+    "sse2",
+    sse2_mix_float,
+    sse2_mix_s16,
+    sse2_mix_s32,
+    sse2_sum_squares,
+    sse2_dot,
+};
+
+/* ------------------------------------------------------------------------- */
+/* AVX2                                                                      */
+
+AUDIO_KERNELS_TARGET_AVX2
+static inline __m256 avx2_average(__m256 sum, uint32_t channels) {
+    if (channels_pow2(channels)) {
+        return _mm256_mul_ps(sum, _mm256_set1_ps(1.0f / (float)channels));
+    }
+    return _mm256_div_ps(sum, _mm256_set1_ps((float)channels));
+}
+
+AUDIO_KERNELS_TARGET_AVX2
+static void avx2_mix_float(const float* const* src, uint32_t channels, float* dst, size_t frames) {
+    if (channels == 1) {
+        memcpy(dst, src[0], frames * sizeof(float));
+        return;
+    }
+    
+    size_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        for (uint32_t c = 0; c < channels; c++) {
+            sum = _mm256_add_ps(sum, _mm256_loadu_ps(src[c] + i));
+        }
+        _mm256_storeu_ps(dst + i, avx2_average(sum, channels));
+    }
+    
+    if (i < frames) {
+        const float* tail[MAX_AV_PLANES];
+        for (uint32_t c = 0; c < channels; c++) {
+            tail[c] = src[c] + i;
+        }
+        sse2_mix_float(tail, channels, dst + i, frames - i);
+    }
+}
+
+AUDIO_KERNELS_TARGET_AVX2
+static void avx2_mix_s16(const int16_t* const* src, uint32_t channels, float* dst, size_t frames) {
+    const __m256 scale = _mm256_set1_ps(S16_SCALE);
+    
+    size_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        for (uint32_t c = 0; c < channels; c++) {
+            __m128i raw = _mm_loadu_si128((const __m128i*)(src[c] + i));
+            __m256 s = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(raw));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(s, scale));
+        }
+        _mm256_storeu_ps(dst + i, avx2_average(sum, channels));
+    }
+    
+    if (i < frames) {
+        const int16_t* tail[MAX_AV_PLANES];
+        for (uint32_t c = 0; c < channels; c++) {
+            tail[c] = src[c] + i;
+        }
+        sse2_mix_s16(tail, channels, dst + i, frames - i);
+    }
+}
+
+AUDIO_KERNELS_TARGET_AVX2
+static void avx2_mix_s32(const int32_t* const* src, uint32_t channels, float* dst, size_t frames) {
+    const __m256 scale = _mm256_set1_ps(S32_SCALE);
+    
+    size_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        for (uint32_t c = 0; c < channels; c++) {
+            __m256i raw = _mm256_loadu_si256((const __m256i*)(src[c] + i));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_cvtepi32_ps(raw), scale));
+        }
+        _mm256_storeu_ps(dst + i, avx2_average(sum, channels));
+    }
+    
+    if (i < frames) {
+        const int32_t* tail[MAX_AV_PLANES];
+        for (uint32_t c = 0; c < channels; c++) {
+            tail[c] = src[c] + i;
+        }
+        sse2_mix_s32(tail, channels, dst + i, frames - i);
+    }
+}
+
+AUDIO_KERNELS_TARGET_AVX2
+static float avx2_sum_squares(const float* src, size_t count) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256 a = _mm256_loadu_ps(src + i);
+        __m256 b = _mm256_loadu_ps(src + i + 8);
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(a, a));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(b, b));
+    }
+    
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    float lanes[4];
+    _mm_storeu_ps(lanes, half);
+    float sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    
+    return sum + sse2_sum_squares(src + i, count - i);
+}
+
+AUDIO_KERNELS_TARGET_AVX2
+static float avx2_dot(const float* a, const float* b, size_t count) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+    }
+    
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    float lanes[4];
+    _mm_storeu_ps(lanes, half);
+    float sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    
+    return sum + sse2_dot(a + i, b + i, count - i);
+}
+
+static const struct audio_kernels avx2_kernels = {
+    "avx2",
+    avx2_mix_float,
+    avx2_mix_s16,
+    avx2_mix_s32,
+    avx2_sum_squares,
+    avx2_dot,
+};
+
+static bool cpu_has_avx2(void) {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx) return false;
+    
+    // The OS must save YMM state across context switches
+    if ((_xgetbv(0) & 0x6) != 0x6) return false;
+    
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // AUDIO_KERNELS_X86
+
+/* ------------------------------------------------------------------------- */
+/* Dispatch                                                                  */
+
+static const struct audio_kernels* active_kernels = NULL;
+
+void audio_kernels_init(void) {
+    const struct audio_kernels* selected = &scalar_kernels;
+
+#ifdef AUDIO_KERNELS_X86
+    selected = cpu_has_avx2() ? &avx2_kernels : &sse2_kernels;
+#endif
+
+    active_kernels = selected;
+    blog(LOG_INFO, "Audio kernels: using %s", selected->name);
+}
+
+const struct audio_kernels* audio_kernels_get(void) {
+    if (!active_kernels) {
+        audio_kernels_init();
+    }
+    return active_kernels;
+}
+
+const struct audio_kernels* audio_kernels_scalar(void) {
+    return &scalar_kernels;
+}
+
+size_t audio_kernels_supported(const struct audio_kernels** tables, size_t max) {
+    size_t count = 0;
+    if (count < max) tables[count++] = &scalar_kernels;
+
+#ifdef AUDIO_KERNELS_X86
+    if (count < max) tables[count++] = &sse2_kernels;
+    if (cpu_has_avx2() && count < max) tables[count++] = &avx2_kernels;
+#endif
+
+    return count;
+}
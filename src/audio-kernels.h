@@ -0,0 +1,46 @@
+#pragma once
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Vectorized inner loops for the audio path.
+//
+// Every table's mixes are bit-identical to the original scalar loops in
+// audio-buffer.c: channels are summed in order starting from 0.0f, integer
+// samples are scaled by an exact power-of-two reciprocal and the channel
+// average uses a true divide unless the channel count is a power of two. The
+// reductions sum in lanes, so they only agree to rounding.
+// bench/audio-kernels-test checks every table against the scalar one.
+struct audio_kernels {
+    const char* name;
+
+    // Average `channels` planar inputs into dst (frames samples each)
+    void (*mix_float)(const float* const* src, uint32_t channels, float* dst, size_t frames);
+    void (*mix_s16)(const int16_t* const* src, uint32_t channels, float* dst, size_t frames);
+    void (*mix_s32)(const int32_t* const* src, uint32_t channels, float* dst, size_t frames);
+
+    // Sum of squared samples, the shared RMS/energy pass
+    float (*sum_squares)(const float* src, size_t count);
+
+    // Inner product, used by the resampler's FIR taps
+    float (*dot)(const float* a, const float* b, size_t count);
+};
+
+// Picks the best table for the running CPU. Called from obs_module_load; the
+// getter falls back to calling it lazily.
+void audio_kernels_init(void);
+const struct audio_kernels* audio_kernels_get(void);
+
+// Always available, used as the fallback and as a benchmark baseline.
+const struct audio_kernels* audio_kernels_scalar(void);
+
+// Fills `tables` with every table the running CPU can execute, scalar first,
+// and returns how many were written. Used by the kernel tests.
+size_t audio_kernels_supported(const struct audio_kernels** tables, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
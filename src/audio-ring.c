@@ -0,0 +1,131 @@
+#include "audio-ring.h"
+#include <util/bmem.h>
+#include <util/threading.h>
+
+// Free-running positions are stored as long for os_atomic and compared as
+// unsigned long, so the difference stays correct across wrap-around.
+static inline unsigned long ring_load(const volatile long* pos) {
+    return (unsigned long)os_atomic_load_long(pos);
+}
+
+static inline void ring_store(volatile long* pos, unsigned long value) {
+    os_atomic_set_long(pos, (long)value);
+}
+
+bool audio_ring_init(struct audio_ring* ring, size_t min_capacity) {
+    if (!ring || min_capacity == 0 || min_capacity > ((size_t)1 << 30)) {
+        return false;
+    }
+    
+    size_t capacity = 1;
+    while (capacity < min_capacity) {
+        capacity <<= 1;
+    }
+    
+    memset(ring, 0, sizeof(*ring));
+    ring->data = bzalloc(capacity * sizeof(float));
+    if (!ring->data) {
+        return false;
+    }
+    
+    ring->capacity = capacity;
+    ring->mask = capacity - 1;
+    return true;
+}
+
+void audio_ring_free(struct audio_ring* ring) {
+    if (!ring) return;
+    
+    bfree(ring->data);
+    memset(ring, 0, sizeof(*ring));
+}
+
+size_t audio_ring_write(struct audio_ring* ring, const float* samples, size_t count) {
+    if (!ring->data || !samples || count == 0) {
+        return 0;
+    }
+    
+    unsigned long write_pos = ring_load(&ring->write_pos);
+    unsigned long read_pos = ring_load(&ring->read_pos);
+    size_t used = (size_t)(write_pos - read_pos);
+    size_t free_space = ring->capacity - used;
+    
+    size_t to_write = count;
+    if (to_write > free_space) {
+        // The consumer owns everything behind write_pos, so the newest samples
+        // are the only ones the producer may drop without a lock.
+        to_write = free_space;
+        os_atomic_set_long(&ring->overrun_samples,
+                           os_atomic_load_long(&ring->overrun_samples) + (long)(count - to_write));
+        os_atomic_inc_long(&ring->overrun_events);
+    }
+    
+    if (to_write > 0) {
+        size_t offset = write_pos & ring->mask;
+        size_t first = ring->capacity - offset;
+        if (first > to_write) {
+            first = to_write;
+        }
+        
+        memcpy(ring->data + offset, samples, first * sizeof(float));
+        if (to_write > first) {
+            memcpy(ring->data, samples + first, (to_write - first) * sizeof(float));
+        }
+        
+        // Publish the samples only after they have been copied
+        ring_store(&ring->write_pos, write_pos + (unsigned long)to_write);
+    }
+    
+    size_t fill = used + to_write;
+    if ((long)fill > os_atomic_load_long(&ring->high_water_mark)) {
+        os_atomic_set_long(&ring->high_water_mark, (long)fill);
+    }
+    
+    return to_write;
+}
+
+size_t audio_ring_available(const struct audio_ring* ring) {
+    if (!ring->data) return 0;
+    
+    return (size_t)(ring_load(&ring->write_pos) - ring_load(&ring->read_pos));
+}
+
+size_t audio_ring_peek(const struct audio_ring* ring, float* dst, size_t count) {
+    size_t available = audio_ring_available(ring);
+    if (count > available) {
+        count = available;
+    }
+    
+    if (dst && count > 0) {
+        size_t offset = ring_load(&ring->read_pos) & ring->mask;
+        size_t first = ring->capacity - offset;
+        if (first > count) {
+            first = count;
+        }
+        
+        memcpy(dst, ring->data + offset, first * sizeof(float));
+        if (count > first) {
+            memcpy(dst + first, ring->data, (count - first) * sizeof(float));
+        }
+    }
+    
+    return count;
+}
+
+size_t audio_ring_read(struct audio_ring* ring, float* dst, size_t count) {
+    count = audio_ring_peek(ring, dst, count);
+    if (count > 0) {
+        ring_store(&ring->read_pos, ring_load(&ring->read_pos) + (unsigned long)count);
+    }
+    return count;
+}
+
+size_t audio_ring_skip(struct audio_ring* ring, size_t count) {
+    return audio_ring_read(ring, NULL, count);
+}
+
+void audio_ring_clear(struct audio_ring* ring) {
+    if (!ring->data) return;
+    
+    ring_store(&ring->read_pos, ring_load(&ring->write_pos));
+}
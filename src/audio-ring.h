@@ -0,0 +1,46 @@
+#pragma once
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Single-producer/single-consumer ring of mono float samples.
+//
+// The producer is the OBS audio thread (ai_transcription_filter_audio) and
+// the consumer is the transcription worker. Storage is allocated once in
+// audio_ring_init; neither side ever allocates, locks or waits on the other.
+// Positions are free-running counters published through os_atomic, so the
+// capacity must stay below 2^31 samples.
+struct audio_ring {
+    float* data;
+    size_t capacity; // always a power of two
+    size_t mask;
+
+    volatile long write_pos; // advanced by the producer only
+    volatile long read_pos;  // advanced by the consumer only
+
+    // Statistics, written by the producer and readable from any thread
+    volatile long overrun_samples; // samples dropped because the ring was full
+    volatile long overrun_events;  // number of writes that dropped samples
+    volatile long high_water_mark; // largest fill level observed, in samples
+};
+
+bool audio_ring_init(struct audio_ring* ring, size_t min_capacity);
+void audio_ring_free(struct audio_ring* ring);
+
+// Producer side. Returns the number of samples stored; anything that does not
+// fit is dropped and counted as an overrun.
+size_t audio_ring_write(struct audio_ring* ring, const float* samples, size_t count);
+
+// Consumer side.
+size_t audio_ring_available(const struct audio_ring* ring);
+size_t audio_ring_peek(const struct audio_ring* ring, float* dst, size_t count);
+size_t audio_ring_read(struct audio_ring* ring, float* dst, size_t count);
+size_t audio_ring_skip(struct audio_ring* ring, size_t count);
+void audio_ring_clear(struct audio_ring* ring);
+
+#ifdef __cplusplus
+}
+#endif
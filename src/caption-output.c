@@ -0,0 +1,347 @@
+#include "caption-output.h"
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/task.h>
+#include <util/threading.h>
+#include <pthread.h>
+
+#define LOOKUP_RETRY_NS 1000000000ULL // a missing source is looked for once a second
+#define CAPTION_QUEUE_SIZE 16          // captions held for their display time
+
+static const char* const invalidating_signals[] = {
+    "source_create",
+    "source_remove",
+    "source_rename",
+};
+
+struct caption_entry {
+    struct dstr text;
+    float confidence;
+    uint64_t set_ns;
+    uint64_t due_ns;
+};
+
+struct caption_output {
+    os_task_queue_t* queue;
+    os_event_t* stop;
+    volatile bool stopping;
+    struct latency_histogram* latency;
+    
+    // Guarded by the mutex: settings, the captions waiting for their display
+    // time (oldest first, due times never decreasing), and whether a task is
+    // queued to show them
+    pthread_mutex_t mutex;
+    char* source_name;
+    bool show_confidence;
+    uint64_t interval_ns;
+    uint64_t delay_ns;
+    struct caption_entry captions[CAPTION_QUEUE_SIZE];
+    size_t head;
+    size_t count;
+    bool scheduled;
+    bool invalidated; // the name may refer to a different source now
+    struct caption_output_stats stats;
+    
+    // Output task only
+    obs_weak_source_t* source;
+    uint64_t missing_ns; // last lookup that found nothing
+    struct dstr text;
+    struct dstr rendered;
+    struct dstr shown; // what the source displays, as far as we know
+    uint64_t shown_ns;
+    obs_data_t* settings;
+};
+
+// OBS dstr leaves the array NULL when empty
+static const char* dstr_text(const struct dstr* str) {
+    return str->array ? str->array : "";
+}
+
+static void swap_dstr(struct dstr* a, struct dstr* b) {
+    struct dstr swap = *a;
+    *a = *b;
+    *b = swap;
+}
+
+// Global source signals: anything that could change which source our name
+// resolves to drops the cached reference
+static void caption_output_source_signal(void* param, calldata_t* data) {
+    struct caption_output* output = param;
+    obs_source_t* source = calldata_ptr(data, "source");
+    const char* name = source ? obs_source_get_name(source) : NULL;
+    const char* new_name = calldata_string(data, "new_name");
+    const char* prev_name = calldata_string(data, "prev_name");
+    
+    pthread_mutex_lock(&output->mutex);
+    const char* ours = output->source_name;
+    if (ours && ((name && strcmp(name, ours) == 0) || (new_name && strcmp(new_name, ours) == 0) ||
+                 (prev_name && strcmp(prev_name, ours) == 0))) {
+        output->invalidated = true;
+    }
+    pthread_mutex_unlock(&output->mutex);
+}
+
+// The text source, with a reference for the caller, or NULL
+static obs_source_t* caption_output_resolve(struct caption_output* output, bool invalidated) {
+    if (invalidated) {
+        obs_weak_source_release(output->source);
+        output->source = NULL;
+        output->missing_ns = 0;
+    }
+    if (output->source) {
+        obs_source_t* source = obs_weak_source_get_source(output->source);
+        if (source) {
+            return source;
+        }
+        obs_weak_source_release(output->source);
+        output->source = NULL;
+    }
+    
+    uint64_t now = os_gettime_ns();
+    if (output->missing_ns && now - output->missing_ns < LOOKUP_RETRY_NS) {
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&output->mutex);
+    char* name = output->source_name ? bstrdup(output->source_name) : NULL;
+    output->stats.lookups++;
+    pthread_mutex_unlock(&output->mutex);
+    
+    obs_source_t* source = name ? obs_get_source_by_name(name) : NULL;
+    bfree(name);
+    if (!source) {
+        output->missing_ns = now;
+        return NULL;
+    }
+    
+    output->missing_ns = 0;
+    output->source = obs_source_get_weak_source(source);
+    dstr_free(&output->shown); // nothing is known about what a new source shows
+    return source;
+}
+
+// Renders and shows the caption in output->text. Runs on the output task.
+static void caption_output_show(struct caption_output* output, float confidence,
+                                bool show_confidence, bool invalidated, uint64_t ready_ns) {
+    obs_source_t* source = caption_output_resolve(output, invalidated);
+    if (!source) {
+        return;
+    }
+    
+    dstr_copy(&output->rendered, dstr_text(&output->text));
+    if (show_confidence) {
+        dstr_catf(&output->rendered, " (%.1f%%)", confidence * 100.0f);
+    }
+    
+    bool unchanged = output->shown.array &&
+                     strcmp(dstr_text(&output->shown), dstr_text(&output->rendered)) == 0;
+    if (!unchanged) {
+        obs_data_set_string(output->settings, "text", dstr_text(&output->rendered));
+        obs_source_update(source, output->settings);
+        swap_dstr(&output->shown, &output->rendered);
+        output->shown_ns = os_gettime_ns();
+        if (output->latency) {
+            latency_histogram_record(output->latency,
+                                     output->shown_ns > ready_ns ? output->shown_ns - ready_ns : 0);
+        }
+    }
+    obs_source_release(source);
+    
+    pthread_mutex_lock(&output->mutex);
+    if (unchanged) {
+        output->stats.unchanged++;
+    } else {
+        output->stats.shown++;
+    }
+    pthread_mutex_unlock(&output->mutex);
+}
+
+// Shows queued captions as they come due, at most one per display interval.
+// When several are due at once only the newest is shown.
+static void caption_output_task(void* param) {
+    struct caption_output* output = param;
+    
+    pthread_mutex_lock(&output->mutex);
+    while (output->count > 0 && !os_atomic_load_bool(&output->stopping)) {
+        uint64_t now = os_gettime_ns();
+        size_t due = 0;
+        while (due < output->count &&
+               output->captions[(output->head + due) % CAPTION_QUEUE_SIZE].due_ns <= now) {
+            due++;
+        }
+        
+        uint64_t wake_ns = 0;
+        if (due == 0) {
+            wake_ns = output->captions[output->head].due_ns;
+        } else if (output->shown_ns && now < output->shown_ns + output->interval_ns) {
+            wake_ns = output->shown_ns + output->interval_ns;
+        }
+        if (wake_ns > now) {
+            pthread_mutex_unlock(&output->mutex);
+            os_event_timedwait(output->stop, (unsigned long)((wake_ns - now + 999999) / 1000000));
+            pthread_mutex_lock(&output->mutex);
+            continue;
+        }
+        
+        output->stats.coalesced += due - 1;
+        output->head = (output->head + due - 1) % CAPTION_QUEUE_SIZE;
+        output->count -= due - 1;
+        
+        struct caption_entry* entry = &output->captions[output->head];
+        swap_dstr(&output->text, &entry->text);
+        float confidence = entry->confidence;
+        uint64_t ready_ns = entry->due_ns > entry->set_ns ? entry->due_ns : entry->set_ns;
+        output->head = (output->head + 1) % CAPTION_QUEUE_SIZE;
+        output->count--;
+        
+        bool show_confidence = output->show_confidence;
+        bool invalidated = output->invalidated;
+        output->invalidated = false;
+        pthread_mutex_unlock(&output->mutex);
+        
+        caption_output_show(output, confidence, show_confidence, invalidated, ready_ns);
+        
+        pthread_mutex_lock(&output->mutex);
+    }
+    output->scheduled = false;
+    pthread_mutex_unlock(&output->mutex);
+}
+
+struct caption_output* caption_output_create(struct latency_histogram* latency) {
+    struct caption_output* output = bzalloc(sizeof(struct caption_output));
+    
+    if (os_event_init(&output->stop, OS_EVENT_TYPE_MANUAL) != 0) {
+        blog(LOG_ERROR, "Caption output: Failed to create event");
+        bfree(output);
+        return NULL;
+    }
+    output->queue = os_task_queue_create();
+    if (!output->queue) {
+        blog(LOG_ERROR, "Caption output: Failed to create task queue");
+        os_event_destroy(output->stop);
+        bfree(output);
+        return NULL;
+    }
+    pthread_mutex_init(&output->mutex, NULL);
+    output->latency = latency;
+    output->settings = obs_data_create();
+    
+    signal_handler_t* signals = obs_get_signal_handler();
+    for (size_t i = 0; i < sizeof(invalidating_signals) / sizeof(invalidating_signals[0]); i++) {
+        signal_handler_connect(signals, invalidating_signals[i], caption_output_source_signal,
+                               output);
+    }
+    return output;
+}
+
+void caption_output_destroy(struct caption_output* output) {
+    if (!output) {
+        return;
+    }
+    
+    signal_handler_t* signals = obs_get_signal_handler();
+    for (size_t i = 0; i < sizeof(invalidating_signals) / sizeof(invalidating_signals[0]); i++) {
+        signal_handler_disconnect(signals, invalidating_signals[i], caption_output_source_signal,
+                                  output);
+    }
+    
+    // Cuts a task short in its display wait; queued ones return at once
+    os_atomic_set_bool(&output->stopping, true);
+    os_event_signal(output->stop);
+    os_task_queue_destroy(output->queue);
+    
+    obs_weak_source_release(output->source);
+    obs_data_release(output->settings);
+    for (size_t i = 0; i < CAPTION_QUEUE_SIZE; i++) {
+        dstr_free(&output->captions[i].text);
+    }
+    dstr_free(&output->text);
+    dstr_free(&output->rendered);
+    dstr_free(&output->shown);
+    bfree(output->source_name);
+    pthread_mutex_destroy(&output->mutex);
+    os_event_destroy(output->stop);
+    bfree(output);
+}
+
+void caption_output_configure(struct caption_output* output, const char* source_name,
+                              bool show_confidence, uint32_t min_interval_ms,
+                              uint32_t delay_ms) {
+    if (!output) {
+        return;
+    }
+    
+    bool enabled = source_name && *source_name;
+    
+    pthread_mutex_lock(&output->mutex);
+    if (!enabled || !output->source_name || strcmp(output->source_name, source_name) != 0) {
+        bfree(output->source_name);
+        output->source_name = enabled ? bstrdup(source_name) : NULL;
+        output->invalidated = true;
+    }
+    output->show_confidence = show_confidence;
+    output->interval_ns = (uint64_t)min_interval_ms * 1000000ULL;
+    output->delay_ns = (uint64_t)delay_ms * 1000000ULL;
+    pthread_mutex_unlock(&output->mutex);
+}
+
+void caption_output_set(struct caption_output* output, const char* text, float confidence,
+                        uint64_t capture_ns) {
+    if (!output) {
+        return;
+    }
+    
+    uint64_t now = os_gettime_ns();
+    
+    pthread_mutex_lock(&output->mutex);
+    if (!output->source_name) {
+        pthread_mutex_unlock(&output->mutex);
+        return;
+    }
+    
+    // A full queue loses its oldest caption, which would have been replaced
+    // soon anyway
+    output->stats.requested++;
+    if (output->count == CAPTION_QUEUE_SIZE) {
+        output->head = (output->head + 1) % CAPTION_QUEUE_SIZE;
+        output->count--;
+        output->stats.coalesced++;
+    }
+    
+    uint64_t due = output->delay_ns && capture_ns ? capture_ns + output->delay_ns : now;
+    if (output->count > 0) {
+        const struct caption_entry* last =
+            &output->captions[(output->head + output->count - 1) % CAPTION_QUEUE_SIZE];
+        if (due < last->due_ns) {
+            due = last->due_ns;
+        }
+    }
+    
+    struct caption_entry* entry =
+        &output->captions[(output->head + output->count) % CAPTION_QUEUE_SIZE];
+    dstr_copy(&entry->text, text ? text : "");
+    entry->confidence = confidence;
+    entry->set_ns = now;
+    entry->due_ns = due;
+    output->count++;
+    
+    bool schedule = !output->scheduled;
+    output->scheduled = true;
+    pthread_mutex_unlock(&output->mutex);
+    
+    if (schedule) {
+        os_task_queue_queue_task(output->queue, caption_output_task, output);
+    }
+}
+
+void caption_output_get_stats(struct caption_output* output, struct caption_output_stats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!output) {
+        return;
+    }
+    
+    pthread_mutex_lock(&output->mutex);
+    *stats = output->stats;
+    pthread_mutex_unlock(&output->mutex);
+}
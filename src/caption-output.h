@@ -0,0 +1,59 @@
+#pragma once
+
+#include <obs-module.h>
+#include "pipeline-stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Caption delivery to an OBS text source.
+//
+// caption_output_set only queues the caption; a task on the output's own
+// queue renders it and calls obs_source_update, so the inference and
+// correction threads never touch the source. Captions arriving faster than
+// the display interval replace each other, and an update that would render
+// the same string as the last one is skipped.
+//
+// With a delay, each caption is held until the capture time of its speech
+// plus the delay, so captions keep a fixed offset to the audio (and video)
+// they belong to instead of following the processing latency. Captions that
+// are late already are shown at once.
+//
+// The source is looked up by name once and then held as a weak reference.
+// Renames, removals and new sources with a matching name invalidate it, and
+// a missing source is looked up again at most once a second.
+
+struct caption_output_stats {
+    uint64_t requested;  // captions set
+    uint64_t coalesced;  // replaced before they were shown
+    uint64_t shown;      // obs_source_update calls
+    uint64_t unchanged;  // skipped, same string as on screen
+    uint64_t lookups;    // source name lookups
+};
+
+struct caption_output;
+
+// `latency`, if given, records how long each caption took from when it was
+// due (set, or its delayed display time) until it was on the source
+struct caption_output* caption_output_create(struct latency_histogram* latency);
+void caption_output_destroy(struct caption_output* output);
+
+// An empty or NULL source name turns output off. `min_interval_ms` bounds
+// the display rate; 0 shows every caption. `delay_ms` of 0 shows captions
+// as soon as the rate allows.
+void caption_output_configure(struct caption_output* output, const char* source_name,
+                              bool show_confidence, uint32_t min_interval_ms,
+                              uint32_t delay_ms);
+
+// `capture_ns` is when the speech behind the caption was captured, on the
+// OBS audio clock, or 0 when unknown. Never blocks on OBS; safe from any
+// thread.
+void caption_output_set(struct caption_output* output, const char* text, float confidence,
+                        uint64_t capture_ns);
+
+void caption_output_get_stats(struct caption_output* output, struct caption_output_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
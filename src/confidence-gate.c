@@ -0,0 +1,96 @@
+#include "confidence-gate.h"
+#include <ctype.h>
+#include <string.h>
+
+struct gate_word {
+    size_t begin;
+    size_t end;
+};
+
+// Whitespace-separated words, the same split the engine and the stitcher
+// use for their confidence arrays. Returns the total word count even when
+// it exceeds `max_words`.
+static size_t split_words(const char* text, struct gate_word* words, size_t max_words) {
+    size_t count = 0;
+    size_t i = 0;
+    
+    while (text[i]) {
+        while (text[i] && isspace((unsigned char)text[i])) i++;
+        if (!text[i]) break;
+        
+        size_t begin = i;
+        while (text[i] && !isspace((unsigned char)text[i])) i++;
+        if (count < max_words) {
+            words[count].begin = begin;
+            words[count].end = i;
+        }
+        count++;
+    }
+    return count;
+}
+
+static size_t whole_text(const char* text, float confidence, struct correction_span* spans) {
+    spans[0].begin = 0;
+    spans[0].end = strlen(text);
+    spans[0].confidence = confidence;
+    return spans[0].end > 0 ? 1 : 0;
+}
+
+size_t correction_gate_select(enum correction_gate gate, const char* text, float confidence,
+                              const float* word_confidence, size_t word_count,
+                              float threshold, size_t context_words,
+                              struct correction_span* spans, size_t max_spans) {
+    if (!text || !spans || max_spans == 0) return 0;
+    
+    if (gate == CORRECTION_GATE_ALWAYS) {
+        return whole_text(text, confidence, spans);
+    }
+    
+    struct gate_word* words = NULL;
+    if (gate == CORRECTION_GATE_SPANS && word_confidence && word_count > 0) {
+        words = bmalloc(word_count * sizeof(struct gate_word));
+        if (split_words(text, words, word_count) != word_count) {
+            bfree(words);
+            words = NULL;
+        }
+    }
+    
+    if (!words) {
+        return confidence < threshold ? whole_text(text, confidence, spans) : 0;
+    }
+    
+    size_t span_count = 0;
+    size_t last_end = 0; // word index one past the previous span
+    
+    for (size_t i = 0; i < word_count; i++) {
+        if (word_confidence[i] >= threshold) continue;
+        
+        // Run of uncertain words starting at i
+        size_t run_end = i + 1;
+        float lowest = word_confidence[i];
+        while (run_end < word_count && word_confidence[run_end] < threshold) {
+            if (word_confidence[run_end] < lowest) lowest = word_confidence[run_end];
+            run_end++;
+        }
+        
+        size_t first = i > context_words ? i - context_words : 0;
+        size_t last = run_end + context_words < word_count ? run_end + context_words : word_count;
+        
+        struct correction_span* previous = span_count > 0 ? &spans[span_count - 1] : NULL;
+        if (previous && (first <= last_end || span_count == max_spans)) {
+            previous->end = words[last - 1].end;
+            if (lowest < previous->confidence) previous->confidence = lowest;
+        } else {
+            spans[span_count].begin = words[first].begin;
+            spans[span_count].end = words[last - 1].end;
+            spans[span_count].confidence = lowest;
+            span_count++;
+        }
+        
+        last_end = last;
+        i = run_end - 1;
+    }
+    
+    bfree(words);
+    return span_count;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <obs-module.h>
+
+// Decides which parts of a transcript go to the LLM corrector.
+//
+// Most of what Whisper decodes is right, so sending every segment mostly
+// pays for round trips that change nothing. With per-word confidence from
+// the decoder, only the runs of words below the threshold are sent, each
+// widened by a few words of context so the model can see what the word
+// belongs to; overlapping or touching spans are merged. LLM traffic then
+// follows the decoder's actual uncertainty.
+
+enum correction_gate {
+    CORRECTION_GATE_ALWAYS,  // every transcript, whole
+    CORRECTION_GATE_SEGMENT, // whole transcript when its confidence is below the threshold
+    CORRECTION_GATE_SPANS,   // only the low-confidence words, with context
+};
+
+struct correction_span {
+    size_t begin;     // byte offsets into the transcript
+    size_t end;
+    float confidence; // lowest word confidence inside the span
+};
+
+// Fills up to `max_spans` spans, in text order, and returns how many were
+// written; 0 means the transcript needs no correction. Without usable word
+// confidences (NULL, or a count that does not match the text) the spans
+// gate falls back to the segment gate. Past `max_spans`, the remaining
+// words are folded into the last span.
+size_t correction_gate_select(enum correction_gate gate, const char* text, float confidence,
+                              const float* word_confidence, size_t word_count,
+                              float threshold, size_t context_words,
+                              struct correction_span* spans, size_t max_spans);
@@ -0,0 +1,253 @@
+#include "correction-cache.h"
+#include <obs-module.h>
+#include <util/bmem.h>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <fstream>
+#include <filesystem>
+#include <cctype>
+#include <cinttypes>
+#include <json/json.h>
+
+// Bookkeeping per entry on top of the strings: list node, map node, hash
+#define CACHE_ENTRY_OVERHEAD 96
+
+struct CacheEntry {
+    uint64_t hash;
+    std::string text;      // normalized, guards against hash collisions
+    std::string corrected; // empty when the text needed no correction
+};
+
+static struct {
+    std::mutex mutex;
+    bool initialized = false;
+    std::string persist_path;
+    std::list<CacheEntry> lru; // most recently used first
+    std::unordered_map<uint64_t, std::list<CacheEntry>::iterator> index;
+    size_t bytes = 0;
+    correction_cache_stats stats{};
+} cache;
+
+static std::string normalize(const char* text) {
+    std::string normalized;
+    bool space = false;
+    for (const char* p = text; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (isspace(c)) {
+            space = !normalized.empty();
+            continue;
+        }
+        if (space) {
+            normalized += ' ';
+            space = false;
+        }
+        normalized += (char)tolower(c);
+    }
+    
+    // Whisper is inconsistent about closing punctuation and quotes
+    size_t begin = 0;
+    size_t end = normalized.size();
+    while (begin < end && ispunct((unsigned char)normalized[begin])) begin++;
+    while (end > begin && ispunct((unsigned char)normalized[end - 1])) end--;
+    return normalized.substr(begin, end - begin);
+}
+
+// FNV-1a over the normalized text, prompt, model and endpoint, each
+// terminated so that moving characters between fields changes the hash
+static uint64_t hash_key(const std::string& text, const char* prompt, const char* model,
+                         const char* endpoint) {
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](const char* s) {
+        for (; s && *s; s++) {
+            hash ^= (unsigned char)*s;
+            hash *= 1099511628211ULL;
+        }
+        hash ^= 0xff;
+        hash *= 1099511628211ULL;
+    };
+    mix(text.c_str());
+    mix(prompt);
+    mix(model);
+    mix(endpoint);
+    return hash;
+}
+
+static size_t entry_bytes(const CacheEntry& entry) {
+    return entry.text.size() + entry.corrected.size() + CACHE_ENTRY_OVERHEAD;
+}
+
+// Called with the mutex held
+static void evict_to_budget() {
+    while (cache.bytes > cache.stats.max_bytes && !cache.lru.empty()) {
+        const CacheEntry& victim = cache.lru.back();
+        cache.bytes -= entry_bytes(victim);
+        cache.index.erase(victim.hash);
+        cache.lru.pop_back();
+        cache.stats.evictions++;
+    }
+}
+
+// Called with the mutex held
+static void insert(uint64_t hash, std::string text, std::string corrected) {
+    auto found = cache.index.find(hash);
+    if (found != cache.index.end()) {
+        cache.bytes -= entry_bytes(*found->second);
+        cache.lru.erase(found->second);
+        cache.index.erase(found);
+    }
+    
+    cache.lru.push_front(CacheEntry{hash, std::move(text), std::move(corrected)});
+    cache.index[hash] = cache.lru.begin();
+    cache.bytes += entry_bytes(cache.lru.front());
+    evict_to_budget();
+}
+
+static void load(const std::string& path) {
+    std::ifstream file(std::filesystem::u8path(path));
+    if (!file) return;
+    
+    // Oldest first, so inserting in file order rebuilds the recency order
+    Json::CharReaderBuilder reader_builder;
+    std::unique_ptr<Json::CharReader> reader(reader_builder.newCharReader());
+    std::string line;
+    while (std::getline(file, line)) {
+        Json::Value entry;
+        std::string errors;
+        if (!reader->parse(line.data(), line.data() + line.size(), &entry, &errors) ||
+            !entry.isObject() || !entry["key"].isString() || !entry["text"].isString() ||
+            !entry["corrected"].isString()) {
+            continue;
+        }
+        
+        uint64_t hash = strtoull(entry["key"].asCString(), nullptr, 16);
+        insert(hash, entry["text"].asString(), entry["corrected"].asString());
+    }
+    
+    blog(LOG_INFO, "Correction cache: loaded %zu entries (%zu bytes) from %s",
+         cache.lru.size(), cache.bytes, path.c_str());
+}
+
+static void save(const std::string& path) {
+    std::error_code error;
+    std::filesystem::path target = std::filesystem::u8path(path);
+    if (target.has_parent_path()) {
+        std::filesystem::create_directories(target.parent_path(), error);
+    }
+    
+    // Write next to the target and rename, so a crash never leaves half a file
+    std::filesystem::path temp_path = target;
+    temp_path += ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::trunc);
+        if (!file) {
+            blog(LOG_WARNING, "Correction cache: cannot write %s", temp_path.u8string().c_str());
+            return;
+        }
+        
+        Json::StreamWriterBuilder writer;
+        writer["indentation"] = "";
+        char key[17];
+        for (auto it = cache.lru.rbegin(); it != cache.lru.rend(); ++it) {
+            snprintf(key, sizeof(key), "%016" PRIx64, it->hash);
+            Json::Value entry;
+            entry["key"] = key;
+            entry["text"] = it->text;
+            entry["corrected"] = it->corrected;
+            file << Json::writeString(writer, entry) << '\n';
+        }
+    }
+    
+    std::filesystem::rename(temp_path, target, error);
+    if (error) {
+        blog(LOG_WARNING, "Correction cache: cannot replace %s: %s", path.c_str(),
+             error.message().c_str());
+    }
+}
+
+extern "C" {
+
+void correction_cache_init(size_t max_bytes, const char* persist_path) {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if (cache.initialized) return;
+    
+    cache.initialized = true;
+    cache.stats = correction_cache_stats{};
+    cache.stats.max_bytes = max_bytes;
+    cache.persist_path = persist_path ? persist_path : "";
+    if (!cache.persist_path.empty()) {
+        load(cache.persist_path);
+        cache.stats.insertions = 0;
+        cache.stats.evictions = 0;
+    }
+}
+
+void correction_cache_shutdown(void) {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if (!cache.initialized) return;
+    
+    if (!cache.persist_path.empty()) {
+        save(cache.persist_path);
+    }
+    
+    blog(LOG_INFO, "Correction cache: %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64
+         " evictions, %zu entries (%zu bytes)",
+         cache.stats.hits, cache.stats.misses, cache.stats.evictions, cache.lru.size(),
+         cache.bytes);
+    
+    cache.lru.clear();
+    cache.index.clear();
+    cache.bytes = 0;
+    cache.initialized = false;
+}
+
+char* correction_cache_lookup(const char* text, const char* prompt, const char* model,
+                              const char* endpoint) {
+    if (!text) return nullptr;
+    
+    std::string normalized = normalize(text);
+    uint64_t hash = hash_key(normalized, prompt, model, endpoint);
+    
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if (!cache.initialized) return nullptr;
+    
+    auto found = cache.index.find(hash);
+    if (found == cache.index.end() || found->second->text != normalized) {
+        cache.stats.misses++;
+        return nullptr;
+    }
+    
+    cache.lru.splice(cache.lru.begin(), cache.lru, found->second);
+    cache.stats.hits++;
+    const std::string& corrected = found->second->corrected;
+    return bstrdup(corrected.empty() ? text : corrected.c_str());
+}
+
+void correction_cache_store(const char* text, const char* prompt, const char* model,
+                            const char* endpoint, const char* corrected) {
+    if (!text || !corrected) return;
+    
+    std::string normalized = normalize(text);
+    if (normalized.empty()) return;
+    uint64_t hash = hash_key(normalized, prompt, model, endpoint);
+    
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if (!cache.initialized) return;
+    
+    // An unchanged answer is kept as "no correction", so a later hit keeps
+    // that caller's own spelling of the text
+    insert(hash, std::move(normalized), strcmp(corrected, text) == 0 ? "" : corrected);
+    cache.stats.insertions++;
+}
+
+void correction_cache_get_stats(struct correction_cache_stats* stats) {
+    if (!stats) return;
+    
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    *stats = cache.stats;
+    stats->entries = cache.lru.size();
+    stats->bytes = cache.bytes;
+}
+
+} // extern "C"
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Process-wide LRU cache of LLM corrections.
+//
+// Streams repeat the same phrases constantly, so answers are remembered by
+// a hash of the normalized transcript (lowercase, single spaces, no
+// surrounding punctuation) together with the context prompt, model and
+// endpoint, so correctors talking to different servers never share answers.
+// The cache is bounded by an approximate memory budget and evicts the least
+// recently used entries first. With a persist path, it is loaded from that
+// file at init and written back at shutdown, most recent entries last.
+// Strings returned by this API are allocated with bmalloc and released
+// with bfree.
+
+struct correction_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t insertions;
+    uint64_t evictions;
+    size_t entries;
+    size_t bytes;
+    size_t max_bytes;
+};
+
+// `persist_path` may be NULL for a memory-only cache
+void correction_cache_init(size_t max_bytes, const char* persist_path);
+void correction_cache_shutdown(void);
+
+// Returns the remembered correction for `text`, or NULL on a miss
+char* correction_cache_lookup(const char* text, const char* prompt, const char* model,
+                              const char* endpoint);
+
+// Remembers an answer from the LLM; `corrected` may equal `text`, which
+// records that nothing needed fixing
+void correction_cache_store(const char* text, const char* prompt, const char* model,
+                            const char* endpoint, const char* corrected);
+
+void correction_cache_get_stats(struct correction_cache_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
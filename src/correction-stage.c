@@ -0,0 +1,525 @@
+#include "correction-stage.h"
+#include "llm-corrector.h"
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <pthread.h>
+#include <ctype.h>
+
+// One span of a request in flight, filled in by the transport thread
+struct correction_part {
+    struct correction_item* item;
+    char* corrected;
+    uint64_t finish_ns;
+    bool local; // answered without a request, by the cache or the confidence gate
+    
+    // Streamed answer so far, cut after its last whole word
+    char* partial;
+    size_t partial_words;
+    uint64_t first_token_ns;
+};
+
+struct correction_item {
+    struct correction_request request;
+    struct correction_item* next;
+    
+    struct correction_stage* stage;
+    struct correction_part* parts; // one per span
+    size_t unfinished;             // parts still waiting, guarded by the stage mutex
+    bool partial_dirty;            // a part streamed another word
+    bool partial_shown;            // streamed text was reported for this item
+};
+
+struct correction_stage {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_cond_t finished; // an in-flight request has its answer
+    bool stop;
+    long batch_window_ms;
+    bool streaming;
+    
+    struct correction_item* head;
+    struct correction_item* tail;
+    size_t count;
+    size_t max_queued;
+    
+    // `corrector` is only used on the stage thread; replacements wait in
+    // `pending_corrector` until the thread is between requests
+    void* corrector;
+    void* pending_corrector;
+    bool pending_set;
+    bool has_corrector;
+    
+    correction_done_cb done;
+    correction_partial_cb partial;
+    void* param;
+    struct correction_stats stats;
+};
+
+static void free_item(struct correction_item* item) {
+    bfree(item->request.text);
+    bfree(item->request.prompt);
+    bfree(item->request.spans);
+    bfree(item->parts);
+    bfree(item);
+}
+
+// Counts the words in `text` that are followed by whitespace, and where the
+// last of them ends; a trailing word may still be growing
+static size_t complete_words(const char* text, size_t* end) {
+    size_t words = 0;
+    size_t i = 0;
+    
+    *end = 0;
+    for (;;) {
+        while (text[i] && isspace((unsigned char)text[i])) i++;
+        if (!text[i]) break;
+        while (text[i] && !isspace((unsigned char)text[i])) i++;
+        if (!text[i]) break;
+        words++;
+        *end = i;
+    }
+    return words;
+}
+
+// Offset just past the first `words` words of `text`
+static size_t skip_words(const char* text, size_t len, size_t words) {
+    size_t i = 0;
+    
+    for (; words > 0; words--) {
+        while (i < len && isspace((unsigned char)text[i])) i++;
+        while (i < len && !isspace((unsigned char)text[i])) i++;
+    }
+    return i;
+}
+
+static void correction_part_partial(void* param, const char* partial) {
+    struct correction_part* part = param;
+    struct correction_stage* stage = part->item->stage;
+    uint64_t now = os_gettime_ns();
+    size_t end;
+    size_t words = complete_words(partial, &end);
+    
+    pthread_mutex_lock(&stage->mutex);
+    if (!part->first_token_ns) {
+        part->first_token_ns = now;
+    }
+    if (words > part->partial_words) {
+        bfree(part->partial);
+        part->partial = bstrdup_n(partial, end);
+        part->partial_words = words;
+        part->item->partial_dirty = true;
+        pthread_cond_broadcast(&stage->finished);
+    }
+    pthread_mutex_unlock(&stage->mutex);
+}
+
+static void correction_part_done(void* param, char* corrected) {
+    struct correction_part* part = param;
+    struct correction_stage* stage = part->item->stage;
+    
+    pthread_mutex_lock(&stage->mutex);
+    part->corrected = corrected;
+    part->finish_ns = os_gettime_ns();
+    part->item->unfinished--;
+    pthread_cond_broadcast(&stage->finished);
+    pthread_mutex_unlock(&stage->mutex);
+}
+
+// Sends every span of `item` to the LLM
+static void dispatch_item(struct correction_stage* stage, struct correction_item* item,
+                          void* corrector, bool streaming, uint64_t now) {
+    const struct correction_request* request = &item->request;
+    
+    item->stage = stage;
+    item->parts = bzalloc(request->span_count * sizeof(struct correction_part));
+    item->unfinished = request->span_count;
+    
+    if (!corrector || now >= request->deadline_ns) {
+        item->unfinished = 0;
+        return;
+    }
+    long timeout_ms = (long)((request->deadline_ns - now) / 1000000);
+    
+    for (size_t i = 0; i < request->span_count; i++) {
+        const struct correction_span* span = &request->spans[i];
+        struct correction_part* part = &item->parts[i];
+        part->item = item;
+        
+        char* span_text = bstrdup_n(request->text + span->begin, span->end - span->begin);
+        bool local = false;
+        bool sent = llm_corrector_improve_streaming(corrector, span_text, request->prompt,
+                                                    span->confidence,
+                                                    timeout_ms > 0 ? timeout_ms : 1,
+                                                    streaming ? correction_part_partial : NULL,
+                                                    correction_part_done, part, &local);
+        bfree(span_text);
+        
+        // A fast network answer may also be in before the call returns, so
+        // only the corrector can tell which answers stayed local
+        pthread_mutex_lock(&stage->mutex);
+        if (!sent) {
+            item->unfinished--;
+        } else {
+            part->local = local;
+        }
+        pthread_mutex_unlock(&stage->mutex);
+    }
+}
+
+// Splices the span answers back into the transcript. With `streamed`, a
+// span still being answered shows the words streamed so far followed by the
+// raw words they have not replaced yet. Returns whether the text differs from
+// the raw transcript; `expired` is set when an answer came too late.
+static bool splice_text(const struct correction_item* item, bool streamed, struct dstr* out,
+                        bool* expired) {
+    const struct correction_request* request = &item->request;
+    bool changed = false;
+    size_t copied = 0;
+    
+    dstr_copy(out, "");
+    for (size_t i = 0; i < request->span_count; i++) {
+        const struct correction_span* span = &request->spans[i];
+        const struct correction_part* part = &item->parts[i];
+        const char* raw = request->text + span->begin;
+        size_t span_len = span->end - span->begin;
+        
+        dstr_ncat(out, request->text + copied, span->begin - copied);
+        copied = span->end;
+        
+        // A late answer is worth nothing, the raw text stays
+        if (part->corrected && part->finish_ns > request->deadline_ns) {
+            *expired = true;
+        } else if (part->corrected && (strlen(part->corrected) != span_len ||
+                   strncmp(part->corrected, raw, span_len) != 0)) {
+            dstr_cat(out, part->corrected);
+            changed = true;
+            continue;
+        } else if (streamed && !part->corrected && part->partial) {
+            size_t replaced = skip_words(raw, span_len, part->partial_words);
+            dstr_cat(out, part->partial);
+            dstr_ncat(out, raw + replaced, span_len - replaced);
+            changed = true;
+            continue;
+        }
+        dstr_ncat(out, raw, span_len);
+    }
+    dstr_cat(out, request->text + copied);
+    return changed;
+}
+
+// Shows the streamed progress of the requests in flight, from `items` on.
+// Called, and returns, with the stage mutex held.
+static void report_partials(struct correction_stage* stage, struct correction_item* items) {
+    for (struct correction_item* item = items; item; item = item->next) {
+        if (!item->partial_dirty) continue;
+        item->partial_dirty = false;
+        
+        struct dstr text = {0};
+        bool expired = false;
+        bool changed = splice_text(item, true, &text, &expired);
+        
+        pthread_mutex_unlock(&stage->mutex);
+        if (changed) {
+            stage->partial(stage->param, &item->request, text.array);
+            item->partial_shown = true;
+        }
+        dstr_free(&text);
+        pthread_mutex_lock(&stage->mutex);
+    }
+}
+
+// Adds the timings of the network answers of `item` to the stats. Called
+// with the stage mutex held.
+static void record_latency(struct correction_stage* stage, const struct correction_item* item,
+                           uint64_t dispatch_ns) {
+    struct correction_stats* stats = &stage->stats;
+    
+    for (size_t i = 0; i < item->request.span_count; i++) {
+        const struct correction_part* part = &item->parts[i];
+        if (!part->corrected || part->local || part->finish_ns < dispatch_ns) continue;
+        
+        uint64_t latency_us = (part->finish_ns - dispatch_ns) / 1000;
+        stats->answered++;
+        stats->latency_total_us += latency_us;
+        if (latency_us > stats->latency_max_us) stats->latency_max_us = latency_us;
+        
+        if (part->first_token_ns >= dispatch_ns) {
+            uint64_t first_token_us = (part->first_token_ns - dispatch_ns) / 1000;
+            stats->streamed++;
+            stats->first_token_total_us += first_token_us;
+            if (first_token_us > stats->first_token_max_us) {
+                stats->first_token_max_us = first_token_us;
+            }
+        }
+    }
+}
+
+// Splices the span answers back into the transcript and reports it
+static void resolve_item(struct correction_stage* stage, struct correction_item* item,
+                         uint64_t dispatch_ns) {
+    const struct correction_request* request = &item->request;
+    struct dstr result = {0};
+    bool expired = dispatch_ns >= request->deadline_ns;
+    bool changed = splice_text(item, false, &result, &expired);
+    
+    pthread_mutex_lock(&stage->mutex);
+    if (changed) {
+        stage->stats.corrected++;
+    } else if (expired) {
+        stage->stats.expired++;
+    } else {
+        stage->stats.unchanged++;
+    }
+    record_latency(stage, item, dispatch_ns);
+    pthread_mutex_unlock(&stage->mutex);
+    
+    // A stream cut off by the deadline must not leave half a correction on
+    // screen
+    if (!changed && item->partial_shown) {
+        stage->partial(stage->param, request, request->text);
+    }
+    stage->done(stage->param, request, changed ? result.array : NULL);
+    
+    dstr_free(&result);
+    for (size_t i = 0; i < request->span_count; i++) {
+        bfree(item->parts[i].corrected);
+        bfree(item->parts[i].partial);
+    }
+    free_item(item);
+}
+
+static void* correction_thread(void* data) {
+    struct correction_stage* stage = data;
+    
+    os_set_thread_name("ai-transcription: correction");
+    
+    for (;;) {
+        pthread_mutex_lock(&stage->mutex);
+        while (!stage->stop && !stage->head && !stage->pending_set) {
+            pthread_cond_wait(&stage->cond, &stage->mutex);
+        }
+        
+        void* retired = NULL;
+        if (stage->pending_set) {
+            retired = stage->corrector;
+            stage->corrector = stage->pending_corrector;
+            stage->pending_corrector = NULL;
+            stage->pending_set = false;
+        }
+        
+        // Everything queued goes out together, so the requests can share a
+        // batch or a connection instead of waiting on each other
+        struct correction_item* items = NULL;
+        if (!stage->stop) {
+            items = stage->head;
+            stage->head = stage->tail = NULL;
+            stage->count = 0;
+        }
+        bool stop = stage->stop;
+        void* corrector = stage->corrector;
+        long batch_window_ms = stage->batch_window_ms;
+        bool streaming = stage->streaming && stage->partial;
+        pthread_mutex_unlock(&stage->mutex);
+        
+        if (retired) {
+            llm_corrector_destroy(retired);
+        }
+        if (stop) {
+            break;
+        }
+        if (corrector) {
+            llm_corrector_set_batch_window(corrector, batch_window_ms);
+        }
+        
+        uint64_t now = os_gettime_ns();
+        for (struct correction_item* item = items; item; item = item->next) {
+            dispatch_item(stage, item, corrector, streaming, now);
+        }
+        
+        // Resolve in submission order; the transport bounds every wait by
+        // the request's deadline. Streamed words are shown as they come in.
+        while (items) {
+            struct correction_item* item = items;
+            items = item->next;
+            
+            pthread_mutex_lock(&stage->mutex);
+            while (item->unfinished > 0) {
+                pthread_cond_wait(&stage->finished, &stage->mutex);
+                report_partials(stage, item);
+            }
+            pthread_mutex_unlock(&stage->mutex);
+            
+            resolve_item(stage, item, now);
+        }
+    }
+    return NULL;
+}
+
+struct correction_stage* correction_stage_create(size_t max_queued, correction_done_cb done,
+                                                 correction_partial_cb partial, void* param) {
+    if (!done) return NULL;
+    
+    struct correction_stage* stage = bzalloc(sizeof(struct correction_stage));
+    stage->max_queued = max_queued > 0 ? max_queued : 1;
+    stage->done = done;
+    stage->partial = partial;
+    stage->param = param;
+    
+    pthread_mutex_init(&stage->mutex, NULL);
+    pthread_cond_init(&stage->cond, NULL);
+    pthread_cond_init(&stage->finished, NULL);
+    if (pthread_create(&stage->thread, NULL, correction_thread, stage) != 0) {
+        pthread_cond_destroy(&stage->finished);
+        pthread_cond_destroy(&stage->cond);
+        pthread_mutex_destroy(&stage->mutex);
+        bfree(stage);
+        return NULL;
+    }
+    return stage;
+}
+
+void correction_stage_destroy(struct correction_stage* stage) {
+    if (!stage) return;
+    
+    pthread_mutex_lock(&stage->mutex);
+    stage->stop = true;
+    pthread_cond_signal(&stage->cond);
+    pthread_mutex_unlock(&stage->mutex);
+    pthread_join(stage->thread, NULL);
+    
+    // Nothing may be lost from the transcript: keep the raw text
+    while (stage->head) {
+        struct correction_item* next = stage->head->next;
+        stage->done(stage->param, &stage->head->request, NULL);
+        free_item(stage->head);
+        stage->head = next;
+    }
+    
+    if (stage->corrector) {
+        llm_corrector_destroy(stage->corrector);
+    }
+    if (stage->pending_corrector) {
+        llm_corrector_destroy(stage->pending_corrector);
+    }
+    pthread_cond_destroy(&stage->finished);
+    pthread_cond_destroy(&stage->cond);
+    pthread_mutex_destroy(&stage->mutex);
+    bfree(stage);
+}
+
+void correction_stage_set_corrector(struct correction_stage* stage, void* corrector) {
+    if (!stage) {
+        if (corrector) llm_corrector_destroy(corrector);
+        return;
+    }
+    
+    pthread_mutex_lock(&stage->mutex);
+    void* replaced = stage->pending_set ? stage->pending_corrector : NULL;
+    stage->pending_corrector = corrector;
+    stage->pending_set = true;
+    stage->has_corrector = corrector != NULL;
+    pthread_cond_signal(&stage->cond);
+    pthread_mutex_unlock(&stage->mutex);
+    
+    // Never reached the stage thread, so nobody else can be using it
+    if (replaced) {
+        llm_corrector_destroy(replaced);
+    }
+}
+
+void correction_stage_set_batch_window(struct correction_stage* stage, long window_ms) {
+    if (!stage) return;
+    
+    pthread_mutex_lock(&stage->mutex);
+    stage->batch_window_ms = window_ms;
+    pthread_mutex_unlock(&stage->mutex);
+}
+
+void correction_stage_set_streaming(struct correction_stage* stage, bool streaming) {
+    if (!stage) return;
+    
+    pthread_mutex_lock(&stage->mutex);
+    stage->streaming = streaming;
+    pthread_mutex_unlock(&stage->mutex);
+}
+
+bool correction_stage_has_corrector(struct correction_stage* stage) {
+    if (!stage) return false;
+    
+    pthread_mutex_lock(&stage->mutex);
+    bool has_corrector = stage->has_corrector;
+    pthread_mutex_unlock(&stage->mutex);
+    return has_corrector;
+}
+
+void correction_stage_submit(struct correction_stage* stage, const char* text,
+                             const char* prompt, float confidence,
+                             const struct correction_span* spans, size_t span_count,
+                             uint64_t caption_id, uint64_t start_ns, uint64_t end_ns,
+                             uint64_t deadline_ns) {
+    if (!stage || !text) return;
+    
+    struct correction_item* item = bzalloc(sizeof(struct correction_item));
+    item->request.text = bstrdup(text);
+    item->request.prompt = prompt ? bstrdup(prompt) : NULL;
+    item->request.confidence = confidence;
+    item->request.caption_id = caption_id;
+    item->request.start_ns = start_ns;
+    item->request.end_ns = end_ns;
+    item->request.submit_ns = os_gettime_ns();
+    item->request.deadline_ns = deadline_ns;
+    
+    if (spans && span_count > 0) {
+        item->request.spans = bmemdup(spans, span_count * sizeof(struct correction_span));
+        item->request.span_count = span_count;
+    } else {
+        item->request.spans = bzalloc(sizeof(struct correction_span));
+        item->request.spans[0].end = strlen(text);
+        item->request.spans[0].confidence = confidence;
+        item->request.span_count = 1;
+    }
+    
+    struct correction_item* overflow = NULL;
+    
+    pthread_mutex_lock(&stage->mutex);
+    if (stage->count >= stage->max_queued) {
+        overflow = stage->head;
+        stage->head = overflow->next;
+        if (!stage->head) {
+            stage->tail = NULL;
+        }
+        stage->count--;
+        stage->stats.overflowed++;
+    }
+    
+    if (stage->tail) {
+        stage->tail->next = item;
+    } else {
+        stage->head = item;
+    }
+    stage->tail = item;
+    stage->count++;
+    stage->stats.submitted++;
+    stage->stats.spans += item->request.span_count;
+    if (stage->count > stage->stats.max_queued) {
+        stage->stats.max_queued = stage->count;
+    }
+    pthread_cond_signal(&stage->cond);
+    pthread_mutex_unlock(&stage->mutex);
+    
+    if (overflow) {
+        stage->done(stage->param, &overflow->request, NULL);
+        free_item(overflow);
+    }
+}
+
+void correction_stage_get_stats(struct correction_stage* stage, struct correction_stats* stats) {
+    if (!stage || !stats) return;
+    
+    pthread_mutex_lock(&stage->mutex);
+    *stats = stage->stats;
+    pthread_mutex_unlock(&stage->mutex);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <obs-module.h>
+#include "confidence-gate.h"
+
+// Asynchronous LLM correction stage.
+//
+// Transcripts are queued here after the raw text has already been shown, and
+// a dedicated thread hands everything queued to the LLM transport at once,
+// then resolves the requests in order as the answers come in. Every request
+// carries a deadline: if it has passed before the request starts, or the
+// HTTP call runs into it, the raw text is kept. The queue is bounded; when
+// it is full the oldest request is resolved with its raw text on the spot.
+// Inference therefore never waits on the network.
+
+struct correction_request {
+    char* text;           // raw transcript
+    char* prompt;         // context prompt captured at submit time
+    float confidence;
+    struct correction_span* spans; // the parts of `text` sent to the LLM
+    size_t span_count;
+    uint64_t caption_id;  // caller's handle for the caption showing `text`
+    uint64_t start_ns;    // when `text` was spoken, on the caller's clock
+    uint64_t end_ns;
+    uint64_t submit_ns;
+    uint64_t deadline_ns;
+};
+
+// Called exactly once per submitted request, usually on the stage thread.
+// `corrected` is NULL when the raw text is kept, for whatever reason.
+typedef void (*correction_done_cb)(void* param, const struct correction_request* request,
+                                   const char* corrected);
+
+// Called on the stage thread while streamed answers come in, each time
+// another whole word is in. `text` is the transcript with the words
+// corrected so far in place of the raw ones. It is for display only, and
+// the done callback still follows; when the final answer keeps the raw
+// text, a last call with the raw text undoes what was shown.
+typedef void (*correction_partial_cb)(void* param, const struct correction_request* request,
+                                      const char* text);
+
+struct correction_stats {
+    uint64_t submitted;
+    uint64_t spans;      // LLM requests the submitted transcripts were split into
+    uint64_t corrected;  // the LLM returned a different text in time
+    uint64_t unchanged;  // answered in time, nothing to fix (or request failed)
+    uint64_t expired;    // deadline passed before the request could start
+    uint64_t overflowed; // pushed out of a full queue
+    size_t max_queued;
+    
+    // Spans that went over the network (cache hits and confidence-gate
+    // skips excluded), timed from dispatch to the answer, error or timeout
+    uint64_t answered;
+    uint64_t latency_total_us;
+    uint64_t latency_max_us;
+    uint64_t streamed;            // answered spans that streamed their text
+    uint64_t first_token_total_us;
+    uint64_t first_token_max_us;
+};
+
+struct correction_stage;
+// `partial` may be NULL when streamed text is of no use to the caller
+struct correction_stage* correction_stage_create(size_t max_queued, correction_done_cb done,
+                                                 correction_partial_cb partial, void* param);
+
+// Stops the thread once the requests in flight return (bounded by their
+// deadlines) and resolves whatever is still queued with the raw text
+void correction_stage_destroy(struct correction_stage* stage);
+
+// Hands over an llm-corrector context; the stage owns and destroys it. The
+// stage thread switches to it between requests. NULL disables correction.
+void correction_stage_set_corrector(struct correction_stage* stage, void* corrector);
+// How long the transport may hold requests to batch them (see
+// llm_corrector_set_batch_window); applied from the next dispatch on
+void correction_stage_set_batch_window(struct correction_stage* stage, long window_ms);
+// Asks for streamed answers, reported through the partial callback; see
+// llm_corrector_improve_streaming
+void correction_stage_set_streaming(struct correction_stage* stage, bool streaming);
+bool correction_stage_has_corrector(struct correction_stage* stage);
+
+// Only the given spans of `text` are sent, each as its own request, and the
+// answers are spliced back in; with no spans the whole text is sent
+void correction_stage_submit(struct correction_stage* stage, const char* text,
+                             const char* prompt, float confidence,
+                             const struct correction_span* spans, size_t span_count,
+                             uint64_t caption_id, uint64_t start_ns, uint64_t end_ns,
+                             uint64_t deadline_ns);
+
+void correction_stage_get_stats(struct correction_stage* stage, struct correction_stats* stats);
@@ -0,0 +1,358 @@
+#include "inference-scheduler.h"
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <pthread.h>
+
+#define MAX_INFERENCE_WORKERS 16
+
+struct inference_job {
+    void* job;
+    uint64_t enqueue_ns;
+    uint64_t deadline_ns;
+    struct inference_job* next;
+};
+
+struct inference_client {
+    char* name;
+    enum inference_priority priority;
+    size_t max_queued;
+    inference_run_cb run;
+    inference_drop_cb drop;
+    void* param;
+    
+    struct inference_job* head;
+    struct inference_job* tail;
+    bool running; // a pool thread is inside run()
+    struct inference_client_stats stats;
+    
+    struct inference_client* next;
+};
+
+struct inference_worker {
+    pthread_t thread;
+    uint32_t index;
+    bool started;
+    bool exited;
+};
+
+// Everything below is guarded by `mutex`; `work` is signalled when a job is
+// queued or the pool shrinks, `idle` when a job finishes.
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t work;
+    pthread_cond_t idle;
+    bool initialized;
+    bool shutting_down;
+    
+    struct inference_worker workers[MAX_INFERENCE_WORKERS];
+    uint32_t target_workers;
+    
+    struct inference_client* clients;
+    struct inference_client* last_served[INFERENCE_PRIORITY_COUNT];
+} scheduler;
+
+static uint32_t default_worker_count(void) {
+    // Leave most cores to OBS's encoders; each decode is multi-threaded
+    int cores = os_get_physical_cores();
+    uint32_t workers = cores > 0 ? (uint32_t)cores / 4 : 1;
+    if (workers < 1) workers = 1;
+    if (workers > 4) workers = 4;
+    return workers;
+}
+
+static struct inference_job* client_pop(struct inference_client* client) {
+    struct inference_job* item = client->head;
+    if (item) {
+        client->head = item->next;
+        if (!client->head) {
+            client->tail = NULL;
+        }
+        client->stats.queued--;
+    }
+    return item;
+}
+
+// Picks the next client to serve: highest priority class first, and within
+// a class the first runnable client after the one served last. Stale jobs
+// met on the way are moved to `stale` so they can be dropped unlocked.
+static struct inference_client* pick_client(uint64_t now, struct inference_job** stale,
+                                            struct inference_client** stale_owner) {
+    for (int prio = 0; prio < INFERENCE_PRIORITY_COUNT; prio++) {
+        struct inference_client* last = scheduler.last_served[prio];
+        struct inference_client* start = last && last->next ? last->next : scheduler.clients;
+        struct inference_client* client = start;
+        
+        if (!client) return NULL;
+        
+        do {
+            if ((int)client->priority == prio && !client->running && client->head) {
+                if (client->head->deadline_ns && client->head->deadline_ns < now) {
+                    // One stale job per pass keeps the drop callback off the lock
+                    *stale = client_pop(client);
+                    *stale_owner = client;
+                    client->stats.dropped_stale++;
+                    return NULL;
+                }
+                
+                scheduler.last_served[prio] = client;
+                return client;
+            }
+            client = client->next ? client->next : scheduler.clients;
+        } while (client != start);
+    }
+    return NULL;
+}
+
+static void* inference_worker_thread(void* data) {
+    struct inference_worker* worker = data;
+    
+    os_set_thread_name("ai-transcription: inference");
+    
+    pthread_mutex_lock(&scheduler.mutex);
+    for (;;) {
+        if (scheduler.shutting_down || worker->index >= scheduler.target_workers) {
+            break;
+        }
+        
+        struct inference_job* stale = NULL;
+        struct inference_client* stale_owner = NULL;
+        struct inference_client* client = pick_client(os_gettime_ns(), &stale, &stale_owner);
+        
+        if (stale) {
+            // The owner cannot go away while it has a job we hold: destroy
+            // waits for `running`, so borrow that flag for the drop
+            stale_owner->running = true;
+            pthread_mutex_unlock(&scheduler.mutex);
+            stale_owner->drop(stale_owner->param, stale->job, INFERENCE_DROP_STALE);
+            bfree(stale);
+            pthread_mutex_lock(&scheduler.mutex);
+            stale_owner->running = false;
+            pthread_cond_broadcast(&scheduler.idle);
+            continue;
+        }
+        
+        if (!client) {
+            pthread_cond_wait(&scheduler.work, &scheduler.mutex);
+            continue;
+        }
+        
+        struct inference_job* item = client_pop(client);
+        client->running = true;
+        pthread_mutex_unlock(&scheduler.mutex);
+        
+        client->run(client->param, item->job, item->enqueue_ns);
+        bfree(item);
+        
+        pthread_mutex_lock(&scheduler.mutex);
+        client->running = false;
+        client->stats.completed++;
+        pthread_cond_broadcast(&scheduler.idle);
+        
+        // This client may have more work for another thread now
+        pthread_cond_signal(&scheduler.work);
+    }
+    worker->exited = true;
+    pthread_mutex_unlock(&scheduler.mutex);
+    return NULL;
+}
+
+// Called with the mutex held
+static void resize_pool(uint32_t count) {
+    scheduler.target_workers = count;
+    pthread_cond_broadcast(&scheduler.work);
+    
+    for (uint32_t i = 0; i < count; i++) {
+        struct inference_worker* worker = &scheduler.workers[i];
+        if (worker->started && !worker->exited) {
+            continue;
+        }
+        if (worker->started) {
+            // Exited after an earlier shrink; it no longer needs the lock
+            pthread_join(worker->thread, NULL);
+        }
+        
+        worker->index = i;
+        worker->exited = false;
+        worker->started = pthread_create(&worker->thread, NULL, inference_worker_thread,
+                                         worker) == 0;
+    }
+}
+
+void inference_scheduler_init(uint32_t workers) {
+    if (scheduler.initialized) return;
+    
+    pthread_mutex_init(&scheduler.mutex, NULL);
+    pthread_cond_init(&scheduler.work, NULL);
+    pthread_cond_init(&scheduler.idle, NULL);
+    scheduler.initialized = true;
+    scheduler.shutting_down = false;
+    
+    inference_scheduler_set_workers(workers);
+}
+
+void inference_scheduler_shutdown(void) {
+    if (!scheduler.initialized) return;
+    
+    pthread_mutex_lock(&scheduler.mutex);
+    scheduler.shutting_down = true;
+    pthread_cond_broadcast(&scheduler.work);
+    pthread_mutex_unlock(&scheduler.mutex);
+    
+    for (uint32_t i = 0; i < MAX_INFERENCE_WORKERS; i++) {
+        if (scheduler.workers[i].started) {
+            pthread_join(scheduler.workers[i].thread, NULL);
+            scheduler.workers[i].started = false;
+        }
+    }
+    
+    if (scheduler.clients) {
+        blog(LOG_WARNING, "Inference scheduler: shut down with clients still registered");
+    }
+    
+    scheduler.target_workers = 0;
+    pthread_cond_destroy(&scheduler.idle);
+    pthread_cond_destroy(&scheduler.work);
+    pthread_mutex_destroy(&scheduler.mutex);
+    scheduler.initialized = false;
+}
+
+void inference_scheduler_set_workers(uint32_t workers) {
+    if (!scheduler.initialized) return;
+    
+    if (workers == 0) {
+        workers = default_worker_count();
+    }
+    if (workers > MAX_INFERENCE_WORKERS) {
+        workers = MAX_INFERENCE_WORKERS;
+    }
+    
+    pthread_mutex_lock(&scheduler.mutex);
+    if (workers != scheduler.target_workers) {
+        blog(LOG_INFO, "Inference scheduler: %u workers", workers);
+        resize_pool(workers);
+    }
+    pthread_mutex_unlock(&scheduler.mutex);
+}
+
+uint32_t inference_scheduler_get_workers(void) {
+    if (!scheduler.initialized) return 0;
+    
+    pthread_mutex_lock(&scheduler.mutex);
+    uint32_t workers = scheduler.target_workers;
+    pthread_mutex_unlock(&scheduler.mutex);
+    return workers;
+}
+
+struct inference_client* inference_client_create(const char* name, size_t max_queued,
+                                                 inference_run_cb run, inference_drop_cb drop,
+                                                 void* param) {
+    if (!scheduler.initialized || !run || !drop) return NULL;
+    
+    struct inference_client* client = bzalloc(sizeof(struct inference_client));
+    client->name = bstrdup(name ? name : "");
+    client->priority = INFERENCE_PRIORITY_NORMAL;
+    client->max_queued = max_queued > 0 ? max_queued : 1;
+    client->run = run;
+    client->drop = drop;
+    client->param = param;
+    
+    pthread_mutex_lock(&scheduler.mutex);
+    client->next = scheduler.clients;
+    scheduler.clients = client;
+    pthread_mutex_unlock(&scheduler.mutex);
+    return client;
+}
+
+void inference_client_destroy(struct inference_client* client) {
+    if (!client) return;
+    
+    pthread_mutex_lock(&scheduler.mutex);
+    
+    struct inference_client** link = &scheduler.clients;
+    while (*link && *link != client) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = client->next;
+    }
+    for (int prio = 0; prio < INFERENCE_PRIORITY_COUNT; prio++) {
+        if (scheduler.last_served[prio] == client) {
+            scheduler.last_served[prio] = NULL;
+        }
+    }
+    
+    struct inference_job* queued = client->head;
+    client->head = client->tail = NULL;
+    client->stats.queued = 0;
+    
+    while (client->running) {
+        pthread_cond_wait(&scheduler.idle, &scheduler.mutex);
+    }
+    pthread_mutex_unlock(&scheduler.mutex);
+    
+    while (queued) {
+        struct inference_job* next = queued->next;
+        client->drop(client->param, queued->job, INFERENCE_DROP_CANCELED);
+        bfree(queued);
+        queued = next;
+    }
+    
+    bfree(client->name);
+    bfree(client);
+}
+
+void inference_client_set_priority(struct inference_client* client,
+                                   enum inference_priority priority) {
+    if (!client || priority >= INFERENCE_PRIORITY_COUNT) return;
+    
+    pthread_mutex_lock(&scheduler.mutex);
+    client->priority = priority;
+    pthread_mutex_unlock(&scheduler.mutex);
+}
+
+bool inference_client_submit(struct inference_client* client, void* job, uint64_t deadline_ns) {
+    if (!client) return false;
+    
+    struct inference_job* item = bzalloc(sizeof(struct inference_job));
+    item->job = job;
+    item->enqueue_ns = os_gettime_ns();
+    item->deadline_ns = deadline_ns;
+    
+    struct inference_job* overflow = NULL;
+    
+    pthread_mutex_lock(&scheduler.mutex);
+    if (client->stats.queued >= client->max_queued) {
+        overflow = client_pop(client);
+        client->stats.dropped_overflow++;
+    }
+    
+    if (client->tail) {
+        client->tail->next = item;
+    } else {
+        client->head = item;
+    }
+    client->tail = item;
+    client->stats.queued++;
+    if (client->stats.queued > client->stats.max_queued) {
+        client->stats.max_queued = client->stats.queued;
+    }
+    
+    pthread_cond_signal(&scheduler.work);
+    pthread_mutex_unlock(&scheduler.mutex);
+    
+    if (overflow) {
+        client->drop(client->param, overflow->job, INFERENCE_DROP_OVERFLOW);
+        bfree(overflow);
+    }
+    return true;
+}
+
+void inference_client_get_stats(struct inference_client* client,
+                                struct inference_client_stats* stats) {
+    if (!client || !stats) return;
+    
+    pthread_mutex_lock(&scheduler.mutex);
+    *stats = client->stats;
+    pthread_mutex_unlock(&scheduler.mutex);
+}
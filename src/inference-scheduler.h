@@ -0,0 +1,64 @@
+#pragma once
+
+#include <obs-module.h>
+
+// Process-wide pool of inference workers shared by every filter instance.
+//
+// Each filter registers a client and submits jobs to it. A client has at
+// most one job running at a time, so per-source state such as a streaming
+// decoder needs no locking, and the pool size caps how many decodes run
+// across all sources. Workers serve the highest priority class with work
+// first and go round-robin between the clients inside a class. A job still
+// queued past its deadline is dropped instead of run, so a backlog can never
+// make captions arbitrarily late.
+
+enum inference_priority {
+    INFERENCE_PRIORITY_HIGH,
+    INFERENCE_PRIORITY_NORMAL,
+    INFERENCE_PRIORITY_LOW,
+    INFERENCE_PRIORITY_COUNT,
+};
+
+enum inference_drop_reason {
+    INFERENCE_DROP_STALE,    // deadline passed while queued
+    INFERENCE_DROP_OVERFLOW, // client queue full, the oldest job makes room
+    INFERENCE_DROP_CANCELED, // client destroyed with jobs queued
+};
+
+// `run` is called on a pool thread, `drop` on whichever thread gave up on the
+// job; both receive the client's param and must release the job.
+typedef void (*inference_run_cb)(void* param, void* job, uint64_t enqueue_ns);
+typedef void (*inference_drop_cb)(void* param, void* job, enum inference_drop_reason reason);
+
+struct inference_client_stats {
+    size_t queued;
+    size_t max_queued;
+    uint64_t completed;
+    uint64_t dropped_stale;
+    uint64_t dropped_overflow;
+};
+
+void inference_scheduler_init(uint32_t workers);
+void inference_scheduler_shutdown(void);
+
+// Grows or shrinks the pool; 0 picks a default from the core count
+void inference_scheduler_set_workers(uint32_t workers);
+uint32_t inference_scheduler_get_workers(void);
+
+struct inference_client;
+struct inference_client* inference_client_create(const char* name, size_t max_queued,
+                                                 inference_run_cb run, inference_drop_cb drop,
+                                                 void* param);
+
+// Drops queued jobs and waits for a running one to finish
+void inference_client_destroy(struct inference_client* client);
+
+void inference_client_set_priority(struct inference_client* client,
+                                   enum inference_priority priority);
+
+// Queues a job that must start before `deadline_ns` (os_gettime_ns clock).
+// Returns false, leaving the job with the caller, if there is no client.
+bool inference_client_submit(struct inference_client* client, void* job, uint64_t deadline_ns);
+
+void inference_client_get_stats(struct inference_client* client,
+                                struct inference_client_stats* stats);
@@ -1,15 +1,54 @@
 #include "llm-corrector.h"
+#include "correction-cache.h"
 #include <obs-module.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/threading.h>
 #include <curl/curl.h>
 #include <string>
 #include <memory>
+#include <sstream>
+#include <vector>
+#include <deque>
+#include <unordered_set>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 #include <json/json.h>
 
+#define LLM_DEFAULT_TIMEOUT_MS 30000L
+#define LLM_MAX_HOST_CONNECTIONS 4L
+#define LLM_MAX_CACHED_CONNECTIONS 16L
+#define LLM_MAX_BATCH_SEGMENTS 8
+
+static const char* const LLM_DEFAULT_PROMPT =
+    "You are a helpful assistant that corrects transcription errors. "
+    "Return only the corrected text without explanations.";
+
+static const char* const LLM_BATCH_INSTRUCTIONS =
+    "The user message is a JSON array of transcript segments, each with an \"index\" and a "
+    "\"text\". Correct every segment independently and reply with only a JSON object of the "
+    "form {\"segments\":[{\"index\":0,\"text\":\"...\"}]} containing every index.";
+
 struct LLMContext {
     std::string api_endpoint;
     std::string api_key;
-    CURL* curl_handle;
     bool initialized;
+    
+    // Built once per corrector instead of per request
+    curl_slist* headers;
+    std::string model;
+    Json::Value request_template;
+    Json::StreamWriterBuilder writer;
+    
+    // Easy handles are recycled with their static options already set;
+    // connections live in the transport and outlive any corrector
+    std::mutex handles_mutex;
+    std::vector<CURL*> idle_handles;
+    
+    std::atomic<long> batch_window_ms{0};
 };
 
 struct LLMResponse {
@@ -17,36 +56,762 @@ struct LLMResponse {
     long response_code;
 };
 
-static size_t llm_write_callback(void* contents, size_t size, size_t nmemb, LLMResponse* response) {
+// Incremental parser for a streamed (server-sent events) chat completion.
+// The body arrives in arbitrary pieces; complete lines are consumed as they
+// come in and every "data:" event's choices[0].delta.content is appended to
+// `content`.
+class LLMStreamParser {
+public:
+    LLMStreamParser() : reader(Json::CharReaderBuilder().newCharReader()) {}
+    
+    // Returns true when `content` grew
+    bool feed(const char* data, size_t size) {
+        size_t before = content.size();
+        for (size_t i = 0; i < size; i++) {
+            char c = data[i];
+            if (c != '\n') {
+                line.push_back(c);
+                continue;
+            }
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            take_line();
+            line.clear();
+        }
+        return content.size() > before;
+    }
+    
+    std::string content;
+    size_t events = 0;      // data events seen, 0 when the server did not stream
+    bool done = false;      // saw the [DONE] terminator
+    bool truncated = false; // finish_reason "length": cut off by max_tokens
+
+private:
+    void take_line() {
+        // A blank line ends the event
+        if (line.empty()) {
+            if (has_data) dispatch();
+            event_data.clear();
+            has_data = false;
+            return;
+        }
+        if (line.compare(0, 5, "data:") != 0) {
+            return; // comments, event names, ids and retry hints
+        }
+        
+        size_t value = line.size() > 5 && line[5] == ' ' ? 6 : 5;
+        if (has_data) event_data.push_back('\n');
+        event_data.append(line, value, std::string::npos);
+        has_data = true;
+    }
+    
+    void dispatch() {
+        events++;
+        if (event_data == "[DONE]") {
+            done = true;
+            return;
+        }
+        
+        Json::Value chunk;
+        std::string errors;
+        if (!reader->parse(event_data.data(), event_data.data() + event_data.size(), &chunk,
+                           &errors) || !chunk.isObject()) {
+            blog(LOG_WARNING, "LLM Corrector: Skipping malformed stream event: %s",
+                 errors.c_str());
+            return;
+        }
+        
+        const Json::Value& choices = chunk["choices"];
+        if (!choices.isArray() || choices.empty()) return;
+        const Json::Value& finish_reason = choices[0]["finish_reason"];
+        if (finish_reason.isString() && finish_reason.asString() == "length") {
+            truncated = true;
+        }
+        const Json::Value& delta = choices[0]["delta"];
+        if (delta.isObject() && delta["content"].isString()) {
+            content += delta["content"].asString();
+        }
+    }
+    
+    std::unique_ptr<Json::CharReader> reader;
+    std::string line;
+    std::string event_data;
+    bool has_data = false;
+};
+
+// One transcript waiting for its correction
+struct LLMSegment {
+    LLMContext* context;
+    std::string text;
+    std::string prompt;
+    bool has_prompt;
+    uint64_t deadline_ns;
+    llm_corrector_done_cb done;
+    llm_corrector_partial_cb partial; // set for streamed requests
+    void* param;
+};
+
+// One HTTP request, carrying one segment or a batch of them
+struct LLMTransfer {
+    LLMContext* context = nullptr;
+    CURL* easy = nullptr;
+    std::string body;
+    std::vector<LLMSegment> segments;
+    LLMResponse response{};
+    
+    // Only single-segment requests stream; a batch answer is one JSON
+    // document that is useless until it is complete
+    bool streaming = false;
+    LLMStreamParser stream;
+    size_t reported = 0; // bytes of `stream.content` already passed on
+};
+
+// Segments collecting for a shared request. Only segments for the same
+// endpoint, key and prompt can share one.
+struct LLMBatch {
+    uint64_t flush_ns;
+    std::vector<LLMSegment> segments;
+};
+
+static void llm_report_partial(LLMTransfer* transfer);
+
+static size_t llm_write_callback(void* contents, size_t size, size_t nmemb, LLMTransfer* transfer) {
     size_t total_size = size * nmemb;
-    response->data.append(static_cast<char*>(contents), total_size);
+    const char* data = static_cast<char*>(contents);
+    if (transfer->streaming) {
+        // The raw body is still kept for servers that answer without streaming
+        if (transfer->stream.feed(data, total_size)) {
+            llm_report_partial(transfer);
+        }
+    }
+    transfer->response.data.append(data, total_size);
     return total_size;
 }
 
+static bool llm_batchable(const LLMSegment& a, const LLMSegment& b) {
+    return a.context->api_endpoint == b.context->api_endpoint &&
+           a.context->api_key == b.context->api_key &&
+           a.has_prompt == b.has_prompt && a.prompt == b.prompt;
+}
+
+static long llm_remaining_ms(uint64_t deadline_ns, uint64_t now) {
+    long remaining = deadline_ns > now ? (long)((deadline_ns - now) / 1000000) : 0;
+    return remaining > 0 ? remaining : 1L;
+}
+
+static bool llm_start_transfer(LLMTransfer* transfer);
+static void llm_finish_transfer(LLMTransfer* transfer, CURLcode result,
+                                std::vector<LLMTransfer*>& retries);
+
+// Process-wide HTTP transport shared by every corrector. One curl multi
+// handle, driven by a single thread, carries all requests: idle connections
+// are kept alive between requests, requests to the same HTTP/2 server are
+// multiplexed over one connection, and the DNS and TLS session caches are
+// shared, so replacing a corrector after a settings change does not cost a
+// new handshake. Segments submitted with a batch window wait here until the
+// window closes or the batch is full and then go out as one request.
+class LLMTransport {
+public:
+    bool start() {
+        multi = curl_multi_init();
+        share = curl_share_init();
+        if (!multi || !share) {
+            stop();
+            return false;
+        }
+        
+        curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, LLM_MAX_HOST_CONNECTIONS);
+        curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, LLM_MAX_CACHED_CONNECTIONS);
+        
+        // Transfers run on the transport thread, but handles are attached
+        // to the share on the submitting threads and cleaned up on the one
+        // destroying their corrector, so the share needs its locks
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, share_lock);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        
+        stopping = false;
+        thread = std::thread(&LLMTransport::run, this);
+        return true;
+    }
+    
+    void stop() {
+        if (thread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            curl_multi_wakeup(multi);
+            thread.join();
+        }
+        if (multi) {
+            curl_multi_cleanup(multi);
+            multi = nullptr;
+        }
+        if (share) {
+            curl_share_cleanup(share);
+            share = nullptr;
+        }
+    }
+    
+    bool submit(LLMTransfer* transfer) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) return false;
+            incoming.push_back(transfer);
+        }
+        curl_multi_wakeup(multi);
+        return true;
+    }
+    
+    // Adds a segment to an open batch it fits in, or opens one that is sent
+    // `window_ms` from now
+    bool submit_batched(LLMSegment&& segment, long window_ms) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) return false;
+            
+            uint64_t now = os_gettime_ns();
+            LLMBatch* batch = nullptr;
+            for (LLMBatch& open : batches) {
+                if (open.segments.size() < LLM_MAX_BATCH_SEGMENTS &&
+                    llm_batchable(open.segments.front(), segment)) {
+                    batch = &open;
+                    break;
+                }
+            }
+            if (!batch) {
+                batches.push_back(LLMBatch{now + (uint64_t)window_ms * 1000000ULL, {}});
+                batch = &batches.back();
+            }
+            
+            // Never spend more than half a segment's remaining time waiting
+            // for company
+            uint64_t latest = segment.deadline_ns > now ? now + (segment.deadline_ns - now) / 2 : now;
+            batch->flush_ns = std::min(batch->flush_ns, latest);
+            batch->segments.push_back(std::move(segment));
+            if (batch->segments.size() >= LLM_MAX_BATCH_SEGMENTS) {
+                batch->flush_ns = 0;
+            }
+        }
+        curl_multi_wakeup(multi);
+        return true;
+    }
+    
+    CURLSH* share = nullptr;
+
+private:
+    static void share_lock(CURL*, curl_lock_data data, curl_lock_access, void* userptr) {
+        static_cast<LLMTransport*>(userptr)->share_mutexes[share_slot(data)].lock();
+    }
+    
+    static void share_unlock(CURL*, curl_lock_data data, void* userptr) {
+        static_cast<LLMTransport*>(userptr)->share_mutexes[share_slot(data)].unlock();
+    }
+    
+    static size_t share_slot(curl_lock_data data) {
+        return data >= 0 && data < CURL_LOCK_DATA_LAST ? (size_t)data : 0;
+    }
+    
+
+    void run() {
+        os_set_thread_name("ai-transcription: llm");
+        
+        std::vector<LLMTransfer*> retries;
+        for (;;) {
+            std::deque<LLMTransfer*> added;
+            std::vector<LLMBatch> due;
+            uint64_t now = os_gettime_ns();
+            uint64_t next_flush = UINT64_MAX;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopping) break;
+                added.swap(incoming);
+                
+                for (auto it = batches.begin(); it != batches.end();) {
+                    if (it->flush_ns <= now) {
+                        due.push_back(std::move(*it));
+                        it = batches.erase(it);
+                    } else {
+                        next_flush = std::min(next_flush, it->flush_ns);
+                        ++it;
+                    }
+                }
+            }
+            
+            for (LLMBatch& batch : due) {
+                LLMTransfer* transfer = new LLMTransfer();
+                transfer->context = batch.segments.front().context;
+                transfer->segments = std::move(batch.segments);
+                if (llm_start_transfer(transfer)) {
+                    added.push_back(transfer);
+                } else {
+                    llm_finish_transfer(transfer, CURLE_FAILED_INIT, retries);
+                }
+            }
+            for (LLMTransfer* transfer : added) {
+                add(transfer, retries);
+            }
+            
+            int running = 0;
+            curl_multi_perform(multi, &running);
+            
+            int remaining = 0;
+            while (CURLMsg* msg = curl_multi_info_read(multi, &remaining)) {
+                if (msg->msg != CURLMSG_DONE) continue;
+                
+                CURL* easy = msg->easy_handle;
+                CURLcode result = msg->data.result;
+                LLMTransfer* transfer = nullptr;
+                curl_easy_getinfo(easy, CURLINFO_PRIVATE, &transfer);
+                curl_multi_remove_handle(multi, easy);
+                active.erase(transfer);
+                llm_finish_transfer(transfer, result, retries);
+            }
+            
+            // Segments a batch answer left out go out on their own
+            while (!retries.empty()) {
+                std::vector<LLMTransfer*> batch_retries;
+                batch_retries.swap(retries);
+                for (LLMTransfer* transfer : batch_retries) {
+                    add(transfer, retries);
+                }
+            }
+            
+            int timeout_ms = 1000;
+            if (next_flush != UINT64_MAX) {
+                uint64_t wait_ms = (next_flush - now) / 1000000 + 1;
+                timeout_ms = (int)std::min<uint64_t>(wait_ms, (uint64_t)timeout_ms);
+            }
+            curl_multi_poll(multi, nullptr, 0, timeout_ms, nullptr);
+        }
+        
+        // Nobody waits forever: whatever is left resolves to its original text
+        for (LLMTransfer* transfer : active) {
+            curl_multi_remove_handle(multi, transfer->easy);
+            llm_finish_transfer(transfer, CURLE_ABORTED_BY_CALLBACK, retries);
+        }
+        active.clear();
+        
+        std::deque<LLMTransfer*> leftover;
+        std::vector<LLMBatch> unsent;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            leftover.swap(incoming);
+            unsent.swap(batches);
+        }
+        for (LLMTransfer* transfer : leftover) {
+            llm_finish_transfer(transfer, CURLE_ABORTED_BY_CALLBACK, retries);
+        }
+        for (LLMBatch& batch : unsent) {
+            for (LLMSegment& segment : batch.segments) {
+                segment.done(segment.param, bstrdup(segment.text.c_str()));
+            }
+        }
+        for (LLMTransfer* transfer : retries) {
+            llm_finish_transfer(transfer, CURLE_ABORTED_BY_CALLBACK, retries);
+        }
+    }
+    
+    void add(LLMTransfer* transfer, std::vector<LLMTransfer*>& retries) {
+        if (curl_multi_add_handle(multi, transfer->easy) == CURLM_OK) {
+            active.insert(transfer);
+        } else {
+            llm_finish_transfer(transfer, CURLE_FAILED_INIT, retries);
+        }
+    }
+    
+    CURLM* multi = nullptr;
+    std::thread thread;
+    std::mutex mutex;
+    bool stopping = false;
+    std::deque<LLMTransfer*> incoming;
+    std::vector<LLMBatch> batches;
+    std::unordered_set<LLMTransfer*> active; // transport thread only
+    std::mutex share_mutexes[CURL_LOCK_DATA_LAST]; // one per kind of shared data
+};
+
+static std::unique_ptr<LLMTransport> transport;
+
+static CURL* llm_acquire_handle(LLMContext* context) {
+    {
+        std::lock_guard<std::mutex> lock(context->handles_mutex);
+        if (!context->idle_handles.empty()) {
+            CURL* easy = context->idle_handles.back();
+            context->idle_handles.pop_back();
+            return easy;
+        }
+    }
+    
+    CURL* easy = curl_easy_init();
+    if (!easy) return nullptr;
+    
+    curl_easy_setopt(easy, CURLOPT_URL, context->api_endpoint.c_str());
+    curl_easy_setopt(easy, CURLOPT_HTTPHEADER, context->headers);
+    curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, llm_write_callback);
+    curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_SHARE, transport->share);
+    return easy;
+}
+
+static void llm_release_handle(LLMContext* context, CURL* easy) {
+    curl_easy_setopt(easy, CURLOPT_POSTFIELDS, nullptr);
+    std::lock_guard<std::mutex> lock(context->handles_mutex);
+    context->idle_handles.push_back(easy);
+}
+
+// Room for the corrected text, which is about as long as the input; a
+// fixed limit either truncates long segments or over-reserves short ones
+static int llm_max_tokens(size_t chars) {
+    size_t tokens = chars / 3 + 32;
+    return (int)std::min<size_t>(tokens, 2048);
+}
+
+// Builds the chat-completions body: the plain single-segment form, or the
+// indexed form when the transfer carries a batch
+static std::string llm_build_body(LLMContext* context, const std::vector<LLMSegment>& segments,
+                                  bool stream) {
+    const LLMSegment& first = segments.front();
+    
+    // Prepare JSON payload for LLM API
+    Json::Value json_data = context->request_template;
+    Json::Value messages(Json::arrayValue);
+    
+    // System message
+    std::string system_prompt = first.has_prompt ? first.prompt : LLM_DEFAULT_PROMPT;
+    if (segments.size() > 1) {
+        system_prompt += "\n\n";
+        system_prompt += LLM_BATCH_INSTRUCTIONS;
+    }
+    Json::Value system_msg;
+    system_msg["role"] = "system";
+    system_msg["content"] = system_prompt;
+    messages.append(system_msg);
+    
+    // User message with transcription
+    Json::Value user_msg;
+    user_msg["role"] = "user";
+    size_t chars = 0;
+    if (segments.size() == 1) {
+        user_msg["content"] = std::string("Please correct any errors in this transcription: \"") +
+                             first.text + "\"";
+        chars = first.text.size();
+    } else {
+        Json::Value items(Json::arrayValue);
+        for (size_t i = 0; i < segments.size(); i++) {
+            Json::Value item;
+            item["index"] = (Json::UInt)i;
+            item["text"] = segments[i].text;
+            items.append(item);
+            chars += segments[i].text.size() + 24;
+        }
+        user_msg["content"] = Json::writeString(context->writer, items);
+    }
+    messages.append(user_msg);
+    
+    json_data["messages"] = messages;
+    json_data["max_tokens"] = llm_max_tokens(chars);
+    if (stream) {
+        json_data["stream"] = true;
+    }
+    return Json::writeString(context->writer, json_data);
+}
+
+static bool llm_start_transfer(LLMTransfer* transfer) {
+    LLMContext* context = transfer->context;
+    transfer->streaming = transfer->segments.size() == 1 && transfer->segments[0].partial;
+    
+    try {
+        transfer->body = llm_build_body(context, transfer->segments, transfer->streaming);
+    } catch (const std::exception& e) {
+        blog(LOG_ERROR, "LLM Corrector: Exception occurred: %s", e.what());
+        return false;
+    }
+    
+    transfer->easy = llm_acquire_handle(context);
+    if (!transfer->easy) {
+        blog(LOG_ERROR, "LLM Corrector: Failed to initialize CURL");
+        return false;
+    }
+    
+    // The request must be answered before the earliest deadline it carries
+    uint64_t deadline = UINT64_MAX;
+    for (const LLMSegment& segment : transfer->segments) {
+        deadline = std::min(deadline, segment.deadline_ns);
+    }
+    
+    curl_easy_setopt(transfer->easy, CURLOPT_POSTFIELDS, transfer->body.c_str());
+    curl_easy_setopt(transfer->easy, CURLOPT_POSTFIELDSIZE, (long)transfer->body.size());
+    curl_easy_setopt(transfer->easy, CURLOPT_WRITEDATA, transfer);
+    curl_easy_setopt(transfer->easy, CURLOPT_TIMEOUT_MS, llm_remaining_ms(deadline, os_gettime_ns()));
+    curl_easy_setopt(transfer->easy, CURLOPT_PRIVATE, transfer);
+    return true;
+}
+
+// Pulls choices[0].message.content out of a chat-completions response.
+// `truncated` is set when the answer was cut off by max_tokens.
+static bool llm_extract_content(const std::string& data, std::string& content,
+                                bool* truncated = nullptr) {
+    Json::Value json_response;
+    Json::CharReaderBuilder reader_builder;
+    std::string errors;
+    
+    std::istringstream response_stream(data);
+    if (!Json::parseFromStream(reader_builder, response_stream, &json_response, &errors)) {
+        blog(LOG_ERROR, "LLM Corrector: Failed to parse JSON response: %s", errors.c_str());
+        return false;
+    }
+    
+    if (json_response.isMember("choices") && json_response["choices"].isArray() &&
+        json_response["choices"].size() > 0) {
+        
+        const Json::Value& choice = json_response["choices"][0];
+        if (truncated) {
+            *truncated = choice["finish_reason"].isString() &&
+                         choice["finish_reason"].asString() == "length";
+        }
+        if (choice.isMember("message") && choice["message"].isMember("content") &&
+            choice["message"]["content"].isString()) {
+            content = choice["message"]["content"].asString();
+            return true;
+        }
+    }
+    return false;
+}
+
+static void llm_trim(std::string& text) {
+    text.erase(0, text.find_first_not_of(" \t\n\r"));
+    text.erase(text.find_last_not_of(" \t\n\r") + 1);
+}
+
+// Passes the streamed answer so far to the caller, without the leading
+// whitespace and opening quote that llm_result strips from the final one
+static void llm_report_partial(LLMTransfer* transfer) {
+    const LLMSegment& segment = transfer->segments.front();
+    const std::string& content = transfer->stream.content;
+    
+    size_t begin = content.find_first_not_of(" \t\n\r");
+    if (begin == std::string::npos) return;
+    if (content[begin] == '"') begin++;
+    if (begin >= content.size() || content.size() <= transfer->reported) return;
+    
+    transfer->reported = content.size();
+    segment.partial(segment.param, content.c_str() + begin);
+}
+
+// Turns an answer from the LLM into a result and remembers it
+static char* llm_result(const LLMSegment& segment, std::string corrected_text) {
+    // Clean up the response (remove quotes, trim whitespace)
+    llm_trim(corrected_text);
+    if (corrected_text.size() >= 2 &&
+        corrected_text.front() == '"' && corrected_text.back() == '"') {
+        corrected_text = corrected_text.substr(1, corrected_text.length() - 2);
+        llm_trim(corrected_text);
+    }
+    
+    const char* result = segment.text.c_str();
+    if (!corrected_text.empty() && corrected_text != segment.text) {
+        blog(LOG_INFO, "LLM Corrector: '%s' -> '%s'", segment.text.c_str(),
+             corrected_text.c_str());
+        result = corrected_text.c_str();
+    }
+    
+    correction_cache_store(segment.text.c_str(),
+                           segment.has_prompt ? segment.prompt.c_str() : nullptr,
+                           segment.context->model.c_str(),
+                           segment.context->api_endpoint.c_str(), result);
+    return bstrdup(result);
+}
+
+// Splits a batch answer back into its segments; returns how many it filled
+static size_t llm_split_batch(const std::string& content, std::vector<LLMSegment>& segments,
+                              std::vector<char*>& results) {
+    // Models like to wrap JSON in a code fence
+    size_t begin = content.find('{');
+    size_t end = content.rfind('}');
+    if (begin == std::string::npos || end == std::string::npos || end < begin) {
+        return 0;
+    }
+    
+    Json::Value answer;
+    Json::CharReaderBuilder reader_builder;
+    std::string errors;
+    std::istringstream answer_stream(content.substr(begin, end - begin + 1));
+    if (!Json::parseFromStream(reader_builder, answer_stream, &answer, &errors) ||
+        !answer.isObject() || !answer["segments"].isArray()) {
+        return 0;
+    }
+    
+    size_t filled = 0;
+    for (const Json::Value& item : answer["segments"]) {
+        if (!item.isObject() || !item["index"].isIntegral() || !item["text"].isString()) {
+            continue;
+        }
+        Json::Int64 index = item["index"].asInt64();
+        if (index < 0 || (size_t)index >= segments.size() || results[(size_t)index]) {
+            continue;
+        }
+        results[(size_t)index] = llm_result(segments[(size_t)index], item["text"].asString());
+        filled++;
+    }
+    return filled;
+}
+
+// Resolves every segment of a finished transfer. Segments a batch answer
+// did not cover are queued in `retries` as single requests while their
+// deadline allows. Done callbacks run last, after the handle is back in
+// its pool, because a caller may destroy its corrector from one.
+static void llm_finish_transfer(LLMTransfer* transfer, CURLcode result,
+                                std::vector<LLMTransfer*>& retries) {
+    std::vector<LLMSegment>& segments = transfer->segments;
+    std::vector<char*> results(segments.size(), nullptr);
+    
+    bool answered = false;
+    if (result != CURLE_OK) {
+        blog(LOG_ERROR, "LLM Corrector: CURL request failed: %s", curl_easy_strerror(result));
+    } else {
+        curl_easy_getinfo(transfer->easy, CURLINFO_RESPONSE_CODE, &transfer->response.response_code);
+        if (transfer->response.response_code != 200) {
+            blog(LOG_ERROR, "LLM Corrector: API request failed with code: %ld",
+                 transfer->response.response_code);
+        } else {
+            answered = true;
+        }
+    }
+    
+    if (answered) {
+        try {
+            std::string content;
+            bool extracted;
+            bool truncated = false;
+            if (transfer->streaming && transfer->stream.events > 0) {
+                // A connection dropped mid-answer can still end with CURLE_OK
+                content = transfer->stream.content;
+                extracted = transfer->stream.done;
+                truncated = transfer->stream.truncated;
+                if (!extracted) {
+                    blog(LOG_WARNING, "LLM Corrector: Stream ended without [DONE], "
+                         "keeping the original text");
+                }
+            } else {
+                extracted = llm_extract_content(transfer->response.data, content, &truncated);
+            }
+            // Half an answer must not reach the screen or the cache
+            if (extracted && truncated) {
+                blog(LOG_WARNING, "LLM Corrector: Answer cut off by max_tokens, "
+                     "keeping the original text");
+                extracted = false;
+            }
+            if (extracted) {
+                if (segments.size() == 1) {
+                    results[0] = llm_result(segments[0], content);
+                } else {
+                    size_t filled = llm_split_batch(content, segments, results);
+                    if (filled < segments.size()) {
+                        blog(LOG_WARNING, "LLM Corrector: Batch answer covered %zu of %zu "
+                             "segments, retrying the rest one by one", filled, segments.size());
+                    } else {
+                        blog(LOG_DEBUG, "LLM Corrector: Corrected %zu segments in one request",
+                             segments.size());
+                    }
+                }
+            } else {
+                blog(LOG_DEBUG, "LLM Corrector: No correction needed or invalid response");
+            }
+        } catch (const std::exception& e) {
+            blog(LOG_ERROR, "LLM Corrector: Exception occurred: %s", e.what());
+        }
+    }
+    
+    if (transfer->easy) {
+        llm_release_handle(transfer->context, transfer->easy);
+    }
+    
+    uint64_t now = os_gettime_ns();
+    std::vector<std::pair<size_t, char*>> resolved;
+    for (size_t i = 0; i < segments.size(); i++) {
+        if (!results[i] && answered && segments.size() > 1 && segments[i].deadline_ns > now) {
+            LLMTransfer* retry = new LLMTransfer();
+            retry->context = segments[i].context;
+            retry->segments.push_back(segments[i]);
+            if (llm_start_transfer(retry)) {
+                retries.push_back(retry);
+                continue;
+            }
+            delete retry;
+        }
+        if (!results[i]) {
+            results[i] = bstrdup(segments[i].text.c_str()); // Return original on error
+        }
+        resolved.emplace_back(i, results[i]);
+    }
+    
+    std::vector<LLMSegment> done_segments;
+    done_segments.reserve(resolved.size());
+    for (auto& entry : resolved) {
+        done_segments.push_back(segments[entry.first]);
+    }
+    delete transfer;
+    
+    for (size_t i = 0; i < done_segments.size(); i++) {
+        done_segments[i].done(done_segments[i].param, resolved[i].second);
+    }
+}
+
 extern "C" {
 
+void llm_corrector_global_init(void) {
+    if (transport) return;
+    
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    transport = std::make_unique<LLMTransport>();
+    if (!transport->start()) {
+        blog(LOG_ERROR, "LLM Corrector: Failed to start HTTP transport");
+        transport.reset();
+    }
+}
+
+void llm_corrector_global_shutdown(void) {
+    if (transport) {
+        transport->stop();
+        transport.reset();
+    }
+    curl_global_cleanup();
+}
+
 void* llm_corrector_create(const char* api_endpoint, const char* api_key) {
     if (!api_endpoint || !api_key || strlen(api_endpoint) == 0 || strlen(api_key) == 0) {
         blog(LOG_ERROR, "LLM Corrector: Invalid API endpoint or key");
         return nullptr;
     }
+    if (!transport) {
+        blog(LOG_ERROR, "LLM Corrector: HTTP transport not running");
+        return nullptr;
+    }
     
     auto context = std::make_unique<LLMContext>();
     context->api_endpoint = std::string(api_endpoint);
     context->api_key = std::string(api_key);
     context->initialized = false;
     
-    // Initialize libcurl
-    context->curl_handle = curl_easy_init();
-    if (!context->curl_handle) {
-        blog(LOG_ERROR, "LLM Corrector: Failed to initialize CURL");
+    std::string auth_header = "Authorization: Bearer " + context->api_key;
+    context->headers = curl_slist_append(nullptr, "Content-Type: application/json");
+    context->headers = curl_slist_append(context->headers, auth_header.c_str());
+    if (!context->headers) {
+        blog(LOG_ERROR, "LLM Corrector: Failed to build request headers");
         return nullptr;
     }
     
-    // Set basic CURL options
-    curl_easy_setopt(context->curl_handle, CURLOPT_TIMEOUT, 30L);
-    curl_easy_setopt(context->curl_handle, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(context->curl_handle, CURLOPT_WRITEFUNCTION, llm_write_callback);
+    context->model = "gpt-3.5-turbo"; // Default model
+    context->request_template["model"] = context->model;
+    context->request_template["temperature"] = 0.3;
+    context->writer["indentation"] = "";
     
     blog(LOG_INFO, "LLM Corrector: Created with endpoint: %s", api_endpoint);
     context->initialized = true;
@@ -59,133 +824,161 @@ void llm_corrector_destroy(void* ctx) {
     
     LLMContext* context = static_cast<LLMContext*>(ctx);
     
-    if (context->curl_handle) {
-        curl_easy_cleanup(context->curl_handle);
+    // Callers only destroy a corrector with no request in flight, so every
+    // handle is back in the pool
+    for (CURL* easy : context->idle_handles) {
+        curl_easy_cleanup(easy);
     }
+    curl_slist_free_all(context->headers);
     
     blog(LOG_INFO, "LLM Corrector: Destroyed");
     delete context;
 }
 
-char* llm_corrector_improve(void* ctx, const char* original_text, 
-                           const char* context_prompt, float confidence) {
-    if (!ctx || !original_text || strlen(original_text) == 0) {
+void llm_corrector_set_batch_window(void* ctx, long window_ms) {
+    if (!ctx) return;
+    static_cast<LLMContext*>(ctx)->batch_window_ms = window_ms > 0 ? window_ms : 0;
+}
+
+char* llm_corrector_build_request(void* ctx, const char* original_text,
+                                  const char* context_prompt, size_t segments, bool stream) {
+    if (!ctx || !original_text || segments == 0) return nullptr;
+    
+    LLMContext* context = static_cast<LLMContext*>(ctx);
+    LLMSegment segment{context, original_text, context_prompt ? context_prompt : "",
+                       context_prompt != nullptr, 0, nullptr, nullptr, nullptr};
+    std::vector<LLMSegment> batch(segments, segment);
+    try {
+        return bstrdup(llm_build_body(context, batch, stream && segments == 1).c_str());
+    } catch (const std::exception& e) {
+        blog(LOG_ERROR, "LLM Corrector: Exception occurred: %s", e.what());
         return nullptr;
     }
+}
+
+char* llm_corrector_parse_response(const char* response, bool streamed) {
+    if (!response) return nullptr;
+    
+    try {
+        std::string content;
+        if (streamed) {
+            LLMStreamParser parser;
+            parser.feed(response, strlen(response));
+            if (parser.events == 0) return nullptr;
+            content = std::move(parser.content);
+        } else if (!llm_extract_content(response, content)) {
+            return nullptr;
+        }
+        return bstrdup(content.c_str());
+    } catch (const std::exception& e) {
+        blog(LOG_ERROR, "LLM Corrector: Exception occurred: %s", e.what());
+        return nullptr;
+    }
+}
+
+bool llm_corrector_improve_async(void* ctx, const char* original_text,
+                                 const char* context_prompt, float confidence,
+                                 long timeout_ms, llm_corrector_done_cb done, void* param) {
+    return llm_corrector_improve_streaming(ctx, original_text, context_prompt, confidence,
+                                           timeout_ms, nullptr, done, param, nullptr);
+}
+
+bool llm_corrector_improve_streaming(void* ctx, const char* original_text,
+                                     const char* context_prompt, float confidence,
+                                     long timeout_ms, llm_corrector_partial_cb partial,
+                                     llm_corrector_done_cb done, void* param, bool* local) {
+    if (local) *local = false;
+    if (!ctx || !original_text || strlen(original_text) == 0 || !done) {
+        return false;
+    }
     
     LLMContext* context = static_cast<LLMContext*>(ctx);
-    if (!context->initialized) {
+    if (!context->initialized || !transport) {
         blog(LOG_ERROR, "LLM Corrector: Not initialized");
-        return nullptr;
+        return false;
     }
     
     // Skip correction if confidence is already high
     if (confidence > 0.95f) {
         blog(LOG_DEBUG, "LLM Corrector: Skipping correction, confidence too high: %.2f", confidence);
-        return strdup(original_text);
+        if (local) *local = true;
+        done(param, bstrdup(original_text));
+        return true;
     }
     
-    try {
-        // Prepare JSON payload for LLM API
-        Json::Value json_data;
-        Json::Value messages(Json::arrayValue);
-        
-        // System message
-        Json::Value system_msg;
-        system_msg["role"] = "system";
-        system_msg["content"] = context_prompt ? context_prompt : 
-            "You are a helpful assistant that corrects transcription errors. "
-            "Return only the corrected text without explanations.";
-        messages.append(system_msg);
-        
-        // User message with transcription
-        Json::Value user_msg;
-        user_msg["role"] = "user";
-        user_msg["content"] = std::string("Please correct any errors in this transcription: \"") + 
-                             original_text + "\"";
-        messages.append(user_msg);
-        
-        json_data["model"] = "gpt-3.5-turbo"; // Default model
-        json_data["messages"] = messages;
-        json_data["max_tokens"] = 150;
-        json_data["temperature"] = 0.3;
-        
-        Json::StreamWriterBuilder builder;
-        std::string json_string = Json::writeString(builder, json_data);
-        
-        // Set up CURL request
-        struct curl_slist* headers = nullptr;
-        std::string auth_header = "Authorization: Bearer " + context->api_key;
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        headers = curl_slist_append(headers, auth_header.c_str());
-        
-        LLMResponse response;
-        
-        curl_easy_setopt(context->curl_handle, CURLOPT_URL, context->api_endpoint.c_str());
-        curl_easy_setopt(context->curl_handle, CURLOPT_POSTFIELDS, json_string.c_str());
-        curl_easy_setopt(context->curl_handle, CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt(context->curl_handle, CURLOPT_WRITEDATA, &response);
-        
-        // Perform the request
-        CURLcode curl_result = curl_easy_perform(context->curl_handle);
-        curl_slist_free_all(headers);
-        
-        if (curl_result != CURLE_OK) {
-            blog(LOG_ERROR, "LLM Corrector: CURL request failed: %s", 
-                 curl_easy_strerror(curl_result));
-            return strdup(original_text); // Return original on error
-        }
-        
-        curl_easy_getinfo(context->curl_handle, CURLINFO_RESPONSE_CODE, &response.response_code);
-        
-        if (response.response_code != 200) {
-            blog(LOG_ERROR, "LLM Corrector: API request failed with code: %ld", 
-                 response.response_code);
-            return strdup(original_text);
-        }
-        
-        // Parse JSON response
-        Json::Value json_response;
-        Json::CharReaderBuilder reader_builder;
-        std::string errors;
-        
-        std::istringstream response_stream(response.data);
-        if (!Json::parseFromStream(reader_builder, response_stream, &json_response, &errors)) {
-            blog(LOG_ERROR, "LLM Corrector: Failed to parse JSON response: %s", errors.c_str());
-            return strdup(original_text);
-        }
-        
-        // Extract corrected text
-        if (json_response.isMember("choices") && json_response["choices"].isArray() &&
-            json_response["choices"].size() > 0) {
-            
-            const Json::Value& choice = json_response["choices"][0];
-            if (choice.isMember("message") && choice["message"].isMember("content")) {
-                std::string corrected_text = choice["message"]["content"].asString();
-                
-                // Clean up the response (remove quotes, trim whitespace)
-                if (corrected_text.front() == '"' && corrected_text.back() == '"') {
-                    corrected_text = corrected_text.substr(1, corrected_text.length() - 2);
-                }
-                
-                // Trim whitespace
-                corrected_text.erase(0, corrected_text.find_first_not_of(" \t\n\r"));
-                corrected_text.erase(corrected_text.find_last_not_of(" \t\n\r") + 1);
-                
-                if (!corrected_text.empty() && corrected_text != original_text) {
-                    blog(LOG_INFO, "LLM Corrector: '%s' -> '%s'", original_text, corrected_text.c_str());
-                    return strdup(corrected_text.c_str());
-                }
-            }
-        }
-        
-        blog(LOG_DEBUG, "LLM Corrector: No correction needed or invalid response");
-        return strdup(original_text);
-        
-    } catch (const std::exception& e) {
-        blog(LOG_ERROR, "LLM Corrector: Exception occurred: %s", e.what());
-        return strdup(original_text);
+    // Repeated phrases never reach the network
+    char* cached = correction_cache_lookup(original_text, context_prompt, context->model.c_str(),
+                                           context->api_endpoint.c_str());
+    if (cached) {
+        blog(LOG_DEBUG, "LLM Corrector: Cache hit for '%s'", original_text);
+        if (local) *local = true;
+        done(param, cached);
+        return true;
     }
+    
+    uint64_t now = os_gettime_ns();
+    LLMSegment segment{context, original_text, context_prompt ? context_prompt : "",
+                       context_prompt != nullptr,
+                       now + (uint64_t)(timeout_ms > 0 ? timeout_ms : 1L) * 1000000ULL,
+                       done, partial, param};
+    
+    // A streamed answer starts showing after the first token, which is
+    // worth more than sharing a request
+    long window_ms = context->batch_window_ms;
+    if (window_ms > 0 && !partial) {
+        return transport->submit_batched(std::move(segment), window_ms);
+    }
+    
+    auto transfer = std::make_unique<LLMTransfer>();
+    transfer->context = context;
+    transfer->segments.push_back(std::move(segment));
+    if (!llm_start_transfer(transfer.get())) {
+        if (transfer->easy) llm_release_handle(context, transfer->easy);
+        return false;
+    }
+    
+    if (!transport->submit(transfer.get())) {
+        llm_release_handle(context, transfer->easy);
+        return false;
+    }
+    transfer.release();
+    return true;
+}
+
+struct LLMWaiter {
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool finished = false;
+    char* result = nullptr;
+};
+
+static void llm_wake_waiter(void* param, char* corrected) {
+    LLMWaiter* waiter = static_cast<LLMWaiter*>(param);
+    std::lock_guard<std::mutex> lock(waiter->mutex);
+    waiter->result = corrected;
+    waiter->finished = true;
+    waiter->cond.notify_one();
+}
+
+char* llm_corrector_improve(void* ctx, const char* original_text,
+                           const char* context_prompt, float confidence) {
+    return llm_corrector_improve_timeout(ctx, original_text, context_prompt, confidence,
+                                         LLM_DEFAULT_TIMEOUT_MS);
+}
+
+char* llm_corrector_improve_timeout(void* ctx, const char* original_text,
+                                   const char* context_prompt, float confidence,
+                                   long timeout_ms) {
+    LLMWaiter waiter;
+    if (!llm_corrector_improve_async(ctx, original_text, context_prompt, confidence,
+                                     timeout_ms, llm_wake_waiter, &waiter)) {
+        return nullptr;
+    }
+    
+    // curl enforces the timeout, so this always returns
+    std::unique_lock<std::mutex> lock(waiter.mutex);
+    waiter.cond.wait(lock, [&waiter] { return waiter.finished; });
+    return waiter.result;
 }
 
-} // extern "C"
\ No newline at end of file
+} // extern "C"
@@ -1,14 +1,72 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Starts and stops the HTTP transport shared by all correctors; every
+// corrector must be destroyed before shutdown
+void llm_corrector_global_init(void);
+void llm_corrector_global_shutdown(void);
+
 void* llm_corrector_create(const char* api_endpoint, const char* api_key);
 void llm_corrector_destroy(void* context);
 char* llm_corrector_improve(void* context, const char* original_text, 
                            const char* context_prompt, float confidence);
 
+// Same as llm_corrector_improve, but the request is abandoned after
+// `timeout_ms` and the original text returned
+char* llm_corrector_improve_timeout(void* context, const char* original_text,
+                                   const char* context_prompt, float confidence,
+                                   long timeout_ms);
+
+// Holds requests for up to `window_ms` so requests for the same endpoint,
+// key and prompt, from any corrector, can share one chat-completions call.
+// 0 (the default) sends every request on its own.
+void llm_corrector_set_batch_window(void* context, long window_ms);
+
+// Receives the result of llm_corrector_improve_async on the transport
+// thread; `corrected` is bfree'd by the callee and holds the original text
+// when the request failed or timed out. Keep it short, the transport thread
+// serves every corrector.
+typedef void (*llm_corrector_done_cb)(void* param, char* corrected);
+
+// Receives the corrected text generated so far, on the transport thread,
+// whenever a streamed answer grows. `partial` is only valid during the call
+// and may end in the middle of a word.
+typedef void (*llm_corrector_partial_cb)(void* param, const char* partial);
+
+// Queues a request on the shared transport and returns without waiting.
+// On false `done` is never called.
+bool llm_corrector_improve_async(void* context, const char* original_text,
+                                 const char* context_prompt, float confidence,
+                                 long timeout_ms, llm_corrector_done_cb done, void* param);
+
+// Same as llm_corrector_improve_async, but asks for a streamed answer
+// (server-sent events) and reports it through `partial` as it arrives,
+// before `done` delivers the final text. Streamed requests are never
+// batched. A server that answers in one piece is handled as usual. When the
+// confidence gate or the cache answers without a request, `done` is called
+// before this returns and `*local` (if given) is set; a network answer can
+// also arrive before the return but leaves it false.
+bool llm_corrector_improve_streaming(void* context, const char* original_text,
+                                     const char* context_prompt, float confidence,
+                                     long timeout_ms, llm_corrector_partial_cb partial,
+                                     llm_corrector_done_cb done, void* param, bool* local);
+
+// The JSON steps of a correction without the network, for benchmarks.
+// llm_corrector_build_request returns the body that would be sent for
+// `segments` copies of the text (the batch form when there is more than
+// one); llm_corrector_parse_response returns the text a chat-completions
+// response carries, read as server-sent events when `streamed`, or NULL.
+// Both results are bfree'd by the caller.
+char* llm_corrector_build_request(void* context, const char* original_text,
+                                  const char* context_prompt, size_t segments, bool stream);
+char* llm_corrector_parse_response(const char* response, bool streamed);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "load-shedder.h"
+#include <util/threading.h>
+#include <string.h>
+
+#define SHED_SAMPLE_RATE 16000
+#define SHED_RTF_HIGH 0.9          // slower than this leaves too little headroom
+#define SHED_RTF_LOW 0.6           // faster than this is calm
+#define SHED_RTF_SMOOTHING 0.3     // weight of the newest job
+#define SHED_BACKLOG_HIGH_MS 2000  // live jobs go stale at 3 s
+#define SHED_BACKLOG_LOW_MS 500
+#define SHED_MIN_SAMPLES 2         // jobs measured at a level before it is judged
+#define SHED_ESCALATE_HOLD_NS 2000000000ULL
+#define SHED_RECOVER_HOLD_NS 10000000000ULL
+#define SHED_RECOVER_HOLD_MAX_NS 160000000000ULL
+#define SHED_FLAP_NS 30000000000ULL    // falling behind this soon undoes a recovery
+#define SHED_STABLE_NS 120000000000ULL // a recovery that held this long is trusted again
+
+static const char* const level_names[LOAD_LEVEL_COUNT] = {
+    "normal",
+    "no LLM correction",
+    "short overlap",
+    "small model",
+    "speech only",
+};
+
+static void publish_level(struct load_shedder* shedder) {
+    os_atomic_set_long(&shedder->level_published, (long)shedder->level);
+    if ((long)shedder->level > os_atomic_load_long(&shedder->max_level)) {
+        os_atomic_set_long(&shedder->max_level, (long)shedder->level);
+    }
+}
+
+// A new level starts unmeasured, so it is judged by its own jobs only
+static void change_level(struct load_shedder* shedder, enum load_level level, uint64_t now_ns) {
+    shedder->level = level;
+    shedder->rtf = 0.0;
+    shedder->rtf_samples = 0;
+    shedder->changed_ns = now_ns;
+    shedder->calm_since_ns = 0;
+    publish_level(shedder);
+}
+
+void load_shedder_init(struct load_shedder* shedder) {
+    memset(shedder, 0, sizeof(*shedder));
+    shedder->recover_hold_ns = SHED_RECOVER_HOLD_NS;
+}
+
+void load_shedder_reset(struct load_shedder* shedder) {
+    shedder->level = LOAD_LEVEL_NORMAL;
+    shedder->rtf = 0.0;
+    shedder->rtf_samples = 0;
+    shedder->carry_ns = 0;
+    shedder->changed_ns = 0;
+    shedder->calm_since_ns = 0;
+    shedder->recovered_ns = 0;
+    shedder->recover_hold_ns = SHED_RECOVER_HOLD_NS;
+    shedder->last_ns = 0;
+    publish_level(shedder);
+    os_atomic_set_long(&shedder->rtf_milli, 0);
+    os_atomic_set_long(&shedder->backlog_ms, 0);
+}
+
+enum load_level load_shedder_update(struct load_shedder* shedder, uint64_t busy_ns,
+                                    size_t samples, size_t backlog_samples,
+                                    uint64_t dropped_total, uint64_t now_ns) {
+    if (shedder->last_ns && shedder->level != LOAD_LEVEL_NORMAL) {
+        os_atomic_set_long(&shedder->degraded_ms, os_atomic_load_long(&shedder->degraded_ms) +
+                           (long)((now_ns - shedder->last_ns) / 1000000));
+    }
+    shedder->last_ns = now_ns;
+    if (!shedder->changed_ns) {
+        shedder->changed_ns = now_ns;
+    }
+    
+    // Jobs without new audio (an utterance's closing piece) still cost time;
+    // it is charged to the next job that has some
+    shedder->carry_ns += busy_ns;
+    if (samples > 0) {
+        double audio_ns = (double)samples * 1e9 / SHED_SAMPLE_RATE;
+        double rtf = (double)shedder->carry_ns / audio_ns;
+        shedder->rtf = shedder->rtf_samples == 0 ? rtf
+            : shedder->rtf + SHED_RTF_SMOOTHING * (rtf - shedder->rtf);
+        shedder->rtf_samples++;
+        shedder->carry_ns = 0;
+    }
+    
+    bool dropped = dropped_total > shedder->dropped;
+    shedder->dropped = dropped_total;
+    uint64_t backlog_ms = (uint64_t)backlog_samples * 1000 / SHED_SAMPLE_RATE;
+    os_atomic_set_long(&shedder->rtf_milli, (long)(shedder->rtf * 1000.0));
+    os_atomic_set_long(&shedder->backlog_ms, (long)backlog_ms);
+    
+    if (shedder->rtf_samples < SHED_MIN_SAMPLES) {
+        return shedder->level;
+    }
+    
+    // A backlog only counts against a level that drains it slowly
+    bool behind = dropped || shedder->rtf > SHED_RTF_HIGH ||
+                  (backlog_ms > SHED_BACKLOG_HIGH_MS && shedder->rtf > SHED_RTF_LOW);
+    bool calm = !dropped && shedder->rtf < SHED_RTF_LOW && backlog_ms < SHED_BACKLOG_LOW_MS;
+    
+    if (behind) {
+        if (shedder->level + 1 < LOAD_LEVEL_COUNT &&
+            now_ns - shedder->changed_ns >= SHED_ESCALATE_HOLD_NS) {
+            if (shedder->recovered_ns && now_ns - shedder->recovered_ns < SHED_FLAP_NS) {
+                shedder->recover_hold_ns *= 2;
+                if (shedder->recover_hold_ns > SHED_RECOVER_HOLD_MAX_NS) {
+                    shedder->recover_hold_ns = SHED_RECOVER_HOLD_MAX_NS;
+                }
+            }
+            change_level(shedder, (enum load_level)(shedder->level + 1), now_ns);
+            os_atomic_inc_long(&shedder->escalations);
+        } else {
+            shedder->calm_since_ns = 0;
+        }
+        return shedder->level;
+    }
+    
+    if (!calm) {
+        shedder->calm_since_ns = 0;
+        return shedder->level;
+    }
+    
+    if (!shedder->calm_since_ns) {
+        shedder->calm_since_ns = now_ns;
+    }
+    if (shedder->recovered_ns && now_ns - shedder->recovered_ns >= SHED_STABLE_NS) {
+        shedder->recover_hold_ns = SHED_RECOVER_HOLD_NS;
+    }
+    if (shedder->level > LOAD_LEVEL_NORMAL &&
+        now_ns - shedder->calm_since_ns >= shedder->recover_hold_ns &&
+        now_ns - shedder->changed_ns >= shedder->recover_hold_ns) {
+        change_level(shedder, (enum load_level)(shedder->level - 1), now_ns);
+        shedder->recovered_ns = now_ns;
+        os_atomic_inc_long(&shedder->recoveries);
+    }
+    return shedder->level;
+}
+
+void load_shedder_get_stats(struct load_shedder* shedder, struct load_shedder_stats* stats) {
+    stats->level = (uint64_t)os_atomic_load_long(&shedder->level_published);
+    stats->max_level = (uint64_t)os_atomic_load_long(&shedder->max_level);
+    stats->escalations = (uint64_t)os_atomic_load_long(&shedder->escalations);
+    stats->recoveries = (uint64_t)os_atomic_load_long(&shedder->recoveries);
+    stats->rtf_milli = (uint64_t)os_atomic_load_long(&shedder->rtf_milli);
+    stats->backlog_ms = (uint64_t)os_atomic_load_long(&shedder->backlog_ms);
+    stats->degraded_ms = (uint64_t)os_atomic_load_long(&shedder->degraded_ms);
+}
+
+const char* load_level_name(enum load_level level) {
+    return (unsigned)level < LOAD_LEVEL_COUNT ? level_names[level] : "unknown";
+}
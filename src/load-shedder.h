@@ -0,0 +1,84 @@
+#pragma once
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Graceful degradation for a stream whose inference falls behind real time.
+//
+// After every inference job the controller gets the time the job took, the
+// new audio it covered and the audio still waiting for a worker. From these
+// it keeps a smoothed real-time factor (processing time per second of new
+// audio). A stream that is too slow, has a growing backlog or is losing jobs
+// is degraded one level at a time, cheapest quality loss first; each level
+// keeps everything the levels below it shed. Once it has stayed comfortably
+// ahead for a while it climbs back one level at a time. A stream that falls
+// behind again right after recovering waits twice as long before its next
+// recovery, so it does not flap between two levels.
+//
+// The controller only decides; the filter applies the levels. It is owned
+// by the stream's inference jobs. load_shedder_get_stats may be called from
+// any thread.
+
+enum load_level {
+    LOAD_LEVEL_NORMAL,
+    LOAD_LEVEL_NO_LLM,        // transcripts skip LLM correction
+    LOAD_LEVEL_SHORT_OVERLAP, // streaming windows keep less audio as context
+    LOAD_LEVEL_SMALL_MODEL,   // decode with the smaller fallback model
+    LOAD_LEVEL_SPEECH_ONLY,   // the VAD is forced on with a short hangover
+    LOAD_LEVEL_COUNT
+};
+
+struct load_shedder_stats {
+    uint64_t level;
+    uint64_t max_level;
+    uint64_t escalations;
+    uint64_t recoveries;
+    uint64_t rtf_milli;   // smoothed real-time factor, times 1000
+    uint64_t backlog_ms;  // audio waiting at the last job
+    uint64_t degraded_ms; // time spent above LOAD_LEVEL_NORMAL
+};
+
+struct load_shedder {
+    enum load_level level;
+    double rtf;
+    uint32_t rtf_samples;     // jobs measured at the current level
+    uint64_t carry_ns;        // time of jobs without new audio, not yet charged
+    uint64_t changed_ns;      // last level change
+    uint64_t calm_since_ns;   // 0 while not calm
+    uint64_t recovered_ns;    // last recovery
+    uint64_t recover_hold_ns; // calm time needed before the next recovery
+    uint64_t dropped;         // job drops seen so far
+    uint64_t last_ns;
+    
+    // Published for load_shedder_get_stats
+    volatile long level_published;
+    volatile long max_level;
+    volatile long escalations;
+    volatile long recoveries;
+    volatile long rtf_milli;
+    volatile long backlog_ms;
+    volatile long degraded_ms;
+};
+
+void load_shedder_init(struct load_shedder* shedder);
+
+// Back to LOAD_LEVEL_NORMAL with nothing measured; the counters are kept
+void load_shedder_reset(struct load_shedder* shedder);
+
+// Feeds one finished job: `busy_ns` spent on `samples` new 16kHz samples,
+// `backlog_samples` still waiting, and the stream's total count of dropped
+// jobs. Returns the level for the next job.
+enum load_level load_shedder_update(struct load_shedder* shedder, uint64_t busy_ns,
+                                    size_t samples, size_t backlog_samples,
+                                    uint64_t dropped_total, uint64_t now_ns);
+
+void load_shedder_get_stats(struct load_shedder* shedder, struct load_shedder_stats* stats);
+
+const char* load_level_name(enum load_level level);
+
+#ifdef __cplusplus
+}
+#endif
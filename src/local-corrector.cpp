@@ -0,0 +1,475 @@
+#include "local-corrector.h"
+#include <obs-module.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <string>
+#include <memory>
+#include <vector>
+#include <unordered_set>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cctype>
+
+#define LOCAL_MAX_PHRASE_WORDS 4
+#define LOCAL_MAX_KEY 64 // longer runs are never names
+
+struct VocabularyTerm {
+    std::string text;  // what the transcript should say
+    size_t words;
+};
+
+// One way of writing a term: the term itself or a known mishearing
+struct Spelling {
+    std::string key;
+    std::string phonetic;
+    uint32_t term;
+};
+
+struct LocalContext {
+    std::string path;
+    uintmax_t size = 0;
+    int64_t mtime = 0;
+    
+    std::vector<VocabularyTerm> terms;
+    std::vector<Spelling> spellings;
+    size_t longest = 0; // longest spelling key
+    
+    // Deletion neighbourhood: the hash of every variant of every spelling
+    // with up to its budget of characters removed, sorted. Two keys within
+    // distance d share a variant with at most d deletions from each, so a
+    // lookup only checks spellings that share one with the query.
+    std::vector<std::pair<uint64_t, uint32_t>> variants;
+};
+
+struct TranscriptWord {
+    std::string lead;  // punctuation before the word
+    std::string core;
+    std::string trail; // punctuation after it
+    std::string key;
+};
+
+static bool is_edge_punct(unsigned char c) {
+    return c < 0x80 && ispunct(c);
+}
+
+// Lowercase letters and digits; bytes of multi-byte UTF-8 characters are
+// kept as they are. "Stream-Labs" and "streamlabs" share a key.
+static std::string spelling_key(const std::string& text) {
+    std::string key;
+    for (unsigned char c : text) {
+        if (c >= 0x80) {
+            key += (char)c;
+        } else if (isalnum(c)) {
+            key += (char)tolower(c);
+        }
+    }
+    return key;
+}
+
+// Soundex-style consonant classes over the whole key rather than the first
+// four sounds, so the code tells long names apart. Vowels separate
+// repeated classes; h, w and y are ignored.
+static std::string phonetic_key(const std::string& key) {
+    static const char classes[27] = "01230120022455012623010202";
+    std::string code;
+    char previous = 0;
+    
+    for (size_t i = 0; i < key.size(); i++) {
+        unsigned char c = (unsigned char)key[i];
+        if (c < 'a' || c > 'z') {
+            code += (char)c;
+            previous = 0;
+            continue;
+        }
+        
+        char cls = classes[c - 'a'];
+        if (i == 0) {
+            code += (char)c;
+            previous = cls;
+        } else if (c == 'h' || c == 'w' || c == 'y') {
+            continue;
+        } else if (cls == '0') {
+            previous = 0;
+        } else if (cls != previous) {
+            code += cls;
+            previous = cls;
+        }
+    }
+    return code;
+}
+
+// Unrestricted Damerau-Levenshtein distance: adjacent transpositions count
+// once, even with other edits around them. Both keys are at most
+// LOCAL_MAX_KEY bytes.
+static int edit_distance(const std::string& a, const std::string& b) {
+    const size_t n = a.size();
+    const size_t m = b.size();
+    const size_t stride = m + 2;
+    const int infinity = (int)(n + m);
+    
+    int table[(LOCAL_MAX_KEY + 2) * (LOCAL_MAX_KEY + 2)];
+    auto at = [&](size_t i, size_t j) -> int& { return table[i * stride + j]; };
+    size_t last_row[256] = {0};
+    
+    at(0, 0) = infinity;
+    for (size_t i = 0; i <= n; i++) {
+        at(i + 1, 0) = infinity;
+        at(i + 1, 1) = (int)i;
+    }
+    for (size_t j = 0; j <= m; j++) {
+        at(0, j + 1) = infinity;
+        at(1, j + 1) = (int)j;
+    }
+    
+    for (size_t i = 1; i <= n; i++) {
+        size_t last_col = 0;
+        for (size_t j = 1; j <= m; j++) {
+            size_t i1 = last_row[(unsigned char)b[j - 1]];
+            size_t j1 = last_col;
+            int cost = 1;
+            if (a[i - 1] == b[j - 1]) {
+                cost = 0;
+                last_col = j;
+            }
+            at(i + 1, j + 1) = std::min({at(i, j) + cost, at(i + 1, j) + 1, at(i, j + 1) + 1,
+                                         at(i1, j1) + (int)(i - i1 - 1) + 1 + (int)(j - j1 - 1)});
+        }
+        last_row[(unsigned char)a[i - 1]] = i;
+    }
+    return at(n + 1, m + 1);
+}
+
+// Edits allowed for a key of `length` bytes; the last one only counts when
+// the words also sound alike. Never more than two, which the deletion index
+// relies on.
+static int distance_budget(size_t length) {
+    if (length < 5) return 0;
+    if (length < 8) return 1;
+    return 2;
+}
+
+// FNV-1a of `key` without the characters at `skip1` and `skip2`
+static uint64_t variant_hash(const std::string& key, size_t skip1, size_t skip2) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < key.size(); i++) {
+        if (i == skip1 || i == skip2) continue;
+        hash ^= (unsigned char)key[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Hashes of `key` and of every string left after deleting up to `deletions`
+// (at most two) of its characters; duplicates are harmless
+static void delete_variants(const std::string& key, int deletions, std::vector<uint64_t>& out) {
+    const size_t none = std::string::npos;
+    const size_t n = key.size();
+    
+    out.push_back(variant_hash(key, none, none));
+    if (deletions < 1) return;
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0 && key[i] == key[i - 1]) continue; // same string as deleting i - 1
+        out.push_back(variant_hash(key, i, none));
+    }
+    if (deletions < 2) return;
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = i + 1; j < n; j++) {
+            out.push_back(variant_hash(key, i, j));
+        }
+    }
+}
+
+static void add_spelling(LocalContext* context, std::unordered_set<std::string>& seen,
+                         const std::string& key, uint32_t term) {
+    if (!seen.insert(key).second) return; // first spelling wins
+    
+    uint32_t index = (uint32_t)context->spellings.size();
+    context->spellings.push_back(Spelling{key, phonetic_key(key), term});
+    context->longest = std::max(context->longest, key.size());
+    
+    std::vector<uint64_t> hashes;
+    delete_variants(key, distance_budget(key.size()), hashes);
+    for (uint64_t hash : hashes) {
+        context->variants.emplace_back(hash, index);
+    }
+}
+
+struct TermMatch {
+    uint32_t spelling = UINT32_MAX;
+    int distance = 0;
+};
+
+// Closest acceptable vocabulary spelling for `key`, if any
+static TermMatch find_spelling(const LocalContext* context, const std::string& key) {
+    TermMatch best;
+    int budget = distance_budget(key.size());
+    if (key.size() > context->longest + (size_t)budget) return best;
+    
+    std::vector<uint64_t> hashes;
+    delete_variants(key, budget, hashes);
+    
+    std::vector<uint32_t> candidates;
+    for (uint64_t hash : hashes) {
+        auto range = std::equal_range(context->variants.begin(), context->variants.end(),
+                                      std::make_pair(hash, (uint32_t)0),
+                                      [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (auto it = range.first; it != range.second; ++it) {
+            candidates.push_back(it->second);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    
+    std::string phonetic;
+    for (uint32_t index : candidates) {
+        const Spelling& spelling = context->spellings[index];
+        int allowed = std::min(budget, distance_budget(spelling.key.size()));
+        int distance = edit_distance(key, spelling.key);
+        
+        bool accept = distance < allowed || distance == 0;
+        if (!accept && distance == allowed) {
+            if (phonetic.empty()) phonetic = phonetic_key(key);
+            accept = phonetic == spelling.phonetic;
+        }
+        if (accept && (best.spelling == UINT32_MAX || distance < best.distance)) {
+            best.spelling = index;
+            best.distance = distance;
+        }
+    }
+    return best;
+}
+
+static void trim(std::string& text) {
+    text.erase(0, text.find_first_not_of(" \t\r\n"));
+    text.erase(text.find_last_not_of(" \t\r\n") + 1);
+}
+
+static size_t count_words(const std::string& text) {
+    size_t words = 0;
+    bool in_word = false;
+    for (unsigned char c : text) {
+        bool space = isspace(c) != 0;
+        if (!space && !in_word) words++;
+        in_word = !space;
+    }
+    return words;
+}
+
+static bool load_vocabulary(LocalContext* context, const std::filesystem::path& path) {
+    std::ifstream file(path);
+    if (!file) return false;
+    
+    std::unordered_set<std::string> seen;
+    std::string line;
+    bool first = true;
+    while (std::getline(file, line)) {
+        if (first && line.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+            line.erase(0, 3);
+        }
+        first = false;
+        
+        trim(line);
+        if (line.empty() || line[0] == '#') continue;
+        
+        std::string heard = line;
+        std::string text = line;
+        size_t arrow = line.find("=>");
+        if (arrow != std::string::npos) {
+            heard = line.substr(0, arrow);
+            text = line.substr(arrow + 2);
+            trim(heard);
+            trim(text);
+        }
+        
+        std::string key = spelling_key(heard);
+        if (key.empty() || key.size() > LOCAL_MAX_KEY || text.empty()) continue;
+        
+        uint32_t term = (uint32_t)context->terms.size();
+        context->terms.push_back(VocabularyTerm{text, count_words(text)});
+        add_spelling(context, seen, key, term);
+        
+        // The term itself is always a valid spelling of itself
+        if (arrow != std::string::npos) {
+            std::string own_key = spelling_key(text);
+            if (!own_key.empty() && own_key.size() <= LOCAL_MAX_KEY) {
+                add_spelling(context, seen, own_key, term);
+            }
+        }
+    }
+    
+    std::sort(context->variants.begin(), context->variants.end());
+    return true;
+}
+
+static bool file_identity(const std::filesystem::path& path, uintmax_t& size, int64_t& mtime) {
+    std::error_code ec;
+    size = std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    auto time = std::filesystem::last_write_time(path, ec);
+    if (ec) return false;
+    mtime = (int64_t)time.time_since_epoch().count();
+    return true;
+}
+
+static std::vector<TranscriptWord> split_transcript(const char* text) {
+    std::vector<TranscriptWord> words;
+    const char* p = text;
+    
+    while (*p) {
+        while (*p && isspace((unsigned char)*p)) p++;
+        if (!*p) break;
+        
+        const char* begin = p;
+        while (*p && !isspace((unsigned char)*p)) p++;
+        const char* end = p;
+        
+        const char* core_begin = begin;
+        while (core_begin < end && is_edge_punct((unsigned char)*core_begin)) core_begin++;
+        const char* core_end = end;
+        while (core_end > core_begin && is_edge_punct((unsigned char)core_end[-1])) core_end--;
+        
+        TranscriptWord word;
+        word.lead.assign(begin, core_begin);
+        word.core.assign(core_begin, core_end);
+        word.trail.assign(core_end, end);
+        word.key = spelling_key(word.core);
+        words.push_back(std::move(word));
+    }
+    return words;
+}
+
+extern "C" {
+
+void* local_corrector_create(const char* vocabulary_path) {
+    if (!vocabulary_path || !*vocabulary_path) return nullptr;
+    
+    uint64_t start = os_gettime_ns();
+    std::error_code ec;
+    std::filesystem::path path = std::filesystem::u8path(vocabulary_path);
+    std::filesystem::path canonical = std::filesystem::canonical(path, ec);
+    
+    auto context = std::make_unique<LocalContext>();
+    if (ec || !file_identity(canonical, context->size, context->mtime) ||
+        !load_vocabulary(context.get(), canonical)) {
+        blog(LOG_ERROR, "Local Corrector: Cannot read vocabulary %s", vocabulary_path);
+        return nullptr;
+    }
+    context->path = canonical.u8string();
+    
+    blog(LOG_INFO, "Local Corrector: Loaded %zu terms (%zu spellings) from %s in %.1f ms",
+         context->terms.size(), context->spellings.size(), context->path.c_str(),
+         (os_gettime_ns() - start) / 1000000.0);
+    return context.release();
+}
+
+void local_corrector_destroy(void* ctx) {
+    delete static_cast<LocalContext*>(ctx);
+}
+
+bool local_corrector_vocabulary_changed(void* ctx, const char* vocabulary_path) {
+    if (!ctx || !vocabulary_path) return true;
+    
+    LocalContext* context = static_cast<LocalContext*>(ctx);
+    std::error_code ec;
+    std::filesystem::path canonical =
+        std::filesystem::canonical(std::filesystem::u8path(vocabulary_path), ec);
+    
+    uintmax_t size;
+    int64_t mtime;
+    if (ec || !file_identity(canonical, size, mtime)) return true;
+    return canonical.u8string() != context->path || size != context->size ||
+           mtime != context->mtime;
+}
+
+bool local_corrector_correct(void* ctx, const char* text, const float* word_confidence,
+                             size_t word_count, struct local_correction* result) {
+    if (!result) return false;
+    *result = local_correction{};
+    if (!ctx || !text) return false;
+    
+    const LocalContext* context = static_cast<const LocalContext*>(ctx);
+    std::vector<TranscriptWord> words = split_transcript(text);
+    if (word_confidence && word_count != words.size()) {
+        word_confidence = nullptr;
+    }
+    
+    std::string output;
+    std::vector<float> confidence;
+    size_t replaced = 0;
+    
+    for (size_t i = 0; i < words.size();) {
+        // Try every run starting here; the closest match wins, longer runs on
+        // a tie. Runs never cross punctuation.
+        TermMatch best;
+        size_t best_length = 0;
+        std::string key;
+        for (size_t length = 1; length <= LOCAL_MAX_PHRASE_WORDS && i + length <= words.size();
+             length++) {
+            const TranscriptWord& last = words[i + length - 1];
+            if (length > 1 && (!words[i + length - 2].trail.empty() || !last.lead.empty())) break;
+            
+            if (last.key.empty()) break; // punctuation or symbols only
+            
+            key += last.key;
+            if (key.size() > LOCAL_MAX_KEY || key.size() > context->longest + 2) break;
+            
+            // Edits that could delete a whole word at either end mean the
+            // run reaches into a neighbour that is not part of the name
+            TermMatch match = find_spelling(context, key);
+            if (match.spelling != UINT32_MAX &&
+                (size_t)match.distance < std::min(words[i].key.size(), last.key.size()) &&
+                (best.spelling == UINT32_MAX || match.distance <= best.distance)) {
+                best = match;
+                best_length = length;
+            }
+        }
+        
+        if (!output.empty()) output += ' ';
+        
+        if (best.spelling == UINT32_MAX) {
+            output += words[i].lead + words[i].core + words[i].trail;
+            if (word_confidence) confidence.push_back(word_confidence[i]);
+            i++;
+            continue;
+        }
+        
+        std::string heard = words[i].core;
+        for (size_t k = 1; k < best_length; k++) {
+            heard += ' ' + words[i + k].core;
+        }
+        
+        const VocabularyTerm& term = context->terms[context->spellings[best.spelling].term];
+        output += words[i].lead + term.text + words[i + best_length - 1].trail;
+        
+        if (heard != term.text) {
+            blog(LOG_INFO, "Local Corrector: '%s' -> '%s'", heard.c_str(), term.text.c_str());
+            replaced++;
+            if (word_confidence) confidence.insert(confidence.end(), term.words, 1.0f);
+        } else if (word_confidence) {
+            confidence.insert(confidence.end(), word_confidence + i,
+                              word_confidence + i + best_length);
+        }
+        i += best_length;
+    }
+    
+    if (replaced == 0) return false;
+    
+    result->text = bstrdup(output.c_str());
+    result->replaced = replaced;
+    if (word_confidence) {
+        result->word_count = confidence.size();
+        result->word_confidence = (float*)bmemdup(confidence.data(),
+                                                  confidence.size() * sizeof(float));
+    }
+    return true;
+}
+
+void local_correction_free(struct local_correction* result) {
+    if (!result) return;
+    bfree(result->text);
+    bfree(result->word_confidence);
+    *result = local_correction{};
+}
+
+} // extern "C"
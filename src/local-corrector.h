@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// In-process corrector for names and jargon from a user vocabulary.
+//
+// The vocabulary is a UTF-8 text file with one term per line, such as a
+// channel name, a sponsor or a piece of game jargon. Blank lines and lines
+// starting with '#' are ignored. A line of the form `heard => Term` adds a
+// known mishearing that is rewritten to `Term`. Terms are indexed by their
+// spelling (lowercase letters and digits only) together with every variant
+// of it missing one or two characters, so a lookup only has to check the
+// few terms that share a variant with the query; candidates are then
+// confirmed by Damerau-Levenshtein distance. Runs of up to four transcript
+// words are looked up, so "stream labs" can become "Streamlabs". The
+// distance allowed grows with the length of the term, and the largest one
+// is only accepted when the two also sound alike. No network is involved,
+// and a transcript takes microseconds.
+
+void* local_corrector_create(const char* vocabulary_path);
+void local_corrector_destroy(void* context);
+
+// True when `vocabulary_path` no longer names the file this corrector was
+// loaded from, either because the path differs or because the file changed
+bool local_corrector_vocabulary_changed(void* context, const char* vocabulary_path);
+
+struct local_correction {
+    char* text;
+    float* word_confidence; // realigned to `text`, rewritten words at 1; NULL if none was given
+    size_t word_count;
+    size_t replaced;        // terms rewritten
+};
+
+// Rewrites near-miss words in `text`. `word_confidence` may be NULL and is
+// otherwise one entry per whitespace-separated word. Returns false, with
+// `result` zeroed, when nothing was rewritten.
+bool local_corrector_correct(void* context, const char* text, const float* word_confidence,
+                             size_t word_count, struct local_correction* result);
+void local_correction_free(struct local_correction* result);
+
+#ifdef __cplusplus
+}
+#endif
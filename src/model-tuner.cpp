@@ -0,0 +1,536 @@
+#include "model-tuner.h"
+#include "whisper-engine.h"
+#include <obs-module.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <json/json.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MODEL_TUNER_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#define TUNER_SAMPLE_RATE 16000
+#define TUNER_MIN_DECODE_MS 1000  // the filter pads shorter audio to a second
+#define TUNER_TARGET_RTF 0.8f     // headroom for everything else on the machine
+#define TUNER_RUNS 2              // timed decodes per setting, the fastest counts
+#define TUNER_THREAD_GAIN 0.9     // more threads must be at least 10% faster
+#define TUNER_REFERENCE_MS 12000
+#define TUNER_TWO_PI 6.283185307179586
+
+// Candidate streaming windows, shortest first
+static const uint32_t window_candidates[] = {500, 1000, 2000};
+
+// whisper.cpp quantization suffixes, most accurate first. The unsuffixed
+// file is the f16 model.
+static const struct {
+    const char* suffix;
+    int rank;
+} quantizations[] = {
+    {"", 0},     {"f16", 0},  {"q8_0", 1}, {"q6_k", 2}, {"q5_1", 3},
+    {"q5_k", 4}, {"q5_0", 5}, {"q4_1", 6}, {"q4_k", 7}, {"q4_0", 8},
+};
+
+struct Variant {
+    std::string path;
+    std::string quantization;
+    int rank;
+    uintmax_t size;
+    int64_t mtime;
+};
+
+struct Candidate {
+    std::string path;
+    int threads = 0;
+    uint32_t window_ms = 0;
+    double decode_ms = 0.0;
+    
+    double rtf() const { return decode_ms / window_ms; }
+    double latency_ms() const { return window_ms + decode_ms; }
+};
+
+static struct {
+    std::mutex mutex; // held for a whole calibration
+    std::string persist_path;
+    std::string reference_path;
+    std::string machine;
+    std::vector<float> reference;
+    std::unordered_map<std::string, double> decode_ms; // by measurement_key
+} tuner;
+
+// CPU model and core counts; the same model file decodes at a different
+// speed on every machine
+static std::string machine_id() {
+    std::string brand;
+#ifdef MODEL_TUNER_X86
+    unsigned int regs[12] = {0};
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0x80000000);
+    if ((unsigned int)info[0] >= 0x80000004) {
+        for (int i = 0; i < 3; i++) {
+            __cpuid(info, 0x80000002 + i);
+            memcpy(regs + i * 4, info, sizeof(info));
+        }
+    }
+#else
+    unsigned int max_leaf = __get_cpuid_max(0x80000000, nullptr);
+    if (max_leaf >= 0x80000004) {
+        for (unsigned int i = 0; i < 3; i++) {
+            __get_cpuid(0x80000002 + i, &regs[i * 4], &regs[i * 4 + 1], &regs[i * 4 + 2],
+                        &regs[i * 4 + 3]);
+        }
+    }
+#endif
+    char text[sizeof(regs) + 1] = {0};
+    memcpy(text, regs, sizeof(regs));
+    brand = text;
+    brand.erase(0, brand.find_first_not_of(' '));
+#endif
+    if (brand.empty()) {
+        brand = "unknown cpu";
+    }
+    return brand + " " + std::to_string(os_get_physical_cores()) + "c/" +
+           std::to_string(os_get_logical_cores()) + "t";
+}
+
+static std::string measurement_key(const Variant& variant, int threads, int beam_size,
+                                   uint32_t window_ms, uint32_t overlap_ms) {
+    return tuner.machine + "|" + variant.path + "|" + std::to_string(variant.size) + "|" +
+           std::to_string(variant.mtime) + "|" + std::to_string(threads) + "|" +
+           std::to_string(beam_size) + "|" + std::to_string(window_ms) + "|" +
+           std::to_string(overlap_ms);
+}
+
+static bool file_variant(const std::filesystem::path& path, Variant& variant) {
+    std::error_code ec;
+    variant.path = path.u8string();
+    variant.size = std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    variant.mtime = (int64_t)std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+    return !ec;
+}
+
+// Splits "ggml-base.en-q5_1" into the model name and the quantization rank.
+// Without a known suffix the whole stem is the name of an f16 model.
+static void parse_variant(const std::string& stem, std::string& base, std::string& quant,
+                          int& rank) {
+    size_t dash = stem.rfind('-');
+    std::string suffix = dash == std::string::npos ? "" : stem.substr(dash + 1);
+    std::transform(suffix.begin(), suffix.end(), suffix.begin(),
+                   [](unsigned char c) { return (char)tolower(c); });
+    
+    for (const auto& q : quantizations) {
+        if (*q.suffix && suffix == q.suffix) {
+            base = stem.substr(0, dash);
+            quant = q.suffix;
+            rank = q.rank;
+            return;
+        }
+    }
+    base = stem;
+    quant = "f16";
+    rank = 0;
+}
+
+// The configured model and its other quantizations, most accurate first
+static std::vector<Variant> find_variants(const char* model_path) {
+    std::vector<Variant> variants;
+    std::error_code ec;
+    std::filesystem::path configured = std::filesystem::u8path(model_path);
+    
+    std::string base, quant;
+    int rank = 0;
+    parse_variant(configured.stem().u8string(), base, quant, rank);
+    
+    std::filesystem::path directory = configured.parent_path();
+    if (directory.empty()) directory = ".";
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+        if (!entry.is_regular_file(ec) || entry.path().extension() != ".bin") continue;
+        
+        std::string entry_base, entry_quant;
+        int entry_rank = 0;
+        parse_variant(entry.path().stem().u8string(), entry_base, entry_quant, entry_rank);
+        
+        Variant variant;
+        if (entry_base != base || !file_variant(entry.path(), variant)) continue;
+        variant.quantization = entry_quant;
+        variant.rank = entry_rank;
+        variants.push_back(variant);
+    }
+    
+    // The configured file alone if the directory could not be listed
+    if (variants.empty()) {
+        Variant variant;
+        if (file_variant(configured, variant)) {
+            variant.quantization = quant;
+            variant.rank = rank;
+            variants.push_back(variant);
+        }
+    }
+    
+    std::stable_sort(variants.begin(), variants.end(),
+                     [](const Variant& a, const Variant& b) { return a.rank < b.rank; });
+    return variants;
+}
+
+static uint32_t read_le(const unsigned char* p, int bytes) {
+    uint32_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+// 16 kHz mono 16-bit PCM only; the bundled clip is stored that way
+static bool load_reference(const std::string& path, std::vector<float>& samples) {
+    std::ifstream file(std::filesystem::u8path(path), std::ios::binary);
+    if (!file) return false;
+    std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)),
+                                    std::istreambuf_iterator<char>());
+    if (data.size() < 12 || memcmp(data.data(), "RIFF", 4) != 0 ||
+        memcmp(data.data() + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+    
+    bool format_ok = false;
+    for (size_t pos = 12; pos + 8 <= data.size();) {
+        const unsigned char* chunk = data.data() + pos;
+        size_t size = read_le(chunk + 4, 4);
+        size_t body = pos + 8;
+        if (body + size > data.size()) size = data.size() - body;
+        
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            format_ok = read_le(chunk + 8, 2) == 1 && read_le(chunk + 10, 2) == 1 &&
+                        read_le(chunk + 12, 4) == TUNER_SAMPLE_RATE &&
+                        read_le(chunk + 22, 2) == 16;
+        } else if (memcmp(chunk, "data", 4) == 0 && format_ok) {
+            samples.resize(size / 2);
+            for (size_t i = 0; i < samples.size(); i++) {
+                samples[i] = (int16_t)read_le(data.data() + body + i * 2, 2) / 32768.0f;
+            }
+            return !samples.empty();
+        }
+        pos = body + size + (size & 1);
+    }
+    return false;
+}
+
+// Voiced syllables on a few formants with pauses between, like the bench
+// harness generates. Whisper decodes fewer tokens on it than on speech, so
+// a real clip gives more representative timings.
+static void synthesize_reference(std::vector<float>& samples) {
+    const double formants[3] = {600.0, 1400.0, 2600.0};
+    samples.assign((size_t)TUNER_REFERENCE_MS * TUNER_SAMPLE_RATE / 1000, 0.0f);
+    
+    uint32_t seed = 12345;
+    double phase = 0.0;
+    bool voiced = false;
+    for (size_t pos = 0; pos < samples.size();) {
+        seed = seed * 1664525u + 1013904223u;
+        double span = voiced ? 0.5 + (seed >> 8) / 16777216.0 * 0.7
+                             : 0.2 + (seed >> 8) / 16777216.0 * 0.3;
+        voiced = !voiced;
+        size_t end = std::min(samples.size(), pos + (size_t)(span * TUNER_SAMPLE_RATE));
+        double pitch = 110.0 + (seed % 90);
+        
+        for (size_t i = pos; voiced && i < end; i++) {
+            double t = (double)(i - pos) / TUNER_SAMPLE_RATE;
+            phase += TUNER_TWO_PI * pitch / TUNER_SAMPLE_RATE;
+            double value = 0.0;
+            for (int h = 1; h * pitch < 4000.0; h++) {
+                double gain = 0.0;
+                for (int f = 0; f < 3; f++) {
+                    double d = (h * pitch - formants[f]) / 300.0;
+                    gain += std::exp(-d * d) / (f + 1);
+                }
+                value += gain * std::sin(h * phase);
+            }
+            samples[i] = (float)(0.15 * (0.5 - 0.5 * std::cos(TUNER_TWO_PI * 4.0 * t)) * value);
+        }
+        pos = end;
+    }
+}
+
+static const std::vector<float>& reference_clip() {
+    if (tuner.reference.empty()) {
+        if (!tuner.reference_path.empty() && load_reference(tuner.reference_path, tuner.reference)) {
+            blog(LOG_INFO, "Model tuner: Using reference clip %s", tuner.reference_path.c_str());
+        } else {
+            synthesize_reference(tuner.reference);
+        }
+    }
+    return tuner.reference;
+}
+
+// Fastest of TUNER_RUNS decodes of `duration_ms` of the reference clip
+static double time_decode(void* engine, uint32_t duration_ms) {
+    const std::vector<float>& reference = reference_clip();
+    std::vector<float> audio((size_t)std::max(duration_ms, (uint32_t)TUNER_MIN_DECODE_MS) *
+                             TUNER_SAMPLE_RATE / 1000);
+    for (size_t i = 0; i < audio.size(); i++) {
+        audio[i] = reference[i % reference.size()];
+    }
+    
+    double best = 0.0;
+    for (int run = 0; run < TUNER_RUNS; run++) {
+        whisper_transcript transcript;
+        uint64_t start = os_gettime_ns();
+        whisper_engine_transcribe_detailed(engine, audio.data(), audio.size(), "en", &transcript);
+        double elapsed = (os_gettime_ns() - start) / 1000000.0;
+        whisper_transcript_free(&transcript);
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+static bool fits(const Candidate& candidate, uint32_t budget_ms) {
+    return candidate.rtf() <= TUNER_TARGET_RTF && candidate.latency_ms() <= budget_ms;
+}
+
+// Over budget everywhere: the lowest latency that still keeps up with real
+// time, or failing that the lowest real-time factor
+static bool better_fallback(const Candidate& candidate, const Candidate& current) {
+    if (current.window_ms == 0) return true;
+    bool keeps_up = candidate.rtf() <= TUNER_TARGET_RTF;
+    if (keeps_up != (current.rtf() <= TUNER_TARGET_RTF)) return keeps_up;
+    return keeps_up ? candidate.latency_ms() < current.latency_ms()
+                    : candidate.rtf() < current.rtf();
+}
+
+static bool canceled(const struct model_tuner_request* request) {
+    return request->cancel && *request->cancel;
+}
+
+static void load(const std::string& path) {
+    std::ifstream file(std::filesystem::u8path(path));
+    if (!file) return;
+    
+    Json::CharReaderBuilder reader_builder;
+    std::unique_ptr<Json::CharReader> reader(reader_builder.newCharReader());
+    std::string line;
+    while (std::getline(file, line)) {
+        Json::Value entry;
+        std::string errors;
+        if (reader->parse(line.data(), line.data() + line.size(), &entry, &errors) &&
+            entry.isObject() && entry["key"].isString() && entry["decode_ms"].isNumeric()) {
+            tuner.decode_ms[entry["key"].asString()] = entry["decode_ms"].asDouble();
+        }
+    }
+    blog(LOG_INFO, "Model tuner: loaded %zu measurements from %s", tuner.decode_ms.size(),
+         path.c_str());
+}
+
+static void save(const std::string& path) {
+    std::error_code error;
+    std::filesystem::path target = std::filesystem::u8path(path);
+    if (target.has_parent_path()) {
+        std::filesystem::create_directories(target.parent_path(), error);
+    }
+    
+    // Write next to the target and rename, so a crash never leaves half a file
+    std::filesystem::path temp_path = target;
+    temp_path += ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::trunc);
+        if (!file) {
+            blog(LOG_WARNING, "Model tuner: cannot write %s", temp_path.u8string().c_str());
+            return;
+        }
+        
+        Json::StreamWriterBuilder writer;
+        writer["indentation"] = "";
+        for (const auto& measurement : tuner.decode_ms) {
+            Json::Value entry;
+            entry["key"] = measurement.first;
+            entry["decode_ms"] = measurement.second;
+            file << Json::writeString(writer, entry) << '\n';
+        }
+    }
+    
+    std::filesystem::rename(temp_path, target, error);
+    if (error) {
+        blog(LOG_WARNING, "Model tuner: cannot replace %s: %s", path.c_str(),
+             error.message().c_str());
+    }
+}
+
+extern "C" {
+
+void model_tuner_init(const char* persist_path, const char* reference_path) {
+    std::lock_guard<std::mutex> lock(tuner.mutex);
+    tuner.persist_path = persist_path ? persist_path : "";
+    tuner.reference_path = reference_path ? reference_path : "";
+    if (!tuner.persist_path.empty()) {
+        load(tuner.persist_path);
+    }
+}
+
+void model_tuner_shutdown(void) {
+    std::lock_guard<std::mutex> lock(tuner.mutex);
+    tuner.decode_ms.clear();
+    tuner.reference.clear();
+    tuner.reference.shrink_to_fit();
+}
+
+bool model_tuner_select(const struct model_tuner_request* request, struct model_tuning* tuning) {
+    if (!tuning) return false;
+    memset(tuning, 0, sizeof(*tuning));
+    if (!request || !request->model_path || !*request->model_path) return false;
+    
+    std::lock_guard<std::mutex> lock(tuner.mutex);
+    if (canceled(request)) return false;
+    if (tuner.machine.empty()) {
+        tuner.machine = machine_id();
+    }
+    
+    std::vector<Variant> variants = find_variants(request->model_path);
+    int max_threads = std::max(request->max_threads, 1);
+    int beam_size = std::max(request->beam_size, 1);
+    
+    Candidate chosen;
+    Candidate fallback;
+    bool found = false;
+    bool stopped = false;
+    size_t measured = 0;
+    uint64_t start = os_gettime_ns();
+    
+    for (const Variant& variant : variants) {
+        void* engine = nullptr;
+        bool failed = false;
+        Candidate best;
+        double previous_ms = 0.0;
+        
+        // Doubling threads until it stops paying off
+        for (int threads = 1; !failed && !stopped; threads = std::min(threads * 2, max_threads)) {
+            double reference_ms = 0.0;
+            for (uint32_t window_ms : window_candidates) {
+                std::string key = measurement_key(variant, threads, beam_size, window_ms,
+                                                  request->overlap_ms);
+                auto saved = tuner.decode_ms.find(key);
+                Candidate candidate{variant.path, threads, window_ms, 0.0};
+                
+                if (saved != tuner.decode_ms.end() && !request->recalibrate) {
+                    candidate.decode_ms = saved->second;
+                } else if (canceled(request)) {
+                    stopped = true;
+                    break;
+                } else {
+                    if (!engine) {
+                        engine = whisper_engine_create(variant.path.c_str());
+                        if (!engine) {
+                            failed = true;
+                            break;
+                        }
+                        // The first decode allocates buffers and warms caches
+                        time_decode(engine, TUNER_MIN_DECODE_MS);
+                    }
+                    whisper_engine_params params = {threads, beam_size, true, true};
+                    whisper_engine_set_params(engine, &params);
+                    candidate.decode_ms = time_decode(engine, window_ms + request->overlap_ms);
+                    tuner.decode_ms[key] = candidate.decode_ms;
+                    measured++;
+                }
+                
+                reference_ms = candidate.decode_ms;
+                if (better_fallback(candidate, fallback)) {
+                    fallback = candidate;
+                }
+                if (fits(candidate, request->latency_budget_ms) &&
+                    (best.window_ms == 0 || candidate.latency_ms() < best.latency_ms())) {
+                    best = candidate;
+                }
+            }
+            
+            if (stopped) break;
+            bool gained = previous_ms == 0.0 || reference_ms < previous_ms * TUNER_THREAD_GAIN;
+            previous_ms = reference_ms;
+            if (threads >= max_threads || !gained) break;
+        }
+        
+        if (engine) whisper_engine_destroy(engine);
+        if (stopped) break;
+        if (failed) {
+            blog(LOG_WARNING, "Model tuner: Skipping %s, it could not be loaded",
+                 variant.path.c_str());
+            continue;
+        }
+        
+        blog(LOG_INFO, "Model tuner: %s (%s) %s", variant.path.c_str(),
+             variant.quantization.c_str(),
+             best.window_ms ? "fits the budget" : "is too slow for the budget");
+        if (best.window_ms) {
+            chosen = best;
+            found = true;
+            break;
+        }
+    }
+    
+    // Measurements from a canceled run are kept, but a variant picked from
+    // part of them could be the wrong one
+    if (measured > 0 && !tuner.persist_path.empty()) {
+        save(tuner.persist_path);
+    }
+    if (stopped) {
+        blog(LOG_INFO, "Model tuner: Calibration of %s canceled after %zu settings",
+             request->model_path, measured);
+        return false;
+    }
+    if (!found) {
+        chosen = fallback;
+    }
+    if (chosen.window_ms == 0) {
+        blog(LOG_WARNING, "Model tuner: No usable model variant for %s", request->model_path);
+        return false;
+    }
+    
+    tuning->model_path = bstrdup(chosen.path.c_str());
+    tuning->n_threads = chosen.threads;
+    tuning->window_ms = chosen.window_ms;
+    tuning->rtf = (float)chosen.rtf();
+    tuning->latency_ms = (uint32_t)chosen.latency_ms();
+    tuning->within_budget = found;
+    
+    blog(LOG_INFO, "Model tuner: %s with %d threads and a %u ms window (RTF %.2f, ~%u ms "
+         "latency%s); %zu settings timed in %.1f s on %s",
+         tuning->model_path, tuning->n_threads, tuning->window_ms, tuning->rtf,
+         tuning->latency_ms, found ? "" : ", over budget", measured,
+         (os_gettime_ns() - start) / 1e9, tuner.machine.c_str());
+    return true;
+}
+
+void model_tuning_free(struct model_tuning* tuning) {
+    if (!tuning) return;
+    bfree(tuning->model_path);
+    memset(tuning, 0, sizeof(*tuning));
+}
+
+char* model_tuner_smallest_variant(const char* model_path) {
+    if (!model_path || !*model_path) return nullptr;
+    
+    std::string base, quant;
+    int rank = 0;
+    parse_variant(std::filesystem::u8path(model_path).stem().u8string(), base, quant, rank);
+    
+    // Variants are sorted most accurate first
+    std::vector<Variant> variants = find_variants(model_path);
+    if (variants.empty() || variants.back().rank <= rank) return nullptr;
+    return bstrdup(variants.back().path.c_str());
+}
+
+} // extern "C"
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Calibration of the Whisper model variant, decoder threads and streaming
+// window for the machine the plugin runs on.
+//
+// The variants are the quantizations of the configured model found next to
+// it, named the way whisper.cpp names them: ggml-base.en.bin (f16),
+// ggml-base.en-q8_0.bin, ggml-base.en-q5_1.bin and so on. Each variant is
+// timed decoding a reference clip at growing thread counts and at every
+// candidate window, most accurate variant first, and the first one that
+// keeps up with real time within the latency budget is chosen. Less
+// accurate variants are only timed when the more accurate ones are too slow.
+//
+// Measurements are remembered per machine and model file. With a persist
+// path they are loaded at init and saved after every calibration, so only
+// the first start on a machine (or with a new model file) pays for them.
+
+struct model_tuner_request {
+    const char* model_path;     // any variant of the model
+    uint32_t latency_budget_ms; // window plus decode time
+    uint32_t overlap_ms;        // context decoded again with every window
+    int max_threads;
+    int beam_size;
+    bool recalibrate;           // measure again instead of using saved results
+    
+    // Checked before every timed setting; set it to stop the calibration.
+    // May be NULL.
+    const volatile bool* cancel;
+};
+
+struct model_tuning {
+    char* model_path;    // release with model_tuning_free
+    int n_threads;
+    uint32_t window_ms;
+    float rtf;           // decode time per window of audio
+    uint32_t latency_ms; // expected window plus decode time
+    bool within_budget;  // false: nothing fit, this is the closest found
+};
+
+// `persist_path` and `reference_path` may be NULL: measurements are then
+// kept in memory only, and the reference clip is generated speech-like
+// audio. The reference file is a 16 kHz mono 16-bit PCM WAV.
+void model_tuner_init(const char* persist_path, const char* reference_path);
+void model_tuner_shutdown(void);
+
+// Blocks while variants are timed, which can take minutes the first time,
+// so never call it on the UI or audio thread. Calibrations run one at a
+// time; a filter asking for the same model meanwhile waits and then reuses
+// the measurements. Returns false when no variant could be loaded, or when
+// `cancel` was set; what was timed before that is still kept.
+bool model_tuner_select(const struct model_tuner_request* request, struct model_tuning* tuning);
+void model_tuning_free(struct model_tuning* tuning);
+
+// The most heavily quantized variant of the model found next to it, if that
+// is quantized more heavily than `model_path` itself: a fallback that
+// decodes faster at some cost in accuracy. Returns NULL when there is none;
+// release with bfree.
+char* model_tuner_smallest_variant(const char* model_path);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,12 +1,34 @@
 #include <obs-module.h>
+#include "ai-transcription-filter.h"
+#include "audio-kernels.h"
+#include "inference-scheduler.h"
+#include "llm-corrector.h"
+#include "correction-cache.h"
+#include "model-tuner.h"
+
+// Memory budget for remembered LLM corrections across all sources
+#define CORRECTION_CACHE_BYTES (4 * 1024 * 1024)
 
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("obs-ai-transcription-filter", "en-US")
 
-extern struct obs_source_info ai_transcription_filter_info;
-
 bool obs_module_load(void)
 {
+    audio_kernels_init();
+    inference_scheduler_init(0);
+    llm_corrector_global_init();
+    
+    char *cache_path = obs_module_config_path("correction-cache.jsonl");
+    correction_cache_init(CORRECTION_CACHE_BYTES, cache_path);
+    bfree(cache_path);
+    
+    // The reference clip is optional; packagers can ship a speech recording
+    char *tuning_path = obs_module_config_path("model-tuning.jsonl");
+    char *reference_path = obs_module_file("calibration/reference.wav");
+    model_tuner_init(tuning_path, reference_path);
+    bfree(tuning_path);
+    bfree(reference_path);
+    
     obs_register_source(&ai_transcription_filter_info);
     
     blog(LOG_INFO, "AI Transcription Filter plugin loaded successfully");
@@ -15,6 +37,10 @@ bool obs_module_load(void)
 
 void obs_module_unload(void)
 {
+    inference_scheduler_shutdown();
+    llm_corrector_global_shutdown();
+    correction_cache_shutdown();
+    model_tuner_shutdown();
     blog(LOG_INFO, "AI Transcription Filter plugin unloaded");
 }
 
@@ -0,0 +1,225 @@
+#include "pipeline-stats.h"
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <stdio.h>
+
+#define SUB_BUCKETS (1u << LATENCY_SUB_BUCKET_BITS)
+#define EXACT_LIMIT (2u * SUB_BUCKETS) // values below this have a bucket each
+
+static const char* const stage_names[PIPELINE_STAGE_COUNT] = {
+    "audio_callback",
+    "queue_wait",
+    "vad",
+    "inference",
+    "llm",
+    "output",
+};
+
+static const char* const stage_labels[PIPELINE_STAGE_COUNT] = {
+    "Audio Callback",
+    "Queue Wait",
+    "VAD",
+    "Inference",
+    "LLM Correction",
+    "Output",
+};
+
+static uint32_t highest_bit(uint64_t value) {
+    uint32_t bit = 0;
+    while (value >>= 1) {
+        bit++;
+    }
+    return bit;
+}
+
+// Below EXACT_LIMIT the value is the index. Above it, the bucket is the
+// power of two (shift) and the top LATENCY_SUB_BUCKET_BITS + 1 bits.
+static size_t bucket_index(uint64_t value) {
+    if (value < EXACT_LIMIT) {
+        return (size_t)value;
+    }
+    if (value >> LATENCY_MAX_BITS) {
+        return LATENCY_HISTOGRAM_BUCKETS - 1;
+    }
+    
+    uint32_t shift = highest_bit(value) - LATENCY_SUB_BUCKET_BITS;
+    return ((size_t)shift << LATENCY_SUB_BUCKET_BITS) + (size_t)(value >> shift);
+}
+
+static uint64_t bucket_lower(size_t index) {
+    if (index < EXACT_LIMIT) {
+        return index;
+    }
+    uint32_t shift = (uint32_t)(index >> LATENCY_SUB_BUCKET_BITS) - 1;
+    uint64_t sub = (index & (SUB_BUCKETS - 1)) + SUB_BUCKETS;
+    return sub << shift;
+}
+
+static uint64_t bucket_width(size_t index) {
+    if (index < EXACT_LIMIT) {
+        return 1;
+    }
+    return (uint64_t)1 << ((index >> LATENCY_SUB_BUCKET_BITS) - 1);
+}
+
+// The value reported for everything in a bucket
+static uint64_t bucket_value(size_t index) {
+    return bucket_lower(index) + bucket_width(index) / 2;
+}
+
+void latency_histogram_record(struct latency_histogram* histogram, uint64_t value_ns) {
+    os_atomic_inc_long(&histogram->buckets[bucket_index(value_ns)]);
+}
+
+void latency_histogram_summarize(const struct latency_histogram* histogram,
+                                 struct latency_summary* summary) {
+    memset(summary, 0, sizeof(*summary));
+    
+    // One pass for a consistent snapshot, one over the copy
+    static const double percentiles[] = {0.50, 0.90, 0.95, 0.99};
+    uint64_t* results[] = {&summary->p50_ns, &summary->p90_ns, &summary->p95_ns,
+                           &summary->p99_ns};
+    
+    unsigned long counts[LATENCY_HISTOGRAM_BUCKETS];
+    double total = 0.0;
+    for (size_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        counts[i] = (unsigned long)os_atomic_load_long(&histogram->buckets[i]);
+        if (counts[i] == 0) continue;
+        
+        summary->count += counts[i];
+        total += (double)counts[i] * (double)bucket_value(i);
+        summary->max_ns = bucket_lower(i) + bucket_width(i) - 1;
+    }
+    if (summary->count == 0) {
+        return;
+    }
+    summary->mean_ns = (uint64_t)(total / (double)summary->count);
+    
+    size_t next = 0;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS && next < 4; i++) {
+        seen += counts[i];
+        while (next < 4 && (double)seen >= percentiles[next] * (double)summary->count &&
+               counts[i] > 0) {
+            *results[next++] = bucket_value(i);
+        }
+    }
+}
+
+void pipeline_stats_init(struct pipeline_stats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->start_ns = os_gettime_ns();
+}
+
+const char* pipeline_stage_name(enum pipeline_stage stage) {
+    return stage < PIPELINE_STAGE_COUNT ? stage_names[stage] : "unknown";
+}
+
+const char* pipeline_stage_label(enum pipeline_stage stage) {
+    return stage < PIPELINE_STAGE_COUNT ? stage_labels[stage] : "Unknown";
+}
+
+// Three significant digits in the largest unit that keeps the value >= 1
+static void format_duration(uint64_t ns, char* buffer, size_t size) {
+    static const struct {
+        uint64_t scale;
+        const char* unit;
+    } units[] = {{1000000000ULL, "s"}, {1000000ULL, "ms"}, {1000ULL, "us"}, {1ULL, "ns"}};
+    
+    for (size_t i = 0; i < sizeof(units) / sizeof(units[0]); i++) {
+        if (ns < units[i].scale && units[i].scale > 1) continue;
+        
+        double value = (double)ns / (double)units[i].scale;
+        snprintf(buffer, size, value < 10.0 ? "%.2f %s" : value < 100.0 ? "%.1f %s" : "%.0f %s",
+                 value, units[i].unit);
+        return;
+    }
+}
+
+void pipeline_stats_format_summary(const struct latency_summary* summary, char* buffer,
+                                   size_t size) {
+    if (summary->count == 0) {
+        snprintf(buffer, size, "no samples yet");
+        return;
+    }
+    
+    char p50[32], p95[32], p99[32], max[32];
+    format_duration(summary->p50_ns, p50, sizeof(p50));
+    format_duration(summary->p95_ns, p95, sizeof(p95));
+    format_duration(summary->p99_ns, p99, sizeof(p99));
+    format_duration(summary->max_ns, max, sizeof(max));
+    snprintf(buffer, size, "p50 %s, p95 %s, p99 %s, max %s (%llu)", p50, p95, p99, max,
+             (unsigned long long)summary->count);
+}
+
+static void json_string(struct dstr* json, const char* text) {
+    dstr_cat_ch(json, '"');
+    for (const char* c = text ? text : ""; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            dstr_cat_ch(json, '\\');
+            dstr_cat_ch(json, *c);
+        } else if ((unsigned char)*c < 0x20) {
+            dstr_catf(json, "\\u%04x", (unsigned)(unsigned char)*c);
+        } else {
+            dstr_cat_ch(json, *c);
+        }
+    }
+    dstr_cat_ch(json, '"');
+}
+
+static void json_stage(struct dstr* json, const struct latency_histogram* histogram) {
+    struct latency_summary summary;
+    latency_histogram_summarize(histogram, &summary);
+    dstr_catf(json, "{\"count\": %llu, \"mean_ns\": %llu, \"p50_ns\": %llu, \"p90_ns\": %llu, "
+              "\"p95_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu, \"buckets\": [",
+              (unsigned long long)summary.count, (unsigned long long)summary.mean_ns,
+              (unsigned long long)summary.p50_ns, (unsigned long long)summary.p90_ns,
+              (unsigned long long)summary.p95_ns, (unsigned long long)summary.p99_ns,
+              (unsigned long long)summary.max_ns);
+    
+    // Sparse [lower bound, count] pairs, enough to merge histograms offline
+    bool first = true;
+    for (size_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        long count = os_atomic_load_long(&histogram->buckets[i]);
+        if (count == 0) continue;
+        dstr_catf(json, "%s[%llu, %lu]", first ? "" : ", ",
+                  (unsigned long long)bucket_lower(i), (unsigned long)count);
+        first = false;
+    }
+    dstr_cat(json, "]}");
+}
+
+bool pipeline_stats_write_json(const struct pipeline_stats* stats, const char* source_name,
+                               const struct pipeline_counter* counters, size_t counter_count,
+                               const char* path) {
+    if (!stats || !path || !*path) {
+        return false;
+    }
+    
+    uint64_t now = os_gettime_ns();
+    struct dstr json = {0};
+    dstr_cat(&json, "{\n  \"source\": ");
+    json_string(&json, source_name);
+    dstr_catf(&json, ",\n  \"uptime_s\": %.3f,\n  \"stages\": {",
+              (double)(now - stats->start_ns) / 1e9);
+    for (int stage = 0; stage < PIPELINE_STAGE_COUNT; stage++) {
+        dstr_catf(&json, "%s\n    \"%s\": ", stage ? "," : "",
+                  pipeline_stage_name((enum pipeline_stage)stage));
+        json_stage(&json, &stats->stages[stage]);
+    }
+    dstr_cat(&json, "\n  },\n  \"counters\": {");
+    for (size_t i = 0; i < counter_count; i++) {
+        dstr_catf(&json, "%s\n    ", i ? "," : "");
+        json_string(&json, counters[i].name);
+        dstr_catf(&json, ": %llu", (unsigned long long)counters[i].value);
+    }
+    dstr_cat(&json, "\n  }\n}\n");
+    
+    bool written = os_quick_write_utf8_file_safe(path, json.array, json.len, false, "tmp", NULL);
+    if (!written) {
+        blog(LOG_WARNING, "Pipeline stats: Failed to write %s", path);
+    }
+    dstr_free(&json);
+    return written;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Per-stage latency instrumentation.
+//
+// Every stage has a log-linear (HDR-style) histogram of nanosecond values:
+// exact below 64 ns, then 32 buckets per power of two, so any reported
+// percentile is within about 3% of the true value up to 2^40 ns (about 18
+// minutes; longer values land in the last bucket). Recording is a single
+// os_atomic increment with no lock or allocation, so it is safe on the audio
+// thread and from any number of threads at once. Histograms only grow;
+// readers take a snapshot that may miss values recorded meanwhile.
+
+#define LATENCY_SUB_BUCKET_BITS 5
+#define LATENCY_MAX_BITS 40
+#define LATENCY_HISTOGRAM_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BUCKET_BITS + 1) \
+                                   << LATENCY_SUB_BUCKET_BITS)
+
+struct latency_histogram {
+    volatile long buckets[LATENCY_HISTOGRAM_BUCKETS];
+};
+
+struct latency_summary {
+    uint64_t count;
+    uint64_t mean_ns;
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p95_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+};
+
+void latency_histogram_record(struct latency_histogram* histogram, uint64_t value_ns);
+void latency_histogram_summarize(const struct latency_histogram* histogram,
+                                 struct latency_summary* summary);
+
+enum pipeline_stage {
+    PIPELINE_STAGE_AUDIO_CALLBACK, // filter_audio: downmix, resample, ring write
+    PIPELINE_STAGE_QUEUE_WAIT,     // segment queued until an inference worker takes it
+    PIPELINE_STAGE_VAD,            // one ingest chunk through the segmenter
+    PIPELINE_STAGE_INFERENCE,      // one Whisper decode
+    PIPELINE_STAGE_LLM,            // correction submitted until it is resolved
+    PIPELINE_STAGE_OUTPUT,         // caption due until it is on the text source
+    PIPELINE_STAGE_COUNT
+};
+
+struct pipeline_stats {
+    uint64_t start_ns;
+    struct latency_histogram stages[PIPELINE_STAGE_COUNT];
+};
+
+// Named counters reported next to the histograms
+struct pipeline_counter {
+    const char* name;
+    uint64_t value;
+};
+
+void pipeline_stats_init(struct pipeline_stats* stats);
+
+static inline void pipeline_stats_record(struct pipeline_stats* stats, enum pipeline_stage stage,
+                                         uint64_t value_ns) {
+    latency_histogram_record(&stats->stages[stage], value_ns);
+}
+
+// Machine name ("audio_callback") and label ("Audio Callback") of a stage
+const char* pipeline_stage_name(enum pipeline_stage stage);
+const char* pipeline_stage_label(enum pipeline_stage stage);
+
+// One-line summary for the properties panel, e.g.
+// "p50 4.1 us, p95 6.3 us, p99 9.0 us, max 31 us (12034)"
+void pipeline_stats_format_summary(const struct latency_summary* summary, char* buffer,
+                                   size_t size);
+
+// Writes every stage (percentiles and the non-empty buckets) and the
+// counters to `path` as one JSON object. The file is replaced atomically,
+// so a reader never sees half of it.
+bool pipeline_stats_write_json(const struct pipeline_stats* stats, const char* source_name,
+                               const struct pipeline_counter* counters, size_t counter_count,
+                               const char* path);
+
+#ifdef __cplusplus
+}
+#endif
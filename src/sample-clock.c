@@ -0,0 +1,91 @@
+#include "sample-clock.h"
+#include <util/threading.h>
+
+// Split so the product cannot overflow over any realistic stream length
+static inline uint64_t samples_to_ns(uint64_t samples, uint32_t sample_rate) {
+    if (sample_rate == 0) {
+        return 0;
+    }
+    return samples / sample_rate * 1000000000ULL +
+           samples % sample_rate * 1000000000ULL / sample_rate;
+}
+
+void sample_clock_init(struct sample_clock* clock, uint32_t sample_rate) {
+    memset(clock, 0, sizeof(*clock));
+    clock->sample_rate = sample_rate;
+}
+
+void sample_clock_produce(struct sample_clock* clock, uint64_t timestamp_ns, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    
+    uint64_t sample = clock->produced;
+    clock->produced += count;
+    
+    if (clock->has_last) {
+        uint64_t predicted = clock->last.timestamp_ns +
+                             samples_to_ns(sample - clock->last.sample, clock->sample_rate);
+        uint64_t error = timestamp_ns > predicted ? timestamp_ns - predicted
+                                                  : predicted - timestamp_ns;
+        if (error < SAMPLE_CLOCK_TOLERANCE_NS) {
+            return;
+        }
+    }
+    
+    // With the consumer this far behind the anchor is lost; the next write
+    // will not match the old one either and tries again
+    unsigned long write_pos = (unsigned long)os_atomic_load_long(&clock->write_pos);
+    unsigned long read_pos = (unsigned long)os_atomic_load_long(&clock->read_pos);
+    if (write_pos - read_pos >= SAMPLE_CLOCK_PENDING) {
+        return;
+    }
+    
+    clock->last.sample = sample;
+    clock->last.timestamp_ns = timestamp_ns;
+    clock->has_last = true;
+    clock->pending[write_pos & (SAMPLE_CLOCK_PENDING - 1)] = clock->last;
+    os_atomic_set_long(&clock->write_pos, (long)(write_pos + 1));
+}
+
+void sample_clock_consume(struct sample_clock* clock) {
+    unsigned long write_pos = (unsigned long)os_atomic_load_long(&clock->write_pos);
+    unsigned long read_pos = (unsigned long)os_atomic_load_long(&clock->read_pos);
+    
+    for (; read_pos != write_pos; read_pos++) {
+        const struct sample_clock_anchor* anchor =
+            &clock->pending[read_pos & (SAMPLE_CLOCK_PENDING - 1)];
+        if (clock->history_count == 0) {
+            clock->origin_ns = anchor->timestamp_ns -
+                               samples_to_ns(anchor->sample, clock->sample_rate);
+        }
+        
+        clock->history[clock->history_next] = *anchor;
+        clock->history_next = (clock->history_next + 1) % SAMPLE_CLOCK_HISTORY;
+        if (clock->history_count < SAMPLE_CLOCK_HISTORY) {
+            clock->history_count++;
+        }
+    }
+    os_atomic_set_long(&clock->read_pos, (long)read_pos);
+}
+
+uint64_t sample_clock_timestamp(const struct sample_clock* clock, uint64_t sample) {
+    if (clock->history_count == 0) {
+        return 0;
+    }
+    
+    // Newest anchor at or before `sample`; anchors are in stream order
+    const struct sample_clock_anchor* anchor = NULL;
+    for (size_t i = 1; i <= clock->history_count; i++) {
+        anchor = &clock->history[(clock->history_next + SAMPLE_CLOCK_HISTORY - i) %
+                                 SAMPLE_CLOCK_HISTORY];
+        if (anchor->sample <= sample) {
+            return anchor->timestamp_ns + samples_to_ns(sample - anchor->sample,
+                                                        clock->sample_rate);
+        }
+    }
+    
+    // Older than anything kept: `anchor` is the oldest
+    uint64_t back = samples_to_ns(anchor->sample - sample, clock->sample_rate);
+    return anchor->timestamp_ns > back ? anchor->timestamp_ns - back : 0;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maps positions in the sample stream carried by an audio_ring to the
+// capture timestamps OBS gave that audio (obs_audio_data.timestamp).
+//
+// The producer (the audio thread) reports each write with the timestamp of
+// its first sample. While timestamps follow the sample count nothing is
+// recorded; an anchor (position, timestamp) is only published when they
+// jump, e.g. after dropped samples, a disabled filter or a clock reset. So
+// a long stream usually needs a single anchor. The consumer (the ingest
+// thread) moves anchors into its own history and answers lookups from it,
+// interpolating at the sample rate between anchors. Like the ring, neither
+// side locks, allocates or waits.
+
+#define SAMPLE_CLOCK_PENDING 64 // anchors in flight, a power of two
+#define SAMPLE_CLOCK_HISTORY 64 // anchors the consumer remembers
+#define SAMPLE_CLOCK_TOLERANCE_NS 2000000ULL // jitter accepted before a new anchor
+
+struct sample_clock_anchor {
+    uint64_t sample;
+    uint64_t timestamp_ns;
+};
+
+struct sample_clock {
+    uint32_t sample_rate;
+    
+    // Producer to consumer, positions as in audio_ring
+    struct sample_clock_anchor pending[SAMPLE_CLOCK_PENDING];
+    volatile long write_pos;
+    volatile long read_pos;
+    
+    // Producer only
+    uint64_t produced; // samples written so far
+    struct sample_clock_anchor last;
+    bool has_last;
+    
+    // Consumer only. origin_ns is the capture time of sample 0; it is set by
+    // the first sample_clock_consume that finds an anchor, before any lookup
+    // can be answered, and never changes after that.
+    struct sample_clock_anchor history[SAMPLE_CLOCK_HISTORY];
+    size_t history_count;
+    size_t history_next;
+    uint64_t origin_ns;
+};
+
+void sample_clock_init(struct sample_clock* clock, uint32_t sample_rate);
+
+// Producer side: `count` samples were stored, the first captured at
+// `timestamp_ns`. Samples the ring dropped must not be counted.
+void sample_clock_produce(struct sample_clock* clock, uint64_t timestamp_ns, size_t count);
+
+// Consumer side. Call before looking up samples the consumer has read.
+void sample_clock_consume(struct sample_clock* clock);
+
+// Capture time of `sample`, or 0 before any audio was seen. Positions older
+// than the history are extrapolated from the oldest anchor kept.
+uint64_t sample_clock_timestamp(const struct sample_clock* clock, uint64_t sample);
+
+#ifdef __cplusplus
+}
+#endif
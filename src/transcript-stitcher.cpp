@@ -0,0 +1,212 @@
+#include "transcript-stitcher.h"
+#include <obs-module.h>
+#include <util/bmem.h>
+#include <string>
+#include <vector>
+#include <cctype>
+#include <cmath>
+
+// How far back into the committed text an overlap may reach. Overlap windows
+// are a few seconds at most, so this comfortably covers them.
+#define STITCH_TAIL_WORDS 24
+
+// Leading hypothesis words allowed before the overlap match starts, for
+// fragments of a word that was cut at the window start.
+#define STITCH_MAX_SKIP 2
+
+struct Word {
+    std::string text; // as decoded, punctuation included
+    std::string key;  // lowercase alphanumerics, used for matching
+    float confidence = 1.0f;
+};
+
+struct StitcherContext {
+    std::vector<Word> committed;
+    std::vector<Word> pending;
+};
+
+static std::vector<Word> split_words(const char* text) {
+    std::vector<Word> words;
+    if (!text) return words;
+    
+    std::string current;
+    for (const char* p = text;; p++) {
+        if (*p == '\0' || isspace((unsigned char)*p)) {
+            if (!current.empty()) {
+                Word word;
+                word.text = current;
+                for (char c : current) {
+                    if (isalnum((unsigned char)c) || (unsigned char)c >= 0x80) {
+                        word.key += (char)tolower((unsigned char)c);
+                    }
+                }
+                words.push_back(word);
+                current.clear();
+            }
+            if (*p == '\0') break;
+        } else {
+            current += *p;
+        }
+    }
+    return words;
+}
+
+static char* join_words(const std::vector<Word>& words, size_t begin, size_t end) {
+    if (begin >= end) return nullptr;
+    
+    std::string text;
+    for (size_t i = begin; i < end; i++) {
+        if (!text.empty()) text += ' ';
+        text += words[i].text;
+    }
+    return bstrdup(text.c_str());
+}
+
+static bool keys_match(const Word& a, const Word& b) {
+    // Pure punctuation tokens carry no key and match each other
+    return a.key == b.key;
+}
+
+// Finds where the new material in `hyp` starts by matching a run of its
+// leading words against the end of the committed text. Longer runs win; one
+// mismatched word is tolerated in runs of four or more, since the re-decoded
+// overlap often differs slightly from the first pass.
+static bool align_overlap(const std::vector<Word>& committed, const std::vector<Word>& hyp,
+                          size_t* new_start) {
+    size_t tail = committed.size() < STITCH_TAIL_WORDS ? committed.size() : STITCH_TAIL_WORDS;
+    size_t longest = tail < hyp.size() ? tail : hyp.size();
+    
+    for (size_t len = longest; len > 0; len--) {
+        for (size_t skip = 0; skip <= STITCH_MAX_SKIP && skip + len <= hyp.size(); skip++) {
+            size_t base = committed.size() - len;
+            size_t mismatches = 0;
+            for (size_t i = 0; i < len && mismatches <= 1; i++) {
+                if (!keys_match(committed[base + i], hyp[skip + i])) {
+                    mismatches++;
+                }
+            }
+            
+            if (mismatches == 0 || (mismatches == 1 && len >= 4)) {
+                *new_start = skip + len;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// When the overlap is too short to reach back into committed text, the
+// held-back word is the only anchor left
+static bool find_pending(const std::vector<Word>& pending, const std::vector<Word>& hyp,
+                         size_t* new_start) {
+    if (pending.empty()) return false;
+    
+    for (size_t i = 0; i <= STITCH_MAX_SKIP && i < hyp.size(); i++) {
+        if (keys_match(pending.front(), hyp[i])) {
+            *new_start = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+extern "C" {
+
+void* transcript_stitcher_create(void) {
+    return new StitcherContext();
+}
+
+void transcript_stitcher_destroy(void* ctx) {
+    delete static_cast<StitcherContext*>(ctx);
+}
+
+void transcript_stitcher_reset(void* ctx) {
+    if (!ctx) return;
+    
+    StitcherContext* context = static_cast<StitcherContext*>(ctx);
+    context->committed.clear();
+    context->pending.clear();
+}
+
+char* transcript_stitcher_merge(void* ctx, const char* hypothesis,
+                                const float* word_confidence, size_t word_count,
+                                float overlap_ratio, bool final) {
+    if (!ctx) return nullptr;
+    
+    StitcherContext* context = static_cast<StitcherContext*>(ctx);
+    std::vector<Word> hyp = split_words(hypothesis);
+    if (word_confidence && word_count == hyp.size()) {
+        for (size_t i = 0; i < word_count; i++) {
+            hyp[i].confidence = word_confidence[i];
+        }
+    }
+    
+    size_t new_start = 0;
+    if (!context->committed.empty() && !align_overlap(context->committed, hyp, &new_start)) {
+        if (!find_pending(context->pending, hyp, &new_start)) {
+            // No textual anchor: assume the words are spread evenly over the
+            // window and drop the share that belongs to the overlap audio
+            if (overlap_ratio < 0.0f) overlap_ratio = 0.0f;
+            if (overlap_ratio > 1.0f) overlap_ratio = 1.0f;
+            new_start = (size_t)floorf(overlap_ratio * (float)hyp.size());
+        }
+    }
+    
+    // The newest word may have been cut by the window end; the next window
+    // decodes it again from the overlap, so hold it back until then
+    size_t stable_end = hyp.size();
+    if (!final && stable_end > new_start) {
+        stable_end--;
+    }
+    
+    char* stable = join_words(hyp, new_start, stable_end);
+    
+    for (size_t i = new_start; i < stable_end; i++) {
+        context->committed.push_back(hyp[i]);
+    }
+    context->pending.assign(hyp.begin() + stable_end, hyp.end());
+    
+    return stable;
+}
+
+char* transcript_stitcher_flush(void* ctx) {
+    if (!ctx) return nullptr;
+    
+    StitcherContext* context = static_cast<StitcherContext*>(ctx);
+    char* stable = join_words(context->pending, 0, context->pending.size());
+    context->committed.insert(context->committed.end(), context->pending.begin(),
+                              context->pending.end());
+    context->pending.clear();
+    return stable;
+}
+
+char* transcript_stitcher_text(void* ctx) {
+    if (!ctx) return nullptr;
+    
+    StitcherContext* context = static_cast<StitcherContext*>(ctx);
+    return join_words(context->committed, 0, context->committed.size());
+}
+
+float* transcript_stitcher_confidence(void* ctx, size_t* count) {
+    if (count) *count = 0;
+    if (!ctx || !count) return nullptr;
+    
+    StitcherContext* context = static_cast<StitcherContext*>(ctx);
+    if (context->committed.empty()) return nullptr;
+    
+    float* confidence = static_cast<float*>(bmalloc(context->committed.size() * sizeof(float)));
+    for (size_t i = 0; i < context->committed.size(); i++) {
+        confidence[i] = context->committed[i].confidence;
+    }
+    *count = context->committed.size();
+    return confidence;
+}
+
+char* transcript_stitcher_pending(void* ctx) {
+    if (!ctx) return nullptr;
+    
+    StitcherContext* context = static_cast<StitcherContext*>(ctx);
+    return join_words(context->pending, 0, context->pending.size());
+}
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Merges overlapping hypotheses from a sliding-window decode into one
+// de-duplicated transcript per utterance.
+//
+// Each window re-decodes a short stretch of already-committed audio for
+// context. The hypothesis is aligned word by word against the tail of the
+// committed text so the overlap is not emitted twice, and the last word is
+// held back until the next window confirms it. Strings returned by this API
+// are allocated with bmalloc and released with bfree.
+
+void* transcript_stitcher_create(void);
+void transcript_stitcher_destroy(void* context);
+
+// Starts a new utterance; committed text from the previous one is discarded
+void transcript_stitcher_reset(void* context);
+
+// Merges a hypothesis decoded from a window whose first `overlap_ratio`
+// (0..1) was audio already seen. Returns the newly stable text, or NULL when
+// nothing new became stable. With `final` set, the held-back tail is flushed.
+// `word_confidence` optionally gives one value per whitespace-separated word
+// of the hypothesis; committed words keep the value they were committed with.
+char* transcript_stitcher_merge(void* context, const char* hypothesis,
+                                const float* word_confidence, size_t word_count,
+                                float overlap_ratio, bool final);
+
+// Commits the held-back tail as it is, for an utterance that ends without a
+// window to confirm it. Returns the newly stable text, or NULL when nothing
+// was held back.
+char* transcript_stitcher_flush(void* context);
+
+// Committed text of the current utterance so far
+char* transcript_stitcher_text(void* context);
+
+// Confidence of each committed word (1 where none was given), allocated
+// with bmalloc; NULL with `count` 0 when nothing is committed
+float* transcript_stitcher_confidence(void* context, size_t* count);
+
+// Tentative words not yet confirmed by a following window
+char* transcript_stitcher_pending(void* context);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,389 @@
+#include "transcript-writer.h"
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// A queued transcript, or a switch to a new configuration when `reconfigure`
+// is set, so transcripts appended before a switch still go to the old file
+struct transcript_entry {
+    char* text;
+    float confidence;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    
+    bool reconfigure;
+    bool enabled;
+    struct transcript_writer_config config;
+    
+    struct transcript_entry* next;
+};
+
+struct transcript_writer {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    os_event_t* wake;
+    bool stop;
+    
+    // Guarded by the mutex
+    struct transcript_entry* head;
+    struct transcript_entry* tail;
+    bool enabled; // as of the last configure, for counting drops up front
+    struct transcript_writer_stats stats;
+    
+    // Writer thread only
+    struct transcript_writer_config config;
+    FILE* file;
+    struct dstr buffer;
+    uint64_t buffered_ns; // when the oldest buffered cue was formatted
+    uint64_t cue_index;
+    bool error_logged;
+};
+
+static void free_entry(struct transcript_entry* entry) {
+    bfree(entry->text);
+    bfree((char*)entry->config.path);
+    bfree(entry);
+}
+
+static void count_error(struct transcript_writer* writer) {
+    pthread_mutex_lock(&writer->mutex);
+    writer->stats.write_errors++;
+    pthread_mutex_unlock(&writer->mutex);
+}
+
+// HH:MM:SS plus milliseconds after `separator` ("," for SRT, "." otherwise)
+static void format_cue_time(struct dstr* out, uint64_t ns, char separator) {
+    uint64_t ms = ns / 1000000;
+    dstr_catf(out, "%02llu:%02llu:%02llu%c%03llu", (unsigned long long)(ms / 3600000),
+              (unsigned long long)(ms / 60000 % 60), (unsigned long long)(ms / 1000 % 60),
+              separator, (unsigned long long)(ms % 1000));
+}
+
+// Cue text on a single line; a blank line would end an SRT or WebVTT cue
+static void cat_cue_text(struct dstr* out, const char* text, bool escape_html) {
+    for (const char* c = text; *c; c++) {
+        if (*c == '\r' || *c == '\n') {
+            dstr_cat_ch(out, ' ');
+        } else if (escape_html && *c == '&') {
+            dstr_cat(out, "&amp;");
+        } else if (escape_html && *c == '<') {
+            dstr_cat(out, "&lt;");
+        } else if (escape_html && *c == '>') {
+            dstr_cat(out, "&gt;");
+        } else {
+            dstr_cat_ch(out, *c);
+        }
+    }
+}
+
+static void cat_json_string(struct dstr* out, const char* text) {
+    dstr_cat_ch(out, '"');
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            dstr_cat_ch(out, '\\');
+            dstr_cat_ch(out, *c);
+        } else if ((unsigned char)*c < 0x20) {
+            dstr_catf(out, "\\u%04x", (unsigned)(unsigned char)*c);
+        } else {
+            dstr_cat_ch(out, *c);
+        }
+    }
+    dstr_cat_ch(out, '"');
+}
+
+static void format_entry(struct transcript_writer* writer, const struct transcript_entry* entry) {
+    struct dstr* out = &writer->buffer;
+    uint64_t start = entry->start_ns;
+    uint64_t end = entry->end_ns > start ? entry->end_ns : start;
+    
+    switch (writer->config.format) {
+    case TRANSCRIPT_FORMAT_SRT:
+        dstr_catf(out, "%llu\n", (unsigned long long)++writer->cue_index);
+        format_cue_time(out, start, ',');
+        dstr_cat(out, " --> ");
+        format_cue_time(out, end, ',');
+        dstr_cat_ch(out, '\n');
+        cat_cue_text(out, entry->text, false);
+        dstr_cat(out, "\n\n");
+        break;
+    case TRANSCRIPT_FORMAT_WEBVTT:
+        format_cue_time(out, start, '.');
+        dstr_cat(out, " --> ");
+        format_cue_time(out, end, '.');
+        dstr_cat_ch(out, '\n');
+        cat_cue_text(out, entry->text, true);
+        dstr_cat(out, "\n\n");
+        break;
+    case TRANSCRIPT_FORMAT_JSONL:
+        dstr_catf(out, "{\"start\": %.3f, \"end\": %.3f, \"confidence\": %.3f, \"text\": ",
+                  (double)start / 1e9, (double)end / 1e9, entry->confidence);
+        cat_json_string(out, entry->text);
+        dstr_cat(out, "}\n");
+        break;
+    case TRANSCRIPT_FORMAT_TEXT:
+    default:
+        dstr_cat_ch(out, '[');
+        format_cue_time(out, start, '.');
+        dstr_cat(out, " --> ");
+        format_cue_time(out, end, '.');
+        dstr_cat(out, "] ");
+        cat_cue_text(out, entry->text, false);
+        dstr_cat_ch(out, '\n');
+        break;
+    }
+}
+
+static void sync_file(FILE* file) {
+#ifdef _WIN32
+    _commit(_fileno(file));
+#else
+    fsync(fileno(file));
+#endif
+}
+
+static void flush_buffer(struct transcript_writer* writer) {
+    size_t len = writer->buffer.len;
+    if (!writer->file || len == 0) {
+        return;
+    }
+    
+    size_t written = fwrite(writer->buffer.array, 1, len, writer->file);
+    bool ok = written == len && fflush(writer->file) == 0;
+    if (ok && writer->config.sync == TRANSCRIPT_SYNC_FLUSH) {
+        sync_file(writer->file);
+    }
+    writer->buffer.len = 0;
+    writer->buffer.array[0] = 0;
+    
+    pthread_mutex_lock(&writer->mutex);
+    writer->stats.bytes += written;
+    writer->stats.flushes++;
+    if (!ok) {
+        writer->stats.write_errors++;
+    }
+    pthread_mutex_unlock(&writer->mutex);
+    
+    // One warning per file; a full disk would otherwise log every flush
+    if (!ok && !writer->error_logged) {
+        blog(LOG_WARNING, "Transcript writer: Failed to write %s", writer->config.path);
+        writer->error_logged = true;
+    }
+}
+
+static void close_file(struct transcript_writer* writer) {
+    if (writer->file) {
+        flush_buffer(writer);
+        if (writer->config.sync == TRANSCRIPT_SYNC_CLOSE) {
+            sync_file(writer->file);
+        }
+        fclose(writer->file);
+        writer->file = NULL;
+    }
+    dstr_free(&writer->buffer);
+    bfree((char*)writer->config.path);
+    memset(&writer->config, 0, sizeof(writer->config));
+}
+
+static void open_file(struct transcript_writer* writer, const struct transcript_entry* entry) {
+    // Settings are applied as a whole, so most switches keep the same file;
+    // reopening it would restart SRT and WebVTT cues
+    if (writer->file && entry->enabled && entry->config.format == writer->config.format &&
+        strcmp(entry->config.path, writer->config.path) == 0) {
+        writer->config.flush_interval_ms = entry->config.flush_interval_ms;
+        writer->config.flush_bytes = entry->config.flush_bytes;
+        writer->config.sync = entry->config.sync;
+        return;
+    }
+    
+    close_file(writer);
+    if (!entry->enabled) {
+        return;
+    }
+    
+    writer->config = entry->config;
+    writer->config.path = bstrdup(entry->config.path);
+    writer->cue_index = 0;
+    writer->error_logged = false;
+    
+    // SRT and WebVTT cue times restart with every file, so those are
+    // rewritten; plain text and JSON Lines carry on where the last run ended
+    bool append = writer->config.format == TRANSCRIPT_FORMAT_TEXT ||
+                  writer->config.format == TRANSCRIPT_FORMAT_JSONL;
+    writer->file = os_fopen(writer->config.path, append ? "ab" : "wb");
+    if (!writer->file) {
+        blog(LOG_WARNING, "Transcript writer: Failed to open %s", writer->config.path);
+        count_error(writer);
+        return;
+    }
+    
+    if (writer->config.format == TRANSCRIPT_FORMAT_WEBVTT) {
+        dstr_cat(&writer->buffer, "WEBVTT\n\n");
+        writer->buffered_ns = os_gettime_ns();
+    }
+}
+
+static void* transcript_writer_thread(void* param) {
+    struct transcript_writer* writer = param;
+    os_set_thread_name("transcript-writer");
+    
+    for (;;) {
+        pthread_mutex_lock(&writer->mutex);
+        struct transcript_entry* entry = writer->head;
+        bool stop = writer->stop;
+        writer->head = writer->tail = NULL;
+        pthread_mutex_unlock(&writer->mutex);
+        
+        while (entry) {
+            struct transcript_entry* next = entry->next;
+            if (entry->reconfigure) {
+                open_file(writer, entry);
+            } else if (writer->file) {
+                if (writer->buffer.len == 0) {
+                    writer->buffered_ns = os_gettime_ns();
+                }
+                format_entry(writer, entry);
+            }
+            free_entry(entry);
+            entry = next;
+        }
+        
+        if (stop) {
+            break;
+        }
+        
+        // Flush when the buffer is full or its oldest cue is due, otherwise
+        // sleep until it is due or more transcripts arrive
+        uint64_t interval_ns = (uint64_t)writer->config.flush_interval_ms * 1000000ULL;
+        uint64_t age_ns = os_gettime_ns() - writer->buffered_ns;
+        if (writer->buffer.len > 0 &&
+            (writer->buffer.len >= writer->config.flush_bytes || age_ns >= interval_ns)) {
+            flush_buffer(writer);
+        }
+        
+        if (writer->file && writer->buffer.len > 0) {
+            unsigned long wait_ms = (unsigned long)((interval_ns - age_ns) / 1000000ULL);
+            os_event_timedwait(writer->wake, wait_ms > 0 ? wait_ms : 1);
+        } else {
+            os_event_wait(writer->wake);
+        }
+    }
+    
+    close_file(writer);
+    return NULL;
+}
+
+struct transcript_writer* transcript_writer_create(void) {
+    struct transcript_writer* writer = bzalloc(sizeof(struct transcript_writer));
+    
+    if (os_event_init(&writer->wake, OS_EVENT_TYPE_AUTO) != 0) {
+        blog(LOG_ERROR, "Transcript writer: Failed to create event");
+        bfree(writer);
+        return NULL;
+    }
+    pthread_mutex_init(&writer->mutex, NULL);
+    if (pthread_create(&writer->thread, NULL, transcript_writer_thread, writer) != 0) {
+        blog(LOG_ERROR, "Transcript writer: Failed to start thread");
+        pthread_mutex_destroy(&writer->mutex);
+        os_event_destroy(writer->wake);
+        bfree(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+void transcript_writer_destroy(struct transcript_writer* writer) {
+    if (!writer) {
+        return;
+    }
+    
+    pthread_mutex_lock(&writer->mutex);
+    writer->stop = true;
+    pthread_mutex_unlock(&writer->mutex);
+    os_event_signal(writer->wake);
+    pthread_join(writer->thread, NULL);
+    
+    pthread_mutex_destroy(&writer->mutex);
+    os_event_destroy(writer->wake);
+    bfree(writer);
+}
+
+static void enqueue(struct transcript_writer* writer, struct transcript_entry* entry) {
+    if (writer->tail) {
+        writer->tail->next = entry;
+    } else {
+        writer->head = entry;
+    }
+    writer->tail = entry;
+}
+
+void transcript_writer_configure(struct transcript_writer* writer,
+                                 const struct transcript_writer_config* config) {
+    if (!writer) {
+        return;
+    }
+    
+    struct transcript_entry* entry = bzalloc(sizeof(struct transcript_entry));
+    entry->reconfigure = true;
+    entry->enabled = config && config->path && *config->path;
+    if (entry->enabled) {
+        entry->config = *config;
+        entry->config.path = bstrdup(config->path);
+    }
+    
+    pthread_mutex_lock(&writer->mutex);
+    writer->enabled = entry->enabled;
+    enqueue(writer, entry);
+    pthread_mutex_unlock(&writer->mutex);
+    os_event_signal(writer->wake);
+}
+
+void transcript_writer_append(struct transcript_writer* writer, const char* text,
+                              float confidence, uint64_t start_ns, uint64_t end_ns) {
+    if (!writer || !text || !*text) {
+        return;
+    }
+    
+    struct transcript_entry* entry = bzalloc(sizeof(struct transcript_entry));
+    entry->text = bstrdup(text);
+    entry->confidence = confidence;
+    entry->start_ns = start_ns;
+    entry->end_ns = end_ns;
+    
+    pthread_mutex_lock(&writer->mutex);
+    bool enabled = writer->enabled;
+    if (enabled) {
+        writer->stats.entries++;
+        enqueue(writer, entry);
+    } else {
+        writer->stats.dropped++;
+    }
+    pthread_mutex_unlock(&writer->mutex);
+    
+    if (enabled) {
+        os_event_signal(writer->wake);
+    } else {
+        free_entry(entry);
+    }
+}
+
+void transcript_writer_get_stats(struct transcript_writer* writer,
+                                 struct transcript_writer_stats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!writer) {
+        return;
+    }
+    
+    pthread_mutex_lock(&writer->mutex);
+    *stats = writer->stats;
+    pthread_mutex_unlock(&writer->mutex);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Asynchronous transcript file output.
+//
+// Transcripts are handed over with transcript_writer_append, which only
+// copies them into a queue; a dedicated thread formats them into an
+// in-memory buffer and writes it out once it reaches flush_bytes or its
+// oldest entry is flush_interval_ms old, so the inference and correction
+// threads never touch the disk. Cue times are given by the caller as offsets
+// into the recording, not taken from the wall clock when a transcript
+// arrives.
+//
+// Plain text and JSON Lines files are appended to. SRT and WebVTT cue times
+// start at zero with every writer, so those files are rewritten when they
+// are opened.
+
+enum transcript_format {
+    TRANSCRIPT_FORMAT_TEXT,   // "[00:01:02.500 --> 00:01:04.000] text"
+    TRANSCRIPT_FORMAT_SRT,
+    TRANSCRIPT_FORMAT_WEBVTT,
+    TRANSCRIPT_FORMAT_JSONL,  // one object per cue with times in seconds
+};
+
+enum transcript_sync {
+    TRANSCRIPT_SYNC_NEVER, // the OS decides when data reaches the disk
+    TRANSCRIPT_SYNC_CLOSE, // fsync when the file is closed
+    TRANSCRIPT_SYNC_FLUSH, // fsync after every flush
+};
+
+struct transcript_writer_config {
+    const char* path;
+    enum transcript_format format;
+    uint32_t flush_interval_ms; // 0 writes every transcript as it comes
+    size_t flush_bytes;
+    enum transcript_sync sync;
+};
+
+struct transcript_writer_stats {
+    uint64_t entries;      // transcripts queued for a file
+    uint64_t bytes;        // written to files
+    uint64_t flushes;
+    uint64_t write_errors; // failed opens and writes; the data is dropped
+    uint64_t dropped;      // appended while no file was configured
+};
+
+struct transcript_writer;
+
+struct transcript_writer* transcript_writer_create(void);
+
+// Writes out everything appended so far, then closes the file
+void transcript_writer_destroy(struct transcript_writer* writer);
+
+// Switches to a new file or format, or turns output off with NULL.
+// Transcripts appended before the call still go to the old file, which the
+// thread flushes and closes before opening the new one.
+void transcript_writer_configure(struct transcript_writer* writer,
+                                 const struct transcript_writer_config* config);
+
+// Queues a cue covering [start_ns, end_ns). Never blocks on I/O.
+void transcript_writer_append(struct transcript_writer* writer, const char* text,
+                              float confidence, uint64_t start_ns, uint64_t end_ns);
+
+void transcript_writer_get_stats(struct transcript_writer* writer,
+                                 struct transcript_writer_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
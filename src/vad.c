@@ -0,0 +1,480 @@
+#include "vad.h"
+#include "audio-buffer.h"
+#include "audio-kernels.h"
+#include <util/bmem.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define VAD_FFT_SIZE 256
+#define VAD_FFT_BINS (VAD_FFT_SIZE / 2 + 1)
+#define VAD_BIN_HZ ((float)VAD_SAMPLE_RATE / VAD_FFT_SIZE)
+
+#define VAD_SPEECH_LOW_HZ 300.0f
+#define VAD_SPEECH_HIGH_HZ 3400.0f
+#define VAD_MIN_BAND_RATIO 0.45f // share of energy that must sit in the speech band
+#define VAD_MAX_FLATNESS 0.55f   // voiced speech is harmonic, broadband noise is flat
+
+// Noise floor by minimum statistics: the floor is the quietest smoothed frame
+// seen over the last VAD_FLOOR_WINDOWS * VAD_FLOOR_WINDOW_FRAMES frames (4 s).
+// Speech always has gaps between words that reach the background, while
+// sustained sound such as a music bed never does, so it becomes the floor.
+#define VAD_FLOOR_WINDOW_FRAMES 50
+#define VAD_FLOOR_WINDOWS 8
+#define VAD_FLOOR_SMOOTHING 0.3f
+#define VAD_FLOOR_INIT_DB -60.0f
+
+struct vad {
+    struct vad_config config;
+    
+    float window[VAD_FRAME_SAMPLES];
+    float twiddle_re[VAD_FFT_SIZE / 2];
+    float twiddle_im[VAD_FFT_SIZE / 2];
+    uint16_t bitrev[VAD_FFT_SIZE];
+    float re[VAD_FFT_SIZE];
+    float im[VAD_FFT_SIZE];
+    
+    float noise_floor_db;
+    float smoothed_db;
+    float window_min_db[VAD_FLOOR_WINDOWS];
+    float current_min_db;
+    uint32_t window_frames;
+    uint32_t window_index;
+    
+    uint32_t speech_run;
+    uint32_t hangover_left;
+    bool active;
+};
+
+void vad_config_defaults(struct vad_config* config) {
+    config->enabled = true;
+    config->threshold_db = -40.0f;
+    config->snr_db = 9.0f;
+    config->onset_frames = 3;
+    config->hangover_frames = 30;
+    config->preroll_frames = 20;
+    config->min_speech_frames = 15;
+}
+
+struct vad* vad_create(const struct vad_config* config) {
+    struct vad* vad = bzalloc(sizeof(struct vad));
+    
+    if (config) {
+        vad->config = *config;
+    } else {
+        vad_config_defaults(&vad->config);
+    }
+    
+    for (uint32_t i = 0; i < VAD_FRAME_SAMPLES; i++) {
+        vad->window[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / (VAD_FRAME_SAMPLES - 1));
+    }
+    
+    for (uint32_t i = 0; i < VAD_FFT_SIZE / 2; i++) {
+        vad->twiddle_re[i] = cosf(-2.0f * (float)M_PI * i / VAD_FFT_SIZE);
+        vad->twiddle_im[i] = sinf(-2.0f * (float)M_PI * i / VAD_FFT_SIZE);
+    }
+    
+    uint32_t bits = 0;
+    while ((1u << bits) < VAD_FFT_SIZE) bits++;
+    for (uint32_t i = 0; i < VAD_FFT_SIZE; i++) {
+        uint32_t r = 0;
+        for (uint32_t b = 0; b < bits; b++) {
+            r |= ((i >> b) & 1u) << (bits - 1 - b);
+        }
+        vad->bitrev[i] = (uint16_t)r;
+    }
+    
+    vad_reset(vad);
+    return vad;
+}
+
+void vad_destroy(struct vad* vad) {
+    bfree(vad);
+}
+
+void vad_reset(struct vad* vad) {
+    if (!vad) return;
+    
+    vad->noise_floor_db = VAD_FLOOR_INIT_DB;
+    vad->smoothed_db = VAD_FLOOR_INIT_DB;
+    vad->current_min_db = VAD_FLOOR_INIT_DB;
+    for (uint32_t i = 0; i < VAD_FLOOR_WINDOWS; i++) {
+        vad->window_min_db[i] = VAD_FLOOR_INIT_DB;
+    }
+    vad->window_frames = 0;
+    vad->window_index = 0;
+    vad->speech_run = 0;
+    vad->hangover_left = 0;
+    vad->active = false;
+}
+
+void vad_set_config(struct vad* vad, const struct vad_config* config) {
+    if (vad && config) {
+        vad->config = *config;
+    }
+}
+
+// In-place iterative radix-2 FFT over vad->re/vad->im
+static void vad_fft(struct vad* vad) {
+    for (uint32_t i = 0; i < VAD_FFT_SIZE; i++) {
+        uint32_t j = vad->bitrev[i];
+        if (j > i) {
+            float t = vad->re[i]; vad->re[i] = vad->re[j]; vad->re[j] = t;
+            t = vad->im[i]; vad->im[i] = vad->im[j]; vad->im[j] = t;
+        }
+    }
+    
+    for (uint32_t size = 2; size <= VAD_FFT_SIZE; size <<= 1) {
+        uint32_t half = size / 2;
+        uint32_t step = VAD_FFT_SIZE / size;
+        for (uint32_t start = 0; start < VAD_FFT_SIZE; start += size) {
+            for (uint32_t k = 0; k < half; k++) {
+                float wr = vad->twiddle_re[k * step];
+                float wi = vad->twiddle_im[k * step];
+                uint32_t a = start + k;
+                uint32_t b = a + half;
+                float tr = vad->re[b] * wr - vad->im[b] * wi;
+                float ti = vad->re[b] * wi + vad->im[b] * wr;
+                vad->re[b] = vad->re[a] - tr;
+                vad->im[b] = vad->im[a] - ti;
+                vad->re[a] += tr;
+                vad->im[a] += ti;
+            }
+        }
+    }
+}
+
+static void vad_spectral_features(struct vad* vad, const float* frame,
+                                  float* band_ratio_out, float* flatness_out) {
+    for (uint32_t i = 0; i < VAD_FRAME_SAMPLES; i++) {
+        vad->re[i] = frame[i] * vad->window[i];
+        vad->im[i] = 0.0f;
+    }
+    for (uint32_t i = VAD_FRAME_SAMPLES; i < VAD_FFT_SIZE; i++) {
+        vad->re[i] = 0.0f;
+        vad->im[i] = 0.0f;
+    }
+    
+    vad_fft(vad);
+    
+    const uint32_t low_bin = (uint32_t)(VAD_SPEECH_LOW_HZ / VAD_BIN_HZ);
+    const uint32_t high_bin = (uint32_t)(VAD_SPEECH_HIGH_HZ / VAD_BIN_HZ);
+    
+    double total = 0.0;
+    double band = 0.0;
+    double log_sum = 0.0;
+    for (uint32_t k = 1; k < VAD_FFT_BINS; k++) {
+        double power = (double)vad->re[k] * vad->re[k] + (double)vad->im[k] * vad->im[k] + 1e-12;
+        total += power;
+        if (k >= low_bin && k <= high_bin) {
+            band += power;
+            log_sum += log(power);
+        }
+    }
+    
+    uint32_t band_bins = high_bin - low_bin + 1;
+    double arith_mean = band / band_bins;
+    double geo_mean = exp(log_sum / band_bins);
+    
+    *band_ratio_out = total > 0.0 ? (float)(band / total) : 0.0f;
+    *flatness_out = arith_mean > 0.0 ? (float)(geo_mean / arith_mean) : 1.0f;
+}
+
+static void vad_update_noise_floor(struct vad* vad, float energy_db) {
+    vad->smoothed_db += VAD_FLOOR_SMOOTHING * (energy_db - vad->smoothed_db);
+    if (vad->smoothed_db < vad->current_min_db) {
+        vad->current_min_db = vad->smoothed_db;
+    }
+    
+    if (++vad->window_frames >= VAD_FLOOR_WINDOW_FRAMES) {
+        vad->window_min_db[vad->window_index] = vad->current_min_db;
+        vad->window_index = (vad->window_index + 1) % VAD_FLOOR_WINDOWS;
+        vad->current_min_db = vad->smoothed_db;
+        vad->window_frames = 0;
+    }
+    
+    float floor_db = vad->current_min_db;
+    for (uint32_t i = 0; i < VAD_FLOOR_WINDOWS; i++) {
+        if (vad->window_min_db[i] < floor_db) {
+            floor_db = vad->window_min_db[i];
+        }
+    }
+    vad->noise_floor_db = floor_db;
+}
+
+bool vad_process_frame(struct vad* vad, const float* frame, struct vad_frame_result* result) {
+    struct vad_frame_result r = {0};
+    
+    float energy = audio_kernels_get()->sum_squares(frame, VAD_FRAME_SAMPLES) / VAD_FRAME_SAMPLES;
+    r.energy_db = energy > 1e-12f ? 10.0f * log10f(energy) : -120.0f;
+    
+    if (!vad->config.enabled) {
+        r.speech = true;
+        r.active = true;
+        r.noise_floor_db = vad->noise_floor_db;
+        if (result) *result = r;
+        return true;
+    }
+    
+    // Spectral features only matter once the frame is loud enough to count
+    bool loud = r.energy_db >= vad->config.threshold_db &&
+                r.energy_db >= vad->noise_floor_db + vad->config.snr_db;
+    if (loud) {
+        vad_spectral_features(vad, frame, &r.speech_band_ratio, &r.flatness);
+        r.speech = r.speech_band_ratio >= VAD_MIN_BAND_RATIO && r.flatness <= VAD_MAX_FLATNESS;
+    }
+    
+    vad_update_noise_floor(vad, r.energy_db);
+    r.noise_floor_db = vad->noise_floor_db;
+    
+    // Onset and hangover smoothing
+    if (r.speech) {
+        vad->speech_run++;
+        if (vad->speech_run >= vad->config.onset_frames) {
+            vad->active = true;
+        }
+        if (vad->active) {
+            vad->hangover_left = vad->config.hangover_frames;
+        }
+    } else {
+        vad->speech_run = 0;
+        if (vad->active) {
+            if (vad->hangover_left > 0) {
+                vad->hangover_left--;
+            } else {
+                vad->active = false;
+            }
+        }
+    }
+    
+    r.active = vad->active;
+    if (result) *result = r;
+    return r.active;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Segmenter                                                                 */
+
+struct vad_segmenter {
+    struct vad* vad;
+    struct vad_config config;
+    
+    float frame[VAD_FRAME_SAMPLES];
+    size_t frame_fill;
+    
+    // Current utterance (or pre-roll while idle)
+    float* buffer;
+    size_t buffer_len;
+    size_t max_samples;
+    size_t capacity;
+    uint64_t buffer_start; // stream position of buffer[0]
+    uint32_t speech_frames;
+    bool in_utterance;
+    
+    size_t partial_samples;
+    bool utterance_emitted; // part of the current utterance was already handed out
+    
+    uint64_t stream_pos;
+    struct vad_stats stats;
+};
+
+struct vad_segmenter* vad_segmenter_create(const struct vad_config* config,
+                                           size_t max_segment_samples) {
+    struct vad_segmenter* seg = bzalloc(sizeof(struct vad_segmenter));
+    
+    if (config) {
+        seg->config = *config;
+    } else {
+        vad_config_defaults(&seg->config);
+    }
+    
+    seg->vad = vad_create(&seg->config);
+    seg->capacity = max_segment_samples + VAD_FRAME_SAMPLES;
+    seg->max_samples = max_segment_samples;
+    seg->buffer = bmalloc(seg->capacity * sizeof(float));
+    return seg;
+}
+
+void vad_segmenter_destroy(struct vad_segmenter* segmenter) {
+    if (!segmenter) return;
+    
+    vad_destroy(segmenter->vad);
+    bfree(segmenter->buffer);
+    bfree(segmenter);
+}
+
+void vad_segmenter_set_config(struct vad_segmenter* segmenter, const struct vad_config* config) {
+    if (!segmenter || !config) return;
+    
+    segmenter->config = *config;
+    vad_set_config(segmenter->vad, config);
+}
+
+void vad_segmenter_set_max_samples(struct vad_segmenter* segmenter, size_t max_segment_samples) {
+    if (!segmenter) return;
+    
+    if (max_segment_samples + VAD_FRAME_SAMPLES > segmenter->capacity) {
+        max_segment_samples = segmenter->capacity - VAD_FRAME_SAMPLES;
+    }
+    segmenter->max_samples = max_segment_samples;
+}
+
+void vad_segmenter_set_partial_samples(struct vad_segmenter* segmenter, size_t partial_samples) {
+    if (!segmenter) return;
+    
+    segmenter->partial_samples = partial_samples;
+}
+
+void vad_segmenter_reset(struct vad_segmenter* segmenter) {
+    if (!segmenter) return;
+    
+    vad_reset(segmenter->vad);
+    segmenter->frame_fill = 0;
+    segmenter->buffer_len = 0;
+    segmenter->buffer_start = segmenter->stream_pos;
+    segmenter->speech_frames = 0;
+    segmenter->in_utterance = false;
+    segmenter->utterance_emitted = false;
+}
+
+bool vad_segmenter_active(const struct vad_segmenter* segmenter) {
+    return segmenter && segmenter->in_utterance;
+}
+
+void vad_segmenter_get_stats(const struct vad_segmenter* segmenter, struct vad_stats* stats) {
+    if (segmenter && stats) {
+        *stats = segmenter->stats;
+    }
+}
+
+static void segmenter_emit(struct vad_segmenter* seg, bool complete, bool partial,
+                           vad_segment_cb callback, void* param) {
+    bool keep;
+    if (seg->utterance_emitted) {
+        // The receiver already has the start of this utterance and needs its end
+        keep = seg->buffer_len > 0 || !partial;
+    } else {
+        keep = seg->buffer_len > 0 && seg->speech_frames >= seg->config.min_speech_frames;
+        
+        // A final whole-utterance RMS gate against the user's silence threshold
+        if (keep && seg->config.enabled) {
+            bool is_silence = false;
+            audio_buffer_apply_silence_detection(seg->buffer, seg->buffer_len,
+                                                 seg->config.threshold_db, &is_silence);
+            keep = !is_silence;
+        }
+    }
+    
+    if (keep) {
+        struct vad_segment segment;
+        segment.samples = seg->buffer_len > 0
+            ? bmemdup(seg->buffer, seg->buffer_len * sizeof(float)) : NULL;
+        segment.count = seg->buffer_len;
+        segment.start_sample = seg->buffer_start;
+        segment.start_ns = 0;
+        segment.end_ns = 0;
+        segment.complete = complete;
+        segment.first = !seg->utterance_emitted;
+        segment.partial = partial;
+        if (segment.first) {
+            seg->stats.segments++;
+        }
+        seg->utterance_emitted = partial;
+        callback(param, &segment);
+    } else if (seg->buffer_len > 0 && !partial) {
+        seg->stats.discarded_segments++;
+    }
+    
+    if (keep || !partial) {
+        seg->buffer_start += seg->buffer_len;
+        seg->buffer_len = 0;
+        seg->speech_frames = 0;
+    }
+}
+
+static void segmenter_frame(struct vad_segmenter* seg, vad_segment_cb callback, void* param) {
+    struct vad_frame_result result;
+    bool active = vad_process_frame(seg->vad, seg->frame, &result);
+    
+    seg->stats.frames++;
+    if (result.speech) {
+        seg->stats.speech_frames++;
+    }
+    
+    memcpy(seg->buffer + seg->buffer_len, seg->frame, sizeof(seg->frame));
+    seg->buffer_len += VAD_FRAME_SAMPLES;
+    
+    if (!seg->in_utterance) {
+        if (active) {
+            seg->in_utterance = true;
+            seg->speech_frames = seg->config.onset_frames;
+        } else {
+            // Idle: keep only the pre-roll
+            size_t preroll = (size_t)seg->config.preroll_frames * VAD_FRAME_SAMPLES;
+            if (seg->buffer_len > preroll) {
+                size_t drop = seg->buffer_len - preroll;
+                memmove(seg->buffer, seg->buffer + drop, preroll * sizeof(float));
+                seg->buffer_len = preroll;
+                seg->buffer_start += drop;
+            }
+            return;
+        }
+    } else if (result.speech) {
+        seg->speech_frames++;
+    }
+    
+    if (!active) {
+        // Hangover elapsed: the pause ends the utterance
+        seg->in_utterance = false;
+        segmenter_emit(seg, true, false, callback, param);
+    } else if (seg->buffer_len + VAD_FRAME_SAMPLES > seg->max_samples) {
+        // Length limit reached mid-speech: cut and keep going
+        segmenter_emit(seg, false, false, callback, param);
+        seg->speech_frames = seg->config.min_speech_frames;
+    } else if (seg->partial_samples > 0 && seg->buffer_len >= seg->partial_samples) {
+        // Streaming: hand out what we have, the utterance keeps going
+        segmenter_emit(seg, false, true, callback, param);
+    }
+}
+
+void vad_segmenter_push(struct vad_segmenter* segmenter, const float* samples, size_t count,
+                        vad_segment_cb callback, void* param) {
+    if (!segmenter || !samples) return;
+    
+    struct vad_segmenter* seg = segmenter;
+    while (count > 0) {
+        size_t take = VAD_FRAME_SAMPLES - seg->frame_fill;
+        if (take > count) {
+            take = count;
+        }
+        
+        memcpy(seg->frame + seg->frame_fill, samples, take * sizeof(float));
+        seg->frame_fill += take;
+        seg->stream_pos += take;
+        samples += take;
+        count -= take;
+        
+        if (seg->frame_fill == VAD_FRAME_SAMPLES) {
+            seg->frame_fill = 0;
+            segmenter_frame(seg, callback, param);
+        }
+    }
+}
+
+void vad_segmenter_flush(struct vad_segmenter* segmenter, vad_segment_cb callback, void* param) {
+    if (!segmenter) return;
+    
+    if (segmenter->in_utterance) {
+        segmenter_emit(segmenter, true, false, callback, param);
+    } else {
+        segmenter->buffer_start += segmenter->buffer_len;
+        segmenter->buffer_len = 0;
+    }
+    
+    segmenter->in_utterance = false;
+    segmenter->utterance_emitted = false;
+    segmenter->speech_frames = 0;
+    vad_reset(segmenter->vad);
+}
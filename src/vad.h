@@ -0,0 +1,88 @@
+#pragma once
+
+#include <obs-module.h>
+
+// Streaming voice-activity detection and utterance segmentation on 16kHz
+// mono audio.
+//
+// Each 10 ms frame is classified from its energy relative to an adaptive
+// noise floor plus two spectral features (speech-band energy ratio and
+// spectral flatness). A short onset requirement rejects clicks, and a
+// hangover keeps the detector active through brief pauses inside a phrase.
+// The segmenter cuts the stream into utterances at longer pauses so that only
+// speech is handed to the recognizer.
+
+#define VAD_SAMPLE_RATE 16000
+#define VAD_FRAME_SAMPLES 160 // 10 ms at 16kHz
+
+struct vad_config {
+    bool enabled;          // when false every frame counts as speech
+    float threshold_db;    // absolute floor, frames quieter than this are never speech
+    float snr_db;          // required margin above the adaptive noise floor
+    uint32_t onset_frames; // consecutive speech frames needed to start an utterance
+    uint32_t hangover_frames;   // frames the detector stays active after speech stops
+    uint32_t preroll_frames;    // audio kept from before the onset
+    uint32_t min_speech_frames; // shorter utterances are discarded
+};
+
+struct vad_frame_result {
+    float energy_db;
+    float noise_floor_db;
+    float speech_band_ratio;
+    float flatness;
+    bool speech; // raw per-frame decision
+    bool active; // decision after onset and hangover smoothing
+};
+
+struct vad_segment {
+    float* samples;        // owned by the receiver, release with bfree
+    size_t count;
+    uint64_t start_sample; // position in the 16kHz stream fed to the segmenter
+    uint64_t start_ns;     // capture times, filled in by the receiver if it
+    uint64_t end_ns;       // knows them; 0 from the segmenter
+    bool complete;         // false when cut at the length limit mid-speech
+    bool first;            // starts a new utterance
+    bool partial;          // the utterance continues in the next segment
+};
+
+struct vad_stats {
+    uint64_t frames;
+    uint64_t speech_frames;
+    uint64_t segments;
+    uint64_t discarded_segments;
+};
+
+typedef void (*vad_segment_cb)(void* param, struct vad_segment* segment);
+
+void vad_config_defaults(struct vad_config* config);
+
+struct vad;
+struct vad* vad_create(const struct vad_config* config);
+void vad_destroy(struct vad* vad);
+void vad_reset(struct vad* vad);
+void vad_set_config(struct vad* vad, const struct vad_config* config);
+bool vad_process_frame(struct vad* vad, const float* frame, struct vad_frame_result* result);
+
+struct vad_segmenter;
+struct vad_segmenter* vad_segmenter_create(const struct vad_config* config,
+                                           size_t max_segment_samples);
+void vad_segmenter_destroy(struct vad_segmenter* segmenter);
+void vad_segmenter_set_config(struct vad_segmenter* segmenter, const struct vad_config* config);
+void vad_segmenter_set_max_samples(struct vad_segmenter* segmenter, size_t max_segment_samples);
+
+// Hands out the utterance in progress every `partial_samples` samples for
+// streaming decoders, 0 waits for the pause. Once the first piece of an
+// utterance is out the rest is always delivered, ending with a non-partial
+// segment that may be empty.
+void vad_segmenter_set_partial_samples(struct vad_segmenter* segmenter, size_t partial_samples);
+
+// Feeds samples and calls `callback` for every utterance completed by them
+void vad_segmenter_push(struct vad_segmenter* segmenter, const float* samples, size_t count,
+                        vad_segment_cb callback, void* param);
+
+// Emits the utterance in progress, if any, and returns to idle
+void vad_segmenter_flush(struct vad_segmenter* segmenter, vad_segment_cb callback, void* param);
+void vad_segmenter_reset(struct vad_segmenter* segmenter);
+
+bool vad_segmenter_active(const struct vad_segmenter* segmenter);
+void vad_segmenter_get_stats(const struct vad_segmenter* segmenter, struct vad_stats* stats);
@@ -1,19 +1,331 @@
 #include "whisper-engine.h"
 #include <obs-module.h>
+#include <util/bmem.h>
+#include <util/platform.h>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <filesystem>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cmath>
+#include <cctype>
+#include <vector>
+#include <algorithm>
 
-// Note: This is a stub implementation. In a real implementation, you would:
-// 1. Include whisper.cpp headers
-// 2. Link against whisper.cpp library
-// 3. Implement actual Whisper integration
+#ifdef HAVE_WHISPER_CPP
+#include <whisper.h>
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define MAX_PROMPT_TOKENS 64 // of the previous transcript; longer prompts slow every decode
+
+// What makes two loads of a model file interchangeable. The canonical path
+// alone misses a model replaced in place, so size, mtime and (where the
+// platform has them) device and inode are compared too.
+struct ModelIdentity {
+    uintmax_t size = 0;
+    int64_t mtime = 0;
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    
+    bool operator==(const ModelIdentity& other) const {
+        return size == other.size && mtime == other.mtime &&
+               device == other.device && inode == other.inode;
+    }
+    bool operator!=(const ModelIdentity& other) const { return !(*this == other); }
+};
+
+// Read-only memory mapping of the weights file. Pages are shared with the
+// OS file cache, so every stream and every filter uses one physical copy.
+struct MappedFile {
+    const void* data = nullptr;
+    size_t size = 0;
+    
+    ~MappedFile() {
+        if (!data) return;
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+#else
+        munmap(const_cast<void*>(data), size);
+#endif
+    }
+};
+
+// Weights shared by every stream using the same file. Owned through
+// shared_ptr by the per-stream contexts; the registry only keeps weak
+// references, so the model goes away with the last stream.
+struct WhisperModel {
+    std::string path;
+    ModelIdentity identity;
+#ifdef HAVE_WHISPER_CPP
+    whisper_context* whisper_ctx = nullptr; // built without a state of its own
+    
+    ~WhisperModel() {
+        if (whisper_ctx) whisper_free(whisper_ctx);
+    }
+#else
+    MappedFile weights; // stands in for the loaded model
+#endif
+};
 
 struct WhisperContext {
-    std::string model_path;
+    std::shared_ptr<WhisperModel> model;
     bool initialized;
-    // void* whisper_ctx; // Would be whisper_context* from whisper.cpp
+    whisper_engine_params params{};
+#ifdef HAVE_WHISPER_CPP
+    whisper_state* state = nullptr; // this stream's decoder buffers
+    std::vector<whisper_token> prompt;
+#endif
 };
 
+static std::mutex registry_mutex;
+static std::unordered_map<std::string, std::weak_ptr<WhisperModel>> model_registry;
+
+static bool canonical_model_path(const char* model_path, std::string& out) {
+    std::error_code ec;
+    std::filesystem::path path = std::filesystem::u8path(model_path);
+    std::filesystem::path canonical = std::filesystem::canonical(path, ec);
+    if (ec) return false;
+    
+    out = canonical.u8string();
+    return true;
+}
+
+static bool model_identity(const std::string& path, ModelIdentity& identity) {
+    std::error_code ec;
+    std::filesystem::path fs_path = std::filesystem::u8path(path);
+    
+    identity.size = std::filesystem::file_size(fs_path, ec);
+    if (ec) return false;
+    
+    auto mtime = std::filesystem::last_write_time(fs_path, ec);
+    if (ec) return false;
+    identity.mtime = (int64_t)mtime.time_since_epoch().count();
+
+#ifndef _WIN32
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    identity.device = (uint64_t)st.st_dev;
+    identity.inode = (uint64_t)st.st_ino;
+#endif
+    return true;
+}
+
+static bool map_file(const std::string& path, MappedFile& mapped) {
+#ifdef _WIN32
+    wchar_t* wpath = nullptr;
+    os_utf8_to_wcs_ptr(path.c_str(), 0, &wpath);
+    HANDLE file = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    bfree(wpath);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) return false;
+    
+    // The view keeps the mapping object alive on its own
+    mapped.data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    mapped.size = (size_t)size.QuadPart;
+#else
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    
+    void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    
+    mapped.data = data;
+    mapped.size = (size_t)st.st_size;
+#endif
+    return mapped.data != nullptr;
+}
+
+// Returns the shared model for `model_path`, mapping it only if no live model
+// matches the file as it is on disk now. A changed file gets a fresh model;
+// streams still holding the old one keep it until they are destroyed.
+static std::shared_ptr<WhisperModel> acquire_model(const char* model_path) {
+    std::string path;
+    if (!canonical_model_path(model_path, path)) {
+        blog(LOG_ERROR, "Whisper: Model file not found: %s", model_path);
+        return nullptr;
+    }
+    
+    ModelIdentity identity;
+    if (!model_identity(path, identity)) {
+        blog(LOG_ERROR, "Whisper: Unable to stat model file %s", path.c_str());
+        return nullptr;
+    }
+    
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    
+    auto it = model_registry.find(path);
+    if (it != model_registry.end()) {
+        std::shared_ptr<WhisperModel> model = it->second.lock();
+        if (model && model->identity == identity) {
+            blog(LOG_INFO, "Whisper: Sharing loaded model %s (%ld streams)",
+                 path.c_str(), (long)model.use_count());
+            return model;
+        }
+    }
+    
+    auto model = std::make_shared<WhisperModel>();
+    model->path = path;
+    model->identity = identity;
+    
+    uint64_t start = os_gettime_ns();
+    size_t size = 0;
+#ifdef HAVE_WHISPER_CPP
+    // whisper.cpp copies the weights into its own buffers, so the mapping is
+    // only needed while the context is built
+    {
+        MappedFile weights;
+        if (!map_file(path, weights)) {
+            blog(LOG_ERROR, "Whisper: Failed to map model file %s", path.c_str());
+            return nullptr;
+        }
+        size = weights.size;
+        model->whisper_ctx = whisper_init_from_buffer_with_params_no_state(
+            const_cast<void*>(weights.data), weights.size, whisper_context_default_params());
+    }
+    if (!model->whisper_ctx) {
+        blog(LOG_ERROR, "Whisper: Failed to load model %s", path.c_str());
+        return nullptr;
+    }
+#else
+    if (!map_file(path, model->weights)) {
+        blog(LOG_ERROR, "Whisper: Failed to map model file %s", path.c_str());
+        return nullptr;
+    }
+    size = model->weights.size;
+#endif
+
+    blog(LOG_INFO, "Whisper: Loaded model %s (%.1f MB in %.1f ms)", path.c_str(),
+         size / (1024.0 * 1024.0), (os_gettime_ns() - start) / 1000000.0);
+    
+    // Drop entries whose models have been released meanwhile
+    for (auto entry = model_registry.begin(); entry != model_registry.end();) {
+        if (entry->second.expired()) {
+            entry = model_registry.erase(entry);
+        } else {
+            ++entry;
+        }
+    }
+    
+    model_registry[path] = model;
+    return model;
+}
+
+struct DecodedToken {
+    std::string text;
+    float logprob;
+};
+
+struct DecodedSegment {
+    std::vector<DecodedToken> tokens;
+    float no_speech_prob = 0.0f;
+};
+
+// Joins the decoded tokens into the transcript and derives its confidence
+// from their log-probabilities. Word boundaries are the whitespace in the
+// token text, so the word list lines up with a plain whitespace split of
+// the result; a token spanning a boundary counts towards both words.
+static bool score_transcript(const std::vector<DecodedSegment>& segments,
+                             whisper_transcript* transcript) {
+    std::string text;
+    std::vector<float> words;
+    double word_logprob = 0.0;
+    int word_tokens = 0;
+    bool in_word = false;
+    double total = 0.0;
+    int total_tokens = 0;
+    float max_no_speech = 0.0f;
+    
+    auto close_word = [&](float speech) {
+        if (in_word && word_tokens > 0) {
+            words.push_back((float)std::exp(word_logprob / word_tokens) * speech);
+        }
+        in_word = false;
+        word_logprob = 0.0;
+        word_tokens = 0;
+    };
+    
+    for (const DecodedSegment& segment : segments) {
+        float speech = 1.0f - segment.no_speech_prob;
+        max_no_speech = std::max(max_no_speech, segment.no_speech_prob);
+        
+        for (const DecodedToken& token : segment.tokens) {
+            bool counted = false;
+            for (char c : token.text) {
+                if (isspace((unsigned char)c)) {
+                    close_word(speech);
+                    if (!text.empty() && !isspace((unsigned char)text.back())) {
+                        text += ' ';
+                    }
+                    continue;
+                }
+                if (!in_word) {
+                    in_word = true;
+                    counted = false;
+                }
+                if (!counted) {
+                    word_logprob += token.logprob;
+                    word_tokens++;
+                    counted = true;
+                }
+                text += c;
+            }
+            total += token.logprob + std::log(std::max(speech, 1e-6f));
+            total_tokens++;
+        }
+        
+        // Segments are separate phrases even without a leading space
+        close_word(speech);
+        if (!text.empty() && !isspace((unsigned char)text.back())) {
+            text += ' ';
+        }
+    }
+    
+    while (!text.empty() && isspace((unsigned char)text.back())) {
+        text.pop_back();
+    }
+    if (text.empty()) {
+        return false;
+    }
+    
+    transcript->text = bstrdup(text.c_str());
+    transcript->confidence = total_tokens > 0 ? (float)std::exp(total / total_tokens) : 0.0f;
+    transcript->no_speech_prob = max_no_speech;
+    transcript->word_count = words.size();
+    transcript->word_confidence = (float*)bmemdup(words.data(), words.size() * sizeof(float));
+    return true;
+}
+
 extern "C" {
 
 void* whisper_engine_create(const char* model_path) {
@@ -22,18 +334,27 @@ void* whisper_engine_create(const char* model_path) {
         return nullptr;
     }
     
+    std::shared_ptr<WhisperModel> model = acquire_model(model_path);
+    if (!model) {
+        return nullptr;
+    }
+    
     auto context = std::make_unique<WhisperContext>();
-    context->model_path = std::string(model_path);
+    context->model = model;
     context->initialized = false;
-    
-    // TODO: Initialize whisper.cpp context here
-    // context->whisper_ctx = whisper_init_from_file(model_path);
-    // if (!context->whisper_ctx) {
-    //     blog(LOG_ERROR, "Whisper: Failed to load model from %s", model_path);
-    //     return nullptr;
-    // }
-    
-    blog(LOG_INFO, "Whisper: Engine created with model: %s", model_path);
+    context->params.n_threads = 4;
+    context->params.beam_size = 1;
+    context->params.single_segment = true;
+
+#ifdef HAVE_WHISPER_CPP
+    context->state = whisper_init_state(model->whisper_ctx);
+    if (!context->state) {
+        blog(LOG_ERROR, "Whisper: Failed to create decoder state for %s", model_path);
+        return nullptr;
+    }
+#endif
+
+    blog(LOG_INFO, "Whisper: Engine created with model: %s", model->path.c_str());
     context->initialized = true;
     
     return context.release();
@@ -44,90 +365,176 @@ void whisper_engine_destroy(void* ctx) {
     
     WhisperContext* context = static_cast<WhisperContext*>(ctx);
     
-    // TODO: Free whisper.cpp context
-    // if (context->whisper_ctx) {
-    //     whisper_free(context->whisper_ctx);
-    // }
-    
+    // The shared context is freed with the last reference to the model
+#ifdef HAVE_WHISPER_CPP
+    if (context->state) {
+        whisper_free_state(context->state);
+    }
+#endif
+
     blog(LOG_INFO, "Whisper: Engine destroyed");
     delete context;
 }
 
-char* whisper_engine_transcribe(void* ctx, const float* audio_data, 
-                               size_t sample_count, const char* language_hint, 
-                               float* confidence_out) {
+void whisper_engine_set_params(void* ctx, const struct whisper_engine_params* params) {
+    if (!ctx || !params) return;
+    
+    WhisperContext* context = static_cast<WhisperContext*>(ctx);
+    context->params = *params;
+    context->params.n_threads = std::max(params->n_threads, 1);
+    context->params.beam_size = std::max(params->beam_size, 1);
+}
+
+void whisper_engine_set_prompt(void* ctx, const char* text) {
+    if (!ctx) return;
+
+#ifdef HAVE_WHISPER_CPP
+    WhisperContext* context = static_cast<WhisperContext*>(ctx);
+    context->prompt.clear();
+    if (!text || !*text) return;
+    
+    // A negative count is the number of tokens the text would need
+    whisper_context* whisper_ctx = context->model->whisper_ctx;
+    std::string spaced = std::string(" ") + text;
+    std::vector<whisper_token> tokens(MAX_PROMPT_TOKENS * 2);
+    int count = whisper_tokenize(whisper_ctx, spaced.c_str(), tokens.data(), (int)tokens.size());
+    if (count < 0) {
+        tokens.resize((size_t)-count);
+        count = whisper_tokenize(whisper_ctx, spaced.c_str(), tokens.data(), (int)tokens.size());
+    }
+    if (count <= 0) return;
+    
+    int first = std::max(count - MAX_PROMPT_TOKENS, 0);
+    context->prompt.assign(tokens.begin() + first, tokens.begin() + count);
+#else
+    UNUSED_PARAMETER(text);
+#endif
+}
+
+bool whisper_engine_model_changed(void* ctx, const char* model_path) {
+    if (!ctx || !model_path) return true;
+    
+    WhisperContext* context = static_cast<WhisperContext*>(ctx);
+    
+    std::string path;
+    ModelIdentity identity;
+    if (!canonical_model_path(model_path, path) || !model_identity(path, identity)) {
+        return true;
+    }
+    return path != context->model->path || identity != context->model->identity;
+}
+
+bool whisper_engine_transcribe_detailed(void* ctx, const float* audio_data,
+                                        size_t sample_count, const char* language_hint,
+                                        struct whisper_transcript* transcript) {
+    if (!transcript) return false;
+    *transcript = whisper_transcript{};
+    
     if (!ctx || !audio_data || sample_count == 0) {
-        if (confidence_out) *confidence_out = 0.0f;
-        return nullptr;
+        return false;
     }
     
     WhisperContext* context = static_cast<WhisperContext*>(ctx);
     if (!context->initialized) {
         blog(LOG_ERROR, "Whisper: Engine not initialized");
-        if (confidence_out) *confidence_out = 0.0f;
-        return nullptr;
+        return false;
     }
     
-    // TODO: Implement actual Whisper transcription
-    // This is a placeholder implementation
-    
-    // Example of what the real implementation would look like:
-    /*
-    // Prepare whisper parameters
-    whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    std::vector<DecodedSegment> segments;
+
+#ifdef HAVE_WHISPER_CPP
+    const whisper_engine_params& options = context->params;
+    whisper_full_params params = whisper_full_default_params(
+        options.beam_size > 1 ? WHISPER_SAMPLING_BEAM_SEARCH : WHISPER_SAMPLING_GREEDY);
+    params.n_threads = options.n_threads;
+    params.beam_search.beam_size = options.beam_size;
     params.language = language_hint && strlen(language_hint) > 0 ? language_hint : "auto";
     params.translate = false;
+    params.print_special = false;
     params.print_progress = false;
+    params.print_realtime = false;
     params.print_timestamps = false;
+    params.single_segment = options.single_segment;
+    params.no_timestamps = options.single_segment;
     
-    // Run inference
-    if (whisper_full(context->whisper_ctx, params, audio_data, sample_count) != 0) {
-        blog(LOG_ERROR, "Whisper: Failed to process audio");
-        if (confidence_out) *confidence_out = 0.0f;
-        return nullptr;
+    // whisper.cpp would otherwise carry the tokens of every window it decoded,
+    // including the overlap that streaming decodes again; the prompt is the
+    // committed transcript instead
+    params.no_context = true;
+    if (!options.no_context && !context->prompt.empty()) {
+        params.prompt_tokens = context->prompt.data();
+        params.prompt_n_tokens = (int)context->prompt.size();
     }
     
-    // Get transcription results
-    const int n_segments = whisper_full_n_segments(context->whisper_ctx);
-    if (n_segments <= 0) {
-        if (confidence_out) *confidence_out = 0.0f;
-        return nullptr;
+    // Run inference on this stream's state; the weights are shared
+    whisper_context* whisper_ctx = context->model->whisper_ctx;
+    if (whisper_full_with_state(whisper_ctx, context->state, params, audio_data,
+                                (int)sample_count) != 0) {
+        blog(LOG_ERROR, "Whisper: Failed to process audio");
+        return false;
     }
     
-    std::string full_text;
-    float total_confidence = 0.0f;
-    
+    // Collect the tokens with their log-probabilities; special and
+    // timestamp tokens (ids from whisper_token_eot on) carry no text
+    whisper_token eot = whisper_token_eot(whisper_ctx);
+    const int n_segments = whisper_full_n_segments_from_state(context->state);
     for (int i = 0; i < n_segments; ++i) {
-        const char* text = whisper_full_get_segment_text(context->whisper_ctx, i);
-        if (text) {
-            full_text += text;
-        }
+        DecodedSegment segment;
+        segment.no_speech_prob = whisper_full_get_segment_no_speech_prob_from_state(
+            context->state, i);
         
-        // Note: whisper.cpp doesn't provide direct confidence scores
-        // You might need to implement your own confidence calculation
-        total_confidence += 0.8f; // Placeholder
-    }
-    
-    if (confidence_out) {
-        *confidence_out = n_segments > 0 ? total_confidence / n_segments : 0.0f;
+        const int n_tokens = whisper_full_n_tokens_from_state(context->state, i);
+        for (int j = 0; j < n_tokens; ++j) {
+            whisper_token_data data = whisper_full_get_token_data_from_state(context->state, i, j);
+            if (data.id >= eot) continue;
+            
+            DecodedToken token;
+            token.text = whisper_full_get_token_text_from_state(whisper_ctx, context->state, i, j);
+            token.logprob = data.plog;
+            segment.tokens.push_back(token);
+        }
+        segments.push_back(segment);
     }
-    
-    return strdup(full_text.c_str());
-    */
-    
-    // Placeholder implementation for testing
-    blog(LOG_INFO, "Whisper: Processing %zu samples (language: %s)", 
+#else
+    blog(LOG_INFO, "Whisper: Processing %zu samples (language: %s)",
          sample_count, language_hint ? language_hint : "auto");
     
     // Simulate transcription delay
-    usleep(100000); // 100ms
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
     
+    // Placeholder transcription, one token per word at a simulated 85%
+    DecodedSegment placeholder;
+    for (const char* word : {"[Placeholder", " transcription", " -", " Whisper", " not", " yet",
+                             " integrated]"}) {
+        placeholder.tokens.push_back(DecodedToken{word, std::log(0.85f)});
+    }
+    segments.push_back(placeholder);
+#endif
+
+    return score_transcript(segments, transcript);
+}
+
+void whisper_transcript_free(struct whisper_transcript* transcript) {
+    if (!transcript) return;
+    bfree(transcript->text);
+    bfree(transcript->word_confidence);
+    *transcript = whisper_transcript{};
+}
+
+char* whisper_engine_transcribe(void* ctx, const float* audio_data, 
+                               size_t sample_count, const char* language_hint, 
+                               float* confidence_out) {
+    whisper_transcript transcript;
+    bool ok = whisper_engine_transcribe_detailed(ctx, audio_data, sample_count, language_hint,
+                                                 &transcript);
     if (confidence_out) {
-        *confidence_out = 0.85f; // Simulated confidence
+        *confidence_out = ok ? transcript.confidence : 0.0f;
     }
     
-    // Return placeholder transcription
-    return strdup("[Placeholder transcription - Whisper not yet integrated]");
+    char* text = transcript.text;
+    transcript.text = nullptr;
+    whisper_transcript_free(&transcript);
+    return text;
 }
 
 } // extern "C"
\ No newline at end of file
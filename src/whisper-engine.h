@@ -1,11 +1,59 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Engines are per-stream decoder states. Filters opening the same model file
+// share one loaded copy of the weights; the file is loaded again only once it
+// has changed on disk. Each engine keeps its own whisper.cpp state, so the
+// decoder buffers are allocated once per stream instead of once per call.
+//
+// Built without whisper.cpp (HAVE_WHISPER_CPP undefined) the engine returns
+// a fixed placeholder transcript after a short simulated decode.
 void* whisper_engine_create(const char* model_path);
 void whisper_engine_destroy(void* context);
+
+struct whisper_engine_params {
+    int n_threads;       // decoder threads, at least 1
+    int beam_size;       // 1 decodes greedily
+    bool no_context;     // decode without the previous transcript as prompt
+    bool single_segment; // one segment without timestamps, for short windows
+};
+
+// The engine functions below are not thread-safe; call them from the thread
+// that decodes with the engine.
+void whisper_engine_set_params(void* context, const struct whisper_engine_params* params);
+
+// Text the next decodes are conditioned on, normally the last transcript of
+// the stream. Only its last few dozen tokens are kept; NULL clears it.
+void whisper_engine_set_prompt(void* context, const char* text);
+
+// True when `model_path` no longer names the file this engine was loaded from,
+// either because the path differs or because the file was modified
+bool whisper_engine_model_changed(void* context, const char* model_path);
+
+// Decoder output with confidence taken from the token log-probabilities.
+// A word's confidence is the geometric mean of its tokens' probabilities,
+// scaled by 1 - no-speech probability of the segment it came from; the
+// overall confidence does the same over every text token. `word_confidence`
+// has one entry per whitespace-separated word of `text`, in order.
+struct whisper_transcript {
+    char* text;
+    float confidence;
+    float no_speech_prob; // highest of the decoded segments
+    float* word_confidence;
+    size_t word_count;
+};
+
+bool whisper_engine_transcribe_detailed(void* context, const float* audio_data,
+                                        size_t sample_count, const char* language_hint,
+                                        struct whisper_transcript* transcript);
+void whisper_transcript_free(struct whisper_transcript* transcript);
+
 char* whisper_engine_transcribe(void* context, const float* audio_data, 
                                size_t sample_count, const char* language_hint, 
                                float* confidence_out);